@@ -115,6 +115,8 @@ function bench_run() {
     local isa2technique_cauchy='cauchy'
     local jerasure2technique_vandermonde='reed_sol_van'
     local jerasure2technique_cauchy='cauchy_good'
+    local clay2technique_vandermonde='reed_sol_van'
+    local clay2technique_cauchy='cauchy_good'
     for technique in ${TECHNIQUES} ; do
         for plugin in ${PLUGINS} ; do
             eval technique_parameter=\$${plugin}2technique_${technique}
@@ -147,6 +149,20 @@ function bench_run() {
             done
         done
     done
+    for technique in ${TECHNIQUES} ; do
+        for plugin in ${PLUGINS} ; do
+            eval technique_parameter=\$${plugin}2technique_${technique}
+            echo "serie repair_${technique}_${plugin}"
+            for k in $ks ; do
+                for m in ${k2ms[$k]} ; do
+                    bench $plugin $k $m repair $(($TOTAL_SIZE / $SIZE)) $SIZE 1 \
+                        --parameter packetsize=$(packetsize $k $w $VECTOR_WORDSIZE  $SIZE) \
+                        ${PARAMETERS} \
+                        --parameter technique=$technique_parameter
+                done
+            done
+        done
+    done
 }
 
 function fplot() {
@@ -162,7 +178,7 @@ function fplot() {
             echo "var $serie = ["
         else
             local x
-            if [ $workload = encode ] ; then
+            if [ $workload = encode ] || [ $workload = repair ] ; then
                 x=$k/$m
             else
                 x=$k/$m/$erasures
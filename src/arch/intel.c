@@ -23,6 +23,9 @@ int ceph_arch_intel_ssse3 = 0;
 int ceph_arch_intel_sse3 = 0;
 int ceph_arch_intel_sse2 = 0;
 int ceph_arch_intel_aesni = 0;
+int ceph_arch_intel_avx2 = 0;
+int ceph_arch_intel_avx512bw = 0;
+int ceph_arch_intel_gfni = 0;
 
 #ifdef __x86_64__
 #include <cpuid.h>
@@ -36,6 +39,24 @@ int ceph_arch_intel_aesni = 0;
 #define CPUID_SSE3	(1)
 #define CPUID_SSE2	(1 << 26)
 #define CPUID_AESNI (1 << 25)
+#define CPUID_OSXSAVE	(1 << 27)
+
+/* leaf 7 */
+#define CPUID_AVX2	(1 << 5)
+#define CPUID_AVX512F	(1 << 16)
+#define CPUID_AVX512BW	(1 << 30)
+#define CPUID_GFNI	(1 << 8)
+
+/* XCR0: the OS saves the xmm/ymm and opmask/zmm registers */
+#define XCR0_YMM	0x6
+#define XCR0_ZMM	0xe6
+
+static unsigned long long xgetbv(unsigned int index)
+{
+	unsigned int eax, edx;
+	__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+	return ((unsigned long long)edx << 32) | eax;
+}
 
 int ceph_arch_intel_probe(void)
 {
@@ -66,6 +87,27 @@ int ceph_arch_intel_probe(void)
           ceph_arch_intel_aesni = 1;
   }
 
+	/* the vector extensions are of no use unless the OS saves the
+	 * registers they use on context switches */
+	if ((ecx & CPUID_OSXSAVE) == 0) {
+		return 0;
+	}
+	unsigned long long xcr0 = xgetbv(0);
+	if ((xcr0 & XCR0_YMM) != XCR0_YMM ||
+	    !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+		return 0;
+	}
+	if ((ebx & CPUID_AVX2) != 0) {
+		ceph_arch_intel_avx2 = 1;
+	}
+	if ((ebx & CPUID_AVX512F) != 0 && (ebx & CPUID_AVX512BW) != 0 &&
+	    (xcr0 & XCR0_ZMM) == XCR0_ZMM) {
+		ceph_arch_intel_avx512bw = 1;
+	}
+	if ((ecx & CPUID_GFNI) != 0) {
+		ceph_arch_intel_gfni = 1;
+	}
+
 	return 0;
 }
 
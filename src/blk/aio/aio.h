@@ -103,6 +103,16 @@ struct io_queue_t {
   virtual int submit_batch(aio_iter begin, aio_iter end, uint16_t aios_size,
 			   void *priv, int *retries) = 0;
   virtual int get_next_completed(int timeout_ms, aio_t **paio, int max) = 0;
+
+  /// get a buffer pre-registered with the kernel for I/O, if the queue
+  /// supports it and one is available; nullptr otherwise
+  virtual ceph::unique_leakable_ptr<ceph::buffer::raw> try_create_fixed(
+    size_t len) {
+    return nullptr;
+  }
+  virtual size_t get_fixed_buffer_size() const {
+    return 0;
+  }
 };
 
 struct aio_queue_t final : public io_queue_t {
@@ -39,6 +39,7 @@
 #endif
 #include "common/debug.h"
 #include "common/numa.h"
+#include "common/perf_counters.h"
 
 #include "global/global_context.h"
 #include "io_uring.h"
@@ -74,14 +75,23 @@ KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv, ai
   fd_directs.resize(WRITE_LIFE_MAX, -1);
   fd_buffereds.resize(WRITE_LIFE_MAX, -1);
 
-  bool use_ioring = cct->_conf.get_val<bool>("bdev_ioring");
+  use_ioring = cct->_conf.get_val<bool>("bdev_ioring");
   unsigned int iodepth = cct->_conf->bdev_aio_max_queue_depth;
 
   if (use_ioring && ioring_queue_t::supported()) {
     bool use_ioring_hipri = cct->_conf.get_val<bool>("bdev_ioring_hipri");
     bool use_ioring_sqthread_poll = cct->_conf.get_val<bool>("bdev_ioring_sqthread_poll");
-    io_queue = std::make_unique<ioring_queue_t>(iodepth, use_ioring_hipri, use_ioring_sqthread_poll);
+    unsigned fixed_buffers =
+      cct->_conf.get_val<uint64_t>("bdev_ioring_fixed_buffers");
+    size_t fixed_buffer_size = p2roundup<uint64_t>(
+      cct->_conf.get_val<Option::size_t>("bdev_ioring_fixed_buffer_size"),
+      CEPH_PAGE_SIZE);
+    io_queue = std::make_unique<ioring_queue_t>(iodepth, use_ioring_hipri,
+                                                use_ioring_sqthread_poll,
+                                                fixed_buffers,
+                                                fixed_buffer_size);
   } else {
+    use_ioring = false;
     static bool once;
     if (use_ioring && !once) {
       derr << "WARNING: io_uring API is not supported! Fallback to libaio!"
@@ -288,6 +298,8 @@ int KernelDevice::open(const string& p)
   // round size down to an even block
   size &= ~(block_size - 1);
 
+  _init_logger();
+
   dout(1) << __func__
 	  << " size " << size
 	  << " (0x" << std::hex << size << std::dec << ", "
@@ -296,6 +308,8 @@ int KernelDevice::open(const string& p)
 	  << " (" << byte_u_t(block_size) << ")"
 	  << " " << (rotational ? "rotational device," : "non-rotational device,")
       << " discard " << (support_discard ? "supported" : "not supported")
+	  << " ioring " << (use_ioring ? "enabled" : "disabled")
+	  << " fixed buffers " << io_queue->get_fixed_buffer_size()
 	  << dendl;
   return 0;
 
@@ -346,9 +360,57 @@ void KernelDevice::close()
     VOID_TEMP_FAILURE_RETRY(::close(fd_buffereds[i]));
     fd_buffereds[i] = -1;
   }
+  _shutdown_logger();
   path.clear();
 }
 
+void KernelDevice::_init_logger()
+{
+  // one instance per device file, e.g. bdev-block, bdev-block.db
+  string name = "bdev-" + path.substr(path.find_last_of('/') + 1);
+  PerfCountersBuilder b(cct, name, l_bdev_first, l_bdev_last);
+  b.add_time_avg(l_bdev_aio_submit_lat, "aio_submit_lat",
+		 "Average aio batch submission latency");
+  b.add_u64_counter(l_bdev_aio_ops, "aio_ops",
+		    "I/Os submitted through libaio");
+  b.add_u64_counter(l_bdev_ioring_ops, "ioring_ops",
+		    "I/Os submitted through io_uring");
+  b.add_u64_counter(l_bdev_ioring_fixed_ops, "ioring_fixed_ops",
+		    "I/Os using io_uring registered buffers");
+  b.add_u64_counter(l_bdev_ioring_fixed_bytes, "ioring_fixed_bytes",
+		    "Bytes transferred through io_uring registered buffers",
+		    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bdev_ioring_fixed_miss, "ioring_fixed_miss",
+		    "I/Os eligible for a registered buffer that found none free");
+  logger = b.create_perf_counters();
+  cct->get_perfcounters_collection()->add(logger);
+}
+
+void KernelDevice::_shutdown_logger()
+{
+  if (logger) {
+    cct->get_perfcounters_collection()->remove(logger);
+    delete logger;
+    logger = nullptr;
+  }
+}
+
+ceph::unique_leakable_ptr<buffer::raw> KernelDevice::try_create_fixed(
+  size_t len)
+{
+  if (len > io_queue->get_fixed_buffer_size()) {
+    return nullptr;
+  }
+  auto raw = io_queue->try_create_fixed(len);
+  if (raw) {
+    logger->inc(l_bdev_ioring_fixed_ops);
+    logger->inc(l_bdev_ioring_fixed_bytes, len);
+  } else {
+    logger->inc(l_bdev_ioring_fixed_miss);
+  }
+  return raw;
+}
+
 int KernelDevice::collect_metadata(const string& prefix, map<string,string> *pm) const
 {
   (*pm)[prefix + "support_discard"] = stringify((int)(bool)support_discard);
@@ -868,8 +930,11 @@ void KernelDevice::aio_submit(IOContext *ioc)
   int r, retries = 0;
   // num of pending aios should not overflow when passed to submit_batch()
   assert(pending <= std::numeric_limits<uint16_t>::max());
+  auto start = mono_clock::now();
   r = io_queue->submit_batch(ioc->running_aios.begin(), e,
 			     pending, priv, &retries);
+  logger->tinc(l_bdev_aio_submit_lat, mono_clock::now() - start);
+  logger->inc(use_ioring ? l_bdev_ioring_ops : l_bdev_aio_ops, pending);
 
   if (retries)
     derr << __func__ << " retries " << retries << dendl;
@@ -1016,7 +1081,20 @@ int KernelDevice::aio_write(
       aio.preadv(off, len);
       ++injecting_crash;
     } else {
-      if (bl.length() <= RW_IO_MAX) {
+      if (auto fixed = try_create_fixed(len); fixed) {
+	// small write: stage it in a buffer registered with the kernel
+	ioc->pending_aios.push_back(aio_t(ioc, choose_fd(false, write_hint)));
+	++ioc->num_pending;
+	auto& aio = ioc->pending_aios.back();
+	bl.begin().copy(len, fixed->get_data());
+	bl.clear();
+	aio.bl.push_back(ceph::buffer::ptr_node::create(std::move(fixed)));
+	aio.bl.prepare_iov(&aio.iov);
+	aio.pwritev(off, len);
+	dout(30) << aio << dendl;
+	dout(5) << __func__ << " 0x" << std::hex << off << "~" << len
+		<< std::dec << " aio " << &aio << " (fixed)" << dendl;
+      } else if (bl.length() <= RW_IO_MAX) {
 	// fast path (non-huge write)
 	ioc->pending_aios.push_back(aio_t(ioc, choose_fd(false, write_hint)));
 	++ioc->num_pending;
@@ -1306,8 +1384,18 @@ int KernelDevice::aio_read(
     ioc->pending_aios.push_back(aio_t(ioc, fd_directs[WRITE_LIFE_NOT_SET]));
     ++ioc->num_pending;
     aio_t& aio = ioc->pending_aios.back();
-    aio.bl.push_back(
-      ceph::buffer::ptr_node::create(create_custom_aligned(len, ioc)));
+    ceph::unique_leakable_ptr<buffer::raw> fixed;
+    if (ioc->skip_cache()) {
+      // registered buffers are a scarce resource; only hand them to
+      // reads the caller won't keep in its cache
+      fixed = try_create_fixed(len);
+    }
+    if (fixed) {
+      aio.bl.push_back(ceph::buffer::ptr_node::create(std::move(fixed)));
+    } else {
+      aio.bl.push_back(
+	ceph::buffer::ptr_node::create(create_custom_aligned(len, ioc)));
+    }
     aio.bl.prepare_iov(&aio.iov);
     aio.preadv(off, len);
     dout(30) << aio << dendl;
@@ -28,6 +28,19 @@
 
 #define RW_IO_MAX (INT_MAX & CEPH_PAGE_MASK)
 
+enum {
+  l_bdev_first = 732800,
+  l_bdev_aio_submit_lat,
+  l_bdev_aio_ops,
+  l_bdev_ioring_ops,
+  l_bdev_ioring_fixed_ops,
+  l_bdev_ioring_fixed_bytes,
+  l_bdev_ioring_fixed_miss,
+  l_bdev_last
+};
+
+class PerfCounters;
+
 class KernelDevice : public BlockDevice {
 protected:
   std::string path;
@@ -47,6 +60,8 @@ private:
   ceph::mutex flush_mutex = ceph::make_mutex("KernelDevice::flush_mutex");
 
   std::unique_ptr<io_queue_t> io_queue;
+  bool use_ioring = false;
+  PerfCounters *logger = nullptr;
   aio_callback_t discard_callback;
   void *discard_callback_priv;
   bool aio_stop;
@@ -100,6 +115,11 @@ private:
 
   int _lock();
 
+  void _init_logger();
+  void _shutdown_logger();
+
+  ceph::unique_leakable_ptr<buffer::raw> try_create_fixed(size_t len);
+
   int direct_read_unaligned(uint64_t off, uint64_t len, char *buf);
 
   // stalled aio debugging
@@ -7,16 +7,81 @@
 
 #include "liburing.h"
 #include <sys/epoll.h>
+#include <sys/mman.h>
+
+#include <boost/lockfree/queue.hpp>
+
+#include "include/buffer_raw.h"
 
 using std::list;
 using std::make_unique;
 
+// a contiguous region carved into equally sized buffers, each registered
+// with the ring so that I/O on them skips per-request page pinning.  it is
+// reference counted by the raws handed out, as those may outlive the ring.
+struct ioring_fixed_pool {
+  char *base = nullptr;
+  const size_t buffer_size;
+  const unsigned count;
+  boost::lockfree::queue<unsigned> free_q;
+
+  ioring_fixed_pool(size_t buffer_size_, unsigned count_)
+    : buffer_size(buffer_size_), count(count_), free_q(count_) {
+    void *region = ::mmap(nullptr, buffer_size * count,
+			  PROT_READ | PROT_WRITE,
+			  MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+			  -1, 0);
+    if (region == MAP_FAILED) {
+      return;
+    }
+    base = static_cast<char*>(region);
+    for (unsigned i = 0; i < count; ++i) {
+      free_q.push(i);
+    }
+  }
+  ~ioring_fixed_pool() {
+    if (base) {
+      ::munmap(base, buffer_size * count);
+    }
+  }
+
+  // returns the registered buffer index covering [p, p + len), or -1
+  int find(const void *p, size_t len) const {
+    const char *c = static_cast<const char*>(p);
+    if (!base || c < base || c >= base + buffer_size * count) {
+      return -1;
+    }
+    size_t index = (c - base) / buffer_size;
+    if (c + len > base + buffer_size * (index + 1)) {
+      return -1;
+    }
+    return index;
+  }
+};
+
+struct fixed_buffer_raw : public ceph::buffer::raw {
+  std::shared_ptr<ioring_fixed_pool> pool; // keeps the region mapped
+  const unsigned index;
+
+  fixed_buffer_raw(std::shared_ptr<ioring_fixed_pool> pool_,
+		   unsigned index_, unsigned len)
+    : raw(pool_->base + pool_->buffer_size * index_, len),
+      pool(std::move(pool_)),
+      index(index_) {
+  }
+  ~fixed_buffer_raw() override {
+    // don't free; recycle the slot instead
+    pool->free_q.push(index);
+  }
+};
+
 struct ioring_data {
   struct io_uring io_uring;
   pthread_mutex_t cq_mutex;
   pthread_mutex_t sq_mutex;
   int epoll_fd = -1;
   std::map<int, int> fixed_fds_map;
+  std::shared_ptr<ioring_fixed_pool> fixed_pool; // null if not registered
 };
 
 static int ioring_get_cqe(struct ioring_data *d, unsigned int max,
@@ -50,6 +115,14 @@ static int find_fixed_fd(struct ioring_data *d, int real_fd)
   return it->second;
 }
 
+static int find_fixed_buf(struct ioring_data *d, struct aio_t *io)
+{
+  if (!d->fixed_pool || io->iov.size() != 1)
+    return -1;
+
+  return d->fixed_pool->find(io->iov[0].iov_base, io->iov[0].iov_len);
+}
+
 static void init_sqe(struct ioring_data *d, struct io_uring_sqe *sqe,
 		     struct aio_t *io)
 {
@@ -57,13 +130,23 @@ static void init_sqe(struct ioring_data *d, struct io_uring_sqe *sqe,
 
   ceph_assert(fixed_fd != -1);
 
-  if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV)
-    io_uring_prep_writev(sqe, fixed_fd, &io->iov[0],
-			 io->iov.size(), io->offset);
-  else if (io->iocb.aio_lio_opcode == IO_CMD_PREADV)
-    io_uring_prep_readv(sqe, fixed_fd, &io->iov[0],
-			io->iov.size(), io->offset);
-  else
+  int fixed_buf = find_fixed_buf(d, io);
+
+  if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV) {
+    if (fixed_buf >= 0)
+      io_uring_prep_write_fixed(sqe, fixed_fd, io->iov[0].iov_base,
+				io->iov[0].iov_len, io->offset, fixed_buf);
+    else
+      io_uring_prep_writev(sqe, fixed_fd, &io->iov[0],
+			   io->iov.size(), io->offset);
+  } else if (io->iocb.aio_lio_opcode == IO_CMD_PREADV) {
+    if (fixed_buf >= 0)
+      io_uring_prep_read_fixed(sqe, fixed_fd, io->iov[0].iov_base,
+			       io->iov[0].iov_len, io->offset, fixed_buf);
+    else
+      io_uring_prep_readv(sqe, fixed_fd, &io->iov[0],
+			  io->iov.size(), io->offset);
+  } else
     ceph_assert(0);
 
   io_uring_sqe_set_data(sqe, io);
@@ -106,11 +189,34 @@ static void build_fixed_fds_map(struct ioring_data *d,
   }
 }
 
-ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_) :
+static void register_fixed_bufs(struct ioring_data *d,
+				unsigned count, size_t buffer_size)
+{
+  auto pool = std::make_shared<ioring_fixed_pool>(buffer_size, count);
+  if (!pool->base)
+    return;
+
+  std::vector<struct iovec> iovs(count);
+  for (unsigned i = 0; i < count; ++i) {
+    iovs[i].iov_base = pool->base + buffer_size * i;
+    iovs[i].iov_len = buffer_size;
+  }
+  /* Failing here (e.g. RLIMIT_MEMLOCK) is not fatal, just go without */
+  if (io_uring_register_buffers(&d->io_uring, &iovs[0], count) < 0)
+    return;
+
+  d->fixed_pool = std::move(pool);
+}
+
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_,
+			       unsigned fixed_buffers_,
+			       size_t fixed_buffer_size_) :
   d(make_unique<ioring_data>()),
   iodepth(iodepth_),
   hipri(hipri_),
-  sq_thread(sq_thread_)
+  sq_thread(sq_thread_),
+  fixed_buffers(fixed_buffers_),
+  fixed_buffer_size(fixed_buffer_size_)
 {
 }
 
@@ -143,6 +249,9 @@ int ioring_queue_t::init(std::vector<int> &fds)
 
   build_fixed_fds_map(d.get(), fds);
 
+  if (fixed_buffers && fixed_buffer_size)
+    register_fixed_bufs(d.get(), fixed_buffers, fixed_buffer_size);
+
   d->epoll_fd = epoll_create1(0);
   if (d->epoll_fd < 0) {
     ret = -errno;
@@ -170,6 +279,8 @@ close_ring_fd:
 void ioring_queue_t::shutdown()
 {
   d->fixed_fds_map.clear();
+  /* Outstanding fixed buffers keep the region alive until released */
+  d->fixed_pool.reset();
   close(d->epoll_fd);
   d->epoll_fd = -1;
   io_uring_queue_exit(&d->io_uring);
@@ -209,6 +320,23 @@ get_cqe:
   return events;
 }
 
+ceph::unique_leakable_ptr<ceph::buffer::raw>
+ioring_queue_t::try_create_fixed(size_t len)
+{
+  auto pool = d->fixed_pool;
+  unsigned index;
+  if (!pool || len > pool->buffer_size || !pool->free_q.pop(index))
+    return nullptr;
+
+  return ceph::unique_leakable_ptr<ceph::buffer::raw>(
+    new fixed_buffer_raw(std::move(pool), index, len));
+}
+
+size_t ioring_queue_t::get_fixed_buffer_size() const
+{
+  return d->fixed_pool ? d->fixed_pool->buffer_size : 0;
+}
+
 bool ioring_queue_t::supported()
 {
   struct io_uring ring;
@@ -224,7 +352,9 @@ bool ioring_queue_t::supported()
 
 struct ioring_data {};
 
-ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_)
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_,
+			       unsigned fixed_buffers_,
+			       size_t fixed_buffer_size_)
 {
   ceph_assert(0);
 }
@@ -256,6 +386,17 @@ int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
   ceph_assert(0);
 }
 
+ceph::unique_leakable_ptr<ceph::buffer::raw>
+ioring_queue_t::try_create_fixed(size_t len)
+{
+  ceph_assert(0);
+}
+
+size_t ioring_queue_t::get_fixed_buffer_size() const
+{
+  ceph_assert(0);
+}
+
 bool ioring_queue_t::supported()
 {
   return false;
@@ -16,6 +16,7 @@
 #include <sstream>
 #include <iterator>
 #include <algorithm>
+#include <cmath>
 
 #include "CompressionPlugin.h"
 #include "Compressor.h"
@@ -99,6 +100,41 @@ CompressorRef Compressor::create(CephContext *cct, const std::string &type)
   return cs_impl;
 }
 
+double Compressor::estimate_ratio(const ceph::bufferlist &in,
+				 size_t sample_bytes) const
+{
+  // take runs rather than single bytes so that the sample still sees
+  // local structure, and spread them to cover the whole input
+  constexpr size_t run = 64;
+  size_t len = in.length();
+  if (len == 0 || sample_bytes == 0) {
+    return 1.0;
+  }
+  size_t runs = std::max<size_t>(1, std::min(len, sample_bytes) / run);
+  size_t stride = std::max<size_t>(run, len / runs);
+
+  uint32_t hist[256] = {0};
+  size_t n = 0;
+  auto p = in.begin();
+  for (size_t off = 0; off < len && n < sample_bytes; off += stride) {
+    p.seek(off);
+    size_t l = std::min(run, len - off);
+    for (size_t i = 0; i < l; ++i, ++p) {
+      ++hist[(uint8_t)*p];
+    }
+    n += l;
+  }
+
+  double entropy = 0;
+  for (auto h : hist) {
+    if (h) {
+      double f = (double)h / n;
+      entropy -= f * std::log2(f);
+    }
+  }
+  return entropy / 8;
+}
+
 CompressorRef Compressor::create(CephContext *cct, int alg)
 {
   if (alg < 0 || alg >= COMP_ALG_LAST) {
@@ -96,6 +96,14 @@ public:
   // alignment with decode methods
   virtual int decompress(ceph::bufferlist::const_iterator &p, size_t compressed_len, ceph::bufferlist &out, std::optional<int32_t> compressor_message) = 0;
 
+  /// Cheap guess of the compressed to original size ratio of @p in, so
+  /// callers can skip compressing data that will not shrink anyway
+  /// (media, encrypted or already compressed content).  The default is
+  /// the order-0 byte entropy of up to @p sample_bytes sampled evenly
+  /// across the input; 1.0 means incompressible.
+  virtual double estimate_ratio(const ceph::bufferlist &in,
+				size_t sample_bytes) const;
+
   static CompressorRef create(CephContext *cct, const std::string &type);
   static CompressorRef create(CephContext *cct, int alg);
 
@@ -116,9 +116,19 @@ public:
     return bl;
   }
 
+  // let the tx crypto handler release the buffer shared by the frames
+  // assembled so far
+  void end_tx_batch() {
+    if (session_stream_handlers.tx) {
+      session_stream_handlers.tx->end_tx_batch();
+    }
+  }
+
   template <class F>
   seastar::future<> write_flush_frame(F &tx_frame) {
     auto bl = get_buffer(tx_frame);
+    // the handlers may move to another connection once the frame is out
+    end_tx_batch();
     return write_flush(std::move(bl));
   }
 
@@ -118,6 +118,7 @@ ceph::bufferlist IOHandler::sweep_out_pending_msgs_to_sent(
         std::make_move_iterator(out_pending_msgs.end()));
   }
   out_pending_msgs.clear();
+  frame_assembler->end_tx_batch();
   return bl;
 }
 
@@ -41,7 +41,8 @@ Cache::Cache(
   ExtentPlacementManager &epm)
   : epm(epm),
     lru(crimson::common::get_conf<Option::size_t>(
-	  "seastore_cache_lru_size"))
+	  "seastore_cache_lru_size"),
+	stats.cache_query_by_src)
 {
   LOG_PREFIX(Cache::Cache);
   INFO("created, lru_size={}", lru.get_capacity());
@@ -180,7 +181,7 @@ void Cache::register_metrics()
   }
 
   /*
-   * cache_query: cache_access and cache_hit
+   * cache_query: cache_access, cache_hit and cache_read_ahead*
    */
   for (auto& [src, src_label] : labels_by_src) {
     metrics.add_group(
@@ -198,6 +199,26 @@ void Cache::register_metrics()
           sm::description("total number of cache hits"),
           {src_label}
         ),
+        sm::make_counter(
+          "cache_read_ahead",
+          get_by_src(stats.cache_query_by_src, src).read_ahead,
+          sm::description("total number of extents read ahead"),
+          {src_label}
+        ),
+        sm::make_counter(
+          "cache_read_ahead_hit",
+          get_by_src(stats.cache_query_by_src, src).read_ahead_hit,
+          sm::description("total number of extents read ahead and then "
+                          "accessed"),
+          {src_label}
+        ),
+        sm::make_counter(
+          "cache_read_ahead_wasted",
+          get_by_src(stats.cache_query_by_src, src).read_ahead_wasted,
+          sm::description("total number of extents read ahead and dropped "
+                          "from cache without being accessed"),
+          {src_label}
+        ),
       }
     );
   }
@@ -923,6 +944,39 @@ void Cache::mark_transaction_conflicted(
   }
 }
 
+void Cache::abort_read_ahead(CachedExtent& extent)
+{
+  LOG_PREFIX(Cache::abort_read_ahead);
+  SUBWARN(seastore_cache, "read ahead failed -- {}", extent);
+  if (extent.is_valid()) {
+    assert(extent.state == CachedExtent::extent_state_t::CLEAN_PENDING);
+    // counts the read ahead as wasted
+    remove_extent(&extent);
+    if (extent.is_logical()) {
+      // prefetch_pin() linked it to the stable lba leaf, which must not
+      // keep pointing to it once it is invalid
+      auto &lextent = static_cast<LogicalCachedExtent&>(extent);
+      if (lextent.has_parent_tracker()) {
+        lextent.unlink_from_parent();
+      }
+    }
+    // transactions which found it while in flight must not use its
+    // content, they will read it again once retried
+    for (auto &&i : extent.transactions) {
+      if (!i.t->conflicted) {
+        mark_transaction_conflicted(*i.t, extent);
+      }
+    }
+    extent.state = CachedExtent::extent_state_t::INVALID;
+  }
+  if (extent.read_ahead_src != TRANSACTION_TYPE_NULL) {
+    ++get_by_src(stats.cache_query_by_src,
+                 extent.read_ahead_src).read_ahead_wasted;
+    extent.read_ahead_src = TRANSACTION_TYPE_NULL;
+  }
+  extent.complete_io();
+}
+
 void Cache::on_transaction_destruct(Transaction& t)
 {
   LOG_PREFIX(Cache::on_transaction_destruct);
@@ -1628,29 +1682,33 @@ Cache::mkfs_iertr::future<> Cache::mkfs(Transaction &t)
 
 Cache::close_ertr::future<> Cache::close()
 {
-  LOG_PREFIX(Cache::close);
-  INFO("close with {}({}B) dirty, dirty_from={}, alloc_from={}, "
-       "{}({}B) lru, totally {}({}B) indexed extents",
-       dirty.size(),
-       stats.dirty_bytes,
-       get_oldest_dirty_from().value_or(JOURNAL_SEQ_NULL),
-       get_oldest_backref_dirty_from().value_or(JOURNAL_SEQ_NULL),
-       lru.get_current_contents_extents(),
-       lru.get_current_contents_bytes(),
-       extents.size(),
-       extents.get_bytes());
-  root.reset();
-  for (auto i = dirty.begin(); i != dirty.end(); ) {
-    auto ptr = &*i;
-    stats.dirty_bytes -= ptr->get_length();
-    dirty.erase(i++);
-    intrusive_ptr_release(ptr);
-  }
-  backref_extents.clear();
-  backref_entryrefs_by_seq.clear();
-  assert(stats.dirty_bytes == 0);
-  lru.clear();
-  return close_ertr::now();
+  // the reads ahead hold extents which are about to be dropped
+  return read_ahead_gate.close().then([this] {
+    LOG_PREFIX(Cache::close);
+    INFO("close with {}({}B) dirty, dirty_from={}, alloc_from={}, "
+         "{}({}B) lru, totally {}({}B) indexed extents",
+         dirty.size(),
+         stats.dirty_bytes,
+         get_oldest_dirty_from().value_or(JOURNAL_SEQ_NULL),
+         get_oldest_backref_dirty_from().value_or(JOURNAL_SEQ_NULL),
+         lru.get_current_contents_extents(),
+         lru.get_current_contents_bytes(),
+         extents.size(),
+         extents.get_bytes());
+    root.reset();
+    for (auto i = dirty.begin(); i != dirty.end(); ) {
+      auto ptr = &*i;
+      stats.dirty_bytes -= ptr->get_length();
+      dirty.erase(i++);
+      intrusive_ptr_release(ptr);
+    }
+    backref_extents.clear();
+    backref_entryrefs_by_seq.clear();
+    assert(stats.dirty_bytes == 0);
+    lru.clear();
+    read_ahead_gate = seastar::gate();
+    return close_ertr::now();
+  });
 }
 
 Cache::replay_delta_ret
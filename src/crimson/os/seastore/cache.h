@@ -5,6 +5,7 @@
 
 #include <iostream>
 
+#include "seastar/core/gate.hh"
 #include "seastar/core/shared_future.hh"
 
 #include "include/buffer.h"
@@ -522,6 +523,59 @@ public:
     return get_absent_extent<T>(t, offset, length, [](T &){});
   }
 
+  /**
+   * prefetch_extent
+   *
+   * Starts reading the extent at offset~length into the cache if it is
+   * absent from both t and the cache.  Unlike get_absent_extent(), the
+   * extent isn't added to t's read set and the read isn't waited for, so
+   * it outlives t; its first access is counted as a read ahead hit.
+   */
+  template <typename T, typename Func>
+  void prefetch_extent(
+    Transaction &t,
+    paddr_t offset,
+    extent_len_t length,
+    Func &&extent_init_func) {
+    LOG_PREFIX(Cache::prefetch_extent);
+    const auto src = t.get_src();
+    CachedExtentRef cached;
+    if (read_ahead_gate.is_closed() ||
+        // the lru doesn't keep the extents of background transactions
+        is_background_transaction(src) ||
+        t.get_extent(offset, &cached) != Transaction::get_extent_ret::ABSENT ||
+        query_cache(offset, nullptr)) {
+      return;
+    }
+    auto ret = CachedExtent::make_cached_extent_ref<T>(
+      alloc_cache_buf(length));
+    ret->init(CachedExtent::extent_state_t::CLEAN_PENDING,
+              offset,
+              PLACEMENT_HINT_NULL,
+              NULL_GENERATION,
+              TRANS_ID_NULL);
+    ret->read_ahead_src = src;
+    SUBDEBUGT(seastore_cache,
+        "{} {}~{} is absent, add extent and reading ahead ... -- {}",
+        t, T::TYPE, offset, length, *ret);
+    add_extent(ret, &src);
+    extent_init_func(*ret);
+    ++get_by_src(stats.cache_query_by_src, src).read_ahead;
+    std::ignore = seastar::with_gate(
+      read_ahead_gate,
+      [this, ret=std::move(ret)]() mutable {
+      return read_extent<T>(TCachedExtentRef<T>(ret)
+      ).handle_error(
+        crimson::ct_error::input_output_error::handle([this, ret] {
+          abort_read_ahead(*ret);
+        }),
+        crimson::ct_error::assert_all{
+          "Cache::prefetch_extent: invalid error"
+        }
+      ).discard_result();
+    });
+  }
+
   seastar::future<CachedExtentRef> get_extent_viewable_by_trans(
     Transaction &t,
     CachedExtentRef extent)
@@ -532,6 +586,7 @@ public:
       if (!p_extent->is_mutation_pending()) {
 	touch_extent(*p_extent);
       }
+      on_access_read_ahead(*p_extent, t.get_src());
     }
     return p_extent->wait_io(
     ).then([p_extent] {
@@ -1197,6 +1252,9 @@ private:
 
   journal_seq_t last_commit = JOURNAL_SEQ_MIN;
 
+  /// waited for by close(), tracks the reads started by prefetch_extent()
+  seastar::gate read_ahead_gate;
+
   // FIXME: This is specific to the segmented implementation
   std::vector<SegmentProvider*> segment_providers_by_device_id;
 
@@ -1243,6 +1301,17 @@ private:
 
   friend class crimson::os::seastore::backref::BtreeBackrefManager;
   friend class crimson::os::seastore::BackrefManager;
+
+  struct query_counters_t {
+    uint64_t access = 0;
+    uint64_t hit = 0;
+    // extents read ahead, and how many of them were accessed before
+    // (read_ahead_hit) or without (read_ahead_wasted) leaving the cache
+    uint64_t read_ahead = 0;
+    uint64_t read_ahead_hit = 0;
+    uint64_t read_ahead_wasted = 0;
+  };
+
   /**
    * lru
    *
@@ -1257,6 +1326,9 @@ private:
 
     CachedExtent::list lru;
 
+    // Cache::stats.cache_query_by_src
+    std::array<query_counters_t, TRANSACTION_TYPE_MAX> &query_counters;
+
     void trim_to_capacity() {
       while (contents > capacity) {
 	assert(lru.size() > 0);
@@ -1276,7 +1348,9 @@ private:
     }
 
   public:
-    LRU(size_t capacity) : capacity(capacity) {}
+    LRU(size_t capacity,
+        std::array<query_counters_t, TRANSACTION_TYPE_MAX> &query_counters)
+      : capacity(capacity), query_counters(query_counters) {}
 
     size_t get_capacity() const {
       return capacity;
@@ -1294,6 +1368,11 @@ private:
       assert(extent.is_clean() && !extent.is_placeholder());
 
       if (extent.primary_ref_list_hook.is_linked()) {
+	if (extent.read_ahead_src != TRANSACTION_TYPE_NULL) {
+	  ++query_counters[
+	    static_cast<std::size_t>(extent.read_ahead_src)].read_ahead_wasted;
+	  extent.read_ahead_src = TRANSACTION_TYPE_NULL;
+	}
 	lru.erase(lru.s_iterator_to(extent));
 	assert(contents >= extent.get_length());
 	contents -= extent.get_length();
@@ -1326,11 +1405,6 @@ private:
     }
   } lru;
 
-  struct query_counters_t {
-    uint64_t access = 0;
-    uint64_t hit = 0;
-  };
-
   template <typename CounterT>
   using counter_by_extent_t = std::array<CounterT, EXTENT_TYPES_MAX>;
 
@@ -1508,6 +1582,9 @@ private:
   void mark_transaction_conflicted(
     Transaction& t, CachedExtent& conflicting_extent);
 
+  /// Drop an extent whose read ahead failed, waking up its readers
+  void abort_read_ahead(CachedExtent& extent);
+
   /// Introspect transaction when it is being destructed
   void on_transaction_destruct(Transaction& t);
 
@@ -1545,6 +1622,16 @@ private:
     );
   }
 
+  /// Counts the first access to an extent read ahead
+  void on_access_read_ahead(
+      CachedExtent &extent,
+      Transaction::src_t src) {
+    if (extent.read_ahead_src != TRANSACTION_TYPE_NULL) {
+      extent.read_ahead_src = TRANSACTION_TYPE_NULL;
+      ++get_by_src(stats.cache_query_by_src, src).read_ahead_hit;
+    }
+  }
+
   // Extents in cache may contain placeholders
   CachedExtentRef query_cache(
       paddr_t offset,
@@ -1560,6 +1647,7 @@ private:
           // retired_placeholder is not really cached yet
           iter->get_type() != extent_types_t::RETIRED_PLACEHOLDER) {
         ++p_counters->hit;
+        on_access_read_ahead(*iter, p_metric_key->first);
       }
       return CachedExtentRef(&*iter);
     } else {
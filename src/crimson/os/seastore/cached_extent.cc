@@ -128,15 +128,20 @@ void CachedExtent::set_invalid(Transaction &t) {
 
 LogicalCachedExtent::~LogicalCachedExtent() {
   if (has_parent_tracker() && is_valid() && !is_pending()) {
-    assert(get_parent_node());
-    auto parent = get_parent_node<FixedKVNode<laddr_t>>();
-    auto off = parent->lower_bound_offset(laddr);
-    assert(parent->get_key_from_idx(off) == laddr);
-    assert(parent->children[off] == this);
-    parent->children[off] = nullptr;
+    unlink_from_parent();
   }
 }
 
+void LogicalCachedExtent::unlink_from_parent() {
+  assert(get_parent_node());
+  auto parent = get_parent_node<FixedKVNode<laddr_t>>();
+  auto off = parent->lower_bound_offset(laddr);
+  assert(parent->get_key_from_idx(off) == laddr);
+  assert(parent->children[off] == this);
+  parent->children[off] = nullptr;
+  reset_parent_tracker();
+}
+
 void LogicalCachedExtent::on_replace_prior(Transaction &t) {
   assert(is_mutation_pending());
   take_prior_parent_tracker();
@@ -645,6 +645,10 @@ private:
   // or the rewrite generation for the fresh write
   rewrite_gen_t rewrite_generation = NULL_GENERATION;
 
+  // the source of the transaction which read the extent ahead,
+  // reset once the extent is accessed
+  transaction_type_t read_ahead_src = TRANSACTION_TYPE_NULL;
+
 protected:
   trans_view_set_t mutation_pendings;
 
@@ -1123,6 +1127,9 @@ public:
 
   void on_replace_prior(Transaction &t) final;
 
+  /// clear the pointer to this extent in the stable lba leaf mapping it
+  void unlink_from_parent();
+
   virtual ~LogicalCachedExtent();
 protected:
 
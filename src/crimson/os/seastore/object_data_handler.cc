@@ -1010,6 +1010,29 @@ ObjectDataHandler::write_ret ObjectDataHandler::write(
     });
 }
 
+extent_len_t ObjectDataHandler::read_ahead_tracker_t::on_read(
+  laddr_t laddr,
+  extent_len_t len)
+{
+  if (max_size == 0) {
+    return 0;
+  }
+  for (auto &stream : streams) {
+    if (stream.next == laddr) {
+      stream.next = laddr + len;
+      stream.window = std::min<uint64_t>(
+	max_size,
+	std::max<uint64_t>(len, 2 * (uint64_t)stream.window));
+      return stream.window;
+    }
+  }
+  auto &stream = streams[next_stream];
+  next_stream = (next_stream + 1) % MAX_STREAMS;
+  stream.next = laddr + len;
+  stream.window = 0;
+  return 0;
+}
+
 ObjectDataHandler::read_ret ObjectDataHandler::read(
   context_t ctx,
   objaddr_t obj_offset,
@@ -1033,47 +1056,65 @@ ObjectDataHandler::read_ret ObjectDataHandler::read(
 	  ceph_assert(len > 0);
 	  laddr_t loffset =
 	    object_data.get_reserved_data_base() + obj_offset;
+	  extent_len_t read_ahead_len = 0;
+	  if (ctx.read_ahead) {
+	    read_ahead_len = std::min<extent_len_t>(
+	      ctx.read_ahead->on_read(loffset, len),
+	      object_data.get_reserved_data_len() - (obj_offset + len));
+	  }
+	  // look the read ahead pins up along with the ones to read
 	  return ctx.tm.get_pins(
 	    ctx.t,
 	    loffset,
-	    len
+	    len + read_ahead_len
 	  ).si_then([ctx, loffset, len, &ret](auto _pins) {
 	    // offset~len falls within reserved region and len > 0
 	    ceph_assert(_pins.size() >= 1);
 	    ceph_assert((*_pins.begin())->get_key() <= loffset);
+	    std::vector<std::pair<LBAMappingRef, bufferlist>> to_read;
+	    lba_pin_list_t to_read_ahead;
+	    laddr_t current = loffset;
+	    for (auto &pin : _pins) {
+	      if (pin->get_key() < loffset + len) {
+		// See LBAManager::get_mappings
+		ceph_assert(std::max(pin->get_key(), loffset) == current);
+		current = pin->get_key() + pin->get_length();
+		to_read.emplace_back(std::move(pin), bufferlist());
+	      } else {
+		to_read_ahead.emplace_back(std::move(pin));
+	      }
+	    }
+	    ceph_assert(current >= loffset + len);
 	    return seastar::do_with(
-	      std::move(_pins),
-	      loffset,
-	      [ctx, loffset, len, &ret](auto &pins, auto &current) {
-		return trans_intr::do_for_each(
-		  pins,
-		  [ctx, loffset, len, &current, &ret](auto &pin)
-		  -> read_iertr::future<> {
-		    ceph_assert(current <= (loffset + len));
-		    ceph_assert(
-		      (loffset + len) > pin->get_key());
+	      std::move(to_read),
+	      std::move(to_read_ahead),
+	      [ctx, loffset, len, &ret](auto &to_read, auto &to_read_ahead) {
+		// the extents don't depend on each other, read them
+		// concurrently into their own bufferlists
+		auto fut = trans_intr::parallel_for_each(
+		  to_read,
+		  [ctx, loffset, len](auto &p) -> read_iertr::future<> {
+		    auto &pin = p.first;
+		    laddr_t begin = std::max(pin->get_key(), loffset);
 		    laddr_t end = std::min(
 		      pin->get_key() + pin->get_length(),
 		      loffset + len);
+		    ceph_assert(end > begin);
 		    if (pin->get_val().is_zero()) {
-		      ceph_assert(end > current); // See LBAManager::get_mappings
-		      ret.append_zero(end - current);
-		      current = end;
+		      p.second.append_zero(end - begin);
 		      return seastar::now();
 		    } else {
 		      return ctx.tm.read_pin<ObjectDataBlock>(
 			ctx.t,
 			std::move(pin)
-		      ).si_then([&ret, &current, end](auto extent) {
+		      ).si_then([&bl=p.second, begin, end](auto extent) {
 			ceph_assert(
 			  (extent->get_laddr() + extent->get_length()) >= end);
-			ceph_assert(end > current);
-			ret.append(
+			bl.append(
 			  bufferptr(
 			    extent->get_bptr(),
-			    current - extent->get_laddr(),
-			    end - current));
-			current = end;
+			    begin - extent->get_laddr(),
+			    end - begin));
 			return seastar::now();
 		      }).handle_error_interruptible(
 			read_iertr::pass_further{},
@@ -1083,6 +1124,15 @@ ObjectDataHandler::read_ret ObjectDataHandler::read(
 		      );
 		    }
 		  });
+		// after the reads above so that they are queued first
+		for (auto &pin : to_read_ahead) {
+		  ctx.tm.prefetch_pin<ObjectDataBlock>(ctx.t, std::move(pin));
+		}
+		return fut.si_then([&to_read, &ret] {
+		  for (auto &p : to_read) {
+		    ret.claim_append(p.second);
+		  }
+		});
 	      });
 	  });
 	}).si_then([&ret] {
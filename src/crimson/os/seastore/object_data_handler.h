@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <array>
 #include <iostream>
 #include <limits>
 
@@ -52,10 +53,37 @@ public:
 
   ObjectDataHandler(uint32_t mos) : max_object_size(mos) {}
 
+  /**
+   * read_ahead_tracker_t
+   *
+   * Remembers where the last few reads ended in order to detect the
+   * sequential ones.  The read ahead window of a stream starts at the
+   * size of its first sequential read and doubles with each following
+   * one, up to max_size.
+   */
+  class read_ahead_tracker_t {
+  public:
+    read_ahead_tracker_t(extent_len_t max_size) : max_size(max_size) {}
+
+    /// returns the length to read ahead of laddr~len
+    extent_len_t on_read(laddr_t laddr, extent_len_t len);
+
+  private:
+    struct stream_t {
+      laddr_t next = L_ADDR_NULL;
+      extent_len_t window = 0;
+    };
+    static constexpr std::size_t MAX_STREAMS = 16;
+    std::array<stream_t, MAX_STREAMS> streams;
+    std::size_t next_stream = 0;   ///< next one to be replaced
+    const extent_len_t max_size;
+  };
+
   struct context_t {
     TransactionManager &tm;
     Transaction &t;
     Onode &onode;
+    read_ahead_tracker_t *read_ahead = nullptr; ///< only used by read()
   };
 
   /// Writes bl to [offset, offset + bl.length())
@@ -122,7 +122,9 @@ SeaStore::Shard::Shard(
      get_conf<uint64_t>("seastore_default_max_object_size")),
    is_test(is_test),
    throttler(
-      get_conf<uint64_t>("seastore_max_concurrent_transactions"))
+      get_conf<uint64_t>("seastore_max_concurrent_transactions")),
+   read_ahead(
+      get_conf<Option::size_t>("seastore_obj_data_read_ahead_size"))
 {
   device = &(dev->get_sharded_device());
   register_metrics();
@@ -834,6 +836,7 @@ SeaStore::Shard::read(
           *transaction_manager,
           t,
           onode,
+          &read_ahead,
         },
         offset,
         corrected_len);
@@ -446,6 +446,8 @@ public:
 
     common::Throttle throttler;
 
+    ObjectDataHandler::read_ahead_tracker_t read_ahead;
+
     seastar::metrics::metric_group metrics;
     void register_metrics();
   };
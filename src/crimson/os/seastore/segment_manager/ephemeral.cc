@@ -274,6 +274,18 @@ SegmentManager::read_ertr::future<> EphemeralSegmentManager::read(
     return crimson::ct_error::invarg::make();
   }
 
+  if (read_errors.count(addr)) {
+    logger().debug(
+      "EphemeralSegmentManager::read: injected error at {}~{}",
+      addr,
+      len);
+    return read_ertr::now().safe_then([] {
+      return seastar::sleep(std::chrono::milliseconds(1));
+    }).safe_then([]() -> read_ertr::future<> {
+      return crimson::ct_error::input_output_error::make();
+    });
+  }
+
   out.copy_in(0, len, buffer + get_offset(addr));
 
   bufferlist bl;
@@ -86,6 +86,9 @@ class EphemeralSegmentManager final : public SegmentManager {
 
   char *buffer = nullptr;
 
+  /// reads starting at these addresses fail with EIO
+  std::set<paddr_t> read_errors;
+
   Segment::close_ertr::future<> segment_close(segment_id_t id);
 
 public:
@@ -152,6 +155,14 @@ public:
 
   void remount();
 
+  // for tests of the error paths
+  void inject_read_error(paddr_t addr) {
+    read_errors.insert(addr);
+  }
+  void clear_read_errors() {
+    read_errors.clear();
+  }
+
   // public so tests can bypass segment interface when simpler
   Segment::write_ertr::future<> segment_write(
     paddr_t addr,
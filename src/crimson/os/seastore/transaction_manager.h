@@ -186,6 +186,46 @@ public:
     }
   }
 
+  /**
+   * prefetch_pin
+   *
+   * Start reading the extent mapped at pin into the cache, if it is not
+   * there yet, without waiting for it.  See Cache::prefetch_extent().
+   */
+  template <typename T>
+  void prefetch_pin(
+    Transaction &t,
+    LBAMappingRef pin)
+  {
+    LOG_PREFIX(TransactionManager::prefetch_pin);
+    static_assert(is_logical_type(T::TYPE));
+    if (!pin->get_val().is_real() ||
+        pin->get_parent()->is_pending()) {
+      return;
+    }
+    SUBTRACET(seastore_tm, "prefetching extent {}", t, *pin);
+    auto &pref = *pin;
+    cache->prefetch_extent<T>(
+      t,
+      pref.get_val(),
+      pref.get_length(),
+      [&t, pin=std::move(pin)]
+      (T &extent) mutable {
+	// only called if the extent is absent from the cache, so the
+	// stable parent doesn't point to it yet, and get_logical_extent()
+	// just locates the child slot without touching the read set
+	[[maybe_unused]] auto v = pin->get_logical_extent(t);
+	assert(!v.has_child());
+	assert(!extent.has_laddr());
+	assert(!extent.has_been_invalidated());
+	assert(!pin->has_been_invalidated());
+	assert(pin->get_parent());
+	pin->link_child(&extent);
+	extent.set_laddr(pin->get_key());
+      }
+    );
+  }
+
   base_iertr::future<LogicalCachedExtentRef> read_pin_by_type(
     Transaction &t,
     LBAMappingRef pin,
@@ -17,6 +17,7 @@
 
 #include <algorithm>
 #include <cerrno>
+#include <cstring>
 
 #include "ErasureCode.h"
 
@@ -41,6 +42,62 @@ using ceph::bufferlist;
 namespace ceph {
 const unsigned ErasureCode::SIMD_ALIGN = 32;
 
+bufferptr ErasureCodeDecodeCache::get(const std::string &signature)
+{
+  std::lock_guard l(lock);
+  auto p = tables.find(signature);
+  if (p == tables.end()) {
+    ++misses;
+    return bufferptr();
+  }
+  ++hits;
+  lru.splice(lru.begin(), lru, p->second);
+  return p->second->second;
+}
+
+void ErasureCodeDecodeCache::put(const std::string &signature,
+				 const bufferptr &table)
+{
+  std::lock_guard l(lock);
+  auto p = tables.find(signature);
+  if (p != tables.end()) {
+    // raced with another decode of the same erasures
+    p->second->second = table;
+    lru.splice(lru.begin(), lru, p->second);
+    return;
+  }
+  while (!lru.empty() && lru.size() >= max_entries) {
+    tables.erase(lru.back().first);
+    lru.pop_back();
+  }
+  lru.emplace_front(signature, table);
+  tables[signature] = lru.begin();
+}
+
+void ErasureCodeDecodeCache::clear()
+{
+  std::lock_guard l(lock);
+  tables.clear();
+  lru.clear();
+}
+
+size_t ErasureCodeDecodeCache::size() const
+{
+  std::lock_guard l(lock);
+  return lru.size();
+}
+
+std::string ErasureCodeDecodeCache::signature(const set<int> &erasures)
+{
+  std::string s;
+  for (auto i : erasures) {
+    if (!s.empty())
+      s += ',';
+    s += std::to_string(i);
+  }
+  return s;
+}
+
 int ErasureCode::init(
   ErasureCodeProfile &profile,
   std::ostream *ss)
@@ -202,6 +259,40 @@ int ErasureCode::encode(const set<int> &want_to_encode,
   return 0;
 }
 
+void ErasureCode::encode_delta(const bufferlist &old_data,
+                               const bufferlist &new_data,
+                               bufferlist *delta)
+{
+  ceph_assert(old_data.length() == new_data.length());
+  // the codes implemented here work in GF(2^w), where the difference
+  // is the xor of both versions
+  unsigned len = old_data.length();
+  bufferlist o = old_data, n = new_data;
+  const char *a = o.c_str();
+  const char *b = n.c_str();
+  bufferptr out(buffer::create_aligned(len, SIMD_ALIGN));
+  char *d = out.c_str();
+  unsigned i = 0;
+  for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+    uint64_t x, y;
+    memcpy(&x, a + i, sizeof(x));
+    memcpy(&y, b + i, sizeof(y));
+    x ^= y;
+    memcpy(d + i, &x, sizeof(x));
+  }
+  for (; i < len; i++) {
+    d[i] = a[i] ^ b[i];
+  }
+  delta->clear();
+  delta->push_back(std::move(out));
+}
+
+int ErasureCode::apply_delta(const map<int, bufferlist> &deltas,
+                             map<int, bufferlist> *parity)
+{
+  return -EOPNOTSUPP;
+}
+
 int ErasureCode::_decode(const set<int> &want_to_read,
 			 const map<int, bufferlist> &chunks,
 			 map<int, bufferlist> *decoded)
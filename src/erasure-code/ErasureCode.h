@@ -22,16 +22,67 @@
 
  */ 
 
+#include <atomic>
+#include <list>
+#include <unordered_map>
+
 #include "ErasureCodeInterface.h"
+#include "common/ceph_mutex.h"
 
 namespace ceph {
 
+  /**
+   * Bounded LRU of decoding tables, keyed by erasure signature.
+   *
+   * Plugins that derive their decoding tables from the erasures, e.g. by
+   * inverting a matrix, can keep them here instead of computing them for
+   * every degraded read: all the objects of a PG missing the same shards
+   * share the same erasure pattern.  Tables are opaque to the cache and
+   * stay valid after being evicted while a decode still uses them.
+   */
+  class ErasureCodeDecodeCache {
+  public:
+    /// enough for every erasure pattern of k=12, m=4
+    static const size_t DEFAULT_MAX_ENTRIES = 2516;
+
+    explicit ErasureCodeDecodeCache(size_t max_entries = DEFAULT_MAX_ENTRIES)
+      : max_entries(max_entries) {}
+
+    /// @return the table cached for signature, or an empty ptr
+    ceph::buffer::ptr get(const std::string &signature);
+    void put(const std::string &signature, const ceph::buffer::ptr &table);
+    void clear();
+
+    size_t size() const;
+    uint64_t get_hits() const {
+      return hits;
+    }
+    uint64_t get_misses() const {
+      return misses;
+    }
+
+    /// e.g. "1,4" for a decode with chunks 1 and 4 missing
+    static std::string signature(const std::set<int> &erasures);
+
+  private:
+    typedef std::list<std::pair<std::string, ceph::buffer::ptr>> lru_t;
+
+    const size_t max_entries;
+    mutable ceph::mutex lock = ceph::make_mutex("ErasureCodeDecodeCache::lock");
+    lru_t lru;  ///< most recently used first
+    std::unordered_map<std::string, lru_t::iterator> tables;
+    std::atomic<uint64_t> hits = {0};
+    std::atomic<uint64_t> misses = {0};
+  };
+
   class ErasureCode : public ErasureCodeInterface {
   public:
     static const unsigned SIMD_ALIGN;
 
     std::vector<int> chunk_mapping;
     ErasureCodeProfile _profile;
+    /// decoding tables for plugins that need them
+    ErasureCodeDecodeCache decode_cache;
 
     // for CRUSH rule
     std::string rule_root;
@@ -56,6 +107,12 @@ namespace ceph {
       return get_chunk_count() - get_data_chunk_count();
     }
 
+    void get_decode_cache_stats(uint64_t *hits,
+                                uint64_t *misses) const override {
+      *hits = decode_cache.get_hits();
+      *misses = decode_cache.get_misses();
+    }
+
     virtual int get_sub_chunk_count() override {
       return 1;
     }
@@ -79,6 +136,17 @@ namespace ceph {
                        const bufferlist &in,
                        std::map<int, bufferlist> *encoded) override;
 
+    bool supports_parity_delta() const override {
+      return false;
+    }
+
+    void encode_delta(const bufferlist &old_data,
+                      const bufferlist &new_data,
+                      bufferlist *delta) override;
+
+    int apply_delta(const std::map<int, bufferlist> &deltas,
+                    std::map<int, bufferlist> *parity) override;
+
     int decode(const std::set<int> &want_to_read,
                 const std::map<int, bufferlist> &chunks,
                 std::map<int, bufferlist> *decoded, int chunk_size) override;
@@ -370,6 +370,57 @@ namespace ceph {
     virtual int encode_chunks(const std::set<int> &want_to_encode,
                               std::map<int, bufferlist> *encoded) = 0;
 
+    /**
+     * Return true if coding chunks can be updated with **apply_delta**
+     * from the changes made to some data chunks, without knowing the
+     * content of the other data chunks.
+     *
+     * @return true if **apply_delta** is implemented
+     */
+    virtual bool supports_parity_delta() const = 0;
+
+    /**
+     * Store in **delta** the difference between **old_data** and
+     * **new_data**, the content of a data chunk before and after it
+     * is modified. Both buffers must have the same size.
+     *
+     * @param [in] old_data current content of the data chunk
+     * @param [in] new_data content the data chunk is updated to
+     * @param [out] delta difference to be given to **apply_delta**
+     */
+    virtual void encode_delta(const bufferlist &old_data,
+                              const bufferlist &new_data,
+                              bufferlist *delta) = 0;
+
+    /**
+     * Update the coding chunks in **parity** in place so that they
+     * match data chunks modified by **deltas**, which maps data
+     * chunk indexes to the output of **encode_delta**. Data chunks
+     * not found in **deltas** are unchanged. All buffers must have
+     * the same size.
+     *
+     * This is only implemented if **supports_parity_delta** returns
+     * true.
+     *
+     * @param [in] deltas map data chunk indexes to deltas
+     * @param [in,out] parity map coding chunk indexes to chunk data
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int apply_delta(const std::map<int, bufferlist> &deltas,
+                            std::map<int, bufferlist> *parity) = 0;
+
+    /**
+     * Report how often decoding found its tables in the cache of
+     * decoding tables. Plugins without such a cache report zeros.
+     *
+     * @param [out] hits decodes that reused cached tables
+     * @param [out] misses decodes that had to compute their tables
+     */
+    virtual void get_decode_cache_stats(uint64_t *hits,
+                                        uint64_t *misses) const {
+      *hits = *misses = 0;
+    }
+
     /**
      * Decode the **chunks** and store at least **want_to_read**
      * chunks in **decoded**.
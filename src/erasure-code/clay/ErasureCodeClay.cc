@@ -16,9 +16,14 @@
 
 #include <errno.h>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include "ErasureCodeClay.h"
 
+#include "common/Thread.h"
 #include "common/debug.h"
 #include "erasure-code/ErasureCodePlugin.h"
 #include "include/ceph_assert.h"
@@ -52,6 +57,25 @@ static int pow_int(int a, int x) {
   return power;
 }
 
+// the field of the reed_sol_van and reed_sol_r6_op codes of jerasure
+// and isa, i.e. gf-complete's default for w=8
+static int gf8_mul(int a, int b) {
+  int p = 0;
+  for (; b; b >>= 1) {
+    if (b & 1) p ^= a;
+    a <<= 1;
+    if (a & 0x100) a ^= 0x11d;
+  }
+  return p;
+}
+
+static int gf8_inv(int a) {
+  for (int b = 1; b < 256; b++) {
+    if (gf8_mul(a, b) == 1) return b;
+  }
+  ceph_abort_msg("zero has no inverse");
+}
+
 ErasureCodeClay::~ErasureCodeClay()
 {
   for (int i = 0; i < q*t; i++) {
@@ -83,10 +107,172 @@ int ErasureCodeClay::init(ErasureCodeProfile &profile,
 		       pft.profile,
 		       &pft.erasure_code,
 		       ss);
-  return r;
+  if (r)
+    return r;
+  init_pft_coefs();
+  return 0;
+}
+
+void ErasureCodeClay::init_pft_coefs()
+{
+  // the codes that multiply each byte by the coefficients of their
+  // generator matrix, as the simd kernels do
+  const std::string &plugin = pft.profile["plugin"];
+  const std::string &technique = pft.profile["technique"];
+  if ((plugin != "jerasure" && plugin != "isa") ||
+      (technique != "reed_sol_van" && technique != "reed_sol_r6_op")) {
+    return;
+  }
 
+  // read the parity rows of the generator matrix back from the plugin,
+  // jerasure and isa do not build the same one
+  int G[4][2] = {{1, 0}, {0, 1}};
+  unsigned size = pft.erasure_code->get_chunk_size(1);
+  for (int j = 0; j < 2; j++) {
+    map<int, bufferlist> encoded;
+    for (int i = 0; i < 4; i++) {
+      bufferptr ptr(buffer::create_aligned(size, SIMD_ALIGN));
+      ptr.zero();
+      if (i == j) {
+	ptr[0] = 1;
+      }
+      encoded[i].push_back(std::move(ptr));
+    }
+    if (pft.erasure_code->encode_chunks({2, 3}, &encoded)) {
+      return;
+    }
+    G[2][j] = (unsigned char)encoded[2].c_str()[0];
+    G[3][j] = (unsigned char)encoded[3].c_str()[0];
+  }
+
+  // sub-chunk e = G[e] * inverse(G[a], G[b]) * (sub-chunk a, sub-chunk b)
+  for (int a = 0; a < 4; a++) {
+    for (int b = a + 1; b < 4; b++) {
+      int det = gf8_mul(G[a][0], G[b][1]) ^ gf8_mul(G[a][1], G[b][0]);
+      ceph_assert(det != 0);
+      int inv_det = gf8_inv(det);
+      int inv[2][2] = {
+	{gf8_mul(G[b][1], inv_det), gf8_mul(G[a][1], inv_det)},
+	{gf8_mul(G[b][0], inv_det), gf8_mul(G[a][0], inv_det)},
+      };
+      for (int e = 0; e < 4; e++) {
+	for (int j = 0; j < 2; j++) {
+	  pft_coefs[a][b][e][j] =
+	    gf8_mul(G[e][0], inv[0][j]) ^ gf8_mul(G[e][1], inv[1][j]);
+	}
+      }
+    }
+  }
+  simd = ceph::jerasure_simd::get_best();
+  pft_gf8 = true;
+  dout(10) << __func__ << " coupling transforms with "
+	   << ceph::jerasure_simd::get_name(simd) << dendl;
+}
+
+void ErasureCodeClay::pft_decode_chunks(const set<int> &erasures,
+					const map<int, bufferlist> &known_subchunks,
+					map<int, bufferlist> *pftsubchunks)
+{
+  if (!pft_gf8) {
+    pft.erasure_code->decode_chunks(erasures, known_subchunks, pftsubchunks);
+    return;
+  }
+  // only compute the sub-chunks asked for, the others are scratch
+  ceph_assert(known_subchunks.size() == 2);
+  int a = known_subchunks.begin()->first;
+  int b = known_subchunks.rbegin()->first;
+  char *src[2] = {
+    pftsubchunks->at(a).c_str(),
+    pftsubchunks->at(b).c_str(),
+  };
+  for (auto e : erasures) {
+    bufferlist &out = pftsubchunks->at(e);
+    char *dst = out.c_str();
+    ceph::jerasure_simd::gf8_matrix_dotprod(simd, 2, 1, pft_coefs[a][b][e],
+					    src, &dst, out.length(), false);
+  }
 }
 
+/// runs the passes of a decode or repair call over its planes, on
+/// threads started once for the whole call rather than for every pass
+class ErasureCodeClay::PlaneWorkers {
+  const unsigned n;
+  std::mutex lock;
+  std::condition_variable cond;
+  std::vector<std::thread> workers;
+  bool stopping = false;
+  /// the current pass
+  uint64_t pass = 0;
+  const vector<int> *planes = nullptr;
+  const std::function<void(int)> *fn = nullptr;
+  std::atomic<unsigned> next = 0;
+  unsigned running = 0;
+
+  void run_pass() {
+    for (unsigned i = next++; i < planes->size(); i = next++) {
+      (*fn)((*planes)[i]);
+    }
+  }
+
+  void entry() {
+    uint64_t done = 0;
+    std::unique_lock l(lock);
+    while (true) {
+      cond.wait(l, [&] { return stopping || pass != done; });
+      if (stopping) {
+	return;
+      }
+      done = pass;
+      l.unlock();
+      run_pass();
+      l.lock();
+      if (--running == 0) {
+	cond.notify_all();
+      }
+    }
+  }
+
+public:
+  explicit PlaneWorkers(unsigned n) : n(n) {}
+  ~PlaneWorkers() {
+    {
+      std::lock_guard l(lock);
+      stopping = true;
+    }
+    cond.notify_all();
+    for (auto &w : workers) {
+      w.join();
+    }
+  }
+
+  void for_each(const vector<int> &planes,
+		const std::function<void(int)> &fn) {
+    if (n <= 1 || planes.size() <= 1) {
+      for (auto z : planes) {
+	fn(z);
+      }
+      return;
+    }
+    if (workers.empty()) {
+      for (unsigned i = 1; i < n; i++) {
+	workers.push_back(make_named_thread("ec_clay", [this] { entry(); }));
+      }
+    }
+    {
+      std::lock_guard l(lock);
+      this->planes = &planes;
+      this->fn = &fn;
+      next = 0;
+      running = workers.size();
+      pass++;
+    }
+    cond.notify_all();
+    run_pass();
+    std::unique_lock l(lock);
+    cond.wait(l, [&] { return running == 0; });
+  }
+};
+
 unsigned int ErasureCodeClay::get_chunk_size(unsigned int object_size) const
 {
   unsigned int alignment_scalar_code = pft.erasure_code->get_chunk_size(1);
@@ -196,6 +382,12 @@ int ErasureCodeClay::parse(ErasureCodeProfile &profile,
   err |= sanity_check_k_m(k, m, ss);
 
   err |= to_int("d", profile, &d, std::to_string(k+m-1), ss);
+  err |= to_int("threads", profile, &threads, "1", ss);
+  if (threads < 1) {
+    *ss << "threads=" << threads << " must be >= 1" << std::endl;
+    err = -EINVAL;
+    return err;
+  }
 
   // check for scalar_mds in profile input
   if (profile.find("scalar_mds") == profile.end() ||
@@ -446,6 +638,12 @@ int ErasureCodeClay::repair(const set<int> &want_to_read,
 
   ceph_assert(helper_data.size()+aloof_nodes.size()+recovered_data.size() ==
 	      (unsigned) q*t);
+  // planes may be repaired concurrently, make the helpers contiguous
+  // before they all call c_str() on them
+  for ([[maybe_unused]] auto& [node, bl] : helper_data) {
+    bl.c_str();
+    (void)node;  // silence -Wunused-variable
+  }
 
   int r = repair_one_lost_chunk(recovered_data, aloof_nodes,
 				helper_data, repair_blocksize,
@@ -469,15 +667,10 @@ int ErasureCodeClay::repair_one_lost_chunk(map<int, bufferlist> &recovered_data,
   unsigned sub_chunksize = repair_blocksize / repair_subchunks;
 
   int z_vec[t];
-  map<int, set<int> > ordered_planes;
+  map<int, vector<int> > ordered_planes;
   map<int, int> repair_plane_to_ind;
-  int count_retrieved_sub_chunks = 0;
   int plane_ind = 0;
 
-  bufferptr buf(buffer::create_aligned(sub_chunksize, SIMD_ALIGN));
-  bufferlist temp_buf;
-  temp_buf.push_back(buf);
-
   for (auto [index,count] : repair_sub_chunks_ind) {
     for (int j = index; j < index + count; j++) {
       get_plane_vector(j, z_vec);
@@ -491,7 +684,7 @@ int ErasureCodeClay::repair_one_lost_chunk(map<int, bufferlist> &recovered_data,
         if (node % q == z_vec[node / q]) order++;
       }
       ceph_assert(order > 0);
-      ordered_planes[order].insert(j);
+      ordered_planes[order].push_back(j);
       // to keep track of a sub chunk within helper buffer recieved
       repair_plane_to_ind[j] = plane_ind;
       plane_ind++;
@@ -524,82 +717,47 @@ int ErasureCodeClay::repair_one_lost_chunk(map<int, bufferlist> &recovered_data,
     erasures.insert(node);
   }
 
+  // a plane only depends on planes of a lower order, those of the same
+  // order can be repaired concurrently
+  PlaneWorkers workers(std::min(threads, sub_chunk_no));
   for (int order = 1; ;order++) {
     if (ordered_planes.count(order) == 0) {
       break;
     }
-    for (auto z : ordered_planes[order]) {
-      get_plane_vector(z, z_vec);
-
-      for (int y = 0; y < t; y++) {
-	for (int x = 0; x < q; x++) {
-	  int node_xy = y*q + x;
-	  map<int, bufferlist> known_subchunks;
-	  map<int, bufferlist> pftsubchunks;
-	  set<int> pft_erasures;
-	  if (erasures.count(node_xy) == 0) {
-	    assert(helper_data.count(node_xy) > 0);
-	    int z_sw = z + (x - z_vec[y])*pow_int(q,t-1-y);
-	    int node_sw = y*q + z_vec[y];
-	    int i0 = 0, i1 = 1, i2 = 2, i3 = 3;
-	    if (z_vec[y] > x) {
-	      i0 = 1;
-	      i1 = 0;
-	      i2 = 3;
-	      i3 = 2;
-	    }
-	    if (aloof_nodes.count(node_sw) > 0) {
-	      assert(repair_plane_to_ind.count(z) > 0);
-	      assert(repair_plane_to_ind.count(z_sw) > 0);
-	      pft_erasures.insert(i2);
-	      known_subchunks[i0].substr_of(helper_data[node_xy], repair_plane_to_ind[z]*sub_chunksize, sub_chunksize);
-	      known_subchunks[i3].substr_of(U_buf[node_sw], z_sw*sub_chunksize, sub_chunksize);
-	      pftsubchunks[i0] = known_subchunks[i0];
-	      pftsubchunks[i1] = temp_buf;
-	      pftsubchunks[i2].substr_of(U_buf[node_xy], z*sub_chunksize, sub_chunksize);
-	      pftsubchunks[i3] = known_subchunks[i3];
-	      for (int i=0; i<3; i++) {
-		pftsubchunks[i].rebuild_aligned(SIMD_ALIGN);
-	      }
-	      pft.erasure_code->decode_chunks(pft_erasures, known_subchunks, &pftsubchunks);
-	    } else {
-	      ceph_assert(helper_data.count(node_sw) > 0);
-	      ceph_assert(repair_plane_to_ind.count(z) > 0);
-	      if (z_vec[y] != x){
-		pft_erasures.insert(i2);
-		ceph_assert(repair_plane_to_ind.count(z_sw) > 0);
-		known_subchunks[i0].substr_of(helper_data[node_xy], repair_plane_to_ind[z]*sub_chunksize, sub_chunksize);
-		known_subchunks[i1].substr_of(helper_data[node_sw], repair_plane_to_ind[z_sw]*sub_chunksize, sub_chunksize);
-		pftsubchunks[i0] = known_subchunks[i0];
-		pftsubchunks[i1] = known_subchunks[i1];
-		pftsubchunks[i2].substr_of(U_buf[node_xy], z*sub_chunksize, sub_chunksize);
-		pftsubchunks[i3].substr_of(temp_buf, 0, sub_chunksize);
-		for (int i=0; i<3; i++) {
-		  pftsubchunks[i].rebuild_aligned(SIMD_ALIGN);
-		}
-		pft.erasure_code->decode_chunks(pft_erasures, known_subchunks, &pftsubchunks);
-	      } else {
-		char* uncoupled_chunk = U_buf[node_xy].c_str();
-		char* coupled_chunk = helper_data[node_xy].c_str();
-		memcpy(&uncoupled_chunk[z*sub_chunksize],
-		       &coupled_chunk[repair_plane_to_ind[z]*sub_chunksize],
-		       sub_chunksize);
-	      }
-	    }
-	  }
-	} // x
-      } // y
-      ceph_assert(erasures.size() <= (unsigned)m);
-      decode_uncoupled(erasures, z, sub_chunksize);
-
-      for (auto i : erasures) {
-	int x = i % q;
-	int y = i / q;
-	int node_sw = y*q+z_vec[y];
-	int z_sw = z + (x - z_vec[y]) * pow_int(q,t-1-y);
-	set<int> pft_erasures;
-	map<int, bufferlist> known_subchunks;
-	map<int, bufferlist> pftsubchunks;
+    workers.for_each(ordered_planes[order], [&](int z) {
+      repair_plane(z, erasures, aloof_nodes, lost_chunk, recovered_data,
+		   helper_data, repair_plane_to_ind, sub_chunksize);
+    });
+  } // order
+
+  return 0;
+}
+
+void ErasureCodeClay::repair_plane(int z, const set<int> &erasures,
+				   const set<int> &aloof_nodes, int lost_chunk,
+				   map<int, bufferlist> &recovered_data,
+				   map<int, bufferlist> &helper_data,
+				   const map<int, int> &repair_plane_to_ind,
+				   unsigned sub_chunksize)
+{
+  int z_vec[t];
+  get_plane_vector(z, z_vec);
+
+  // scratch for the pft outputs that are not needed
+  bufferptr buf(buffer::create_aligned(sub_chunksize, SIMD_ALIGN));
+  bufferlist temp_buf;
+  temp_buf.push_back(buf);
+
+  for (int y = 0; y < t; y++) {
+    for (int x = 0; x < q; x++) {
+      int node_xy = y*q + x;
+      map<int, bufferlist> known_subchunks;
+      map<int, bufferlist> pftsubchunks;
+      set<int> pft_erasures;
+      if (erasures.count(node_xy) == 0) {
+	assert(helper_data.count(node_xy) > 0);
+	int z_sw = z + (x - z_vec[y])*pow_int(q,t-1-y);
+	int node_sw = y*q + z_vec[y];
 	int i0 = 0, i1 = 1, i2 = 2, i3 = 3;
 	if (z_vec[y] > x) {
 	  i0 = 1;
@@ -607,38 +765,92 @@ int ErasureCodeClay::repair_one_lost_chunk(map<int, bufferlist> &recovered_data,
 	  i2 = 3;
 	  i3 = 2;
 	}
-	// make sure it is not an aloof node before you retrieve repaired_data
-	if (aloof_nodes.count(i) == 0) {
-	  if (x == z_vec[y]) { // hole-dot pair (type 0)
-	    char* coupled_chunk = recovered_data[i].c_str();
-	    char* uncoupled_chunk = U_buf[i].c_str();
-	    memcpy(&coupled_chunk[z*sub_chunksize],
-		   &uncoupled_chunk[z*sub_chunksize],
-		   sub_chunksize);
-	    count_retrieved_sub_chunks++;
-	  } else {
-	    ceph_assert(y == lost_chunk / q);
-	    ceph_assert(node_sw == lost_chunk);
-	    ceph_assert(helper_data.count(i) > 0);
-	    pft_erasures.insert(i1);
-	    known_subchunks[i0].substr_of(helper_data[i], repair_plane_to_ind[z]*sub_chunksize, sub_chunksize);
-	    known_subchunks[i2].substr_of(U_buf[i], z*sub_chunksize, sub_chunksize);
-
+	if (aloof_nodes.count(node_sw) > 0) {
+	  assert(repair_plane_to_ind.count(z) > 0);
+	  assert(repair_plane_to_ind.count(z_sw) > 0);
+	  pft_erasures.insert(i2);
+	  known_subchunks[i0].substr_of(helper_data.at(node_xy), repair_plane_to_ind.at(z)*sub_chunksize, sub_chunksize);
+	  known_subchunks[i3].substr_of(U_buf.at(node_sw), z_sw*sub_chunksize, sub_chunksize);
+	  pftsubchunks[i0] = known_subchunks[i0];
+	  pftsubchunks[i1] = temp_buf;
+	  pftsubchunks[i2].substr_of(U_buf.at(node_xy), z*sub_chunksize, sub_chunksize);
+	  pftsubchunks[i3] = known_subchunks[i3];
+	  for (int i=0; i<3; i++) {
+	    pftsubchunks[i].rebuild_aligned(SIMD_ALIGN);
+	  }
+	  pft_decode_chunks(pft_erasures, known_subchunks, &pftsubchunks);
+	} else {
+	  ceph_assert(helper_data.count(node_sw) > 0);
+	  ceph_assert(repair_plane_to_ind.count(z) > 0);
+	  if (z_vec[y] != x){
+	    pft_erasures.insert(i2);
+	    ceph_assert(repair_plane_to_ind.count(z_sw) > 0);
+	    known_subchunks[i0].substr_of(helper_data.at(node_xy), repair_plane_to_ind.at(z)*sub_chunksize, sub_chunksize);
+	    known_subchunks[i1].substr_of(helper_data.at(node_sw), repair_plane_to_ind.at(z_sw)*sub_chunksize, sub_chunksize);
 	    pftsubchunks[i0] = known_subchunks[i0];
-	    pftsubchunks[i1].substr_of(recovered_data[node_sw], z_sw*sub_chunksize, sub_chunksize);
-	    pftsubchunks[i2] = known_subchunks[i2];
-	    pftsubchunks[i3] = temp_buf;
+	    pftsubchunks[i1] = known_subchunks[i1];
+	    pftsubchunks[i2].substr_of(U_buf.at(node_xy), z*sub_chunksize, sub_chunksize);
+	    pftsubchunks[i3].substr_of(temp_buf, 0, sub_chunksize);
 	    for (int i=0; i<3; i++) {
 	      pftsubchunks[i].rebuild_aligned(SIMD_ALIGN);
 	    }
-	    pft.erasure_code->decode_chunks(pft_erasures, known_subchunks, &pftsubchunks);
+	    pft_decode_chunks(pft_erasures, known_subchunks, &pftsubchunks);
+	  } else {
+	    char* uncoupled_chunk = U_buf.at(node_xy).c_str();
+	    char* coupled_chunk = helper_data.at(node_xy).c_str();
+	    memcpy(&uncoupled_chunk[z*sub_chunksize],
+		   &coupled_chunk[repair_plane_to_ind.at(z)*sub_chunksize],
+		   sub_chunksize);
 	  }
 	}
-      } // recover all erasures
-    } // planes of particular order
-  } // order
-
-  return 0;
+      }
+    } // x
+  } // y
+  ceph_assert(erasures.size() <= (unsigned)m);
+  decode_uncoupled(erasures, z, sub_chunksize);
+
+  for (auto i : erasures) {
+    int x = i % q;
+    int y = i / q;
+    int node_sw = y*q+z_vec[y];
+    int z_sw = z + (x - z_vec[y]) * pow_int(q,t-1-y);
+    set<int> pft_erasures;
+    map<int, bufferlist> known_subchunks;
+    map<int, bufferlist> pftsubchunks;
+    int i0 = 0, i1 = 1, i2 = 2, i3 = 3;
+    if (z_vec[y] > x) {
+      i0 = 1;
+      i1 = 0;
+      i2 = 3;
+      i3 = 2;
+    }
+    // make sure it is not an aloof node before you retrieve repaired_data
+    if (aloof_nodes.count(i) == 0) {
+      if (x == z_vec[y]) { // hole-dot pair (type 0)
+	char* coupled_chunk = recovered_data.at(i).c_str();
+	char* uncoupled_chunk = U_buf.at(i).c_str();
+	memcpy(&coupled_chunk[z*sub_chunksize],
+	       &uncoupled_chunk[z*sub_chunksize],
+	       sub_chunksize);
+      } else {
+	ceph_assert(y == lost_chunk / q);
+	ceph_assert(node_sw == lost_chunk);
+	ceph_assert(helper_data.count(i) > 0);
+	pft_erasures.insert(i1);
+	known_subchunks[i0].substr_of(helper_data.at(i), repair_plane_to_ind.at(z)*sub_chunksize, sub_chunksize);
+	known_subchunks[i2].substr_of(U_buf.at(i), z*sub_chunksize, sub_chunksize);
+
+	pftsubchunks[i0] = known_subchunks[i0];
+	pftsubchunks[i1].substr_of(recovered_data.at(node_sw), z_sw*sub_chunksize, sub_chunksize);
+	pftsubchunks[i2] = known_subchunks[i2];
+	pftsubchunks[i3] = temp_buf;
+	for (int i=0; i<3; i++) {
+	  pftsubchunks[i].rebuild_aligned(SIMD_ALIGN);
+	}
+	pft_decode_chunks(pft_erasures, known_subchunks, &pftsubchunks);
+      }
+    }
+  } // recover all erasures
 }
 
 
@@ -663,7 +875,6 @@ int ErasureCodeClay::decode_layered(set<int> &erased_chunks,
 
   int max_iscore = get_max_iscore(erased_chunks);
   int order[sub_chunk_no];
-  int z_vec[t];
   for (int i = 0; i < q*t; i++) {
     if (U_buf[i].length() == 0) {
       bufferptr buf(buffer::create_aligned(size, SIMD_ALIGN));
@@ -674,42 +885,38 @@ int ErasureCodeClay::decode_layered(set<int> &erased_chunks,
 
   set_planes_sequential_decoding_order(order, erased_chunks);
 
-  for (int iscore = 0; iscore <= max_iscore; iscore++) {
-   for (int z = 0; z < sub_chunk_no; z++) {
-      if (order[z] == iscore) {
-        decode_erasures(erased_chunks, z, chunks, sc_size);
-      }
-    }
+  // planes may be decoded concurrently, make the chunks contiguous before
+  // they all call c_str() on them
+  for ([[maybe_unused]] auto& [node, bl] : *chunks) {
+    bl.c_str();
+    (void)node;  // silence -Wunused-variable
+  }
 
+  PlaneWorkers workers(std::min(threads, sub_chunk_no));
+  for (int iscore = 0; iscore <= max_iscore; iscore++) {
+    vector<int> planes;
     for (int z = 0; z < sub_chunk_no; z++) {
       if (order[z] == iscore) {
-	get_plane_vector(z, z_vec);
-        for (auto node_xy : erased_chunks) {
-          int x = node_xy % q;
-          int y = node_xy / q;
-	  int node_sw = y*q+z_vec[y];
-          if (z_vec[y] != x) {
-            if (erased_chunks.count(node_sw) == 0) {
-	      recover_type1_erasure(chunks, x, y, z, z_vec, sc_size);
-	    } else if (z_vec[y] < x){
-              ceph_assert(erased_chunks.count(node_sw) > 0);
-              ceph_assert(z_vec[y] != x);
-              get_coupled_from_uncoupled(chunks, x, y, z, z_vec, sc_size);
-	    }
-	  } else {
-	    char* C = (*chunks)[node_xy].c_str();
-            char* U = U_buf[node_xy].c_str();
-            memcpy(&C[z*sc_size], &U[z*sc_size], sc_size);
-          }
-        }
+	planes.push_back(z);
       }
-    } // plane
+    }
+    // uncoupling a plane may also fill in the uncoupled sub-chunks of a
+    // later plane with the same score, hence one pass for each step
+    workers.for_each(planes, [&](int z) {
+      uncouple_plane(erased_chunks, z, chunks, sc_size);
+    });
+    workers.for_each(planes, [&](int z) {
+      decode_uncoupled(erased_chunks, z, sc_size);
+    });
+    workers.for_each(planes, [&](int z) {
+      couple_plane(erased_chunks, z, chunks, sc_size);
+    });
   } // iscore, order
 
   return 0;
 }
 
-int ErasureCodeClay::decode_erasures(const set<int>& erased_chunks, int z,
+void ErasureCodeClay::uncouple_plane(const set<int>& erased_chunks, int z,
 				     map<int, bufferlist>* chunks, int sc_size)
 {
   int z_vec[t];
@@ -724,8 +931,8 @@ int ErasureCodeClay::decode_erasures(const set<int>& erased_chunks, int z,
 	if (z_vec[y] < x) {
 	  get_uncoupled_from_coupled(chunks, x, y, z, z_vec, sc_size);
 	} else if (z_vec[y] == x) {
-	  char* uncoupled_chunk = U_buf[node_xy].c_str();
-	  char* coupled_chunk = (*chunks)[node_xy].c_str();
+	  char* uncoupled_chunk = U_buf.at(node_xy).c_str();
+	  char* coupled_chunk = chunks->at(node_xy).c_str();
           memcpy(&uncoupled_chunk[z*sc_size], &coupled_chunk[z*sc_size], sc_size);
         } else {
           if (erased_chunks.count(node_sw) > 0) {
@@ -735,7 +942,32 @@ int ErasureCodeClay::decode_erasures(const set<int>& erased_chunks, int z,
       }
     }
   }
-  return decode_uncoupled(erased_chunks, z, sc_size);
+}
+
+void ErasureCodeClay::couple_plane(const set<int>& erased_chunks, int z,
+				   map<int, bufferlist>* chunks, int sc_size)
+{
+  int z_vec[t];
+
+  get_plane_vector(z, z_vec);
+  for (auto node_xy : erased_chunks) {
+    int x = node_xy % q;
+    int y = node_xy / q;
+    int node_sw = y*q+z_vec[y];
+    if (z_vec[y] != x) {
+      if (erased_chunks.count(node_sw) == 0) {
+	recover_type1_erasure(chunks, x, y, z, z_vec, sc_size);
+      } else if (z_vec[y] < x){
+	ceph_assert(erased_chunks.count(node_sw) > 0);
+	ceph_assert(z_vec[y] != x);
+	get_coupled_from_uncoupled(chunks, x, y, z, z_vec, sc_size);
+      }
+    } else {
+      char* C = chunks->at(node_xy).c_str();
+      char* U = U_buf.at(node_xy).c_str();
+      memcpy(&C[z*sc_size], &U[z*sc_size], sc_size);
+    }
+  }
 }
 
 int ErasureCodeClay::decode_uncoupled(const set<int>& erased_chunks, int z, int sc_size)
@@ -745,10 +977,10 @@ int ErasureCodeClay::decode_uncoupled(const set<int>& erased_chunks, int z, int
 
   for (int i = 0; i < q*t; i++) {
     if (erased_chunks.count(i) == 0) {
-      known_subchunks[i].substr_of(U_buf[i], z*sc_size, sc_size);
+      known_subchunks[i].substr_of(U_buf.at(i), z*sc_size, sc_size);
       all_subchunks[i] = known_subchunks[i];
     } else {
-      all_subchunks[i].substr_of(U_buf[i], z*sc_size, sc_size);
+      all_subchunks[i].substr_of(U_buf.at(i), z*sc_size, sc_size);
     }
     all_subchunks[i].rebuild_aligned_size_and_memory(sc_size, SIMD_ALIGN);
     assert(all_subchunks[i].is_contiguous());
@@ -795,9 +1027,9 @@ void ErasureCodeClay::recover_type1_erasure(map<int, bufferlist>* chunks,
   }
 
   erased_chunks.insert(i0);
-  pftsubchunks[i0].substr_of((*chunks)[node_xy], z * sc_size, sc_size);
-  known_subchunks[i1].substr_of((*chunks)[node_sw], z_sw * sc_size, sc_size);
-  known_subchunks[i2].substr_of(U_buf[node_xy], z * sc_size, sc_size);
+  pftsubchunks[i0].substr_of(chunks->at(node_xy), z * sc_size, sc_size);
+  known_subchunks[i1].substr_of(chunks->at(node_sw), z_sw * sc_size, sc_size);
+  known_subchunks[i2].substr_of(U_buf.at(node_xy), z * sc_size, sc_size);
   pftsubchunks[i1] = known_subchunks[i1];
   pftsubchunks[i2] = known_subchunks[i2];
   pftsubchunks[i3].push_back(ptr);
@@ -806,7 +1038,7 @@ void ErasureCodeClay::recover_type1_erasure(map<int, bufferlist>* chunks,
     pftsubchunks[i].rebuild_aligned_size_and_memory(sc_size, SIMD_ALIGN);
   }
 
-  pft.erasure_code->decode_chunks(erased_chunks, known_subchunks, &pftsubchunks);
+  pft_decode_chunks(erased_chunks, known_subchunks, &pftsubchunks);
 }
 
 void ErasureCodeClay::get_coupled_from_uncoupled(map<int, bufferlist>* chunks,
@@ -821,19 +1053,19 @@ void ErasureCodeClay::get_coupled_from_uncoupled(map<int, bufferlist>* chunks,
 
   ceph_assert(z_vec[y] < x);
   map<int, bufferlist> uncoupled_subchunks;
-  uncoupled_subchunks[2].substr_of(U_buf[node_xy], z * sc_size, sc_size);
-  uncoupled_subchunks[3].substr_of(U_buf[node_sw], z_sw * sc_size, sc_size);
+  uncoupled_subchunks[2].substr_of(U_buf.at(node_xy), z * sc_size, sc_size);
+  uncoupled_subchunks[3].substr_of(U_buf.at(node_sw), z_sw * sc_size, sc_size);
 
   map<int, bufferlist> pftsubchunks;
-  pftsubchunks[0].substr_of((*chunks)[node_xy], z * sc_size, sc_size);
-  pftsubchunks[1].substr_of((*chunks)[node_sw], z_sw * sc_size, sc_size);
+  pftsubchunks[0].substr_of(chunks->at(node_xy), z * sc_size, sc_size);
+  pftsubchunks[1].substr_of(chunks->at(node_sw), z_sw * sc_size, sc_size);
   pftsubchunks[2] = uncoupled_subchunks[2];
   pftsubchunks[3] = uncoupled_subchunks[3];
 
   for (int i=0; i<3; i++) {
     pftsubchunks[i].rebuild_aligned_size_and_memory(sc_size, SIMD_ALIGN);
   }
-  pft.erasure_code->decode_chunks(erased_chunks, uncoupled_subchunks, &pftsubchunks);
+  pft_decode_chunks(erased_chunks, uncoupled_subchunks, &pftsubchunks);
 }
 
 void ErasureCodeClay::get_uncoupled_from_coupled(map<int, bufferlist>* chunks,
@@ -854,18 +1086,18 @@ void ErasureCodeClay::get_uncoupled_from_coupled(map<int, bufferlist>* chunks,
     i3 = 2;
   }
   map<int, bufferlist> coupled_subchunks;
-  coupled_subchunks[i0].substr_of((*chunks)[node_xy], z * sc_size, sc_size);
-  coupled_subchunks[i1].substr_of((*chunks)[node_sw], z_sw * sc_size, sc_size);
+  coupled_subchunks[i0].substr_of(chunks->at(node_xy), z * sc_size, sc_size);
+  coupled_subchunks[i1].substr_of(chunks->at(node_sw), z_sw * sc_size, sc_size);
 
   map<int, bufferlist> pftsubchunks;
   pftsubchunks[0] = coupled_subchunks[0];
   pftsubchunks[1] = coupled_subchunks[1];
-  pftsubchunks[i2].substr_of(U_buf[node_xy], z * sc_size, sc_size);
-  pftsubchunks[i3].substr_of(U_buf[node_sw], z_sw * sc_size, sc_size);
+  pftsubchunks[i2].substr_of(U_buf.at(node_xy), z * sc_size, sc_size);
+  pftsubchunks[i3].substr_of(U_buf.at(node_sw), z_sw * sc_size, sc_size);
   for (int i=0; i<3; i++) {
     pftsubchunks[i].rebuild_aligned_size_and_memory(sc_size, SIMD_ALIGN);
   }
-  pft.erasure_code->decode_chunks(erased_chunks, coupled_subchunks, &pftsubchunks);
+  pft_decode_chunks(erased_chunks, coupled_subchunks, &pftsubchunks);
 }
 
 int ErasureCodeClay::get_max_iscore(set<int>& erased_chunks)
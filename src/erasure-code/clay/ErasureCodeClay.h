@@ -17,9 +17,13 @@
 #ifndef CEPH_ERASURE_CODE_CLAY_H
 #define CEPH_ERASURE_CODE_CLAY_H
 
+#include <functional>
+#include <vector>
+
 #include "include/err.h"
 #include "include/buffer_fwd.h"
 #include "erasure-code/ErasureCode.h"
+#include "erasure-code/jerasure/jerasure_simd.h"
 
 class ErasureCodeClay final : public ceph::ErasureCode {
 public:
@@ -29,6 +33,8 @@ public:
   int k = 0, m = 0, d = 0, w = 8;
   int q = 0, t = 0, nu = 0;
   int sub_chunk_no = 0;
+  /// planes decoded and repaired concurrently
+  int threads = 1;
 
   std::map<int, ceph::bufferlist> U_buf;
 
@@ -40,6 +46,12 @@ public:
   ScalarMDS pft;
   const std::string directory;
 
+  /// the pft is a GF(2^8) code whose transforms are applied with simd
+  bool pft_gf8 = false;
+  ceph::jerasure_simd::isa_t simd = ceph::jerasure_simd::isa_t::none;
+  /// pft_coefs[a][b][e] computes sub-chunk e from the known a < b
+  int pft_coefs[4][4][4][2] = {};
+
   explicit ErasureCodeClay(const std::string& dir)
     : directory(dir)
   {}
@@ -102,9 +114,19 @@ private:
   void get_repair_subchunks(const int &lost_node,
 			    std::vector<std::pair<int, int>> &repair_sub_chunks_ind);
 
-  int decode_erasures(const std::set<int>& erased_chunks, int z,
+  void uncouple_plane(const std::set<int>& erased_chunks, int z,
                       std::map<int, ceph::bufferlist>* chunks, int sc_size);
 
+  void couple_plane(const std::set<int>& erased_chunks, int z,
+                    std::map<int, ceph::bufferlist>* chunks, int sc_size);
+
+  void repair_plane(int z, const std::set<int> &erasures,
+                    const std::set<int> &aloof_nodes, int lost_chunk,
+                    std::map<int, ceph::bufferlist> &recovered_data,
+                    std::map<int, ceph::bufferlist> &helper_data,
+                    const std::map<int, int> &repair_plane_to_ind,
+                    unsigned sub_chunksize);
+
   int decode_uncoupled(const std::set<int>& erasures, int z, int ss_size);
 
   void set_planes_sequential_decoding_order(int* order, std::set<int>& erasures);
@@ -120,6 +142,14 @@ private:
 
   void get_plane_vector(int z, int* z_vec);
 
+  void init_pft_coefs();
+
+  void pft_decode_chunks(const std::set<int> &erasures,
+			 const std::map<int, ceph::bufferlist> &known_subchunks,
+			 std::map<int, ceph::bufferlist> *pftsubchunks);
+
+  class PlaneWorkers;
+
   int get_max_iscore(std::set<int>& erased_chunks);
 };
 
@@ -132,6 +132,51 @@ ErasureCodeIsaDefault::isa_encode(char **data,
 
 // -----------------------------------------------------------------------------
 
+int
+ErasureCodeIsaDefault::apply_delta(const map<int, bufferlist> &deltas,
+                                   map<int, bufferlist> *parity)
+{
+  if (parity->empty())
+    return 0;
+  unsigned size = parity->begin()->second.length();
+
+  // ec_encode_data_update() updates all m coding chunks, point the ones
+  // we were not given to scratch space
+  bufferptr scratch;
+  unsigned char *coding[m];
+  for (int i = 0; i < m; i++) {
+    auto p = parity->find(k + i);
+    if (p == parity->end()) {
+      if (!scratch.length())
+        scratch = bufferptr(buffer::create_aligned(size, SIMD_ALIGN));
+      coding[i] = (unsigned char*) scratch.c_str();
+    } else {
+      if (p->second.length() != size)
+        return -EINVAL;
+      coding[i] = (unsigned char*) p->second.c_str();
+    }
+  }
+  for (auto &i : *parity) {
+    if (i.first < k || i.first >= k + m)
+      return -EINVAL;
+  }
+
+  for (auto &[j, delta] : deltas) {
+    if (j < 0 || j >= k || delta.length() != size)
+      return -EINVAL;
+    unsigned char *src =
+      (unsigned char*) const_cast<bufferlist&>(delta).c_str();
+    if (m == 1)
+      // isa_encode() uses plain xor for a single parity chunk
+      byte_xor(src, coding[0], src + size);
+    else
+      ec_encode_data_update(size, k, m, j, encode_tbls, src, coding);
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+
 bool
 ErasureCodeIsaDefault::erasure_contains(int *erasures, int i)
 {
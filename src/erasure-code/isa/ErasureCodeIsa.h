@@ -134,6 +134,14 @@ public:
                           char **coding,
                           int blocksize) override;
 
+  bool supports_parity_delta() const override
+  {
+    return chunk_mapping.empty();
+  }
+
+  int apply_delta(const std::map<int, ceph::buffer::list> &deltas,
+                  std::map<int, ceph::buffer::list> *parity) override;
+
   virtual bool erasure_contains(int *erasures, int i);
 
   int isa_decode(int *erasures,
@@ -15,6 +15,8 @@
  * 
  */
 
+#include <vector>
+
 #include "common/debug.h"
 #include "ErasureCodeJerasure.h"
 
@@ -74,6 +76,24 @@ int ErasureCodeJerasure::parse(ErasureCodeProfile &profile,
     err = -EINVAL;
   }
   err |= sanity_check_k_m(k, m, ss);
+
+  std::string simd_name;
+  err |= to_string("jerasure-simd", profile, &simd_name, "auto", ss);
+  if (ceph::jerasure_simd::parse(simd_name, &simd) < 0) {
+    *ss << "jerasure-simd=" << simd_name << " must be one of auto, none, "
+	<< "avx2, avx512, gfni_avx2 or gfni_avx512" << std::endl;
+    simd = ceph::jerasure_simd::isa_t::none;
+    err = -EINVAL;
+  } else if (!ceph::jerasure_simd::is_supported(simd)) {
+    // the profile is shared by all the OSDs of the pool, and the output
+    // does not depend on the kernels
+    dout(1) << "jerasure-simd=" << simd_name
+	    << " is not supported by this cpu, using "
+	    << ceph::jerasure_simd::get_name(ceph::jerasure_simd::get_best())
+	    << dendl;
+    simd = ceph::jerasure_simd::get_best();
+  }
+  dout(10) << "jerasure-simd=" << ceph::jerasure_simd::get_name(simd) << dendl;
   return err;
 }
 
@@ -152,6 +172,154 @@ bool ErasureCodeJerasure::is_prime(int value)
   return false;
 }
 
+int ErasureCodeJerasure::matrix_apply_delta(
+  const int *matrix,
+  const map<int, bufferlist> &deltas,
+  map<int, bufferlist> *parity)
+{
+  // parity chunk i is the sum of matrix[i][j] * data chunk j, hence
+  // changes by matrix[i][j] * delta j
+  if (w == 8 && simd != ceph::jerasure_simd::isa_t::none)
+    return simd_apply_delta(matrix, deltas, parity);
+  for (auto &[i, coding] : *parity) {
+    if (i < k || i >= k + m)
+      return -EINVAL;
+    char *dst = coding.c_str();
+    for (auto &[j, delta] : deltas) {
+      if (j < 0 || j >= k || delta.length() != coding.length())
+	return -EINVAL;
+      int coef = matrix[(i - k) * k + j];
+      char *src = const_cast<bufferlist&>(delta).c_str();
+      int size = coding.length();
+      if (coef == 0) {
+	continue;
+      } else if (coef == 1) {
+	galois_region_xor(src, dst, size);
+      } else {
+	switch (w) {
+	case 8:
+	  galois_w08_region_multiply(src, coef, size, dst, 1);
+	  break;
+	case 16:
+	  galois_w16_region_multiply(src, coef, size, dst, 1);
+	  break;
+	case 32:
+	  galois_w32_region_multiply(src, coef, size, dst, 1);
+	  break;
+	default:
+	  return -EINVAL;
+	}
+      }
+    }
+  }
+  return 0;
+}
+
+int ErasureCodeJerasure::matrix_decode(const int *matrix,
+				       int *erasures,
+				       char **data,
+				       char **coding,
+				       int blocksize)
+{
+  // same as jerasure_matrix_decode(), with the decoding matrix of the
+  // erasures inverted once and cached
+  int *erased = jerasure_erasures_to_erased(k, m, erasures);
+  if (erased == NULL)
+    return -1;
+  set<int> erased_chunks, erased_data;
+  for (int i = 0; i < k + m; i++) {
+    if (erased[i])
+      erased_chunks.insert(i);
+    if (erased[i] && i < k)
+      erased_data.insert(i);
+  }
+
+  if (!erased_data.empty()) {
+    // the k x k decoding matrix, followed by the ids of the k surviving
+    // chunks it reads
+    std::string signature = ErasureCodeDecodeCache::signature(erased_chunks);
+    bufferptr table = decode_cache.get(signature);
+    if (!table.length()) {
+      table = ceph::buffer::create((k * k + k) * sizeof(int));
+      int *decoding_matrix = (int*)table.c_str();
+      if (jerasure_make_decoding_matrix(k, m, w, const_cast<int*>(matrix),
+					erased, decoding_matrix,
+					decoding_matrix + k * k) < 0) {
+	free(erased);
+	return -1;
+      }
+      decode_cache.put(signature, table);
+    }
+    const int *decoding_matrix = (const int*)table.c_str();
+    const int *dm_ids = decoding_matrix + k * k;
+    if (w == 8 && simd != ceph::jerasure_simd::isa_t::none) {
+      std::vector<int> rows;
+      std::vector<char*> src(k), dst;
+      for (int j = 0; j < k; j++)
+	src[j] = dm_ids[j] < k ? data[dm_ids[j]] : coding[dm_ids[j] - k];
+      for (int i : erased_data) {
+	rows.insert(rows.end(), decoding_matrix + i * k,
+		    decoding_matrix + (i + 1) * k);
+	dst.push_back(data[i]);
+      }
+      ceph::jerasure_simd::gf8_matrix_dotprod(simd, k, dst.size(), rows.data(),
+					      src.data(), dst.data(), blocksize,
+					      false);
+    } else {
+      for (int i : erased_data)
+	jerasure_matrix_dotprod(k, w, const_cast<int*>(decoding_matrix + i * k),
+				const_cast<int*>(dm_ids), i, data, coding,
+				blocksize);
+    }
+  }
+
+  // then encode the erased coding chunks again
+  for (int i = 0; i < m; i++) {
+    if (!erased[k + i])
+      continue;
+    if (w == 8 && simd != ceph::jerasure_simd::isa_t::none)
+      ceph::jerasure_simd::gf8_matrix_dotprod(simd, k, 1, matrix + i * k,
+					      data, &coding[i], blocksize,
+					      false);
+    else
+      jerasure_matrix_dotprod(k, w, const_cast<int*>(matrix + i * k), NULL,
+			      k + i, data, coding, blocksize);
+  }
+  free(erased);
+  return 0;
+}
+
+int ErasureCodeJerasure::simd_apply_delta(
+  const int *matrix,
+  const map<int, bufferlist> &deltas,
+  map<int, bufferlist> *parity)
+{
+  std::vector<int> coefs;
+  std::vector<char*> src;
+  std::vector<char*> dst;
+  for (auto &[j, delta] : deltas) {
+    if (j < 0 || j >= k)
+      return -EINVAL;
+    src.push_back(const_cast<bufferlist&>(delta).c_str());
+  }
+  for (auto &[i, coding] : *parity) {
+    if (i < k || i >= k + m)
+      return -EINVAL;
+    for (auto &[j, delta] : deltas) {
+      if (delta.length() != coding.length())
+	return -EINVAL;
+      coefs.push_back(matrix[(i - k) * k + j]);
+    }
+    dst.push_back(coding.c_str());
+  }
+  if (dst.empty() || src.empty())
+    return 0;
+  ceph::jerasure_simd::gf8_matrix_dotprod(
+    simd, src.size(), dst.size(), coefs.data(), src.data(), dst.data(),
+    parity->begin()->second.length(), true);
+  return 0;
+}
+
 // 
 // ErasureCodeJerasureReedSolomonVandermonde
 //
@@ -159,7 +327,11 @@ void ErasureCodeJerasureReedSolomonVandermonde::jerasure_encode(char **data,
                                                                 char **coding,
                                                                 int blocksize)
 {
-  jerasure_matrix_encode(k, m, w, matrix, data, coding, blocksize);
+  if (w == 8 && simd != ceph::jerasure_simd::isa_t::none)
+    ceph::jerasure_simd::gf8_matrix_dotprod(simd, k, m, matrix,
+					    data, coding, blocksize, false);
+  else
+    jerasure_matrix_encode(k, m, w, matrix, data, coding, blocksize);
 }
 
 int ErasureCodeJerasureReedSolomonVandermonde::jerasure_decode(int *erasures,
@@ -167,8 +339,14 @@ int ErasureCodeJerasureReedSolomonVandermonde::jerasure_decode(int *erasures,
                                                                 char **coding,
                                                                 int blocksize)
 {
-  return jerasure_matrix_decode(k, m, w, matrix, 1,
-				erasures, data, coding, blocksize);
+  return matrix_decode(matrix, erasures, data, coding, blocksize);
+}
+
+int ErasureCodeJerasureReedSolomonVandermonde::apply_delta(
+  const map<int, bufferlist> &deltas,
+  map<int, bufferlist> *parity)
+{
+  return matrix_apply_delta(matrix, deltas, parity);
 }
 
 unsigned ErasureCodeJerasureReedSolomonVandermonde::get_alignment() const
@@ -210,7 +388,12 @@ void ErasureCodeJerasureReedSolomonRAID6::jerasure_encode(char **data,
                                                                 char **coding,
                                                                 int blocksize)
 {
-  reed_sol_r6_encode(k, w, data, coding, blocksize);
+  // P and Q are the rows of the RAID6 coding matrix
+  if (w == 8 && simd != ceph::jerasure_simd::isa_t::none)
+    ceph::jerasure_simd::gf8_matrix_dotprod(simd, k, m, matrix,
+					    data, coding, blocksize, false);
+  else
+    reed_sol_r6_encode(k, w, data, coding, blocksize);
 }
 
 int ErasureCodeJerasureReedSolomonRAID6::jerasure_decode(int *erasures,
@@ -218,7 +401,14 @@ int ErasureCodeJerasureReedSolomonRAID6::jerasure_decode(int *erasures,
 							 char **coding,
 							 int blocksize)
 {
-  return jerasure_matrix_decode(k, m, w, matrix, 1, erasures, data, coding, blocksize);
+  return matrix_decode(matrix, erasures, data, coding, blocksize);
+}
+
+int ErasureCodeJerasureReedSolomonRAID6::apply_delta(
+  const map<int, bufferlist> &deltas,
+  map<int, bufferlist> *parity)
+{
+  return matrix_apply_delta(matrix, deltas, parity);
 }
 
 unsigned ErasureCodeJerasureReedSolomonRAID6::get_alignment() const
@@ -262,8 +452,10 @@ void ErasureCodeJerasureCauchy::jerasure_encode(char **data,
 						char **coding,
 						int blocksize)
 {
-  jerasure_schedule_encode(k, m, w, schedule,
-			   data, coding, blocksize, packetsize);
+  if (!ceph::jerasure_simd::schedule_encode(simd, k, m, w, schedule,
+					    data, coding, blocksize, packetsize))
+    jerasure_schedule_encode(k, m, w, schedule, data, coding, blocksize,
+			     packetsize);
 }
 
 int ErasureCodeJerasureCauchy::jerasure_decode(int *erasures,
@@ -350,8 +542,10 @@ void ErasureCodeJerasureLiberation::jerasure_encode(char **data,
                                                     char **coding,
                                                     int blocksize)
 {
-  jerasure_schedule_encode(k, m, w, schedule, data,
-			   coding, blocksize, packetsize);
+  if (!ceph::jerasure_simd::schedule_encode(simd, k, m, w, schedule, data,
+					    coding, blocksize, packetsize))
+    jerasure_schedule_encode(k, m, w, schedule, data, coding, blocksize,
+			     packetsize);
 }
 
 int ErasureCodeJerasureLiberation::jerasure_decode(int *erasures,
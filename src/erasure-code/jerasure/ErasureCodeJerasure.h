@@ -19,6 +19,7 @@
 #define CEPH_ERASURE_CODE_JERASURE_H
 
 #include "erasure-code/ErasureCode.h"
+#include "jerasure_simd.h"
 
 class ErasureCodeJerasure : public ceph::ErasureCode {
 public:
@@ -32,6 +33,8 @@ public:
   std::string rule_root;
   std::string rule_failure_domain;
   bool per_chunk_alignment;
+  /// kernels used instead of jerasure's where they apply
+  ceph::jerasure_simd::isa_t simd;
 
   explicit ErasureCodeJerasure(const char *_technique) :
     k(0),
@@ -41,7 +44,8 @@ public:
     w(0),
     DEFAULT_W("8"),
     technique(_technique),
-    per_chunk_alignment(false)
+    per_chunk_alignment(false),
+    simd(ceph::jerasure_simd::isa_t::none)
   {}
 
   ~ErasureCodeJerasure() override {}
@@ -77,6 +81,17 @@ public:
   static bool is_prime(int value);
 protected:
   virtual int parse(ceph::ErasureCodeProfile &profile, std::ostream *ss);
+  int matrix_apply_delta(const int *matrix,
+			 const std::map<int, ceph::buffer::list> &deltas,
+			 std::map<int, ceph::buffer::list> *parity);
+  int matrix_decode(const int *matrix,
+		    int *erasures,
+		    char **data,
+		    char **coding,
+		    int blocksize);
+  int simd_apply_delta(const int *matrix,
+		       const std::map<int, ceph::buffer::list> &deltas,
+		       std::map<int, ceph::buffer::list> *parity);
 };
 class ErasureCodeJerasureReedSolomonVandermonde : public ErasureCodeJerasure {
 public:
@@ -102,6 +117,11 @@ public:
                                char **data,
                                char **coding,
                                int blocksize) override;
+  bool supports_parity_delta() const override {
+    return chunk_mapping.empty();
+  }
+  int apply_delta(const std::map<int, ceph::buffer::list> &deltas,
+		  std::map<int, ceph::buffer::list> *parity) override;
   unsigned get_alignment() const override;
   void prepare() override;
 private:
@@ -132,6 +152,11 @@ public:
                                char **data,
                                char **coding,
                                int blocksize) override;
+  bool supports_parity_delta() const override {
+    return chunk_mapping.empty();
+  }
+  int apply_delta(const std::map<int, ceph::buffer::list> &deltas,
+		  std::map<int, ceph::buffer::list> *parity) override;
   unsigned get_alignment() const override;
   void prepare() override;
 private:
@@ -0,0 +1,388 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph distributed storage system
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "arch/probe.h"
+#include "arch/intel.h"
+#include "jerasure_simd.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define JERASURE_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace ceph::jerasure_simd {
+
+namespace {
+
+// gf-complete's default field for w=8
+constexpr unsigned GF8_POLY = 0x11d;
+
+uint8_t gf8_mul(unsigned a, unsigned b)
+{
+  unsigned p = 0;
+  for (; b; b >>= 1) {
+    if (b & 1)
+      p ^= a;
+    a <<= 1;
+    if (a & 0x100)
+      a ^= GF8_POLY;
+  }
+  return p;
+}
+
+/// everything the kernels need to multiply a region by one coefficient
+struct gf8_coef_t {
+  uint8_t lo[16];   ///< c * x for x < 16
+  uint8_t hi[16];   ///< c * (x << 4) for x < 16
+  uint64_t affine;  ///< multiplication by c as a gf2p8affineqb bit matrix
+};
+
+struct gf8_tables_t {
+  gf8_coef_t coef[256];
+
+  gf8_tables_t() {
+    for (unsigned c = 0; c < 256; c++) {
+      gf8_coef_t &t = coef[c];
+      for (unsigned x = 0; x < 16; x++) {
+	t.lo[x] = gf8_mul(c, x);
+	t.hi[x] = gf8_mul(c, x << 4);
+      }
+      // multiplying by c is linear over GF(2): bit i of c * x is the
+      // parity of x masked with row i, which gf2p8affineqb reads from
+      // byte 7 - i of the matrix
+      t.affine = 0;
+      for (unsigned i = 0; i < 8; i++) {
+	uint64_t row = 0;
+	for (unsigned j = 0; j < 8; j++) {
+	  if (gf8_mul(c, 1u << j) & (1u << i))
+	    row |= 1u << j;
+	}
+	t.affine |= row << (8 * (7 - i));
+      }
+    }
+  }
+};
+
+const gf8_tables_t &get_tables()
+{
+  static const gf8_tables_t tables;
+  return tables;
+}
+
+void dotprod_tail(int nsrc, int ndst, const int *coefs,
+		  char **src, char **dst, int begin, int end, bool accumulate)
+{
+  const gf8_tables_t &tables = get_tables();
+  for (int i = 0; i < ndst; i++) {
+    uint8_t *d = (uint8_t *)dst[i];
+    if (!accumulate)
+      memset(d + begin, 0, end - begin);
+    for (int j = 0; j < nsrc; j++) {
+      const gf8_coef_t &t = tables.coef[coefs[i * nsrc + j]];
+      const uint8_t *s = (const uint8_t *)src[j];
+      for (int o = begin; o < end; o++)
+	d[o] ^= t.lo[s[o] & 0xf] ^ t.hi[s[o] >> 4];
+    }
+  }
+}
+
+void xor_tail(const char *src, char *dst, int begin, int end)
+{
+  for (int o = begin; o < end; o++)
+    dst[o] ^= src[o];
+}
+
+#ifdef JERASURE_SIMD_X86
+
+// Each dot product kernel walks the regions one vector at a time and
+// computes all the destination vectors for that offset, so that the
+// source vectors are read from memory once and from L1 afterwards.
+
+__attribute__((target("avx2")))
+void dotprod_avx2(int nsrc, int ndst, const int *coefs,
+		  char **src, char **dst, int size, bool accumulate)
+{
+  const gf8_tables_t &tables = get_tables();
+  const __m256i mask = _mm256_set1_epi8(0x0f);
+  int end = size & ~31;
+  for (int o = 0; o < end; o += 32) {
+    for (int i = 0; i < ndst; i++) {
+      __m256i acc = accumulate ?
+	_mm256_loadu_si256((const __m256i *)(dst[i] + o)) :
+	_mm256_setzero_si256();
+      for (int j = 0; j < nsrc; j++) {
+	int c = coefs[i * nsrc + j];
+	if (c == 0)
+	  continue;
+	const gf8_coef_t &t = tables.coef[c];
+	__m256i x = _mm256_loadu_si256((const __m256i *)(src[j] + o));
+	__m256i lo = _mm256_broadcastsi128_si256(
+	  _mm_loadu_si128((const __m128i *)t.lo));
+	__m256i hi = _mm256_broadcastsi128_si256(
+	  _mm_loadu_si128((const __m128i *)t.hi));
+	lo = _mm256_shuffle_epi8(lo, _mm256_and_si256(x, mask));
+	hi = _mm256_shuffle_epi8(
+	  hi, _mm256_and_si256(_mm256_srli_epi64(x, 4), mask));
+	acc = _mm256_xor_si256(acc, _mm256_xor_si256(lo, hi));
+      }
+      _mm256_storeu_si256((__m256i *)(dst[i] + o), acc);
+    }
+  }
+  dotprod_tail(nsrc, ndst, coefs, src, dst, end, size, accumulate);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void dotprod_avx512(int nsrc, int ndst, const int *coefs,
+		    char **src, char **dst, int size, bool accumulate)
+{
+  const gf8_tables_t &tables = get_tables();
+  const __m512i mask = _mm512_set1_epi8(0x0f);
+  int end = size & ~63;
+  for (int o = 0; o < end; o += 64) {
+    for (int i = 0; i < ndst; i++) {
+      __m512i acc = accumulate ?
+	_mm512_loadu_si512(dst[i] + o) :
+	_mm512_setzero_si512();
+      for (int j = 0; j < nsrc; j++) {
+	int c = coefs[i * nsrc + j];
+	if (c == 0)
+	  continue;
+	const gf8_coef_t &t = tables.coef[c];
+	__m512i x = _mm512_loadu_si512(src[j] + o);
+	__m512i lo = _mm512_broadcast_i32x4(
+	  _mm_loadu_si128((const __m128i *)t.lo));
+	__m512i hi = _mm512_broadcast_i32x4(
+	  _mm_loadu_si128((const __m128i *)t.hi));
+	lo = _mm512_shuffle_epi8(lo, _mm512_and_si512(x, mask));
+	hi = _mm512_shuffle_epi8(
+	  hi, _mm512_and_si512(_mm512_srli_epi64(x, 4), mask));
+	acc = _mm512_xor_si512(acc, _mm512_xor_si512(lo, hi));
+      }
+      _mm512_storeu_si512(dst[i] + o, acc);
+    }
+  }
+  dotprod_tail(nsrc, ndst, coefs, src, dst, end, size, accumulate);
+}
+
+__attribute__((target("avx2,gfni")))
+void dotprod_gfni_avx2(int nsrc, int ndst, const int *coefs,
+		       char **src, char **dst, int size, bool accumulate)
+{
+  const gf8_tables_t &tables = get_tables();
+  int end = size & ~31;
+  for (int o = 0; o < end; o += 32) {
+    for (int i = 0; i < ndst; i++) {
+      __m256i acc = accumulate ?
+	_mm256_loadu_si256((const __m256i *)(dst[i] + o)) :
+	_mm256_setzero_si256();
+      for (int j = 0; j < nsrc; j++) {
+	int c = coefs[i * nsrc + j];
+	if (c == 0)
+	  continue;
+	__m256i x = _mm256_loadu_si256((const __m256i *)(src[j] + o));
+	__m256i a = _mm256_set1_epi64x(tables.coef[c].affine);
+	acc = _mm256_xor_si256(acc, _mm256_gf2p8affine_epi64_epi8(x, a, 0));
+      }
+      _mm256_storeu_si256((__m256i *)(dst[i] + o), acc);
+    }
+  }
+  dotprod_tail(nsrc, ndst, coefs, src, dst, end, size, accumulate);
+}
+
+__attribute__((target("avx512f,avx512bw,gfni")))
+void dotprod_gfni_avx512(int nsrc, int ndst, const int *coefs,
+			 char **src, char **dst, int size, bool accumulate)
+{
+  const gf8_tables_t &tables = get_tables();
+  int end = size & ~63;
+  for (int o = 0; o < end; o += 64) {
+    for (int i = 0; i < ndst; i++) {
+      __m512i acc = accumulate ?
+	_mm512_loadu_si512(dst[i] + o) :
+	_mm512_setzero_si512();
+      for (int j = 0; j < nsrc; j++) {
+	int c = coefs[i * nsrc + j];
+	if (c == 0)
+	  continue;
+	__m512i x = _mm512_loadu_si512(src[j] + o);
+	__m512i a = _mm512_set1_epi64(tables.coef[c].affine);
+	acc = _mm512_xor_si512(acc, _mm512_gf2p8affine_epi64_epi8(x, a, 0));
+      }
+      _mm512_storeu_si512(dst[i] + o, acc);
+    }
+  }
+  dotprod_tail(nsrc, ndst, coefs, src, dst, end, size, accumulate);
+}
+
+__attribute__((target("avx2")))
+void xor_avx2(const char *src, char *dst, int size)
+{
+  int end = size & ~127;
+  for (int o = 0; o < end; o += 128) {
+    for (int v = 0; v < 128; v += 32) {
+      __m256i s = _mm256_loadu_si256((const __m256i *)(src + o + v));
+      __m256i d = _mm256_loadu_si256((const __m256i *)(dst + o + v));
+      _mm256_storeu_si256((__m256i *)(dst + o + v), _mm256_xor_si256(s, d));
+    }
+  }
+  xor_tail(src, dst, end, size);
+}
+
+__attribute__((target("avx512f")))
+void xor_avx512(const char *src, char *dst, int size)
+{
+  int end = size & ~255;
+  for (int o = 0; o < end; o += 256) {
+    for (int v = 0; v < 256; v += 64) {
+      __m512i s = _mm512_loadu_si512(src + o + v);
+      __m512i d = _mm512_loadu_si512(dst + o + v);
+      _mm512_storeu_si512(dst + o + v, _mm512_xor_si512(s, d));
+    }
+  }
+  xor_avx2(src + end, dst + end, size - end);
+}
+
+#endif // JERASURE_SIMD_X86
+
+} // anonymous namespace
+
+bool is_supported(isa_t isa)
+{
+  ceph_arch_probe();
+  switch (isa) {
+  case isa_t::none:
+    return true;
+#ifdef JERASURE_SIMD_X86
+  case isa_t::avx2:
+    return ceph_arch_intel_avx2;
+  case isa_t::avx512:
+    return ceph_arch_intel_avx512bw;
+  case isa_t::gfni_avx2:
+    return ceph_arch_intel_avx2 && ceph_arch_intel_gfni;
+  case isa_t::gfni_avx512:
+    return ceph_arch_intel_avx512bw && ceph_arch_intel_gfni;
+#endif
+  default:
+    return false;
+  }
+}
+
+isa_t get_best()
+{
+  for (auto isa : { isa_t::gfni_avx512, isa_t::avx512,
+		    isa_t::gfni_avx2, isa_t::avx2 }) {
+    if (is_supported(isa))
+      return isa;
+  }
+  return isa_t::none;
+}
+
+const char *get_name(isa_t isa)
+{
+  switch (isa) {
+  case isa_t::none: return "none";
+  case isa_t::avx2: return "avx2";
+  case isa_t::avx512: return "avx512";
+  case isa_t::gfni_avx2: return "gfni_avx2";
+  case isa_t::gfni_avx512: return "gfni_avx512";
+  default: return "???";
+  }
+}
+
+int parse(const std::string &name, isa_t *isa)
+{
+  if (name == "auto") {
+    *isa = get_best();
+    return 0;
+  }
+  for (auto i : { isa_t::none, isa_t::avx2, isa_t::avx512,
+		  isa_t::gfni_avx2, isa_t::gfni_avx512 }) {
+    if (name == get_name(i)) {
+      *isa = i;
+      return 0;
+    }
+  }
+  return -EINVAL;
+}
+
+void gf8_matrix_dotprod(isa_t isa, int nsrc, int ndst, const int *coefs,
+			char **src, char **dst, int size, bool accumulate)
+{
+  switch (isa) {
+#ifdef JERASURE_SIMD_X86
+  case isa_t::avx2:
+    dotprod_avx2(nsrc, ndst, coefs, src, dst, size, accumulate);
+    break;
+  case isa_t::avx512:
+    dotprod_avx512(nsrc, ndst, coefs, src, dst, size, accumulate);
+    break;
+  case isa_t::gfni_avx2:
+    dotprod_gfni_avx2(nsrc, ndst, coefs, src, dst, size, accumulate);
+    break;
+  case isa_t::gfni_avx512:
+    dotprod_gfni_avx512(nsrc, ndst, coefs, src, dst, size, accumulate);
+    break;
+#endif
+  default:
+    dotprod_tail(nsrc, ndst, coefs, src, dst, 0, size, accumulate);
+  }
+}
+
+bool schedule_encode(isa_t isa, int k, int m, int w, int **schedule,
+		     char **data, char **coding, int size, int packetsize)
+{
+  void (*region_xor)(const char *src, char *dst, int size) = nullptr;
+  switch (isa) {
+#ifdef JERASURE_SIMD_X86
+  case isa_t::avx2:
+  case isa_t::gfni_avx2:
+    region_xor = xor_avx2;
+    break;
+  case isa_t::avx512:
+  case isa_t::gfni_avx512:
+    region_xor = xor_avx512;
+    break;
+#endif
+  default:
+    return false;
+  }
+
+  // each operation is { src device, src packet, dst device, dst packet,
+  // xor or copy }, for one group of w packets per device
+  std::vector<char*> ptrs(k + m);
+  for (int i = 0; i < k; i++)
+    ptrs[i] = data[i];
+  for (int i = 0; i < m; i++)
+    ptrs[k + i] = coding[i];
+  for (int done = 0; done < size; done += packetsize * w) {
+    for (int op = 0; schedule[op][0] >= 0; op++) {
+      const int *o = schedule[op];
+      const char *s = ptrs[o[0]] + o[1] * packetsize;
+      char *d = ptrs[o[2]] + o[3] * packetsize;
+      if (o[4])
+	region_xor(s, d, packetsize);
+      else
+	memcpy(d, s, packetsize);
+    }
+    for (auto &p : ptrs)
+      p += packetsize * w;
+  }
+  return true;
+}
+
+} // namespace ceph::jerasure_simd
@@ -0,0 +1,67 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph distributed storage system
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#ifndef CEPH_JERASURE_SIMD_H
+#define CEPH_JERASURE_SIMD_H
+
+#include <string>
+
+/*
+ * Runtime dispatched x86 kernels for the region operations the jerasure
+ * plugin spends its time in:
+ *
+ *  - GF(2^8) matrix dot products, i.e. Reed Solomon encode, decode and
+ *    parity delta updates with w=8, using the split nibble table
+ *    (vpshufb) or the GFNI affine (vgf2p8affineqb) multiplication, and
+ *  - the XOR schedules of the bit matrix techniques (cauchy_*, liberation,
+ *    blaum_roth, liber8tion).
+ *
+ * They compute exactly the same bytes as jerasure and gf-complete do, the
+ * field being the gf-complete default for w=8 (polynomial 0x11d), so OSDs
+ * with different instruction sets can be mixed freely.
+ */
+namespace ceph::jerasure_simd {
+
+enum class isa_t {
+  none,         ///< leave it to jerasure and gf-complete
+  avx2,
+  avx512,       ///< avx512f and avx512bw
+  gfni_avx2,
+  gfni_avx512,
+};
+
+/// @return true if the cpu, and the compiler, support isa
+bool is_supported(isa_t isa);
+/// @return the fastest isa supported here
+isa_t get_best();
+const char *get_name(isa_t isa);
+/// @return 0, or -EINVAL if name is not one of auto, none or an isa name
+int parse(const std::string &name, isa_t *isa);
+
+/**
+ * dst[i] = sum(coefs[i * nsrc + j] * src[j]) over j < nsrc, for each
+ * i < ndst, in GF(2^8), or dst[i] += ... when accumulate is set.
+ */
+void gf8_matrix_dotprod(isa_t isa, int nsrc, int ndst, const int *coefs,
+			char **src, char **dst, int size, bool accumulate);
+
+/**
+ * same as jerasure_schedule_encode(k, m, w, schedule, ...)
+ *
+ * @return false, and leave it to jerasure, if isa has no xor kernel
+ */
+bool schedule_encode(isa_t isa, int k, int m, int w, int **schedule,
+		     char **data, char **coding, int size, int packetsize);
+
+} // namespace ceph::jerasure_simd
+
+#endif
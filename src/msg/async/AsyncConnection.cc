@@ -378,6 +378,12 @@ void AsyncConnection::process() {
   last_active = ceph::coarse_mono_clock::now();
   recv_start_time = ceph::mono_clock::now();
 
+  if (cs) {
+    // the completions of zero-copy sends come in as socket errors, they
+    // have to be reaped whatever state we are in
+    cs.reap_send_completions();
+  }
+
   ldout(async_msgr->cct, 20) << __func__ << dendl;
 
   switch (state) {
@@ -19,8 +19,13 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#define CEPH_HAVE_MSG_ZEROCOPY
+#endif
 
 #include <algorithm>
+#include <deque>
 
 #include "PosixStack.h"
 
@@ -29,6 +34,7 @@
 #include "common/errno.h"
 #include "common/strtol.h"
 #include "common/dout.h"
+#include "common/perf_counters.h"
 #include "msg/Messenger.h"
 #include "include/compat.h"
 #include "include/sock_compat.h"
@@ -37,16 +43,208 @@
 #undef dout_prefix
 #define dout_prefix *_dout << "PosixStack "
 
+/// the MSG_ZEROCOPY sends of a socket the kernel has not completed yet
+struct PosixZerocopySends {
+  PerfCounters *logger = nullptr;
+  struct pending_t {
+    uint64_t first, last;   ///< ids of the sendmsg calls
+    uint64_t completed = 0;
+    ceph::buffer::list bl;  ///< what they sent, the kernel reads it until then
+  };
+  /// by id, the ids of one following those of the previous one
+  std::deque<pending_t> pending;
+  uint64_t pending_bytes = 0;
+
+  bool empty() const {
+    return pending.empty();
+  }
+
+  void add(uint64_t first, uint64_t last, ceph::buffer::list &&bl) {
+    pending_bytes += bl.length();
+    if (logger) {
+      logger->inc(l_msgr_send_zerocopy_pending_bytes, bl.length());
+    }
+    pending.push_back(pending_t{first, last, 0, std::move(bl)});
+  }
+
+  void complete(uint32_t lo, uint32_t hi, bool copied) {
+    if (pending.empty()) {
+      return;
+    }
+    // all the ids in flight are within 2^32 of the oldest one
+    uint64_t base = pending.front().first;
+    uint64_t first = base + (uint32_t)(lo - (uint32_t)base);
+    uint64_t last = first + (uint32_t)(hi - lo);
+    if (copied && logger) {
+      logger->inc(l_msgr_send_zerocopy_copied, last - first + 1);
+    }
+    for (auto p = pending.begin(); p != pending.end(); ) {
+      uint64_t from = std::max(first, p->first);
+      uint64_t to = std::min(last, p->last);
+      if (from <= to) {
+	p->completed += to - from + 1;
+      }
+      if (p->completed == p->last - p->first + 1) {
+	release(p->bl.length());
+	p = pending.erase(p);
+      } else {
+	++p;
+      }
+    }
+  }
+
+  void release(uint64_t len) {
+    pending_bytes -= len;
+    if (logger) {
+      logger->dec(l_msgr_send_zerocopy_pending_bytes, len);
+    }
+  }
+
+  void release_all() {
+    for (auto& p : pending) {
+      release(p.bl.length());
+    }
+    pending.clear();
+  }
+
+  void swap(PosixZerocopySends &other) {
+    std::swap(logger, other.logger);
+    pending.swap(other.pending);
+    std::swap(pending_bytes, other.pending_bytes);
+  }
+
+  /// release the buffers of the sends the kernel completed since
+  void reap(int fd) {
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+    // they are queued on the socket error queue, which wakes up the
+    // event loop until it is drained
+    while (!pending.empty()) {
+      char control[CMSG_SPACE(sizeof(struct sock_extended_err)) +
+		   CMSG_SPACE(sizeof(struct sockaddr_in6))];
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (::recvmsg(fd, &msg, MSG_ERRQUEUE) < 0) {
+	break;
+      }
+      for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm;
+	   cm = CMSG_NXTHDR(&msg, cm)) {
+	if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+	    !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+	  continue;
+	}
+	auto serr = reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+	if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+	  continue;
+	}
+	complete(serr->ee_info, serr->ee_data,
+		 serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+      }
+    }
+#endif
+  }
+};
+
+/// a closed socket the worker keeps open, with the buffers of its
+/// MSG_ZEROCOPY sends, until the kernel completes them or deadline
+struct PosixZerocopyLinger {
+  int fd;
+  ceph::mono_time deadline;
+  PosixZerocopySends sends;
+
+  PosixZerocopyLinger(int fd, ceph::mono_time deadline,
+		      PosixZerocopySends &from)
+    : fd(fd), deadline(deadline) {
+    sends.swap(from);
+  }
+  ~PosixZerocopyLinger() {
+    sends.release_all();
+    compat_closesocket(fd);
+  }
+};
+
 class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   ceph::NetHandler &handler;
   int _fd;
   entity_addr_t sa;
   bool connected;
+  PerfCounters *logger;
+
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+  CephContext *cct;
+  PosixWorker *worker;
+  /// sends of at least that many bytes use MSG_ZEROCOPY, 0 to never use it
+  uint64_t zerocopy_min_bytes = 0;
+  uint64_t zerocopy_max_pending_bytes = 0;
+  std::chrono::milliseconds zerocopy_linger{0};
+  /// the kernel numbers the sendmsg(MSG_ZEROCOPY) calls that queued some
+  /// data with the 32 low bits of this, from 0
+  uint64_t zerocopy_next_id = 0;
+  PosixZerocopySends zerocopy;
+
+  bool use_zerocopy(uint64_t len) const {
+    return zerocopy_min_bytes && len >= zerocopy_min_bytes &&
+      zerocopy.pending_bytes < zerocopy_max_pending_bytes;
+  }
+
+  /// the kernel completes the pending sends after the socket is closed
+  /// only as long as fd stays open, so rather than waiting for them here,
+  /// in the event loop, hand fd over to the worker with them. Returns
+  /// whether it took fd.
+  bool zerocopy_hand_off(int fd) {
+    zerocopy.reap(fd);
+    if (zerocopy.empty()) {
+      return false;
+    }
+    if (!worker || !worker->center.in_thread()) {
+      // the buffers may be reused while the kernel still sends from them
+      ldout(cct, 1) << __func__ << " fd " << fd << " releasing "
+		    << zerocopy.pending_bytes << " bytes of MSG_ZEROCOPY"
+		    << " sends closed outside of their worker" << dendl;
+      zerocopy.release_all();
+      return false;
+    }
+    worker->zerocopy_linger(new PosixZerocopyLinger(
+      fd, ceph::mono_clock::now() + zerocopy_linger, zerocopy));
+    return true;
+  }
+#endif
 
  public:
   explicit PosixConnectedSocketImpl(ceph::NetHandler &h, const entity_addr_t &sa,
-				    int f, bool connected)
-      : handler(h), _fd(f), sa(sa), connected(connected) {}
+				    int f, bool connected, CephContext *cct,
+				    PerfCounters *logger, PosixWorker *worker)
+      : handler(h), _fd(f), sa(sa), connected(connected), logger(logger) {
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+    this->cct = cct;
+    this->worker = worker;
+    zerocopy.logger = logger;
+    if (cct->_conf.get_val<bool>("ms_tcp_zerocopy") &&
+	handler.set_zerocopy(_fd) == 0) {
+      zerocopy_min_bytes = std::max<uint64_t>(
+	1, cct->_conf.get_val<Option::size_t>("ms_tcp_zerocopy_min_bytes"));
+      zerocopy_max_pending_bytes =
+	cct->_conf.get_val<Option::size_t>("ms_tcp_zerocopy_max_pending_bytes");
+      zerocopy_linger = cct->_conf.get_val<std::chrono::milliseconds>(
+	"ms_tcp_zerocopy_linger");
+    }
+#endif
+  }
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+  ~PosixConnectedSocketImpl() override {
+    // close() hands them over already, unless it was not called
+    if (zerocopy.empty()) {
+      return;
+    }
+    int fd = ::dup(_fd);
+    if (fd < 0) {
+      zerocopy.release_all();
+    } else if (!zerocopy_hand_off(fd)) {
+      compat_closesocket(fd);
+    }
+  }
+#endif
 
   int is_connected() override {
     if (connected)
@@ -77,23 +275,43 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   // return the sent length
   // < 0 means error occurred
   #ifndef _WIN32
-  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more)
+  // zerocopy_id is incremented for each call with MSG_ZEROCOPY that
+  // queued data, null not to use it
+  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more,
+			    uint64_t *zerocopy_id = nullptr)
   {
     size_t sent = 0;
+    int flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+    if (zerocopy_id) {
+      flags |= MSG_ZEROCOPY;
+    }
+#endif
     while (1) {
       MSGR_SIGPIPE_STOPPER;
       ssize_t r;
-      r = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+      r = ::sendmsg(fd, &msg, flags);
       if (r < 0) {
         int err = ceph_sock_errno();
         if (err == EINTR) {
           continue;
         } else if (err == EAGAIN) {
           break;
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+        } else if (err == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+          // no room left for the completions, copy instead
+          flags &= ~MSG_ZEROCOPY;
+          continue;
+#endif
         }
         return -err;
       }
 
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+      if ((flags & MSG_ZEROCOPY) && r > 0) {
+        ++*zerocopy_id;
+      }
+#endif
       sent += r;
       if (len == sent) break;
 
@@ -113,7 +331,17 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
     return (ssize_t)sent;
   }
 
+  void reap_send_completions() override {
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+    zerocopy.reap(_fd);
+#endif
+  }
+
   ssize_t send(ceph::buffer::list &bl, bool more) override {
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+    zerocopy.reap(_fd);
+    uint64_t zerocopy_first = zerocopy_next_id;
+#endif
     size_t sent_bytes = 0;
     auto pb = std::cbegin(bl.buffers());
     uint64_t left_pbrs = bl.get_num_buffers();
@@ -133,7 +361,24 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 	msglen += pb->length();
 	++pb;
       }
-      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more);
+      uint64_t *zerocopy_id = nullptr;
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+      if (use_zerocopy(msglen)) {
+	zerocopy_id = &zerocopy_next_id;
+      }
+#endif
+      auto start = ceph::mono_clock::now();
+      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more, zerocopy_id);
+      if (logger && r > 0) {
+	auto elapsed = ceph::mono_clock::now() - start;
+	if (zerocopy_id) {
+	  logger->inc(l_msgr_send_zerocopy_bytes, r);
+	  logger->tinc(l_msgr_send_zerocopy_time, elapsed);
+	} else {
+	  logger->inc(l_msgr_send_copy_bytes, r);
+	  logger->tinc(l_msgr_send_copy_time, elapsed);
+	}
+      }
       if (r < 0)
         return r;
 
@@ -150,8 +395,14 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
         bl.splice(sent_bytes, bl.length()-sent_bytes, &swapped);
         bl.swap(swapped);
       } else {
-        bl.clear();
+        swapped.swap(bl);
       }
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+      // swapped is what was sent, hold it until the kernel is done with it
+      if (zerocopy_next_id != zerocopy_first) {
+	zerocopy.add(zerocopy_first, zerocopy_next_id - 1, std::move(swapped));
+      }
+#endif
     }
 
     return static_cast<ssize_t>(sent_bytes);
@@ -204,6 +455,11 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
     ::shutdown(_fd, SHUT_RDWR);
   }
   void close() override {
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+    if (zerocopy_hand_off(_fd)) {
+      return;
+    }
+#endif
     compat_closesocket(_fd);
   }
   void set_priority(int sd, int prio, int domain) override {
@@ -262,15 +518,92 @@ int PosixServerSocketImpl::accept(ConnectedSocket *sock, const SocketOptions &op
   out->set_sockaddr((sockaddr*)&ss);
   handler.set_priority(sd, opt.priority, out->get_family());
 
-  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true));
+  std::unique_ptr<PosixConnectedSocketImpl> csi(
+    new PosixConnectedSocketImpl(handler, *out, sd, true, w->cct,
+				 w->get_perf_counter(),
+				 static_cast<PosixWorker*>(w)));
   *sock = ConnectedSocket(std::move(csi));
   return 0;
 }
 
+class C_zerocopy_reap : public EventCallback {
+  PosixWorker *worker;
+
+ public:
+  explicit C_zerocopy_reap(PosixWorker *w) : worker(w) {}
+  void do_request(uint64_t id) override {
+    worker->zerocopy_reap();
+  }
+};
+
+PosixWorker::PosixWorker(CephContext *c, unsigned i)
+  : Worker(c, i), net(c), zerocopy_reap_handler(new C_zerocopy_reap(this))
+{
+}
+
+PosixWorker::~PosixWorker()
+{
+  // the event loop is gone, destroy() usually took care of them
+  for (auto l : zerocopy_lingering) {
+    delete l;
+  }
+  delete zerocopy_reap_handler;
+}
+
 void PosixWorker::initialize()
 {
 }
 
+void PosixWorker::destroy()
+{
+  if (zerocopy_reap_id) {
+    center.delete_time_event(zerocopy_reap_id);
+    zerocopy_reap_id = 0;
+  }
+  for (auto l : zerocopy_lingering) {
+    delete l;
+  }
+  zerocopy_lingering.clear();
+}
+
+void PosixWorker::zerocopy_linger(PosixZerocopyLinger *l)
+{
+  ceph_assert(center.in_thread());
+  ldout(cct, 10) << __func__ << " fd " << l->fd << " "
+		 << l->sends.pending_bytes << " bytes" << dendl;
+  zerocopy_lingering.push_back(l);
+  if (!zerocopy_reap_id) {
+    zerocopy_reap_id = center.create_time_event(zerocopy_reap_interval_us,
+						zerocopy_reap_handler);
+  }
+}
+
+void PosixWorker::zerocopy_reap()
+{
+  zerocopy_reap_id = 0;
+  auto now = ceph::mono_clock::now();
+  for (auto p = zerocopy_lingering.begin(); p != zerocopy_lingering.end(); ) {
+    auto l = *p;
+    l->sends.reap(l->fd);
+    if (!l->sends.empty() && now < l->deadline) {
+      ++p;
+      continue;
+    }
+    if (!l->sends.empty()) {
+      // the buffers may be reused while the kernel still sends from them
+      ldout(cct, 1) << __func__ << " fd " << l->fd << " releasing "
+		    << l->sends.pending_bytes << " bytes of MSG_ZEROCOPY"
+		    << " sends not completed in time" << dendl;
+    }
+    delete l;
+    p = zerocopy_lingering.erase(p);
+  }
+  if (!zerocopy_lingering.empty()) {
+    zerocopy_reap_id = center.create_time_event(zerocopy_reap_interval_us,
+						zerocopy_reap_handler);
+  }
+}
+
 int PosixWorker::listen(entity_addr_t &sa,
 			unsigned addr_slot,
 			const SocketOptions &opt,
@@ -331,7 +664,9 @@ int PosixWorker::connect(const entity_addr_t &addr, const SocketOptions &opts, C
 
   net.set_priority(sd, opts.priority, addr.get_family());
   *socket = ConnectedSocket(
-      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock)));
+      std::unique_ptr<PosixConnectedSocketImpl>(
+	new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock, cct,
+				     perf_logger, this)));
   return 0;
 }
 
@@ -17,6 +17,7 @@
 #ifndef CEPH_MSG_ASYNC_POSIXSTACK_H
 #define CEPH_MSG_ASYNC_POSIXSTACK_H
 
+#include <list>
 #include <thread>
 
 #include "msg/msg_types.h"
@@ -24,17 +25,29 @@
 
 #include "Stack.h"
 
+struct PosixZerocopyLinger;
+
 class PosixWorker : public Worker {
   ceph::NetHandler net;
+  /// how often the lingering sockets are checked for completions
+  static constexpr uint64_t zerocopy_reap_interval_us = 10000;
+  /// closed sockets with MSG_ZEROCOPY sends still in flight
+  std::list<PosixZerocopyLinger*> zerocopy_lingering;
+  uint64_t zerocopy_reap_id = 0;
+  EventCallbackRef zerocopy_reap_handler;
   void initialize() override;
  public:
-  PosixWorker(CephContext *c, unsigned i)
-      : Worker(c, i), net(c) {}
+  PosixWorker(CephContext *c, unsigned i);
+  ~PosixWorker() override;
+  void destroy() override;
   int listen(entity_addr_t &sa,
 	     unsigned addr_slot,
 	     const SocketOptions &opt,
 	     ServerSocket *socks) override;
   int connect(const entity_addr_t &addr, const SocketOptions &opts, ConnectedSocket *socket) override;
+  /// keep l until its sends complete or it expires, then close it
+  void zerocopy_linger(PosixZerocopyLinger *l);
+  void zerocopy_reap();
 };
 
 class PosixNetworkStack : public NetworkStack {
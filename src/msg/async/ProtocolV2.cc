@@ -101,7 +101,9 @@ ProtocolV2::ProtocolV2(AsyncConnection *connection)
       rx_frame_asm(&session_stream_handlers, false, cct->_conf->ms_crc_data,
                    &session_compression_handlers),
       next_tag(static_cast<Tag>(0)),
-      keepalive(false) {
+      keepalive(false),
+      coalesce_bytes(
+        cct->_conf.get_val<Option::size_t>("ms_async_coalesce_bytes")) {
 }
 
 ProtocolV2::~ProtocolV2() {
@@ -556,19 +558,20 @@ ssize_t ProtocolV2::write_message(Message *m, bool more) {
                  << " src=" << entity_name_t(messenger->get_myname())
                  << " off=" << header2.data_off
                  << dendl;
-  ssize_t total_send_size = connection->outgoing_bl.length();
-  ssize_t rc = connection->_try_send(more);
-  if (rc < 0) {
-    ldout(cct, 1) << __func__ << " error sending " << m << ", "
-                  << cpp_strerror(rc) << dendl;
+  ++coalesced_messages;
+  ssize_t rc = 0;
+  if (more && connection->outgoing_bl.length() < coalesce_bytes) {
+    // write_event() sends it along with the next ones
+    ldout(cct, 10) << __func__ << " sending " << m << " coalesced." << dendl;
   } else {
-    const auto sent_bytes = total_send_size - connection->outgoing_bl.length();
-    connection->logger->inc(l_msgr_send_bytes, sent_bytes);
-    if (session_stream_handlers.tx) {
-      connection->logger->inc(l_msgr_send_encrypted_bytes, sent_bytes);
+    rc = send_coalesced(more);
+    if (rc < 0) {
+      ldout(cct, 1) << __func__ << " error sending " << m << ", "
+                    << cpp_strerror(rc) << dendl;
+    } else {
+      ldout(cct, 10) << __func__ << " sending " << m
+                     << (rc ? " continuely." : " done.") << dendl;
     }
-    ldout(cct, 10) << __func__ << " sending " << m
-                   << (rc ? " continuely." : " done.") << dendl;
   }
 
 #if defined(WITH_EVENTTRACE)
@@ -582,6 +585,24 @@ ssize_t ProtocolV2::write_message(Message *m, bool more) {
   return rc;
 }
 
+ssize_t ProtocolV2::send_coalesced(bool more) {
+  ssize_t total_send_size = connection->outgoing_bl.length();
+  ssize_t rc = connection->_try_send(more);
+  if (rc >= 0) {
+    const auto sent_bytes = total_send_size - connection->outgoing_bl.length();
+    connection->logger->inc(l_msgr_send_bytes, sent_bytes);
+    if (session_stream_handlers.tx) {
+      connection->logger->inc(l_msgr_send_encrypted_bytes, sent_bytes);
+    }
+  }
+  if (coalesced_messages > 0) {
+    connection->logger->hinc(l_msgr_send_coalesced_histogram,
+                             coalesced_messages, total_send_size);
+    coalesced_messages = 0;
+  }
+  return rc;
+}
+
 template <class F>
 bool ProtocolV2::append_frame(F& frame) {
   ceph::bufferlist bl;
@@ -594,7 +615,15 @@ bool ProtocolV2::append_frame(F& frame) {
 
   ldout(cct, 25) << __func__ << " assembled frame " << bl.length()
                  << " bytes " << tx_frame_asm << dendl;
-  connection->outgoing_bl.claim_append(bl);
+  if (session_stream_handlers.tx) {
+    // ciphertexts of consecutive frames share buffers, merge them so
+    // that a batch of frames is sent with as few iovecs as possible
+    for (const auto& p : bl.buffers()) {
+      connection->outgoing_bl.append(p, 0, p.length());
+    }
+  } else {
+    connection->outgoing_bl.claim_append(bl);
+  }
   return true;
 }
 
@@ -640,6 +669,7 @@ void ProtocolV2::write_event() {
 
   connection->write_lock.lock();
   if (can_write) {
+    coalesced_messages = 0;
     if (keepalive) {
       ldout(cct, 10) << __func__ << " appending keepalive" << dendl;
       auto keepalive_frame = KeepAliveFrame::Encode();
@@ -656,7 +686,7 @@ void ProtocolV2::write_event() {
     auto start = ceph::mono_clock::now();
     bool more;
     do {
-      if (connection->is_queued()) {
+      if (connection->is_queued() && !coalesced_messages) {
 	if (r = connection->_try_send(); r!= 0) {
 	  // either fails to send or not all queued buffer is sent
 	  break;
@@ -713,14 +743,17 @@ void ProtocolV2::write_event() {
         if (append_frame(ack_frame)) {
           ack_left -= left;
           left = ack_left;
-          r = connection->_try_send(left);
+          r = send_coalesced(left);
         } else {
           r = -EILSEQ;
         }
       } else if (is_queued()) {
-        r = connection->_try_send();
+        r = send_coalesced(false);
       }
     }
+    if (session_stream_handlers.tx) {
+      session_stream_handlers.tx->end_tx_batch();
+    }
     connection->write_lock.unlock();
 
     connection->logger->tinc(l_msgr_running_send_time,
@@ -803,6 +836,10 @@ CtPtr ProtocolV2::write(const std::string &desc,
     ldout(cct, 1) << __func__ << " " << e.what() << dendl;
     return _fault();
   }
+  // frames written from here are not part of a write_event() batch
+  if (session_stream_handlers.tx) {
+    session_stream_handlers.tx->end_tx_batch();
+  }
 
   ldout(cct, 25) << __func__ << " assembled frame " << bl.length()
                  << " bytes " << tx_frame_asm << dendl;
@@ -121,6 +121,11 @@ private:
 
   bool keepalive;
   bool write_in_progress = false;
+  // frames of up to that many bytes are gathered within a write event
+  // and sent together
+  uint64_t coalesce_bytes;
+  // messages appended to outgoing_bl since the last send
+  unsigned coalesced_messages = 0;
 
   CompConnectionMeta comp_meta;
   std::ostream& _conn_prefix(std::ostream *_dout);
@@ -151,6 +156,7 @@ private:
   void prepare_send_message(uint64_t features, Message *m);
   out_queue_entry_t _get_next_outgoing();
   ssize_t write_message(Message *m, bool more);
+  ssize_t send_coalesced(bool more);
   void handle_message_ack(uint64_t seq);
   void reset_compression();
 
@@ -43,17 +43,59 @@ std::function<void ()> NetworkStack::add_thread(Worker* w)
       ldout(cct, 10) << __func__ << " starting" << dendl;
       w->initialize();
       w->init_done();
+      const auto busy_poll = std::chrono::microseconds(
+	cct->_conf.get_val<uint64_t>("ms_async_busy_poll_us"));
+      // Spin only while it pays off: every wait a spin would have cut
+      // short votes for spinning, every spin in vain and every longer
+      // wait votes against it.
+      const int busy_poll_score_max = 8;
+      int busy_poll_score = 0;
       while (!w->done) {
         ldout(cct, 30) << __func__ << " calling event process" << dendl;
 
         ceph::timespan dur;
-        int r = w->center.process_events(EventMaxWaitUs, &dur);
+        int r = 0;
+        if (busy_poll_score > 0) {
+          auto spin_start = ceph::mono_clock::now();
+          ceph::timespan spin_work = ceph::timespan::zero();
+          ceph::mono_time now;
+          do {
+            r = w->center.process_events(0, &dur);
+            spin_work += dur;
+            now = ceph::mono_clock::now();
+          } while (r == 0 && !w->done && now - spin_start < busy_poll);
+          w->perf_logger->tinc(l_msgr_running_total_time, spin_work);
+          w->perf_logger->tinc(l_msgr_busy_poll_time,
+                               now - spin_start - spin_work);
+          if (r > 0) {
+            w->perf_logger->inc(l_msgr_busy_poll_hits);
+            busy_poll_score = std::min(busy_poll_score + 1,
+                                       busy_poll_score_max);
+            continue;
+          }
+          w->perf_logger->inc(l_msgr_busy_poll_misses);
+          --busy_poll_score;
+          if (w->done) {
+            break;
+          }
+        }
+
+        auto wait_start = ceph::mono_clock::now();
+        r = w->center.process_events(EventMaxWaitUs, &dur);
         if (r < 0) {
           ldout(cct, 20) << __func__ << " process events failed: "
                          << cpp_strerror(errno) << dendl;
           // TODO do something?
         }
         w->perf_logger->tinc(l_msgr_running_total_time, dur);
+        if (busy_poll.count() > 0) {
+          if (r > 0 && ceph::mono_clock::now() - wait_start - dur < busy_poll) {
+            busy_poll_score = std::min(busy_poll_score + 1,
+                                       busy_poll_score_max);
+          } else {
+            busy_poll_score = std::max(busy_poll_score - 1, 0);
+          }
+        }
       }
       w->reset();
       w->destroy();
@@ -29,6 +29,8 @@ class ConnectedSocketImpl {
   virtual int is_connected() = 0;
   virtual ssize_t read(char*, size_t) = 0;
   virtual ssize_t send(ceph::buffer::list &bl, bool more) = 0;
+  /// release the buffers of zero-copy sends the kernel is done with
+  virtual void reap_send_completions() {}
   virtual void shutdown() = 0;
   virtual void close() = 0;
   virtual int fd() const = 0;
@@ -100,6 +102,10 @@ class ConnectedSocket {
   ssize_t send(ceph::buffer::list &bl, bool more) {
     return _csi->send(bl, more);
   }
+  /// Releases the buffers of the completed zero-copy sends.
+  void reap_send_completions() {
+    _csi->reap_send_completions();
+  }
   /// Disables output to the socket.
   ///
   /// Current or future writes that have not been successfully flushed
@@ -211,6 +217,19 @@ enum {
   l_msgr_recv_encrypted_bytes,
   l_msgr_send_encrypted_bytes,
 
+  l_msgr_send_copy_bytes,
+  l_msgr_send_copy_time,
+  l_msgr_send_zerocopy_bytes,
+  l_msgr_send_zerocopy_time,
+  l_msgr_send_zerocopy_copied,
+  l_msgr_send_zerocopy_pending_bytes,
+
+  l_msgr_busy_poll_time,
+  l_msgr_busy_poll_hits,
+  l_msgr_busy_poll_misses,
+
+  l_msgr_send_coalesced_histogram,
+
   l_msgr_last,
 };
 
@@ -257,6 +276,36 @@ class Worker {
     plb.add_u64_counter(l_msgr_recv_encrypted_bytes, "msgr_recv_encrypted_bytes", "Network received encrypted bytes", NULL, 0, unit_t(UNIT_BYTES));
     plb.add_u64_counter(l_msgr_send_encrypted_bytes, "msgr_send_encrypted_bytes", "Network sent encrypted bytes", NULL, 0, unit_t(UNIT_BYTES));
 
+    plb.add_u64_counter(l_msgr_send_copy_bytes, "msgr_send_copy_bytes", "Network bytes copied to the socket buffers", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_time(l_msgr_send_copy_time, "msgr_send_copy_time", "The total time of the sends copying data");
+    plb.add_u64_counter(l_msgr_send_zerocopy_bytes, "msgr_send_zerocopy_bytes", "Network bytes sent with MSG_ZEROCOPY", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_time(l_msgr_send_zerocopy_time, "msgr_send_zerocopy_time", "The total time of the sends with MSG_ZEROCOPY");
+    plb.add_u64_counter(l_msgr_send_zerocopy_copied, "msgr_send_zerocopy_copied", "MSG_ZEROCOPY sends the kernel copied anyway");
+    plb.add_u64(l_msgr_send_zerocopy_pending_bytes, "msgr_send_zerocopy_pending_bytes", "Bytes held until the kernel completes their MSG_ZEROCOPY sends", NULL, 0, unit_t(UNIT_BYTES));
+
+    plb.add_time(l_msgr_busy_poll_time, "msgr_busy_poll_time", "The total time spent spinning for events in vain");
+    plb.add_u64_counter(l_msgr_busy_poll_hits, "msgr_busy_poll_hits", "Spins that found events");
+    plb.add_u64_counter(l_msgr_busy_poll_misses, "msgr_busy_poll_misses", "Spins that gave up and blocked");
+
+    PerfHistogramCommon::axis_config_d messages_axis_config{
+      "Messages",
+      PerfHistogramCommon::SCALE_LINEAR, ///< Messages in linear scale
+      0,                                 ///< Start at 0
+      1,                                 ///< Quantization unit is 1 message
+      32,                                ///< Up to 30 messages
+    };
+    PerfHistogramCommon::axis_config_d bytes_axis_config{
+      "Size (bytes)",
+      PerfHistogramCommon::SCALE_LOG2,   ///< Size in logarithmic scale
+      0,                                 ///< Start at 0
+      512,                               ///< Quantization unit is 512 bytes
+      32,                                ///< Enough to cover large messages
+    };
+    plb.add_u64_counter_histogram(
+      l_msgr_send_coalesced_histogram, "msgr_send_coalesced_histogram",
+      messages_axis_config, bytes_axis_config,
+      "Histogram of messages vs bytes handed to the socket by a single send");
+
     perf_logger = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perf_logger);
   }
@@ -1,7 +1,9 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 // vim: ts=8 sw=2 smarttab
 
+#include <algorithm>
 #include <array>
+#include <numeric>
 #include <openssl/evp.h>
 
 #include "crypto_onwire.h"
@@ -38,12 +40,29 @@ using key_t = std::array<std::uint8_t, AESGCM_KEY_LEN>;
 class AES128GCM_OnWireTxHandler : public ceph::crypto::onwire::TxHandler {
   CephContext* const cct;
   std::unique_ptr<EVP_CIPHER_CTX, decltype(&::EVP_CIPHER_CTX_free)> ectx;
-  ceph::bufferlist buffer;
+  ceph::bufferptr batch;   // ciphertexts of the current batch
+  ceph::bufferptr out;     // ciphertext being produced, maybe within batch
+  bool out_in_batch = false;
+  char* gathered = nullptr;
+  std::uint32_t gathered_len = 0;
+  std::uint64_t batch_len = 0;
+  std::uint64_t last_batch_len = 0;
   nonce_t nonce, initial_nonce;
   bool used_initial_nonce;
   bool new_nonce_format;  // 64-bit counter?
   static_assert(sizeof(nonce) == AESGCM_IV_LEN);
 
+  // Plaintext fragments shorter than this are copied to the output and
+  // encrypted in place together with their neighbours: the bulk (AES-NI,
+  // VAES) GCM kernels of OpenSSL only kick in for long enough inputs,
+  // and every EVP call comes with a fixed cost.
+  static constexpr std::uint32_t TX_GATHER_LEN = 1024;
+  static constexpr std::uint64_t TX_BATCH_MIN_LEN = 4096;
+  static constexpr std::uint64_t TX_BATCH_MAX_LEN = 256 << 10;
+
+  void encrypt(const char* in, char* outp, std::uint32_t len);
+  void flush_gathered();
+
 public:
   AES128GCM_OnWireTxHandler(CephContext* const cct,
 			    const key_t& key,
@@ -75,7 +94,10 @@ public:
   void reset_tx_handler(const uint32_t* first, const uint32_t* last) override;
 
   void authenticated_encrypt_update(const ceph::bufferlist& plaintext) override;
+  void authenticated_encrypt_update(const char* plaintext,
+                                    std::uint32_t len) override;
   ceph::bufferlist authenticated_encrypt_final() override;
+  void end_tx_batch() override;
 };
 
 void AES128GCM_OnWireTxHandler::reset_tx_handler(const uint32_t* first,
@@ -93,8 +115,27 @@ void AES128GCM_OnWireTxHandler::reset_tx_handler(const uint32_t* first,
     throw std::runtime_error("EVP_EncryptInit_ex failed");
   }
 
-  ceph_assert(buffer.get_append_buffer_unused_tail_length() == 0);
-  buffer.reserve(std::accumulate(first, last, AESGCM_TAG_LEN));
+  ceph_assert(!out.have_raw());
+  const std::uint64_t need = std::accumulate(first, last, AESGCM_TAG_LEN);
+  if (batch.unused_tail_length() < need) {
+    // size the buffer after what the previous batch took
+    std::uint64_t hint = last_batch_len > batch_len ?
+      last_batch_len - batch_len : 0;
+    hint = std::clamp(hint, TX_BATCH_MIN_LEN, TX_BATCH_MAX_LEN);
+    if (need > hint) {
+      // too big to share, e.g. a message with a lot of data
+      out = ceph::buffer::create_small_page_aligned(need);
+      out.set_length(0);
+      out_in_batch = false;
+    } else {
+      batch = ceph::buffer::create_small_page_aligned(hint);
+      batch.set_length(0);
+    }
+  }
+  if (!out.have_raw()) {
+    out = ceph::bufferptr(batch, batch.length(), 0);
+    out_in_batch = true;
+  }
 
   if (!new_nonce_format) {
     // msgr2.0: 32-bit counter followed by 64-bit fixed field,
@@ -105,42 +146,71 @@ void AES128GCM_OnWireTxHandler::reset_tx_handler(const uint32_t* first,
   }
 }
 
-void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
-  const ceph::bufferlist& plaintext)
+void AES128GCM_OnWireTxHandler::encrypt(const char* in, char* outp,
+                                        std::uint32_t len)
 {
-  ceph_assert(buffer.get_append_buffer_unused_tail_length() >=
-              plaintext.length());
-  auto filler = buffer.append_hole(plaintext.length());
+  int update_len = 0;
+
+  if(1 != EVP_EncryptUpdate(ectx.get(),
+      reinterpret_cast<unsigned char*>(outp),
+      &update_len,
+      reinterpret_cast<const unsigned char*>(in),
+      len)) {
+    throw std::runtime_error("EVP_EncryptUpdate failed");
+  }
+  ceph_assert_always(update_len >= 0);
+  ceph_assert(static_cast<unsigned>(update_len) == len);
+}
 
-  for (const auto& plainbuf : plaintext.buffers()) {
-    int update_len = 0;
+void AES128GCM_OnWireTxHandler::flush_gathered()
+{
+  if (gathered_len > 0) {
+    encrypt(gathered, gathered, gathered_len);
+    gathered = nullptr;
+    gathered_len = 0;
+  }
+}
 
-    if(1 != EVP_EncryptUpdate(ectx.get(),
-	reinterpret_cast<unsigned char*>(filler.c_str()),
-	&update_len,
-	reinterpret_cast<const unsigned char*>(plainbuf.c_str()),
-	plainbuf.length())) {
-      throw std::runtime_error("EVP_EncryptUpdate failed");
+void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
+  const char* plaintext, std::uint32_t len)
+{
+  ceph_assert(out.unused_tail_length() >= len + AESGCM_TAG_LEN);
+  char* p = out.end_c_str();
+  if (len < TX_GATHER_LEN) {
+    ::memcpy(p, plaintext, len);
+    if (gathered_len == 0) {
+      gathered = p;
     }
-    ceph_assert_always(update_len >= 0);
-    ceph_assert(static_cast<unsigned>(update_len) == plainbuf.length());
-    filler.advance(update_len);
+    gathered_len += len;
+  } else {
+    flush_gathered();
+    encrypt(plaintext, p, len);
+  }
+  out.set_length(out.length() + len);
+}
+
+void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
+  const ceph::bufferlist& plaintext)
+{
+  for (const auto& plainbuf : plaintext.buffers()) {
+    authenticated_encrypt_update(plainbuf.c_str(), plainbuf.length());
   }
 
   ldout(cct, 15) << __func__
 		 << " plaintext.length()=" << plaintext.length()
-		 << " buffer.length()=" << buffer.length()
+		 << " out.length()=" << out.length()
 		 << dendl;
 }
 
 ceph::bufferlist AES128GCM_OnWireTxHandler::authenticated_encrypt_final()
 {
+  flush_gathered();
+
   int final_len = 0;
-  ceph_assert(buffer.get_append_buffer_unused_tail_length() ==
-              AESGCM_BLOCK_LEN);
-  auto filler = buffer.append_hole(AESGCM_BLOCK_LEN);
+  ceph_assert(out.unused_tail_length() >= AESGCM_BLOCK_LEN);
+  char* tag = out.end_c_str();
   if(1 != EVP_EncryptFinal_ex(ectx.get(),
-	reinterpret_cast<unsigned char*>(filler.c_str()),
+	reinterpret_cast<unsigned char*>(tag),
 	&final_len)) {
     throw std::runtime_error("EVP_EncryptFinal_ex failed");
   }
@@ -149,15 +219,32 @@ ceph::bufferlist AES128GCM_OnWireTxHandler::authenticated_encrypt_final()
   static_assert(AESGCM_BLOCK_LEN == AESGCM_TAG_LEN);
   if(1 != EVP_CIPHER_CTX_ctrl(ectx.get(),
 	EVP_CTRL_GCM_GET_TAG, AESGCM_TAG_LEN,
-	filler.c_str())) {
+	tag)) {
     throw std::runtime_error("EVP_CIPHER_CTX_ctrl failed");
   }
+  out.set_length(out.length() + AESGCM_TAG_LEN);
 
   ldout(cct, 15) << __func__
-		 << " buffer.length()=" << buffer.length()
+		 << " out.length()=" << out.length()
 		 << " final_len=" << final_len
+		 << " batched=" << out_in_batch
 		 << dendl;
-  return std::move(buffer);
+  if (out_in_batch) {
+    batch.set_length(batch.length() + out.length());
+  }
+  batch_len += out.length();
+  ceph::bufferlist ciphertext;
+  ciphertext.append(std::move(out));
+  out = ceph::bufferptr();
+  return ciphertext;
+}
+
+void AES128GCM_OnWireTxHandler::end_tx_batch()
+{
+  ceph_assert(!out.have_raw());
+  batch = ceph::bufferptr();
+  last_batch_len = batch_len;
+  batch_len = 0;
 }
 
 // RX PART
@@ -242,15 +329,17 @@ void AES128GCM_OnWireRxHandler::authenticated_decrypt_update_final(
   // decrypt optional data. Caller is obliged to provide only signature but it
   // may supply ciphertext as well. Combining the update + final is reflected
   // combined together.
-  ceph::bufferlist auth_tag;
-  bl.splice(orig_len - AESGCM_TAG_LEN, AESGCM_TAG_LEN, &auth_tag);
+  // the tag needs to be in continuous memory, copy it out rather than
+  // having c_str() rebuild the buffer it happens to straddle.
+  std::array<char, AESGCM_TAG_LEN> auth_tag;
+  bl.begin(orig_len - AESGCM_TAG_LEN).copy(AESGCM_TAG_LEN, auth_tag.data());
+  bl.splice(orig_len - AESGCM_TAG_LEN, AESGCM_TAG_LEN);
   if (bl.length() > 0) {
     authenticated_decrypt_update(bl);
   }
 
-  // we need to ensure the tag is stored in continuous memory.
   if (1 != EVP_CIPHER_CTX_ctrl(ectx.get(), EVP_CTRL_GCM_SET_TAG,
-	AESGCM_TAG_LEN, auth_tag.c_str())) {
+	AESGCM_TAG_LEN, auth_tag.data())) {
     throw std::runtime_error("EVP_CIPHER_CTX_ctrl failed");
   }
 
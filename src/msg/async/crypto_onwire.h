@@ -83,9 +83,22 @@ struct TxHandler {
   virtual void authenticated_encrypt_update(
     const ceph::bufferlist& plaintext) = 0;
 
+  // Same as above for plain memory, e.g. a frame's preamble, epilogue or
+  // padding. Client keeps the ownership; the memory isn't referenced
+  // after the call returns.
+  virtual void authenticated_encrypt_update(const char* plaintext,
+                                            std::uint32_t len) = 0;
+
   // Generates authentication signature and returns bufferlist crafted
   // basing on plaintext from preceding call to _update().
   virtual ceph::bufferlist authenticated_encrypt_final() = 0;
+
+  // Implementation may carve the ciphertexts of consecutive frames out
+  // of a shared buffer, so that e.g. all frames assembled in a single
+  // write event cost one allocation and end up contiguous on the wire.
+  // Client calls this once such a batch is complete to let go of the
+  // buffer, which would otherwise stay pinned until the next frame.
+  virtual void end_tx_batch() = 0;
 };
 
 class RxHandler {
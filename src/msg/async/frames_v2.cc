@@ -117,35 +117,39 @@ bufferlist FrameAssembler::asm_crc_rev0(const preamble_block_t& preamble,
   return frame_bl;
 }
 
+void FrameAssembler::encrypt_zero_padding(uint32_t len) const {
+  static const char zeros[FRAME_PREAMBLE_INLINE_SIZE] = {};
+  ceph_assert(len <= sizeof(zeros));
+  if (len > 0) {
+    m_crypto->tx->authenticated_encrypt_update(zeros, len);
+  }
+}
+
 bufferlist FrameAssembler::asm_secure_rev0(const preamble_block_t& preamble,
                                            bufferlist segment_bls[]) const {
-  bufferlist preamble_bl(sizeof(preamble));
-  preamble_bl.append(reinterpret_cast<const char*>(&preamble),
-                     sizeof(preamble));
-
   epilogue_secure_rev0_block_t epilogue;
   // FIPS zeroization audit 20191115: this memset is not security related.
   ::memset(&epilogue, 0, sizeof(epilogue));
-  bufferlist epilogue_bl(sizeof(epilogue));
-  epilogue_bl.append(reinterpret_cast<const char*>(&epilogue),
-                     sizeof(epilogue));
 
   // preamble + MAX_NUM_SEGMENTS + epilogue
   uint32_t onwire_lens[MAX_NUM_SEGMENTS + 2];
-  onwire_lens[0] = preamble_bl.length();
+  onwire_lens[0] = sizeof(preamble);
   for (size_t i = 0; i < m_descs.size(); i++) {
-    onwire_lens[i + 1] = segment_bls[i].length();  // already padded
+    onwire_lens[i + 1] = get_segment_padded_len(i);
   }
-  onwire_lens[m_descs.size() + 1] = epilogue_bl.length();
+  onwire_lens[m_descs.size() + 1] = sizeof(epilogue);
   m_crypto->tx->reset_tx_handler(onwire_lens,
                                  onwire_lens + m_descs.size() + 2);
-  m_crypto->tx->authenticated_encrypt_update(preamble_bl);
+  m_crypto->tx->authenticated_encrypt_update(
+      reinterpret_cast<const char*>(&preamble), sizeof(preamble));
   for (size_t i = 0; i < m_descs.size(); i++) {
     if (segment_bls[i].length() > 0) {
       m_crypto->tx->authenticated_encrypt_update(segment_bls[i]);
+      encrypt_zero_padding(onwire_lens[i + 1] - segment_bls[i].length());
     }
   }
-  m_crypto->tx->authenticated_encrypt_update(epilogue_bl);
+  m_crypto->tx->authenticated_encrypt_update(
+      reinterpret_cast<const char*>(&epilogue), sizeof(epilogue));
   return m_crypto->tx->authenticated_encrypt_final();
 }
 
@@ -183,32 +187,33 @@ bufferlist FrameAssembler::asm_crc_rev1(const preamble_block_t& preamble,
 
 bufferlist FrameAssembler::asm_secure_rev1(const preamble_block_t& preamble,
                                            bufferlist segment_bls[]) const {
-  bufferlist preamble_bl;
-  if (segment_bls[0].length() > FRAME_PREAMBLE_INLINE_SIZE) {
-    // first segment is partially inlined, inline buffer is full
-    preamble_bl.reserve(sizeof(preamble));
-    preamble_bl.append(reinterpret_cast<const char*>(&preamble),
-                       sizeof(preamble));
-    segment_bls[0].splice(0, FRAME_PREAMBLE_INLINE_SIZE, &preamble_bl);
-  } else {
-    // first segment is fully inlined, inline buffer may need padding
-    uint32_t pad_len = FRAME_PREAMBLE_INLINE_SIZE - segment_bls[0].length();
-    preamble_bl.reserve(sizeof(preamble) + pad_len);
-    preamble_bl.append(reinterpret_cast<const char*>(&preamble),
-                       sizeof(preamble));
-    preamble_bl.claim_append(segment_bls[0]);
-    if (pad_len > 0) {
-      preamble_bl.append_zero(pad_len);
+  // the first segment goes into the preamble inline buffer, either fully
+  // (the inline buffer is zero padded) or partially (the inline buffer is
+  // full, the rest is encrypted on its own)
+  const uint32_t inline_len = std::min<uint32_t>(segment_bls[0].length(),
+                                                 FRAME_PREAMBLE_INLINE_SIZE);
+  auto seg0_it = segment_bls[0].cbegin();
+  auto encrypt_seg0 = [this, &seg0_it](uint32_t len) {
+    while (len > 0) {
+      const char* p;
+      auto n = seg0_it.get_ptr_and_advance(len, &p);
+      m_crypto->tx->authenticated_encrypt_update(p, n);
+      len -= n;
     }
-  }
+  };
 
-  m_crypto->tx->reset_tx_handler({preamble_bl.length()});
-  m_crypto->tx->authenticated_encrypt_update(preamble_bl);
+  m_crypto->tx->reset_tx_handler({FRAME_PREAMBLE_WITH_INLINE_SIZE});
+  m_crypto->tx->authenticated_encrypt_update(
+      reinterpret_cast<const char*>(&preamble), sizeof(preamble));
+  encrypt_seg0(inline_len);
+  encrypt_zero_padding(FRAME_PREAMBLE_INLINE_SIZE - inline_len);
   auto frame_bl = m_crypto->tx->authenticated_encrypt_final();
 
-  if (segment_bls[0].length() > 0) {
-    m_crypto->tx->reset_tx_handler({segment_bls[0].length()});
-    m_crypto->tx->authenticated_encrypt_update(segment_bls[0]);
+  const uint32_t padded_len = get_segment_padded_len(0);
+  if (padded_len > FRAME_PREAMBLE_INLINE_SIZE) {
+    m_crypto->tx->reset_tx_handler({padded_len - FRAME_PREAMBLE_INLINE_SIZE});
+    encrypt_seg0(segment_bls[0].length() - inline_len);
+    encrypt_zero_padding(padded_len - segment_bls[0].length());
     frame_bl.claim_append(m_crypto->tx->authenticated_encrypt_final());
   }
   if (m_descs.size() == 1) {
@@ -219,23 +224,22 @@ bufferlist FrameAssembler::asm_secure_rev1(const preamble_block_t& preamble,
   // FIPS zeroization audit 20191115: this memset is not security related.
   ::memset(&epilogue, 0, sizeof(epilogue));
   epilogue.late_status |= FRAME_LATE_STATUS_COMPLETE;
-  bufferlist epilogue_bl(sizeof(epilogue));
-  epilogue_bl.append(reinterpret_cast<const char*>(&epilogue),
-                     sizeof(epilogue));
 
   // MAX_NUM_SEGMENTS - 1 + epilogue
   uint32_t onwire_lens[MAX_NUM_SEGMENTS];
   for (size_t i = 1; i < m_descs.size(); i++) {
-    onwire_lens[i - 1] = segment_bls[i].length();  // already padded
+    onwire_lens[i - 1] = get_segment_padded_len(i);
   }
-  onwire_lens[m_descs.size() - 1] = epilogue_bl.length();
+  onwire_lens[m_descs.size() - 1] = sizeof(epilogue);
   m_crypto->tx->reset_tx_handler(onwire_lens, onwire_lens + m_descs.size());
   for (size_t i = 1; i < m_descs.size(); i++) {
     if (segment_bls[i].length() > 0) {
       m_crypto->tx->authenticated_encrypt_update(segment_bls[i]);
+      encrypt_zero_padding(onwire_lens[i - 1] - segment_bls[i].length());
     }
   }
-  m_crypto->tx->authenticated_encrypt_update(epilogue_bl);
+  m_crypto->tx->authenticated_encrypt_update(
+      reinterpret_cast<const char*>(&epilogue), sizeof(epilogue));
   frame_bl.claim_append(m_crypto->tx->authenticated_encrypt_final());
   return frame_bl;
 }
@@ -258,17 +262,12 @@ bufferlist FrameAssembler::assemble_frame(Tag tag, bufferlist segment_bls[],
   fill_preamble(tag, preamble);
 
   if (m_crypto->rx) {
+    // We're padding segments to biggest cipher's block size. Although
+    // AES-GCM can live without that as it's a stream cipher, we don't
+    // want to be fixed to stream ciphers only. The padding is encrypted
+    // right after each segment instead of being appended to it.
     for (size_t i = 0; i < m_descs.size(); i++) {
       ceph_assert(segment_bls[i].length() == m_descs[i].logical_len);
-      // We're padding segments to biggest cipher's block size. Although
-      // AES-GCM can live without that as it's a stream cipher, we don't
-      // want to be fixed to stream ciphers only.
-      uint32_t padded_len = get_segment_padded_len(i);
-      if (padded_len > segment_bls[i].length()) {
-        uint32_t pad_len = padded_len - segment_bls[i].length();
-        segment_bls[i].reserve(pad_len);
-        segment_bls[i].append_zero(pad_len);
-      }
     }
     if (m_is_rev1) {
       return asm_secure_rev1(preamble, segment_bls);
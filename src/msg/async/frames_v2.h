@@ -337,6 +337,7 @@ private:
   }
 
   void asm_compress(bufferlist segment_bls[]);
+  void encrypt_zero_padding(uint32_t len) const;
 
   bufferlist asm_crc_rev0(const preamble_block_t& preamble,
                           bufferlist segment_bls[]) const;
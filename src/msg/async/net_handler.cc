@@ -126,6 +126,22 @@ int NetHandler::set_socket_options(int sd, bool nodelay, int size)
   return -r;
 }
 
+int NetHandler::set_zerocopy(int sd)
+{
+#ifdef SO_ZEROCOPY
+  int flag = 1;
+  int r = ::setsockopt(sd, SOL_SOCKET, SO_ZEROCOPY, (SOCKOPT_VAL_TYPE)&flag, sizeof(flag));
+  if (r < 0) {
+    r = ceph_sock_errno();
+    ldout(cct, 1) << "couldn't set SO_ZEROCOPY: " << cpp_strerror(r) << dendl;
+    return -r;
+  }
+  return 0;
+#else
+  return -EOPNOTSUPP;
+#endif
+}
+
 void NetHandler::set_priority(int sd, int prio, int domain)
 {
 #ifdef SO_PRIORITY
@@ -28,6 +28,8 @@ namespace ceph {
     explicit NetHandler(CephContext *c): cct(c) {}
     int set_nonblock(int sd);
     int set_socket_options(int sd, bool nodelay, int size);
+    /// let sendmsg() use MSG_ZEROCOPY, @return 0 or -errno
+    int set_zerocopy(int sd);
     int connect(const entity_addr_t &addr, const entity_addr_t& bind_addr);
     
     /**
@@ -84,6 +84,26 @@ int ObjectStore::probe_block_device_fsid(
   return -EINVAL;
 }
 
+int ObjectStore::trace_start(const std::string& trace_path)
+{
+  int r = trace_writer.open(trace_path);
+  if (r < 0) {
+    return r;
+  }
+  tracing = true;
+  return 0;
+}
+
+int ObjectStore::trace_stop(uint64_t *records, uint64_t *bytes)
+{
+  if (!tracing.exchange(false)) {
+    return -ENOENT;
+  }
+  int r = trace_writer.close();
+  trace_writer.get_stats(records, bytes);
+  return r;
+}
+
 int ObjectStore::write_meta(const std::string& key,
 			    const std::string& value)
 {
@@ -26,7 +26,9 @@
 #include "common/WorkQueue.h"
 #include "ObjectMap.h"
 #include "os/Transaction.h"
+#include "os/TransactionTrace.h"
 
+#include <atomic>
 #include <errno.h>
 #include <sys/stat.h>
 #include <map>
@@ -49,6 +51,9 @@ namespace ceph {
 
 class Logger;
 class ContextQueue;
+namespace PriorityCache {
+  struct PriCache;
+}
 
 static inline void encode(const std::map<std::string,ceph::buffer::ptr> *attrset, ceph::buffer::list &bl) {
   using ceph::encode;
@@ -64,6 +69,10 @@ class ObjectStore {
 protected:
   std::string path;
 
+  /// transaction capture, see trace_start()
+  std::atomic<bool> tracing = {false};
+  ceph::os::TransactionTraceWriter trace_writer;
+
 public:
   using Transaction = ceph::os::Transaction;
 
@@ -234,6 +243,33 @@ public:
     TrackedOpRef op = TrackedOpRef(),
     ThreadPool::TPHandle *handle = NULL) = 0;
 
+  /**
+   * trace_start - record every queued transaction into a trace file
+   *
+   * Backends call trace_transactions() from queue_transactions(); the
+   * resulting file can be replayed with ceph-objectstore-replay.
+   *
+   * @param path trace file to create (truncated if it exists)
+   * @returns 0 on success, negative error code on failure
+   */
+  int trace_start(const std::string& path);
+  /**
+   * trace_stop - stop recording and close the trace file
+   *
+   * @param records, bytes [out] size of the trace written
+   * @returns 0, -ENOENT if not tracing, or the write error that stopped
+   *          the trace early
+   */
+  int trace_stop(uint64_t *records, uint64_t *bytes);
+
+protected:
+  void trace_transactions(CollectionHandle& ch,
+			  const std::vector<Transaction>& tls) {
+    if (tracing.load(std::memory_order_relaxed)) {
+      trace_writer.append(ch->get_cid(), tls);
+    }
+  }
+
 
  public:
   ObjectStore(CephContext* cct,
@@ -274,6 +310,14 @@ public:
 
   virtual void set_cache_shards(unsigned num) { }
 
+  /**
+   * Let the store's memory autotuner, if any, size a cache kept by the
+   * caller along with its own caches.  Must be called after mount().
+   */
+  virtual void add_priority_cache(
+    const std::string& name,
+    std::shared_ptr<PriorityCache::PriCache> c) { }
+
   /**
    * Returns 0 if the hobject is valid, -error otherwise
    *
@@ -551,6 +595,45 @@ public:
      return total;
    }
 
+  /// a single object extent requested through read_batch()
+  struct read_batch_op_t {
+    ghobject_t oid;
+    uint64_t offset = 0;
+    size_t len = 0;
+    ceph::buffer::list bl;  ///< output data
+    int rval = 0;           ///< bytes read or negative error code
+
+    read_batch_op_t() = default;
+    read_batch_op_t(const ghobject_t& oid, uint64_t offset, size_t len)
+      : oid(oid), offset(offset), len(len) {}
+  };
+
+  /**
+   * read_batch -- read byte ranges from several objects of a collection
+   *
+   * Each op is completed independently: its rval holds the number of
+   * bytes read or a negative error code, exactly as read() would have
+   * returned for it. Backends that care about performance should override
+   * this to issue the device I/O for all ops at once; the default version
+   * simply calls read() for each op in turn.
+   *
+   * @param c collection for objects
+   * @param ops extents to be read, results are filled in place
+   * @param op_flags is CEPH_OSD_OP_FLAG_*, applied to every op
+   * @returns 0 on success, or negative error code if the batch as a whole
+   *          could not be processed (e.g. -ENOENT for a missing collection).
+   */
+   virtual int read_batch(
+     CollectionHandle &c,
+     std::vector<read_batch_op_t>& ops,
+     uint32_t op_flags = 0) {
+     for (auto& op : ops) {
+       op.bl.clear();
+       op.rval = read(c, op.oid, op.offset, op.len, op.bl, op_flags);
+     }
+     return 0;
+   }
+
   /**
    * dump_onode -- dumps onode metadata in human readable form,
      intended primiarily for debugging
@@ -0,0 +1,186 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "TransactionTrace.h"
+#include "common/safe_io.h"
+#include "include/compat.h"
+
+namespace ceph::os {
+
+static const std::string TRACE_MAGIC = "ceph transaction trace v1\n";
+
+void transaction_trace_record_t::encode(ceph::buffer::list& bl) const
+{
+  ENCODE_START(1, 1, bl);
+  encode(stamp_ns, bl);
+  encode(cid, bl);
+  encode(tls, bl);
+  ENCODE_FINISH(bl);
+}
+
+void transaction_trace_record_t::decode(ceph::buffer::list::const_iterator& p)
+{
+  DECODE_START(1, p);
+  decode(stamp_ns, p);
+  decode(cid, p);
+  decode(tls, p);
+  DECODE_FINISH(p);
+}
+
+// TransactionTraceWriter
+
+int TransactionTraceWriter::open(const std::string& path)
+{
+  std::lock_guard l(lock);
+  if (fd >= 0) {
+    return -EBUSY;
+  }
+  int r = ::open(path.c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644);
+  if (r < 0) {
+    return -errno;
+  }
+  fd = r;
+  r = safe_write(fd, TRACE_MAGIC.data(), TRACE_MAGIC.size());
+  if (r < 0) {
+    VOID_TEMP_FAILURE_RETRY(::close(fd));
+    fd = -1;
+    return r;
+  }
+  start = ceph::mono_clock::now();
+  pending.clear();
+  num_records = 0;
+  num_bytes = TRACE_MAGIC.size();
+  error = 0;
+  return 0;
+}
+
+int TransactionTraceWriter::_flush()
+{
+  ceph_assert(ceph_mutex_is_locked(lock));
+  if (pending.length() == 0) {
+    return 0;
+  }
+  int r = pending.write_fd(fd);
+  pending.clear();
+  return r;
+}
+
+int TransactionTraceWriter::close()
+{
+  std::lock_guard l(lock);
+  if (fd < 0) {
+    return error;
+  }
+  int r = _flush();
+  if (r < 0 && !error) {
+    error = r;
+  }
+  if (::fsync(fd) < 0 && !error) {
+    error = -errno;
+  }
+  VOID_TEMP_FAILURE_RETRY(::close(fd));
+  fd = -1;
+  return error;
+}
+
+void TransactionTraceWriter::append(
+  const coll_t& cid,
+  const std::vector<Transaction>& tls)
+{
+  ceph::mono_time s;
+  {
+    std::lock_guard l(lock);
+    if (fd < 0) {
+      return;
+    }
+    s = start;
+  }
+  // encode outside of the lock; transaction data buffers are shared,
+  // not copied
+  transaction_trace_record_t rec;
+  rec.stamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    ceph::mono_clock::now() - s).count();
+  rec.cid = cid;
+  rec.tls = tls;
+  ceph::buffer::list bl;
+  encode(rec, bl);
+  uint32_t len = bl.length();
+
+  std::lock_guard l(lock);
+  if (fd < 0) {
+    return;
+  }
+  ceph::encode(len, pending);
+  pending.claim_append(bl);
+  ++num_records;
+  num_bytes += sizeof(len) + len;
+  if (pending.length() >= FLUSH_BYTES) {
+    int r = _flush();
+    if (r < 0) {
+      // stop tracing rather than writing a trace with holes
+      error = r;
+      VOID_TEMP_FAILURE_RETRY(::close(fd));
+      fd = -1;
+    }
+  }
+}
+
+// TransactionTraceReader
+
+int TransactionTraceReader::open(const std::string& path)
+{
+  ceph_assert(fd < 0);
+  int r = ::open(path.c_str(), O_RDONLY|O_CLOEXEC);
+  if (r < 0) {
+    return -errno;
+  }
+  fd = r;
+  std::string magic(TRACE_MAGIC.size(), '\0');
+  r = safe_read_exact(fd, magic.data(), magic.size());
+  if (r < 0 || magic != TRACE_MAGIC) {
+    close();
+    return r < 0 ? r : -EINVAL;
+  }
+  return 0;
+}
+
+void TransactionTraceReader::close()
+{
+  if (fd >= 0) {
+    VOID_TEMP_FAILURE_RETRY(::close(fd));
+    fd = -1;
+  }
+}
+
+int TransactionTraceReader::next(transaction_trace_record_t *rec)
+{
+  ceph_assert(fd >= 0);
+  ceph_le32 len;
+  int r = safe_read(fd, &len, sizeof(len));
+  if (r == 0) {
+    return 0;
+  }
+  if (r != (int)sizeof(len)) {
+    return r < 0 ? r : -EIO;   // truncated
+  }
+  ceph::buffer::list bl;
+  r = bl.read_fd(fd, len);
+  if (r < 0) {
+    return r;
+  }
+  if (bl.length() != len) {
+    return -EIO;
+  }
+  try {
+    auto p = bl.cbegin();
+    decode(*rec, p);
+  } catch (ceph::buffer::error& e) {
+    return -EIO;
+  }
+  return 1;
+}
+
+} // namespace ceph::os
@@ -0,0 +1,84 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "common/ceph_mutex.h"
+#include "common/ceph_time.h"
+#include "include/buffer.h"
+#include "os/Transaction.h"
+#include "osd/osd_types.h"
+
+/*
+ * Transaction traces: the stream of transactions an ObjectStore was asked
+ * to apply, with their collection and submission time, so that a real
+ * workload can be replayed against any backend later on.
+ *
+ * File layout: a magic string, then a sequence of records, each one
+ * prefixed with its encoded length as a little endian u32.
+ */
+
+namespace ceph::os {
+
+struct transaction_trace_record_t {
+  uint64_t stamp_ns = 0;   ///< submission time, relative to trace start
+  coll_t cid;
+  std::vector<Transaction> tls;
+
+  void encode(ceph::buffer::list& bl) const;
+  void decode(ceph::buffer::list::const_iterator& p);
+};
+WRITE_CLASS_ENCODER(transaction_trace_record_t)
+
+class TransactionTraceWriter {
+  ceph::mutex lock = ceph::make_mutex("TransactionTraceWriter::lock");
+  int fd = -1;
+  ceph::mono_time start;
+  ceph::buffer::list pending;   ///< encoded records not written out yet
+  uint64_t num_records = 0;
+  uint64_t num_bytes = 0;
+  int error = 0;                ///< first write error, stops the trace
+
+  int _flush();
+
+public:
+  static constexpr size_t FLUSH_BYTES = 4 << 20;
+
+  ~TransactionTraceWriter() {
+    close();
+  }
+
+  int open(const std::string& path);
+  /// @return 0, or the error that made the trace stop
+  int close();
+  bool is_open() {
+    std::lock_guard l(lock);
+    return fd >= 0;
+  }
+  void append(const coll_t& cid, const std::vector<Transaction>& tls);
+
+  void get_stats(uint64_t *records, uint64_t *bytes) {
+    std::lock_guard l(lock);
+    *records = num_records;
+    *bytes = num_bytes;
+  }
+};
+
+class TransactionTraceReader {
+  int fd = -1;
+
+public:
+  ~TransactionTraceReader() {
+    close();
+  }
+
+  int open(const std::string& path);
+  void close();
+  /// @return 1 if a record was read, 0 at the end of the trace, <0 on error
+  int next(transaction_trace_record_t *r);
+};
+
+} // namespace ceph::os
@@ -8,6 +8,7 @@
 #include "AvlAllocator.h"
 #include "BtreeAllocator.h"
 #include "HybridAllocator.h"
+#include "CachedHybridAllocator.h"
 #ifdef HAVE_LIBZBD
 #include "ZonedAllocator.h"
 #endif
@@ -149,6 +150,10 @@ Allocator *Allocator::create(
     return new HybridAllocator(cct, size, block_size,
       cct->_conf.get_val<uint64_t>("bluestore_hybrid_alloc_mem_cap"),
       name);
+  } else if (type == "hybrid_cached") {
+    return new CachedHybridAllocator(cct, size, block_size,
+      cct->_conf.get_val<uint64_t>("bluestore_hybrid_alloc_mem_cap"),
+      name);
 #ifdef HAVE_LIBZBD
   } else if (type == "zoned") {
     return new ZonedAllocator(cct, size, block_size, zone_size, first_sequential_zone,
@@ -10,6 +10,7 @@
 #include "common/perf_counters.h"
 #include "Allocator.h"
 #include "include/ceph_assert.h"
+#include "include/scope_guard.h"
 #include "common/admin_socket.h"
 
 #define dout_context cct
@@ -406,6 +407,28 @@ void BlueFS::_init_logger()
 	    "How many times bluefs read found page with all 0s");
   b.add_u64(l_bluefs_read_zeros_errors, "read_zeros_errors",
 	    "How many times bluefs read found transient page with all 0s");
+  b.add_time_avg(l_bluefs_log_sync_lat, "log_sync_lat",
+		 "Average latency of a metadata log sync (group commit)");
+  PerfHistogramCommon::axis_config_d log_sync_hist_x_axis_config{
+    "Latency (usec)",
+    PerfHistogramCommon::SCALE_LOG2, ///< Latency in logarithmic scale
+    0,                               ///< Start at 0
+    10,                              ///< Quantization unit is 10usec
+    20,                              ///< Enough to cover several seconds
+  };
+  PerfHistogramCommon::axis_config_d log_sync_hist_y_axis_config{
+    "Files synced",
+    PerfHistogramCommon::SCALE_LOG2, ///< Batch size in logarithmic scale
+    0,                               ///< Start at 0
+    1,                               ///< Quantization unit is 1 file
+    12,                              ///< Enough to cover 2048+ files
+  };
+  b.add_u64_counter_histogram(
+    l_bluefs_log_sync_hist, "log_sync_histogram",
+    log_sync_hist_x_axis_config, log_sync_hist_y_axis_config,
+    "Histogram of metadata log sync latency vs. files synced per batch");
+  b.add_u64_counter(l_bluefs_log_sync_joined, "log_sync_joined",
+		    "fsync calls that waited for the log sync of another fsync");
 
   logger = b.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
@@ -3033,7 +3056,8 @@ uint64_t BlueFS::_log_advance_seq()
 
 // Adds to log.t file modifications mentioned in `dirty.files`.
 // Note: some bluefs ops may have already been stored in log.t transaction.
-void BlueFS::_consume_dirty(uint64_t seq)
+// Returns number of dirty files consumed.
+size_t BlueFS::_consume_dirty(uint64_t seq)
 {
   ceph_assert(ceph_mutex_is_locked(dirty.lock));
   ceph_assert(ceph_mutex_is_locked(log.lock));
@@ -3051,7 +3075,9 @@ void BlueFS::_consume_dirty(uint64_t seq)
       dout(20) << __func__ << "   op_file_update_inc " << f.fnode << dendl;
       log.t.op_file_update_inc(f.fnode);
     }
+    return lsi->second.size();
   }
+  return 0;
 }
 
 // Extends log if its free space is smaller then bluefs_min_log_runway.
@@ -3158,6 +3184,8 @@ void BlueFS::_clear_dirty_set_stable_D(uint64_t seq)
       ceph_assert(p->second.empty());
       dirty.files.erase(p++);
     }
+    // wake up fsyncs that joined this log sync
+    dirty.cond.notify_all();
   } else {
     dout(20) << __func__ << " seq_stable " << dirty.seq_stable
              << " already >= out seq " << seq
@@ -3183,8 +3211,38 @@ void BlueFS::_release_pending_allocations(vector<interval_set<uint64_t>>& to_rel
   }
 }
 
+// Group commit for fsync: one fsync at a time leads a log sync, which
+// writes out every file dirtied up to the moment it advances the seq. The
+// others wait for it on dirty.cond instead of on log.lock: those it covers
+// are done once seq_stable reaches their want_seq, the rest are all
+// covered by the next leader, so a batch costs one log write and one
+// _flush_bdev.
 int BlueFS::_flush_and_sync_log_LD(uint64_t want_seq)
 {
+  bool leader = false;
+  if (want_seq) {
+    std::unique_lock dl(dirty.lock);
+    if (want_seq > dirty.seq_stable && dirty.fsync_leader) {
+      dout(10) << __func__ << " want_seq " << want_seq << ", waiting for the"
+	       << " log sync of seq " << dirty.seq_flushing << dendl;
+      logger->inc(l_bluefs_log_sync_joined);
+      dirty.cond.wait(dl, [&] {
+	return want_seq <= dirty.seq_stable || !dirty.fsync_leader;
+      });
+    }
+    if (want_seq <= dirty.seq_stable) {
+      return 0;
+    }
+    dirty.fsync_leader = leader = true;
+  }
+  auto end_leading = make_scope_guard([&] {
+    if (leader) {
+      std::lock_guard dl(dirty.lock);
+      dirty.fsync_leader = false;
+      dirty.cond.notify_all();
+    }
+  });
+
   int64_t available_runway;
   do {
     log.lock.lock();
@@ -3196,6 +3254,13 @@ int BlueFS::_flush_and_sync_log_LD(uint64_t want_seq)
       log.lock.unlock();
       return 0;
     }
+    if (want_seq && want_seq <= dirty.seq_flushing) {
+      // a sync that is not ours covers want_seq and is finishing up
+      log.lock.unlock();
+      std::unique_lock dl(dirty.lock, std::adopt_lock);
+      dirty.cond.wait(dl, [&] { return want_seq <= dirty.seq_stable; });
+      return 0;
+    }
 
     available_runway = _maybe_extend_log();
     if (available_runway == -EWOULDBLOCK) {
@@ -3212,8 +3277,10 @@ int BlueFS::_flush_and_sync_log_LD(uint64_t want_seq)
   } while (available_runway < 0);
   
   ceph_assert(want_seq == 0 || want_seq <= dirty.seq_live); // illegal to request seq that was not created yet
+  auto start = mono_clock::now();
   uint64_t seq =_log_advance_seq();
-  _consume_dirty(seq);
+  dirty.seq_flushing = seq;
+  size_t num_files = _consume_dirty(seq);
   vector<interval_set<uint64_t>> to_release(dirty.pending_release.size());
   to_release.swap(dirty.pending_release);
   dirty.lock.unlock();
@@ -3225,6 +3292,11 @@ int BlueFS::_flush_and_sync_log_LD(uint64_t want_seq)
   log.lock.unlock();
 
   _clear_dirty_set_stable_D(seq);
+  auto lat = mono_clock::now() - start;
+  logger->tinc(l_bluefs_log_sync_lat, lat);
+  logger->hinc(l_bluefs_log_sync_hist,
+	       std::chrono::duration_cast<std::chrono::microseconds>(lat).count(),
+	       num_files);
   _release_pending_allocations(to_release);
 
   _update_logger_stats();
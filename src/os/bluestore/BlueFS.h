@@ -73,6 +73,9 @@ enum {
   l_bluefs_alloc_shared_size_fallbacks,
   l_bluefs_read_zeros_candidate,
   l_bluefs_read_zeros_errors,
+  l_bluefs_log_sync_lat,
+  l_bluefs_log_sync_hist,
+  l_bluefs_log_sync_joined,
   l_bluefs_last,
 };
 
@@ -368,6 +371,9 @@ private:
     ceph::mutex lock = ceph::make_mutex("BlueFS::dirty.lock");
     uint64_t seq_stable = 0; //seq that is now stable on disk
     uint64_t seq_live = 1;   //seq that is ongoing and dirty files will be written to
+    uint64_t seq_flushing = 0; //seq that is being written by the log sync in progress
+    bool fsync_leader = false; //an fsync is syncing the log for the others
+    ceph::condition_variable cond; //signalled when seq_stable advances or the leader is done
     // map of dirty files, files of same dirty_seq are grouped into list.
     std::map<uint64_t, dirty_file_list_t> files;
     std::vector<interval_set<uint64_t>> pending_release; ///< extents to release
@@ -455,7 +461,7 @@ private:
   int64_t _maybe_extend_log();
   void _extend_log();
   uint64_t _log_advance_seq();
-  void _consume_dirty(uint64_t seq);
+  size_t _consume_dirty(uint64_t seq);
   void _clear_dirty_set_stable_D(uint64_t seq_stable);
   void _release_pending_allocations(std::vector<interval_set<uint64_t>>& to_release);
 
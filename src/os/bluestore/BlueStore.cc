@@ -19,6 +19,8 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <algorithm>
+#include <numeric>
+#include <thread>
 
 #include <boost/container/flat_set.hpp>
 #include <boost/algorithm/string.hpp>
@@ -49,6 +51,7 @@
 #include "perfglue/heap_profiler.h"
 #include "common/blkdev.h"
 #include "common/numa.h"
+#include "common/admin_socket.h"
 #include "common/pretty_binary.h"
 #include "kv/KeyValueHistogram.h"
 
@@ -1114,6 +1117,7 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
     o->set_cached();
     if (o->pin_nref == 1) {
       (level > 0) ? lru.push_front(*o) : lru.push_back(*o);
+      o->lru_gen = age_bin_gen.load();
       o->cache_age_bin = age_bins.front();
       *(o->cache_age_bin) += 1;
     }
@@ -1127,6 +1131,7 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
     if (o->lru_item.is_linked()) {
       *(o->cache_age_bin) -= 1;
       lru.erase(lru.iterator_to(*o));
+      o->lru_gen = 0;
     }
     ceph_assert(num);
     --num;
@@ -1147,23 +1152,30 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
       if(!o->lru_item.is_linked()) {
         if (o->exists) {
 	  lru.push_front(*o);
+	  o->lru_gen = age_bin_gen.load();
 	  o->cache_age_bin = age_bins.front();
 	  *(o->cache_age_bin) += 1;
 	  dout(20) << __func__ << " " << this << " " << o->oid << " unpinned"
                    << dendl;
         } else {
-	  ceph_assert(num);
-	  --num;
-	  o->clear_cached();
-	  dout(20) << __func__ << " " << this << " " << o->oid << " removed"
-                   << dendl;
-          // remove will also decrement nref
-          o->c->onode_space._remove(o->oid);
+          // a lockless lookup might be pinning it right now, it either
+          // sees it unpublished or we see its pin below
+          o->c->onode_space._unpublish(o);
+          if (o->pin_nref == 1) {
+	    ceph_assert(num);
+	    --num;
+	    o->clear_cached();
+	    dout(20) << __func__ << " " << this << " " << o->oid << " removed"
+                     << dendl;
+            // remove will also decrement nref
+            o->c->onode_space._remove(o->oid);
+          }
         }
       } else if (o->exists) {
         // move onode within LRU
         lru.erase(lru.iterator_to(*o));
         lru.push_front(*o);
+        o->lru_gen = age_bin_gen.load();
         if (o->cache_age_bin != age_bins.front()) {
           *(o->cache_age_bin) -= 1;
           o->cache_age_bin = age_bins.front();
@@ -1188,6 +1200,10 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
     while (n-- > 0 && lru.size() > 0) {
       BlueStore::Onode *o = &lru.back();
       lru.pop_back();
+      // unlink and unpublish before checking for pins, this orders us
+      // against put() and lockless lookups running without the lock
+      o->lru_gen = 0;
+      o->c->onode_space._unpublish(o);
 
       dout(20) << __func__ << "  rm " << o->oid << " "
                << o->nref << " " << o->cached << dendl;
@@ -1230,9 +1246,88 @@ BlueStore::OnodeCacheShard *BlueStore::OnodeCacheShard::create(
   // Currently we only implement an LRU cache for onodes
   c = new LruOnodeCacheShard(cct);
   c->logger = logger;
+  c->lockless_lookup =
+    cct->_conf.get_val<bool>("bluestore_onode_lockless_lookup");
   return c;
 }
 
+std::atomic<uint64_t>* BlueStore::OnodeCacheShard::epoch_enter()
+{
+  static std::atomic<unsigned> next_slot = {0};
+  thread_local unsigned slot = next_slot++ % EPOCH_READER_SLOTS;
+  auto r = &epoch_readers[slot].n[epoch.load() & 1];
+  r->fetch_add(1);
+  return r;
+}
+
+bool BlueStore::OnodeCacheShard::_epoch_has_readers(unsigned parity)
+{
+  for (auto& r : epoch_readers) {
+    if (r.n[parity].load()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+BlueStore::OnodeCacheShard::retired_t::~retired_t()
+{
+  for (auto o : onodes) {
+    if (--o->nref == 0) {
+      delete o;
+    }
+  }
+}
+
+bool BlueStore::OnodeCacheShard::_epoch_try_advance(retired_t& released)
+{
+  ceph_assert(released.empty());
+  if (retired[0].empty() && retired[1].empty()) {
+    has_retired = false;
+    return true;
+  }
+  uint64_t e = epoch;
+  unsigned prev = (e + 1) & 1;
+  if (_epoch_has_readers(prev)) {
+    return false;
+  }
+  // whatever was retired during the previous epoch is unreachable now
+  released.swap(retired[prev]);
+  epoch = e + 1;
+  return true;
+}
+
+void BlueStore::OnodeCacheShard::epoch_reclaim()
+{
+  if (!has_retired) {
+    return;
+  }
+  retired_t released;
+  {
+    std::lock_guard l(lock);
+    _epoch_try_advance(released);
+  }
+  // released goes away here, without the lock: dropping the last onode
+  // references takes this or other shards' locks
+}
+
+void BlueStore::OnodeCacheShard::epoch_synchronize()
+{
+  // readers never take the lock, so they cannot be blocked by us
+  for (unsigned advanced = 0; advanced < 2; ) {
+    retired_t released;
+    {
+      std::lock_guard l(lock);
+      if (_epoch_try_advance(released)) {
+	++advanced;
+      }
+    }
+    if (advanced < 2 && released.empty()) {
+      std::this_thread::yield();
+    }
+  }
+}
+
 // LruBufferCacheShard
 struct LruBufferCacheShard : public BlueStore::BufferCacheShard {
   typedef boost::intrusive::list<
@@ -1940,25 +2035,86 @@ void BlueStore::BufferSpace::split(BufferCacheShard* cache, size_t pos, BlueStor
 BlueStore::OnodeRef BlueStore::OnodeSpace::add_onode(const ghobject_t& oid,
   OnodeRef& o)
 {
-  std::lock_guard l(cache->lock);
-  // add entry or return existing one
-  auto p = onode_map.emplace(oid, o);
-  if (!p.second) {
-    ldout(cache->cct, 30) << __func__ << " " << oid << " " << o
-			  << " raced, returning existing " << p.first->second
-			  << dendl;
-    return p.first->second;
+  {
+    std::lock_guard l(cache->lock);
+    // add entry or return existing one
+    auto p = onode_map.emplace(oid, o);
+    if (!p.second) {
+      ldout(cache->cct, 30) << __func__ << " " << oid << " " << o
+			    << " raced, returning existing " << p.first->second
+			    << dendl;
+      return p.first->second;
+    }
+    ldout(cache->cct, 20) << __func__ << " " << oid << " " << o << dendl;
+    cache->_add(o.get(), 1);
+    if (cache->lockless_lookup) {
+      _publish(o.get());
+    }
+    cache->_trim();
   }
-  ldout(cache->cct, 20) << __func__ << " " << oid << " " << o << dendl;
-  cache->_add(o.get(), 1);
-  cache->_trim();
+  // release what the trim above may have retired
+  cache->epoch_reclaim();
   return o;
 }
 
 void BlueStore::OnodeSpace::_remove(const ghobject_t& oid)
 {
   ldout(cache->cct, 20) << __func__ << " " << oid << " " << dendl;
-  onode_map.erase(oid);
+  auto p = onode_map.find(oid);
+  if (p == onode_map.end()) {
+    return;
+  }
+  _unpublish(p->second.get());
+  onode_map.erase(p);
+}
+
+void BlueStore::OnodeSpace::_publish(Onode* o)
+{
+  auto t = lookup_table.load();
+  if (!t || onode_map.size() > t->size()) {
+    // grow to keep collisions low, old table is retired as readers
+    // may still be walking it.  Entries in distinct slots of the old
+    // table land in distinct slots of the larger one.
+    size_t n = std::max<size_t>(std::bit_ceil(onode_map.size() * 2), 64);
+    auto nt = std::make_unique<OnodeLookupTable>(n);
+    if (t) {
+      for (size_t i = 0; i < t->size(); ++i) {
+	if (auto e = t->slots[i].load(); e) {
+	  nt->slot(e->oid) = e;
+	}
+      }
+    }
+    ldout(cache->cct, 20) << __func__ << " lookup table " << n << " slots"
+			  << dendl;
+    lookup_table = nt.release();
+    if (t) {
+      cache->_retire(std::unique_ptr<OnodeLookupTable>(t));
+    }
+    t = lookup_table.load();
+  }
+  // an onode is never republished under another oid: rename() unpublishes
+  // it first, and lookups compare the entry's oid, not the onode's
+  auto& slot = t->slot(o->oid);
+  auto prev = slot.load();
+  if (prev && prev->o == o && prev->oid == o->oid) {
+    return;
+  }
+  slot = new OnodeLookupTable::entry_t{o->oid, o};
+  if (prev) {
+    // collision, or a stale entry
+    cache->_retire(std::unique_ptr<OnodeLookupTable::entry_t>(prev));
+  }
+}
+
+void BlueStore::OnodeSpace::_unpublish(Onode* o)
+{
+  if (auto t = lookup_table.load(); t) {
+    auto& slot = t->slot(o->oid);
+    if (auto e = slot.load(); e && e->o == o) {
+      slot = nullptr;
+      cache->_retire(std::unique_ptr<OnodeLookupTable::entry_t>(e));
+    }
+  }
 }
 
 BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
@@ -1966,6 +2122,40 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
   ldout(cache->cct, 30) << __func__ << dendl;
   OnodeRef o;
 
+  if (cache->lockless_lookup) {
+    Onode *raced = nullptr;
+    auto r = cache->epoch_enter();
+    if (auto t = lookup_table.load(); t) {
+      auto& slot = t->slot(oid);
+      // the entry and its onode stay allocated until we leave the read
+      // section, but the onode may be renamed meanwhile: only look at the
+      // entry's oid
+      auto e = slot.load();
+      if (e && e->oid == oid) {
+	Onode *p = e->o;
+	// pin first, then make sure it was not unpublished meanwhile:
+	// eviction unpublishes first and checks for pins afterwards
+	p->get();
+	if (slot.load() == e) {
+	  o.reset(p, false);
+	} else {
+	  raced = p;
+	}
+      }
+    }
+    cache->epoch_exit(r);
+    if (raced) {
+      // may take the cache lock, hence outside of the read section
+      raced->put();
+    }
+    if (o) {
+      ldout(cache->cct, 30) << __func__ << " " << oid << " hit " << o
+			    << " lockless" << dendl;
+      cache->logger->inc(l_bluestore_onode_hits);
+      return o;
+    }
+  }
+
   {
     std::lock_guard l(cache->lock);
     ceph::unordered_map<ghobject_t,OnodeRef>::iterator p = onode_map.find(oid);
@@ -1980,6 +2170,9 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
       // This will pin onode and implicitly touch the cache when Onode
       // eventually will become unpinned
       o = p->second;
+      if (cache->lockless_lookup) {
+	_publish(o.get());
+      }
 
       cache->logger->inc(l_bluestore_onode_hits);
     }
@@ -1990,12 +2183,28 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
 
 void BlueStore::OnodeSpace::clear()
 {
-  std::lock_guard l(cache->lock);
-  ldout(cache->cct, 10) << __func__ << " " << onode_map.size()<< dendl;
-  for (auto &p : onode_map) {
-    cache->_rm(p.second.get());
+  OnodeLookupTable* t;
+  {
+    std::lock_guard l(cache->lock);
+    ldout(cache->cct, 10) << __func__ << " " << onode_map.size()<< dendl;
+    t = lookup_table.exchange(nullptr);
+    if (t) {
+      for (size_t i = 0; i < t->size(); ++i) {
+	if (auto e = t->slots[i].load(); e) {
+	  cache->_retire(std::unique_ptr<OnodeLookupTable::entry_t>(e));
+	}
+      }
+      cache->_retire(std::unique_ptr<OnodeLookupTable>(t));
+    }
+    for (auto &p : onode_map) {
+      cache->_rm(p.second.get());
+    }
+    onode_map.clear();
+  }
+  if (t) {
+    // our onodes refer to the collection, which may be going away
+    cache->epoch_synchronize();
   }
-  onode_map.clear();
 }
 
 bool BlueStore::OnodeSpace::empty()
@@ -2010,35 +2219,41 @@ void BlueStore::OnodeSpace::rename(
   const ghobject_t& new_oid,
   const mempool::bluestore_cache_meta::string& new_okey)
 {
-  std::lock_guard l(cache->lock);
-  ldout(cache->cct, 30) << __func__ << " " << old_oid << " -> " << new_oid
-			<< dendl;
-  ceph::unordered_map<ghobject_t,OnodeRef>::iterator po, pn;
-  po = onode_map.find(old_oid);
-  pn = onode_map.find(new_oid);
-  ceph_assert(po != pn);
-
-  ceph_assert(po != onode_map.end());
-  if (pn != onode_map.end()) {
-    ldout(cache->cct, 30) << __func__ << "  removing target " << pn->second
+  {
+    std::lock_guard l(cache->lock);
+    ldout(cache->cct, 30) << __func__ << " " << old_oid << " -> " << new_oid
 			  << dendl;
-    cache->_rm(pn->second.get());
-    onode_map.erase(pn);
-  }
-  OnodeRef o = po->second;
-
-  // install a non-existent onode at old location
-  oldo.reset(new Onode(o->c, old_oid, o->key));
-  po->second = oldo;
-  cache->_add(oldo.get(), 1);
-  // add at new position and fix oid, key.
-  // This will pin 'o' and implicitly touch cache
-  // when it will eventually become unpinned
-  onode_map.insert(make_pair(new_oid, o));
-
-  o->oid = new_oid;
-  o->key = new_okey;
-  cache->_trim();
+    ceph::unordered_map<ghobject_t,OnodeRef>::iterator po, pn;
+    po = onode_map.find(old_oid);
+    pn = onode_map.find(new_oid);
+    ceph_assert(po != pn);
+
+    ceph_assert(po != onode_map.end());
+    if (pn != onode_map.end()) {
+      ldout(cache->cct, 30) << __func__ << "  removing target " << pn->second
+			    << dendl;
+      cache->_rm(pn->second.get());
+      _unpublish(pn->second.get());
+      onode_map.erase(pn);
+    }
+    OnodeRef o = po->second;
+    _unpublish(o.get());
+
+    // install a non-existent onode at old location
+    oldo.reset(new Onode(o->c, old_oid, o->key));
+    po->second = oldo;
+    cache->_add(oldo.get(), 1);
+    // add at new position and fix oid, key.
+    // This will pin 'o' and implicitly touch cache
+    // when it will eventually become unpinned
+    onode_map.insert(make_pair(new_oid, o));
+
+    o->oid = new_oid;
+    o->key = new_okey;
+    cache->_trim();
+  }
+  // release what the trim above may have retired
+  cache->epoch_reclaim();
 }
 
 bool BlueStore::OnodeSpace::map_any(std::function<bool(Onode*)> f)
@@ -3720,7 +3935,14 @@ void BlueStore::Onode::get()
 void BlueStore::Onode::put()
 {
   if (--pin_nref == 1) {
-    c->get_onode_cache()->maybe_unpin(this);
+    // with lockless lookups, skip the cache lock if we are in the lru and
+    // were already touched during the current age bin; _trim_to() clears
+    // lru_gen before checking pins.
+    auto ocs = c->get_onode_cache();
+    if (!ocs->lockless_lookup ||
+	lru_gen.load() != ocs->age_bin_gen.load()) {
+      ocs->maybe_unpin(this);
+    }
   }
   if (--nref == 0) {
     delete this;
@@ -4153,6 +4375,7 @@ void BlueStore::Collection::split_cache(
       // ensuring that nref is always >= 2 and hence onode is pinned
       OnodeRef o_pin = o;
 
+      onode_space._unpublish(o.get());
       p = onode_space.onode_map.erase(p);
       dest->onode_space.onode_map[o->oid] = o;
       if (o->cached) {
@@ -4239,6 +4462,7 @@ void *BlueStore::MempoolThread::entry()
       pcm->insert("kv_onode", binned_kv_onode_cache, true);
     }
   }
+  _add_external_caches();
 
   utime_t next_balance = ceph_clock_now();
   utime_t next_resize = ceph_clock_now();
@@ -4254,6 +4478,9 @@ void *BlueStore::MempoolThread::entry()
       _update_cache_settings();
       prev_config_change = cur_config_change;
     }
+    if (!pending_external_caches.empty()) {
+      _add_external_caches();
+    }
 
     // define various intervals for background work
     double age_bin_interval = store->cache_age_bin_interval;
@@ -4295,7 +4522,13 @@ void *BlueStore::MempoolThread::entry()
         binned_kv_onode_cache->set_cache_ratio(store->cache_kv_onode_ratio);
       }
       meta_cache->set_cache_ratio(store->cache_meta_ratio);
-      data_cache->set_cache_ratio(store->cache_data_ratio);
+      // external caches take their share out of the data cache's
+      double external_ratio = 0;
+      for (auto& [name, c] : external_caches) {
+        external_ratio += c->get_cache_ratio();
+      }
+      data_cache->set_cache_ratio(
+        std::max(0.0, store->cache_data_ratio - external_ratio));
 
       // Log events at 5 instead of 20 when balance happens.
       interval_stats_trim = true;
@@ -4342,6 +4575,19 @@ void *BlueStore::MempoolThread::entry()
   return NULL;
 }
 
+void BlueStore::MempoolThread::_add_external_caches()
+{
+  ceph_assert(ceph_mutex_is_locked(lock));
+  for (auto& [name, c] : pending_external_caches) {
+    dout(5) << __func__ << " " << name << dendl;
+    if (pcm != nullptr) {
+      pcm->insert(name, c, true);
+    }
+    external_caches[name] = c;
+  }
+  pending_external_caches.clear();
+}
+
 void BlueStore::MempoolThread::_resize_shards(bool interval_stats)
 {
   size_t onode_shards = store->onode_cache_shards.size();
@@ -4402,6 +4648,8 @@ void BlueStore::MempoolThread::_resize_shards(bool interval_stats)
 
   for (auto i : store->onode_cache_shards) {
     i->set_max(max_shard_onodes);
+    // don't let retired onodes pile up while nothing is added
+    i->epoch_reclaim();
   }
   for (auto i : store->buffer_cache_shards) {
     i->set_max(max_shard_buffer);
@@ -4618,6 +4866,67 @@ void BlueStore::handle_discard(interval_set<uint64_t>& to_release)
   alloc->release(to_release);
 }
 
+class BlueStore::SocketHook : public AdminSocketHook {
+  BlueStore* store;
+public:
+  static BlueStore::SocketHook* create(BlueStore* store)
+  {
+    BlueStore::SocketHook* hook = nullptr;
+    AdminSocket* admin_socket = store->cct->get_admin_socket();
+    if (admin_socket) {
+      hook = new BlueStore::SocketHook(store);
+      int r = admin_socket->register_command("bluestore defrag start",
+					     hook,
+					     "Start rewriting fragmented objects "
+					     "into contiguous extents");
+      if (r != 0) {
+	// another store in this process owns the commands
+	ldout(store->cct, 1) << __func__ << " cannot register SocketHook"
+			     << dendl;
+	delete hook;
+	hook = nullptr;
+      } else {
+	r = admin_socket->register_command("bluestore defrag stop",
+					   hook,
+					   "Stop online defragmentation");
+	ceph_assert(r == 0);
+	r = admin_socket->register_command("bluestore defrag status",
+					   hook,
+					   "Show online defragmentation progress");
+	ceph_assert(r == 0);
+      }
+    }
+    return hook;
+  }
+
+  ~SocketHook() {
+    AdminSocket* admin_socket = store->cct->get_admin_socket();
+    admin_socket->unregister_commands(this);
+  }
+private:
+  SocketHook(BlueStore* store) :
+    store(store) {}
+  int call(std::string_view command, const cmdmap_t& cmdmap,
+	   const bufferlist&,
+	   Formatter *f,
+	   std::ostream& errss,
+	   bufferlist& out) override {
+    if (command == "bluestore defrag start") {
+      int r = store->defrag_start(errss);
+      if (r < 0) {
+	return r;
+      }
+    } else if (command == "bluestore defrag stop") {
+      store->defrag_stop();
+    } else if (command != "bluestore defrag status") {
+      errss << "Invalid command" << std::endl;
+      return -ENOSYS;
+    }
+    store->defrag_dump(f);
+    return 0;
+  }
+};
+
 BlueStore::BlueStore(CephContext *cct, const string& path)
   : BlueStore(cct, path, 0) {}
 
@@ -4632,6 +4941,7 @@ BlueStore::BlueStore(CephContext *cct,
 #ifdef HAVE_LIBZBD
     zoned_cleaner_thread(this),
 #endif
+    defrag_thread(this),
     min_alloc_size(_min_alloc_size),
     min_alloc_size_order(std::countr_zero(_min_alloc_size)),
     mempool_thread(this)
@@ -4639,10 +4949,12 @@ BlueStore::BlueStore(CephContext *cct,
   _init_logger();
   cct->_conf.add_observer(this);
   set_cache_shards(1);
+  asok_hook = SocketHook::create(this);
 }
 
 BlueStore::~BlueStore()
 {
+  delete asok_hook;
   cct->_conf.remove_observer(this);
   _shutdown_logger();
   ceph_assert(!mounted);
@@ -4673,6 +4985,7 @@ const char **BlueStore::get_tracked_conf_keys() const
     "bluestore_compression_max_blob_size_ssd",
     "bluestore_compression_max_blob_size_hdd",
     "bluestore_compression_required_ratio",
+    "bluestore_compression_estimate_sample_size",
     "bluestore_max_alloc_size",
     "bluestore_prefer_deferred_size",
     "bluestore_prefer_deferred_size_hdd",
@@ -4726,7 +5039,8 @@ void BlueStore::handle_conf_change(const ConfigProxy& conf,
   if (changed.count("bluestore_compression_mode") ||
       changed.count("bluestore_compression_algorithm") ||
       changed.count("bluestore_compression_min_blob_size") ||
-      changed.count("bluestore_compression_max_blob_size")) {
+      changed.count("bluestore_compression_max_blob_size") ||
+      changed.count("bluestore_compression_estimate_sample_size")) {
     if (bdev) {
       _set_compression();
     }
@@ -4817,6 +5131,9 @@ void BlueStore::_set_compression()
     }
   }
 
+  comp_estimate_sample_size = cct->_conf.get_val<Option::size_t>(
+    "bluestore_compression_estimate_sample_size");
+
   auto& alg_name = cct->_conf->bluestore_compression_algorithm;
   if (!alg_name.empty()) {
     compressor = Compressor::create(cct, alg_name);
@@ -4831,6 +5148,7 @@ void BlueStore::_set_compression()
 	   << " alg " << (compressor ? compressor->get_type_name() : "(none)")
 	   << " min_blob " << comp_min_blob_size
 	   << " max_blob " << comp_max_blob_size
+	   << " estimate_sample " << comp_estimate_sample_size
 	   << dendl;
 }
 
@@ -5106,6 +5424,14 @@ void BlueStore::_init_logger()
   b.add_time_avg(l_bluestore_read_lat, "read_lat",
 		 "Average read latency",
 		 "r_l", PerfCountersBuilder::PRIO_CRITICAL);
+  b.add_time_avg(l_bluestore_read_batch_lat, "read_batch_lat",
+		 "Average batched read latency");
+  b.add_u64_counter(l_bluestore_read_batch_ops, "read_batch_ops",
+		    "Object reads served through the batched read path");
+  b.add_u64_counter(l_bluestore_read_batch_extents, "read_batch_extents",
+		    "Physical extents requested by batched reads");
+  b.add_u64_counter(l_bluestore_read_batch_ios, "read_batch_ios",
+		    "Device reads issued by batched reads after merging");
   //****************************************
 
   // kv_thread latencies
@@ -5218,6 +5544,16 @@ void BlueStore::_init_logger()
 	    "Sum for beneficial compress ops");
   b.add_u64_counter(l_bluestore_compress_rejected_count, "compress_rejected_count",
 	    "Sum for compress ops rejected due to low net gain of space");
+  b.add_u64_counter(l_bluestore_compress_skipped_count, "compress_skipped_count",
+	    "Sum for compress ops skipped as data was estimated incompressible");
+  b.add_u64_counter(l_bluestore_compress_skipped_bytes, "compress_skipped_bytes",
+	    "Sum for bytes not compressed as estimated incompressible",
+	    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_time(l_bluestore_compress_skipped_saved_time,
+	    "compress_skipped_saved_time",
+	    "Estimated compression time saved by skipping incompressible data");
+  b.add_time_avg(l_bluestore_compress_estimate_lat, "compress_estimate_lat",
+	    "Average compressibility estimate latency");
   //****************************************
 
   // onode cache stats
@@ -5241,6 +5577,12 @@ void BlueStore::_init_logger()
 	    "Number of extents in cache");
   b.add_u64(l_bluestore_blobs, "onode_blobs",
 	    "Number of blobs in cache");
+  b.add_u64(l_bluestore_onode_meta_bytes, "onode_meta_bytes",
+	    "Bytes of onode metadata (onodes, extent maps, blobs) in cache",
+	    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64(l_bluestore_onode_avg_bytes, "onode_avg_bytes",
+	    "Average bytes of metadata per cached onode",
+	    NULL, 0, unit_t(UNIT_BYTES));
   //****************************************
 
   // buffer cache stats
@@ -7804,6 +8146,9 @@ int BlueStore::_mount()
 int BlueStore::umount()
 {
   ceph_assert(_kv_only || mounted);
+  if (!_kv_only) {
+    defrag_stop();
+  }
   _osr_drain_all();
 
   mounted = false;
@@ -10686,6 +11031,17 @@ void BlueStore::_update_logger()
   logger->set(l_bluestore_pinned_onodes, num_pinned_onodes);
   logger->set(l_bluestore_extents, num_extents);
   logger->set(l_bluestore_blobs, num_blobs);
+  uint64_t meta_bytes =
+    mempool::bluestore_cache_onode::allocated_bytes() +
+    mempool::bluestore_cache_meta::allocated_bytes() +
+    mempool::bluestore_cache_other::allocated_bytes() +
+    mempool::bluestore_extent::allocated_bytes() +
+    mempool::bluestore_blob::allocated_bytes() +
+    mempool::bluestore_shared_blob::allocated_bytes() +
+    mempool::bluestore_inline_bl::allocated_bytes();
+  logger->set(l_bluestore_onode_meta_bytes, meta_bytes);
+  logger->set(l_bluestore_onode_avg_bytes,
+	      num_onodes ? meta_bytes / num_onodes : 0);
   logger->set(l_bluestore_buffers, num_buffers);
   logger->set(l_bluestore_buffer_bytes, num_buffer_bytes);
 }
@@ -11175,6 +11531,10 @@ int BlueStore::_do_read(
                              // The error isn't that much...
   vector<bufferlist> compressed_blob_bls;
   IOContext ioc(cct, NULL, !cct->_conf->bluestore_fail_eio);
+  if (!buffered) {
+    // nothing read here is cached, the device may use fixed buffers
+    ioc.flags |= IOContext::FLAG_DONT_CACHE;
+  }
   r = _prepare_read_ioc(blobs2read, &compressed_blob_bls, &ioc);
   // we always issue aio for reading, so errors other than EIO are not allowed
   if (r < 0)
@@ -11522,6 +11882,9 @@ int BlueStore::_do_readv(
   _dump_onode<30>(cct, *o);
 
   IOContext ioc(cct, NULL, !cct->_conf->bluestore_fail_eio);
+  if (!buffered) {
+    ioc.flags |= IOContext::FLAG_DONT_CACHE;
+  }
   vector<std::tuple<ready_regions_t, vector<bufferlist>, blobs2read_t>> raw_results;
   raw_results.reserve(m.num_intervals());
   int i = 0;
@@ -11586,6 +11949,254 @@ int BlueStore::_do_readv(
   return bl.length();
 }
 
+int BlueStore::_prepare_read_ioc_batch(
+  vector<blobs2read_t>& blobs2read,
+  vector<vector<bufferlist>>& compressed_blob_bls,
+  IOContext* ioc)
+{
+  // physical extent to be read on behalf of a single destination buffer
+  struct pextent_req_t {
+    uint64_t offset;
+    uint64_t length;
+    bufferlist* bl;
+    size_t io = 0; // index of the merged device read serving this extent
+  };
+  vector<pextent_req_t> reqs;
+
+  ceph_assert(compressed_blob_bls.size() == blobs2read.size());
+  for (size_t i = 0; i < blobs2read.size(); ++i) {
+    size_t num_compressed = 0;
+    for (auto& p : blobs2read[i]) {
+      if (p.first->get_blob().is_compressed()) {
+        ++num_compressed;
+      }
+    }
+    // pointers into compressed_blob_bls are kept until the reads are split,
+    // so it must never reallocate
+    compressed_blob_bls[i].reserve(num_compressed);
+
+    for (auto& p : blobs2read[i]) {
+      const BlobRef& bptr = p.first;
+      regions2read_t& r2r = p.second;
+      dout(20) << __func__ << "  blob " << *bptr << " need "
+               << r2r << dendl;
+      if (bptr->get_blob().is_compressed()) {
+        // read the whole thing
+        compressed_blob_bls[i].push_back(bufferlist());
+        bufferlist* bl = &compressed_blob_bls[i].back();
+        bptr->get_blob().map(
+          0, bptr->get_blob().get_ondisk_length(),
+          [&](uint64_t offset, uint64_t length) {
+            reqs.push_back(pextent_req_t{offset, length, bl});
+            return 0;
+          });
+      } else {
+        // read the pieces
+        for (auto& req : r2r) {
+          bptr->get_blob().map(
+            req.r_off, req.r_len,
+            [&](uint64_t offset, uint64_t length) {
+              reqs.push_back(pextent_req_t{offset, length, &req.bl});
+              return 0;
+            });
+        }
+      }
+    }
+  }
+  logger->inc(l_bluestore_read_batch_extents, reqs.size());
+
+  // sort extents by device offset and merge the adjacent (or overlapping,
+  // e.g. shared by clones) ones into as few device reads as possible
+  vector<size_t> order(reqs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+    [&](size_t a, size_t b) {
+      return reqs[a].offset < reqs[b].offset;
+    });
+
+  uint64_t max_merge = cct->_conf->bluestore_read_batch_max_merge_size;
+  vector<std::pair<uint64_t, uint64_t>> ios; // merged offset~length
+  for (auto i : order) {
+    auto& req = reqs[i];
+    if (max_merge && !ios.empty()) {
+      auto& last = ios.back();
+      uint64_t last_end = last.first + last.second;
+      uint64_t req_end = req.offset + req.length;
+      uint64_t merged_len = std::max(last_end, req_end) - last.first;
+      if (req.offset <= last_end &&
+          (req_end <= last_end || merged_len <= max_merge)) {
+        last.second = merged_len;
+        req.io = ios.size() - 1;
+        continue;
+      }
+    }
+    ios.emplace_back(req.offset, req.length);
+    req.io = ios.size() - 1;
+  }
+  logger->inc(l_bluestore_read_batch_ios, ios.size());
+
+  vector<bufferlist> io_bls(ios.size());
+  for (size_t i = 0; i < ios.size(); ++i) {
+    dout(20) << __func__ << "  reading 0x" << std::hex << ios[i].first
+             << "~" << ios[i].second << std::dec << dendl;
+    int r = bdev->aio_read(ios[i].first, ios[i].second, &io_bls[i], ioc);
+    if (r < 0) {
+      derr << __func__ << " bdev-read failed: " << cpp_strerror(r) << dendl;
+      if (r == -EIO) {
+        // propagate EIO to caller
+        return r;
+      }
+      ceph_assert(r == 0);
+    }
+  }
+
+  // hand out the pieces in their original order; they share the merged
+  // read's buffer, which is filled in once the aio completes
+  for (auto& req : reqs) {
+    bufferlist t;
+    t.substr_of(io_bls[req.io], req.offset - ios[req.io].first, req.length);
+    req.bl->claim_append(t);
+  }
+  return 0;
+}
+
+int BlueStore::read_batch(
+  CollectionHandle &c_,
+  vector<read_batch_op_t>& ops,
+  uint32_t op_flags)
+{
+  auto start = mono_clock::now();
+  Collection *c = static_cast<Collection *>(c_.get());
+  dout(15) << __func__ << " " << c->get_cid() << " " << ops.size() << " ops"
+           << dendl;
+  if (!c->exists)
+    return -ENOENT;
+
+  // see _do_read()
+  bool buffered = false;
+  if (op_flags & CEPH_OSD_OP_FLAG_FADVISE_WILLNEED) {
+    buffered = true;
+  } else if (cct->_conf->bluestore_default_buffered_read &&
+             (op_flags & (CEPH_OSD_OP_FLAG_FADVISE_DONTNEED |
+                          CEPH_OSD_OP_FLAG_FADVISE_NOCACHE)) == 0) {
+    buffered = true;
+  }
+  int read_cache_policy = 0;
+  if (op_flags & CEPH_OSD_OP_FLAG_BYPASS_CLEAN_CACHE) {
+    read_cache_policy = BufferSpace::BYPASS_CLEAN_CACHE;
+  }
+
+  {
+    std::shared_lock l(c->lock);
+
+    vector<OnodeRef> onodes(ops.size());
+    vector<ready_regions_t> ready_regions(ops.size());
+    vector<blobs2read_t> blobs2read(ops.size());
+    vector<vector<bufferlist>> compressed_blob_bls(ops.size());
+
+    auto start1 = mono_clock::now();
+    for (size_t i = 0; i < ops.size(); ++i) {
+      auto& op = ops[i];
+      op.bl.clear();
+      op.rval = 0;
+      OnodeRef o = c->get_onode(op.oid, false);
+      if (!o || !o->exists) {
+        op.rval = -ENOENT;
+        continue;
+      }
+      if (op.offset == op.len && op.offset == 0) {
+        op.len = o->onode.size;
+      }
+      if (op.offset >= o->onode.size) {
+        continue;
+      }
+      if (op.offset + op.len > o->onode.size) {
+        op.len = o->onode.size - op.offset;
+      }
+      o->extent_map.fault_range(db, op.offset, op.len);
+      _dump_onode<30>(cct, *o);
+      _read_cache(o, op.offset, op.len, read_cache_policy,
+                  ready_regions[i], blobs2read[i]);
+      onodes[i] = o;
+    }
+    log_latency("get_onode@read_batch",
+      l_bluestore_read_onode_meta_lat,
+      mono_clock::now() - start1,
+      cct->_conf->bluestore_log_op_age);
+
+    start1 = mono_clock::now();
+    IOContext ioc(cct, NULL, !cct->_conf->bluestore_fail_eio);
+    if (!buffered) {
+      ioc.flags |= IOContext::FLAG_DONT_CACHE;
+    }
+    int r = _prepare_read_ioc_batch(blobs2read, compressed_blob_bls, &ioc);
+    int64_t num_ios = 0;
+    if (r == 0 && ioc.has_pending_aios()) {
+      num_ios = ioc.get_num_ios();
+      bdev->aio_submit(&ioc);
+      dout(20) << __func__ << " waiting for aio" << dendl;
+      ioc.aio_wait();
+      r = ioc.get_return_value();
+    }
+    log_latency_fn(__func__,
+      l_bluestore_read_wait_aio_lat,
+      mono_clock::now() - start1,
+      cct->_conf->bluestore_log_op_age,
+      [&](auto lat) { return ", num_ios = " + stringify(num_ios); }
+    );
+    if (r < 0) {
+      // we always issue aio for reading, so errors other than EIO are not
+      // allowed; fall back to per-object reads so that only the objects
+      // actually hitting the bad extents fail
+      ceph_assert(r == -EIO);
+      dout(10) << __func__ << " batched aio failed, retrying per object"
+               << dendl;
+    }
+
+    for (size_t i = 0; i < ops.size(); ++i) {
+      auto& op = ops[i];
+      if (!onodes[i]) {
+        continue;
+      }
+      bool csum_error = false;
+      if (r == 0) {
+        _generate_read_result_bl(onodes[i], op.offset, op.len,
+                                 ready_regions[i], compressed_blob_bls[i],
+                                 blobs2read[i],
+                                 buffered && !ioc.skip_cache(),
+                                 &csum_error, op.bl);
+      }
+      if (r < 0 || csum_error) {
+        op.bl.clear();
+        op.rval = _do_read(c, onodes[i], op.offset, op.len, op.bl, op_flags,
+                           r < 0 ? 0 : 1);
+      } else {
+        op.rval = op.bl.length();
+      }
+      if (op.rval == -EIO) {
+        logger->inc(l_bluestore_read_eio);
+      }
+    }
+  }
+
+  for (auto& op : ops) {
+    if (op.rval >= 0 && _debug_data_eio(op.oid)) {
+      op.rval = -EIO;
+      derr << __func__ << " " << c->cid << " " << op.oid << " INJECT EIO"
+           << dendl;
+    }
+    dout(10) << __func__ << " " << c->cid << " " << op.oid
+             << " 0x" << std::hex << op.offset << "~" << op.len << std::dec
+             << " = " << op.rval << dendl;
+  }
+  logger->inc(l_bluestore_read_batch_ops, ops.size());
+  log_latency(__func__,
+    l_bluestore_read_batch_lat,
+    mono_clock::now() - start,
+    cct->_conf->bluestore_log_op_age);
+  return 0;
+}
+
 int BlueStore::dump_onode(CollectionHandle &c_,
   const ghobject_t& oid,
   const string& section_name,
@@ -12653,7 +13264,25 @@ void BlueStore::_txc_state_proc(TransContext *txc)
 	  _txc_apply_kv(txc, true);
 	}
       }
-      {
+      if (unsigned shard_id =
+	    txc->osr->get_sequencer_id() % (kv_sync_shards.size() + 1);
+	  shard_id > 0) {
+	// a sequencer always maps to the same shard, preserving its order
+	KVSyncShard *shard = kv_sync_shards[shard_id - 1].get();
+	std::lock_guard l(shard->lock);
+	shard->queue.push_back(txc);
+	if (!shard->in_progress) {
+	  shard->in_progress = true;
+	  shard->cond.notify_one();
+	}
+	if (txc->get_state() != TransContext::STATE_KV_SUBMITTED) {
+	  shard->queue_unsubmitted.push_back(txc);
+	  ++txc->osr->kv_committing_serially;
+	}
+	if (txc->had_ios)
+	  shard->ios++;
+	shard->throttle_costs += txc->cost;
+      } else {
 	std::lock_guard l(kv_lock);
 	kv_queue.push_back(txc);
 	if (!kv_sync_in_progress) {
@@ -13204,6 +13833,13 @@ void BlueStore::_kv_start()
 
   finisher.start();
   kv_sync_thread.create("bstore_kv_sync");
+  unsigned num_shards = cct->_conf.get_val<uint64_t>("bluestore_kv_sync_shards");
+  ceph_assert(kv_sync_shards.empty());
+  for (unsigned i = 1; i < num_shards; ++i) {
+    kv_sync_shards.emplace_back(std::make_unique<KVSyncShard>(this, i));
+    kv_sync_shards.back()->thread.create(
+      ("bstore_kv_sync" + stringify(i)).c_str());
+  }
   kv_finalize_thread.create("bstore_kv_final");
 }
 
@@ -13218,6 +13854,14 @@ void BlueStore::_kv_stop()
     kv_stop = true;
     kv_cond.notify_all();
   }
+  for (auto& shard : kv_sync_shards) {
+    std::unique_lock l{shard->lock};
+    while (!shard->started) {
+      shard->cond.wait(l);
+    }
+    shard->stop = true;
+    shard->cond.notify_all();
+  }
   {
     std::unique_lock l{kv_finalize_lock};
     while (!kv_finalize_started) {
@@ -13227,7 +13871,11 @@ void BlueStore::_kv_stop()
     kv_finalize_cond.notify_all();
   }
   kv_sync_thread.join();
+  for (auto& shard : kv_sync_shards) {
+    shard->thread.join();
+  }
   kv_finalize_thread.join();
+  kv_sync_shards.clear();
   ceph_assert(removed_collections.empty());
   {
     std::lock_guard l(kv_lock);
@@ -13357,23 +14005,13 @@ void BlueStore::_kv_sync_thread()
       // it.  in either case, we increase the max in the earlier txn
       // we submit.
       uint64_t new_nid_max = 0, new_blobid_max = 0;
-      if (nid_last + cct->_conf->bluestore_nid_prealloc/2 > nid_max) {
-	KeyValueDB::Transaction t =
-	  kv_submitting.empty() ? synct : kv_submitting.front()->t;
-	new_nid_max = nid_last + cct->_conf->bluestore_nid_prealloc;
-	bufferlist bl;
-	encode(new_nid_max, bl);
-	t->set(PREFIX_SUPER, "nid_max", bl);
-	dout(10) << __func__ << " new_nid_max " << new_nid_max << dendl;
-      }
-      if (blobid_last + cct->_conf->bluestore_blobid_prealloc/2 > blobid_max) {
-	KeyValueDB::Transaction t =
-	  kv_submitting.empty() ? synct : kv_submitting.front()->t;
-	new_blobid_max = blobid_last + cct->_conf->bluestore_blobid_prealloc;
-	bufferlist bl;
-	encode(new_blobid_max, bl);
-	t->set(PREFIX_SUPER, "blobid_max", bl);
-	dout(10) << __func__ << " new_blobid_max " << new_blobid_max << dendl;
+      std::unique_lock pl(kv_prealloc_lock, std::defer_lock);
+      if (_kv_need_prealloc_ids()) {
+	if (!kv_sync_shards.empty()) {
+	  pl.lock();
+	}
+	_kv_prealloc_ids(kv_submitting.empty() ? synct : kv_submitting.front()->t,
+			 &new_nid_max, &new_blobid_max);
       }
 
       for (auto txc : kv_committing) {
@@ -13445,31 +14083,7 @@ void BlueStore::_kv_sync_thread()
       }
 #endif
 
-      {
-	std::unique_lock m{kv_finalize_lock};
-	if (kv_committing_to_finalize.empty()) {
-	  kv_committing_to_finalize.swap(kv_committing);
-	} else {
-	  kv_committing_to_finalize.insert(
-	      kv_committing_to_finalize.end(),
-	      kv_committing.begin(),
-	      kv_committing.end());
-	  kv_committing.clear();
-	}
-	if (deferred_stable_to_finalize.empty()) {
-	  deferred_stable_to_finalize.swap(deferred_stable);
-	} else {
-	  deferred_stable_to_finalize.insert(
-	      deferred_stable_to_finalize.end(),
-	      deferred_stable.begin(),
-	      deferred_stable.end());
-	  deferred_stable.clear();
-	}
-	if (!kv_finalize_in_progress) {
-	  kv_finalize_in_progress = true;
-	  kv_finalize_cond.notify_one();
-	}
-      }
+      _kv_queue_to_finalize(kv_committing, deferred_stable);
 
       if (new_nid_max) {
 	nid_max = new_nid_max;
@@ -13479,6 +14093,9 @@ void BlueStore::_kv_sync_thread()
 	blobid_max = new_blobid_max;
 	dout(10) << __func__ << " blobid_max now " << blobid_max << dendl;
       }
+      if (pl.owns_lock()) {
+	pl.unlock();
+      }
 
       {
 	auto finish = mono_clock::now();
@@ -13514,6 +14131,180 @@ void BlueStore::_kv_sync_thread()
   kv_sync_started = false;
 }
 
+bool BlueStore::_kv_need_prealloc_ids() const
+{
+  return nid_last + cct->_conf->bluestore_nid_prealloc/2 > nid_max ||
+    blobid_last + cct->_conf->bluestore_blobid_prealloc/2 > blobid_max;
+}
+
+void BlueStore::_kv_prealloc_ids(
+  KeyValueDB::Transaction t,
+  uint64_t *new_nid_max,
+  uint64_t *new_blobid_max)
+{
+  if (nid_last + cct->_conf->bluestore_nid_prealloc/2 > nid_max) {
+    *new_nid_max = nid_last + cct->_conf->bluestore_nid_prealloc;
+    bufferlist bl;
+    encode(*new_nid_max, bl);
+    t->set(PREFIX_SUPER, "nid_max", bl);
+    dout(10) << __func__ << " new_nid_max " << *new_nid_max << dendl;
+  }
+  if (blobid_last + cct->_conf->bluestore_blobid_prealloc/2 > blobid_max) {
+    *new_blobid_max = blobid_last + cct->_conf->bluestore_blobid_prealloc;
+    bufferlist bl;
+    encode(*new_blobid_max, bl);
+    t->set(PREFIX_SUPER, "blobid_max", bl);
+    dout(10) << __func__ << " new_blobid_max " << *new_blobid_max << dendl;
+  }
+}
+
+void BlueStore::_kv_queue_to_finalize(
+  deque<TransContext*>& committing,
+  deque<DeferredBatch*>& deferred_stable)
+{
+  std::unique_lock m{kv_finalize_lock};
+  if (kv_committing_to_finalize.empty()) {
+    kv_committing_to_finalize.swap(committing);
+  } else {
+    kv_committing_to_finalize.insert(
+      kv_committing_to_finalize.end(),
+      committing.begin(),
+      committing.end());
+    committing.clear();
+  }
+  if (deferred_stable_to_finalize.empty()) {
+    deferred_stable_to_finalize.swap(deferred_stable);
+  } else {
+    deferred_stable_to_finalize.insert(
+      deferred_stable_to_finalize.end(),
+      deferred_stable.begin(),
+      deferred_stable.end());
+    deferred_stable.clear();
+  }
+  if (!kv_finalize_in_progress) {
+    kv_finalize_in_progress = true;
+    kv_finalize_cond.notify_one();
+  }
+}
+
+// Secondary kv sync shard: commits the transactions of the sequencers
+// mapped to it, exactly like _kv_sync_thread() does, minus the deferred
+// io bookkeeping which stays with the main kv sync thread.
+void BlueStore::_kv_sync_shard_thread(KVSyncShard *shard)
+{
+  dout(10) << __func__ << " " << shard->id << " start" << dendl;
+  deque<DeferredBatch*> no_deferred;
+  std::unique_lock l{shard->lock};
+  ceph_assert(!shard->started);
+  shard->started = true;
+  shard->cond.notify_all();
+
+  while (true) {
+    ceph_assert(shard->committing.empty());
+    if (shard->queue.empty()) {
+      if (shard->stop)
+	break;
+      dout(20) << __func__ << " " << shard->id << " sleep" << dendl;
+      shard->in_progress = false;
+      shard->cond.wait(l);
+      dout(20) << __func__ << " " << shard->id << " wake" << dendl;
+    } else {
+      deque<TransContext*> kv_submitting;
+      dout(20) << __func__ << " " << shard->id
+	       << " committing " << shard->queue.size()
+	       << " submitting " << shard->queue_unsubmitted.size()
+	       << dendl;
+      shard->committing.swap(shard->queue);
+      kv_submitting.swap(shard->queue_unsubmitted);
+      uint64_t aios = shard->ios;
+      uint64_t costs = shard->throttle_costs;
+      shard->ios = 0;
+      shard->throttle_costs = 0;
+      l.unlock();
+
+      auto start = mono_clock::now();
+      if (aios) {
+	// flush/barrier on block device before committing the metadata
+	// that references the newly written data
+	bdev->flush();
+      }
+      auto after_flush = mono_clock::now();
+
+      KeyValueDB::Transaction synct = db->get_transaction();
+
+      // see _kv_sync_thread(); the new max must be durable before any
+      // shard commits ids beyond the old one, hence the lock is held
+      // until our commit is done.
+      uint64_t new_nid_max = 0, new_blobid_max = 0;
+      std::unique_lock pl(kv_prealloc_lock, std::defer_lock);
+      if (_kv_need_prealloc_ids()) {
+	pl.lock();
+	_kv_prealloc_ids(kv_submitting.empty() ? synct : kv_submitting.front()->t,
+			 &new_nid_max, &new_blobid_max);
+      }
+
+      for (auto txc : shard->committing) {
+	throttle.log_state_latency(*txc, logger, l_bluestore_state_kv_queued_lat);
+	if (txc->get_state() == TransContext::STATE_KV_QUEUED) {
+	  _txc_apply_kv(txc, false);
+	  --txc->osr->kv_committing_serially;
+	} else {
+	  ceph_assert(txc->get_state() == TransContext::STATE_KV_SUBMITTED);
+	}
+	if (txc->had_ios) {
+	  --txc->osr->txc_with_unstable_io;
+	}
+      }
+      throttle.release_kv_throttle(costs);
+
+      int r = cct->_conf->bluestore_debug_omit_kv_commit ? 0 : db->submit_transaction_sync(synct);
+      ceph_assert(r == 0);
+
+      int committing_size = shard->committing.size();
+      _kv_queue_to_finalize(shard->committing, no_deferred);
+
+      if (new_nid_max) {
+	nid_max = new_nid_max;
+	dout(10) << __func__ << " nid_max now " << nid_max << dendl;
+      }
+      if (new_blobid_max) {
+	blobid_max = new_blobid_max;
+	dout(10) << __func__ << " blobid_max now " << blobid_max << dendl;
+      }
+      if (pl.owns_lock()) {
+	pl.unlock();
+      }
+
+      {
+	auto finish = mono_clock::now();
+	ceph::timespan dur_flush = after_flush - start;
+	ceph::timespan dur_kv = finish - after_flush;
+	ceph::timespan dur = finish - start;
+	dout(20) << __func__ << " " << shard->id
+		 << " committed " << committing_size
+		 << " in " << dur
+		 << " (" << dur_flush << " flush + " << dur_kv << " kv commit)"
+		 << dendl;
+	log_latency("kv_flush",
+	  l_bluestore_kv_flush_lat,
+	  dur_flush,
+	  cct->_conf->bluestore_log_op_age);
+	log_latency("kv_commit",
+	  l_bluestore_kv_commit_lat,
+	  dur_kv,
+	  cct->_conf->bluestore_log_op_age);
+	log_latency("kv_sync",
+	  l_bluestore_kv_sync_lat,
+	  dur,
+	  cct->_conf->bluestore_log_op_age);
+      }
+      l.lock();
+    }
+  }
+  dout(10) << __func__ << " " << shard->id << " finish" << dendl;
+  shard->started = false;
+}
+
 void BlueStore::_kv_finalize_thread()
 {
   deque<TransContext*> kv_committed;
@@ -13791,6 +14582,381 @@ void BlueStore::_clean_some(ghobject_t oid, uint32_t zone)
 }
 #endif
 
+// online defragmentation
+
+void BlueStore::defrag_progress_t::dump(Formatter *f) const
+{
+  f->dump_stream("started") << started;
+  f->dump_stream("finished") << finished;
+  f->dump_unsigned("collections_total", collections_total);
+  f->dump_unsigned("collections_done", collections_done);
+  f->dump_unsigned("objects_scanned", objects_scanned);
+  f->dump_unsigned("objects_rewritten", objects_rewritten);
+  f->dump_unsigned("objects_busy", objects_busy);
+  f->dump_unsigned("objects_failed", objects_failed);
+  f->dump_unsigned("fragments_before", fragments_before);
+  f->dump_unsigned("fragments_after", fragments_after);
+  f->dump_unsigned("bytes_rewritten", bytes_rewritten);
+  f->dump_float("alloc_fragmentation_start", alloc_fragmentation_start);
+}
+
+int BlueStore::defrag_start(std::ostream& ss)
+{
+  if (!mounted) {
+    ss << "store is not mounted";
+    return -EAGAIN;
+  }
+  if (bdev->is_smr()) {
+    ss << "zoned devices are compacted by the zone cleaner";
+    return -EOPNOTSUPP;
+  }
+  std::lock_guard l(defrag_lock);
+  if (defrag_running) {
+    ss << "defragmentation is already running";
+    return -EBUSY;
+  }
+  if (defrag_thread.is_started()) {
+    // previous pass finished on its own
+    defrag_thread.join();
+  }
+  defrag_progress = defrag_progress_t();
+  defrag_progress.started = ceph_clock_now();
+  defrag_progress.alloc_fragmentation_start = alloc->get_fragmentation();
+  defrag_running = true;
+  defrag_stopping = false;
+  defrag_thread.create("bstore_defrag");
+  ss << "defragmentation started";
+  return 0;
+}
+
+void BlueStore::defrag_stop()
+{
+  dout(10) << __func__ << dendl;
+  {
+    std::lock_guard l(defrag_lock);
+    defrag_stopping = true;
+    defrag_cond.notify_all();
+  }
+  if (defrag_thread.is_started()) {
+    defrag_thread.join();
+  }
+  std::lock_guard l(defrag_lock);
+  defrag_stopping = false;
+}
+
+void BlueStore::defrag_dump(Formatter *f)
+{
+  std::lock_guard l(defrag_lock);
+  f->open_object_section("defrag");
+  f->dump_bool("running", defrag_running);
+  defrag_progress.dump(f);
+  if (mounted) {
+    f->dump_float("alloc_fragmentation", alloc->get_fragmentation());
+  }
+  f->close_section();
+}
+
+void BlueStore::_defrag_thread()
+{
+  dout(10) << __func__ << " start" << dendl;
+  vector<CollectionRef> colls;
+  {
+    std::shared_lock l(coll_lock);
+    for (auto& [cid, c] : coll_map) {
+      colls.push_back(c);
+    }
+  }
+  std::unique_lock l(defrag_lock);
+  defrag_progress.collections_total = colls.size();
+  auto start = mono_clock::now();
+  uint64_t bytes_total = 0;
+  for (auto& c : colls) {
+    ghobject_t next;
+    while (!defrag_stopping && next != ghobject_t::get_max()) {
+      l.unlock();
+      vector<ghobject_t> ls;
+      int r;
+      {
+	std::shared_lock cl(c->lock);
+	r = _collection_list(c.get(), next, ghobject_t::get_max(), 64, false,
+			     &ls, &next);
+      }
+      l.lock();
+      if (r < 0 || ls.empty()) {
+	break;
+      }
+      for (auto& oid : ls) {
+	if (defrag_stopping) {
+	  break;
+	}
+	l.unlock();
+	uint64_t before = 0, after = 0, bytes = 0;
+	r = _defrag_object(c, oid, &before, &after, &bytes);
+	l.lock();
+	++defrag_progress.objects_scanned;
+	if (r == -EAGAIN) {
+	  ++defrag_progress.objects_busy;
+	} else if (r == -EIO) {
+	  ++defrag_progress.objects_failed;
+	} else if (r == -ENOSPC) {
+	  derr << __func__ << " not enough free space, stopping" << dendl;
+	  defrag_stopping = true;
+	} else if (r > 0) {
+	  ++defrag_progress.objects_rewritten;
+	  defrag_progress.fragments_before += before;
+	  defrag_progress.fragments_after += after;
+	  defrag_progress.bytes_rewritten += bytes;
+	  bytes_total += bytes;
+	  // throttle to the configured rate
+	  auto rate = cct->_conf.get_val<Option::size_t>(
+	    "bluestore_defrag_max_bytes_per_sec");
+	  if (rate) {
+	    auto due = start + ceph::make_timespan((double)bytes_total / rate);
+	    auto now = mono_clock::now();
+	    if (due > now) {
+	      defrag_cond.wait_for(l, due - now);
+	    }
+	  }
+	}
+      }
+    }
+    if (defrag_stopping) {
+      break;
+    }
+    ++defrag_progress.collections_done;
+  }
+  defrag_progress.finished = ceph_clock_now();
+  defrag_running = false;
+  dout(10) << __func__ << " finish, rewrote "
+	   << defrag_progress.objects_rewritten << " objects, "
+	   << defrag_progress.fragments_before << " -> "
+	   << defrag_progress.fragments_after << " fragments" << dendl;
+}
+
+uint64_t BlueStore::_count_fragments(OnodeRef& o, bool *shared)
+{
+  uint64_t fragments = 0;
+  uint64_t next = 0;  // disk offset right after the previous run
+  auto count = [&](const bluestore_pextent_t& p, uint64_t offset,
+		   uint64_t length) {
+    if (p.is_valid()) {
+      if (offset != next) {
+	++fragments;
+      }
+      next = offset + length;
+    }
+    return 0;
+  };
+  std::set<const Blob*> compressed_seen;
+  *shared = false;
+  for (auto& e : o->extent_map.extent_map) {
+    auto& b = e.blob->get_blob();
+    if (b.is_shared()) {
+      *shared = true;
+    }
+    if (b.is_compressed()) {
+      // lextents refer to uncompressed data, count the blob itself once
+      if (compressed_seen.insert(e.blob.get()).second) {
+	b.map(0, b.get_ondisk_length(), count);
+      }
+    } else {
+      b.map(e.blob_offset, e.length, count);
+    }
+  }
+  return fragments;
+}
+
+int BlueStore::_defrag_object(
+  CollectionRef& c,
+  const ghobject_t& oid,
+  uint64_t *fragments_before,
+  uint64_t *fragments_after,
+  uint64_t *bytes)
+{
+  OpSequencer *osr = c->osr.get();
+  // every change to the object goes through osr, and is applied to the
+  // onode before submit_lock is released: if last_seq is the same once
+  // we are ready to rewrite, what we read is still current
+  uint64_t seq;
+  {
+    std::unique_lock sl(osr->submit_lock, std::try_to_lock);
+    if (!sl.owns_lock()) {
+      return -EAGAIN;
+    }
+    std::lock_guard ql(osr->qlock);
+    seq = osr->last_seq;
+  }
+
+  OnodeRef o;
+  bool shared = false;
+  bool compressed = false;
+  uint64_t fragments = 0;
+  uint64_t stored = 0;
+  map<uint64_t, uint64_t> to_move;
+  {
+    std::shared_lock l(c->lock);
+    if (!c->exists) {
+      return 0;
+    }
+    o = c->get_onode(oid, false);
+    if (!o || !o->exists) {
+      return 0;
+    }
+    o->extent_map.fault_range(db, 0, OBJECT_MAX_SIZE);
+    fragments = _count_fragments(o, &shared);
+    for (auto& e : o->extent_map.extent_map) {
+      stored += e.length;
+      compressed |= e.blob->get_blob().is_compressed();
+      if (!to_move.empty() &&
+	  to_move.rbegin()->first + to_move.rbegin()->second == e.logical_offset) {
+	to_move.rbegin()->second += e.length;
+      } else {
+	to_move[e.logical_offset] = e.length;
+      }
+    }
+  }
+  // NOTE: shared blobs would be duplicated by the rewrite, inflating
+  // space usage of clones and snapshots
+  if (shared || fragments == 0 ||
+      fragments < cct->_conf.get_val<uint64_t>("bluestore_defrag_min_fragments") ||
+      stored / fragments >=
+        cct->_conf.get_val<Option::size_t>("bluestore_defrag_fragment_size")) {
+    return 0;
+  }
+  if (alloc->get_free() < stored * 2) {
+    return -ENOSPC;
+  }
+
+  dout(10) << __func__ << " " << oid << " " << fragments << " fragments, 0x"
+	   << std::hex << stored << std::dec << " bytes" << dendl;
+  // read like a client would, a blob at a time, so that writers to the
+  // collection are not held up by the whole object
+  vector<bufferlist> data(to_move.size());
+  auto d = data.begin();
+  for (auto& [offset, length] : to_move) {
+    for (uint64_t pos = offset; pos < offset + length; ) {
+      uint64_t l = std::min<uint64_t>(offset + length - pos,
+				      std::max<uint64_t>(max_blob_size,
+							 min_alloc_size));
+      bufferlist bl;
+      int r;
+      {
+	std::shared_lock cl(c->lock);
+	r = _do_read(c.get(), o, pos, l, bl, 0);
+      }
+      if (r != (int)l) {
+	{
+	  std::lock_guard ql(osr->qlock);
+	  if (osr->last_seq != seq) {
+	    return -EAGAIN;  // e.g. truncated meanwhile
+	  }
+	}
+	derr << __func__ << " " << oid << " failed to read 0x" << std::hex
+	     << pos << "~" << l << std::dec << ": " << cpp_strerror(r)
+	     << ", skipping" << dendl;
+	return -EIO;
+      }
+      d->claim_append(bl);
+      pos += l;
+    }
+    ++d;
+  }
+
+  // same as queue_transactions(): nothing may be queued between our
+  // _txc_create() and _txc_state_proc(), or we would be sequenced
+  // after a txc that applies its changes on top of ours
+  std::unique_lock<ceph::mutex> al;
+  if (bdev->is_smr()) {
+    al = std::unique_lock(atomic_alloc_and_submit_lock);
+  }
+  std::unique_lock sl(osr->submit_lock, std::try_to_lock);
+  if (!sl.owns_lock()) {
+    return -EAGAIN;
+  }
+  std::unique_lock l(c->lock);
+  {
+    std::lock_guard ql(osr->qlock);
+    if (osr->last_seq != seq) {
+      dout(20) << __func__ << " " << oid << " changed while read, skipping"
+	       << dendl;
+      return -EAGAIN;
+    }
+  }
+  if (!c->exists || !o->exists) {
+    return 0;
+  }
+
+  // a txc can't be undone once _do_write() changed the onode, so get
+  // all the space it may need first.  Compressed extents may also be
+  // rewritten by the garbage collection of a preceding range.
+  uint64_t want = 0;
+  for (auto& [offset, length] : to_move) {
+    want += p2roundup(offset + length, min_alloc_size) -
+      p2align(offset, min_alloc_size);
+  }
+  if (compressed) {
+    want *= 2;
+  }
+  PExtentVector reserved;
+  int64_t got = alloc->allocate(want, min_alloc_size, want, 0, &reserved);
+  if (got < (int64_t)want) {
+    if (!reserved.empty()) {
+      alloc->release(reserved);
+    }
+    return -ENOSPC;
+  }
+
+  TransContext *txc = _txc_create(c.get(), osr, nullptr);
+  spg_t pgid;
+  if (c->cid.is_pg(&pgid)) {
+    txc->osd_pool_id = pgid.pool();
+  }
+  d = data.begin();
+  for (auto& [offset, length] : to_move) {
+    // allocates from reserved, so can't run out of space
+    int r = _do_write(txc, c, o, offset, length, *d, 0, &reserved);
+    ceph_assert(r >= 0);
+    ++d;
+  }
+  if (!reserved.empty()) {
+    alloc->release(reserved);
+  }
+  txc->write_onode(o);
+  *fragments_before = fragments;
+  *fragments_after = _count_fragments(o, &shared);
+  *bytes = stored;
+
+  _txc_calc_cost(txc);
+  _txc_write_nodes(txc, txc->t);
+  if (txc->deferred_txn) {
+    txc->deferred_txn->seq = ++deferred_seq;
+    bufferlist bl;
+    encode(*txc->deferred_txn, bl);
+    string key;
+    get_deferred_key(txc->deferred_txn->seq, &key);
+    txc->t->set(PREFIX_DEFERRED, key, bl);
+  }
+  _txc_finalize_kv(txc, txc->t);
+  l.unlock();
+
+  auto tstart = mono_clock::now();
+  if (!throttle.try_start_transaction(*db, *txc, tstart)) {
+    ++deferred_aggressive;
+    deferred_try_submit();
+    {
+      std::lock_guard kl(kv_lock);
+      if (!kv_sync_in_progress) {
+	kv_sync_in_progress = true;
+	kv_cond.notify_one();
+      }
+    }
+    throttle.finish_start_transaction(*db, *txc, tstart);
+    --deferred_aggressive;
+  }
+  _txc_state_proc(txc);
+  return 1;
+}
+
 bluestore_deferred_op_t *BlueStore::_get_deferred_op(
   TransContext *txc, uint64_t len)
 {
@@ -14154,6 +15320,7 @@ int BlueStore::queue_transactions(
   Collection *c = static_cast<Collection*>(ch.get());
   OpSequencer *osr = c->osr.get();
   dout(10) << __func__ << " ch " << c << " " << c->cid << dendl;
+  trace_transactions(ch, tls);
 
   // With HM-SMR drives (and ZNS SSDs) we want the I/O allocation and I/O
   // submission to happen atomically because if I/O submission happens in a
@@ -14164,6 +15331,8 @@ int BlueStore::queue_transactions(
   if (bdev->is_smr()) {
     atomic_alloc_and_submit_lock.lock();
   }
+  // see _defrag_object()
+  osr->submit_lock.lock();
 
   // prepare
   TransContext *txc = _txc_create(static_cast<Collection*>(ch.get()), osr,
@@ -14230,6 +15399,7 @@ int BlueStore::queue_transactions(
   // execute (start)
   _txc_state_proc(txc);
 
+  osr->submit_lock.unlock();
   if (bdev->is_smr()) {
     atomic_alloc_and_submit_lock.unlock();
   }
@@ -15553,6 +16723,7 @@ int BlueStore::_do_alloc_write(
   // and the condition is : (data_size < deferred).
 
   auto max_bsize = std::max(wctx->target_blob_size, min_alloc_size);
+  uint64_t estimate_sample_size = comp_estimate_sample_size;
   for (auto& wi : wctx->writes) {
     if (c && wi.blob_length > min_alloc_size) {
       auto start = mono_clock::now();
@@ -15561,10 +16732,37 @@ int BlueStore::_do_alloc_write(
       ceph_assert(wi.b_off == 0);
       ceph_assert(wi.blob_length == wi.bl.length());
 
+      if (estimate_sample_size) {
+	// don't bother compressing what would be rejected anyway
+	double ratio = c->estimate_ratio(wi.bl, estimate_sample_size);
+	logger->tinc(l_bluestore_compress_estimate_lat,
+		     mono_clock::now() - start);
+	if (ratio > crr) {
+	  dout(20) << __func__ << std::hex << "  0x" << wi.blob_length
+		   << std::dec << " estimated to compress to " << ratio
+		   << ", more than required " << crr
+		   << ", leaving uncompressed" << dendl;
+	  logger->inc(l_bluestore_compress_skipped_count);
+	  logger->inc(l_bluestore_compress_skipped_bytes, wi.blob_length);
+	  if (uint64_t bytes = comp_total_bytes.load(); bytes) {
+	    logger->tinc(l_bluestore_compress_skipped_saved_time,
+	      ceph::timespan((uint64_t)((double)comp_total_ns.load() / bytes *
+					wi.blob_length)));
+	  }
+	  need += wi.blob_length;
+	  data_size += wi.bl.length();
+	  continue;
+	}
+      }
+
       // FIXME: memory alignment here is bad
       bufferlist t;
       std::optional<int32_t> compressor_message;
+      auto compress_start = mono_clock::now();
       int r = c->compress(wi.bl, t, compressor_message);
+      comp_total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+	mono_clock::now() - compress_start).count();
+      comp_total_bytes += wi.blob_length;
       uint64_t want_len_raw = wi.blob_length * crr;
       uint64_t want_len = p2roundup(want_len_raw, min_alloc_size);
       bool rejected = false;
@@ -15640,19 +16838,37 @@ int BlueStore::_do_alloc_write(
   PExtentVector prealloc;
   prealloc.reserve(2 * wctx->writes.size());
   int64_t prealloc_left = 0;
-  prealloc_left = alloc->allocate(
-    need, min_alloc_size, need,
-    0, &prealloc);
-  if (prealloc_left < 0 || prealloc_left < (int64_t)need) {
-    derr << __func__ << " failed to allocate 0x" << std::hex << need
-         << " allocated 0x " << (prealloc_left < 0 ? 0 : prealloc_left)
-         << " min_alloc_size 0x" << min_alloc_size
-         << " available 0x " << alloc->get_free()
-         << std::dec << dendl;
-    if (prealloc.size()) {
-      alloc->release(prealloc);
+  if (wctx->reserved) {
+    // set aside by the caller before it touched the onode
+    auto p = wctx->reserved->begin();
+    for (; p != wctx->reserved->end() && prealloc_left < (int64_t)need; ++p) {
+      uint64_t l = std::min<uint64_t>(p->length, need - prealloc_left);
+      prealloc.emplace_back(p->offset, l);
+      prealloc_left += l;
+      if (l < p->length) {
+	p->offset += l;
+	p->length -= l;
+	break;
+      }
     }
-    return -ENOSPC;
+    wctx->reserved->erase(wctx->reserved->begin(), p);
+  }
+  if (prealloc_left < (int64_t)need) {
+    int64_t got = alloc->allocate(
+      need - prealloc_left, min_alloc_size, need - prealloc_left,
+      0, &prealloc);
+    if (got < 0 || prealloc_left + got < (int64_t)need) {
+      derr << __func__ << " failed to allocate 0x" << std::hex << need
+	   << " allocated 0x " << prealloc_left + (got < 0 ? 0 : got)
+	   << " min_alloc_size 0x" << min_alloc_size
+	   << " available 0x " << alloc->get_free()
+	   << std::dec << dendl;
+      if (prealloc.size()) {
+	alloc->release(prealloc);
+      }
+      return -ENOSPC;
+    }
+    prealloc_left += got;
   }
   _collect_allocation_stats(need, min_alloc_size, prealloc);
 
@@ -16138,7 +17354,8 @@ int BlueStore::_do_write(
   uint64_t offset,
   uint64_t length,
   bufferlist& bl,
-  uint32_t fadvise_flags)
+  uint32_t fadvise_flags,
+  PExtentVector *reserved)
 {
   int r = 0;
 
@@ -16169,6 +17386,7 @@ int BlueStore::_do_write(
 
   WriteContext wctx;
   _choose_write_options(c, o, fadvise_flags, &wctx);
+  wctx.reserved = reserved;
   o->extent_map.fault_range(db, offset, length);
   _do_write_data(txc, c, o, offset, length, bl, &wctx);
   r = _do_alloc_write(txc, c, o, &wctx);
@@ -17617,6 +18835,7 @@ int BlueStore::flush_cache(ostream *os)
   dout(10) << __func__ << dendl;
   for (auto i : onode_cache_shards) {
     i->flush();
+    i->epoch_reclaim();
   }
   for (auto i : buffer_cache_shards) {
     i->flush();
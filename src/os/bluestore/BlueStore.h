@@ -113,6 +113,10 @@ enum {
   l_bluestore_read_eio,
   l_bluestore_reads_with_retries,
   l_bluestore_read_lat,
+  l_bluestore_read_batch_lat,
+  l_bluestore_read_batch_ops,
+  l_bluestore_read_batch_extents,
+  l_bluestore_read_batch_ios,
   //****************************************
 
   // kv_thread latencies
@@ -159,6 +163,10 @@ enum {
   l_bluestore_decompress_lat,
   l_bluestore_compress_success_count,
   l_bluestore_compress_rejected_count,
+  l_bluestore_compress_skipped_count,
+  l_bluestore_compress_skipped_bytes,
+  l_bluestore_compress_skipped_saved_time,
+  l_bluestore_compress_estimate_lat,
   //****************************************
 
   // onode cache stats
@@ -171,6 +179,8 @@ enum {
   l_bluestore_onode_shard_misses,
   l_bluestore_extents,
   l_bluestore_blobs,
+  l_bluestore_onode_meta_bytes,
+  l_bluestore_onode_avg_bytes,
   //****************************************
 
   // buffer cache stats
@@ -1190,6 +1200,9 @@ public:
     mempool::bluestore_cache_meta::string key;
 
     boost::intrusive::list_member_hook<> lru_item;
+    /// age bin generation of the last lru touch, 0 if not in the lru.
+    /// lets put() skip the cache lock when there is nothing to update.
+    std::atomic<uint64_t> lru_gen = {0};
 
     bluestore_onode_t onode;  ///< metadata stored as value in kv store
     bool exists;              ///< true if object logically exists
@@ -1330,6 +1343,7 @@ private:
     std::atomic<uint64_t> max = {0};
     std::atomic<uint64_t> num = {0};
     boost::circular_buffer<std::shared_ptr<int64_t>> age_bins;
+    std::atomic<uint64_t> age_bin_gen = {0}; ///< bumped with each shift_bins()
 
     CacheShard(CephContext* cct) : cct(cct), logger(nullptr), age_bins(1) {
       shift_bins();
@@ -1367,6 +1381,7 @@ private:
     virtual void shift_bins() {
       std::lock_guard l(lock);
       age_bins.push_front(std::make_shared<int64_t>(0));
+      ++age_bin_gen;
     }
     virtual uint32_t get_bin_count() {
       std::lock_guard l(lock);
@@ -1397,10 +1412,77 @@ private:
 #endif
   };
 
+  /// direct mapped onode table for lockless lookups, see OnodeSpace::lookup()
+  struct OnodeLookupTable {
+    /// immutable copy of the oid an onode was published under, so that
+    /// lockless lookups never read the onode's own (renamed) oid
+    struct entry_t {
+      const ghobject_t oid;
+      Onode* const o;
+    };
+
+    const size_t mask;
+    std::unique_ptr<std::atomic<entry_t*>[]> slots;
+
+    explicit OnodeLookupTable(size_t n)
+      : mask(n - 1), slots(new std::atomic<entry_t*>[n]()) {
+      ceph_assert(std::has_single_bit(n));
+    }
+    size_t size() const {
+      return mask + 1;
+    }
+    std::atomic<entry_t*>& slot(const ghobject_t& oid) {
+      return slots[std::hash<ghobject_t>()(oid) & mask];
+    }
+  };
+
   /// A Generic onode Cache Shard
   struct OnodeCacheShard : public CacheShard {
     std::array<std::pair<ghobject_t, ceph::mono_clock::time_point>, 64> dumped_onodes;
 
+    /// serve onode cache hits without taking the lock,
+    /// see bluestore_onode_lockless_lookup
+    bool lockless_lookup = false;
+
+  private:
+    // Epoch based reclamation for lockless lookups.  Readers announce
+    // themselves under the parity of the current epoch; onodes and lookup
+    // tables unpublished under the lock are retired to the current epoch
+    // and released once the epoch advanced twice, i.e. when no reader
+    // that could have seen them is left.
+    static constexpr unsigned EPOCH_READER_SLOTS = 32;
+    struct alignas(64) epoch_readers_t {
+      std::atomic<uint64_t> n[2] = {0, 0};
+    };
+    std::array<epoch_readers_t, EPOCH_READER_SLOTS> epoch_readers;
+    std::atomic<uint64_t> epoch = {0};
+    struct retired_t {
+      /// onodes of the retired entries, referenced without being pinned
+      std::vector<Onode*> onodes;
+      std::vector<std::unique_ptr<OnodeLookupTable::entry_t>> entries;
+      std::vector<std::unique_ptr<OnodeLookupTable>> tables;
+
+      retired_t() = default;
+      retired_t(const retired_t&) = delete;
+      retired_t& operator=(const retired_t&) = delete;
+      /// drops the onode references, which may take cache shard locks
+      ~retired_t();
+      bool empty() const {
+        return onodes.empty() && entries.empty() && tables.empty();
+      }
+      void swap(retired_t& other) {
+        onodes.swap(other.onodes);
+        entries.swap(other.entries);
+        tables.swap(other.tables);
+      }
+    } retired[2];  ///< by epoch parity
+    std::atomic<bool> has_retired = {false};
+
+    bool _epoch_has_readers(unsigned parity);
+    /// move what was retired two epochs ago to released if no reader is
+    /// left there; released must only be destroyed after unlocking
+    bool _epoch_try_advance(retired_t& released);
+
   public:
     OnodeCacheShard(CephContext* cct) : CacheShard(cct) {}
     static OnodeCacheShard *create(CephContext* cct, std::string type,
@@ -1414,6 +1496,31 @@ private:
 
     virtual void maybe_unpin(Onode* o) = 0;
     virtual void add_stats(uint64_t *onodes, uint64_t *pinned_onodes) = 0;
+
+    /// enter a lockless read section, returns the token for epoch_exit()
+    std::atomic<uint64_t>* epoch_enter();
+    void epoch_exit(std::atomic<uint64_t>* r) {
+      r->fetch_sub(1, std::memory_order_release);
+    }
+    // The following must be called under lock
+    void _retire(std::unique_ptr<OnodeLookupTable::entry_t>&& e) {
+      // lockless lookups may still pin the onode through the entry, keep
+      // it allocated without pinning it
+      ++e->o->nref;
+      auto& r = retired[epoch & 1];
+      r.onodes.push_back(e->o);
+      r.entries.emplace_back(std::move(e));
+      has_retired = true;
+    }
+    void _retire(std::unique_ptr<OnodeLookupTable>&& t) {
+      retired[epoch & 1].tables.emplace_back(std::move(t));
+      has_retired = true;
+    }
+    // The following must be called without lock
+    /// release what no lockless lookup can reach anymore
+    void epoch_reclaim();
+    /// wait until everything retired so far has been released
+    void epoch_synchronize();
     bool empty() {
       return _get_num() == 0;
     }
@@ -1470,11 +1577,15 @@ private:
   private:
     /// forward lookups
     mempool::bluestore_cache_meta::unordered_map<ghobject_t,OnodeRef> onode_map;
+    /// subset of onode_map served without the cache lock, if enabled
+    std::atomic<OnodeLookupTable*> lookup_table = {nullptr};
 
     friend struct Collection; // for split_cache()
     friend struct Onode; // for put()
     friend struct LruOnodeCacheShard;
     void _remove(const ghobject_t& oid);
+    void _publish(Onode* o);
+    void _unpublish(Onode* o);
   public:
     OnodeSpace(OnodeCacheShard *c) : cache(c) {}
     ~OnodeSpace() {
@@ -2015,6 +2126,10 @@ private:
   class OpSequencer : public RefCountedObject {
   public:
     ceph::mutex qlock = ceph::make_mutex("BlueStore::OpSequencer::qlock");
+    /// held from _txc_create() through the first _txc_state_proc(), so
+    /// that txcs are applied in the order they are queued
+    ceph::mutex submit_lock =
+      ceph::make_mutex("BlueStore::OpSequencer::submit_lock");
     ceph::condition_variable qcond;
     typedef boost::intrusive::list<
       TransContext,
@@ -2165,6 +2280,33 @@ private:
     }
   };
 
+  /// additional kv sync queue, see bluestore_kv_sync_shards.  shard 0 is
+  /// the main kv_sync_thread, which also owns all deferred io handling.
+  struct KVSyncShard {
+    struct ShardThread : public Thread {
+      BlueStore *store;
+      KVSyncShard *shard;
+      ShardThread(BlueStore *s, KVSyncShard *sh) : store(s), shard(sh) {}
+      void *entry() override {
+	store->_kv_sync_shard_thread(shard);
+	return NULL;
+      }
+    } thread;
+    const unsigned id;
+    ceph::mutex lock = ceph::make_mutex("BlueStore::KVSyncShard::lock");
+    ceph::condition_variable cond;
+    bool started = false;
+    bool stop = false;
+    bool in_progress = false;
+    std::deque<TransContext*> queue;             ///< ready, already submitted
+    std::deque<TransContext*> queue_unsubmitted; ///< ready, need submit
+    std::deque<TransContext*> committing;        ///< currently syncing
+    uint64_t ios = 0;
+    uint64_t throttle_costs = 0;
+
+    KVSyncShard(BlueStore *s, unsigned i) : thread(s, this), id(i) {}
+  };
+
 #ifdef HAVE_LIBZBD
   struct ZonedCleanerThread : public Thread {
     BlueStore *store;
@@ -2175,6 +2317,33 @@ private:
     }
   };
 #endif
+
+  struct DefragThread : public Thread {
+    BlueStore *store;
+    explicit DefragThread(BlueStore *s) : store(s) {}
+    void *entry() override {
+      store->_defrag_thread();
+      return nullptr;
+    }
+  };
+
+  /// progress of the online defragmenter, see defrag_start()
+  struct defrag_progress_t {
+    utime_t started;
+    utime_t finished;
+    uint64_t collections_total = 0;
+    uint64_t collections_done = 0;
+    uint64_t objects_scanned = 0;
+    uint64_t objects_rewritten = 0;
+    uint64_t objects_busy = 0;      ///< skipped, collection had pending writes
+    uint64_t objects_failed = 0;    ///< skipped, could not be read
+    uint64_t fragments_before = 0;  ///< of the rewritten objects
+    uint64_t fragments_after = 0;
+    uint64_t bytes_rewritten = 0;
+    double alloc_fragmentation_start = 0;
+
+    void dump(ceph::Formatter *f) const;
+  };
   
   struct BigDeferredWriteContext {
     uint64_t off = 0;     // original logical offset
@@ -2265,6 +2434,10 @@ private:
   std::deque<DeferredBatch*> deferred_done_queue;   ///< deferred ios done
   bool kv_sync_in_progress = false;
 
+  std::vector<std::unique_ptr<KVSyncShard>> kv_sync_shards; ///< shards 1..n-1
+  /// serializes {nid,blobid}_max preallocation across kv sync shards
+  ceph::mutex kv_prealloc_lock = ceph::make_mutex("BlueStore::kv_prealloc_lock");
+
   KVFinalizeThread kv_finalize_thread;
   ceph::mutex kv_finalize_lock = ceph::make_mutex("BlueStore::kv_finalize_lock");
   ceph::condition_variable kv_finalize_cond;
@@ -2281,6 +2454,16 @@ private:
   std::deque<uint64_t> zoned_cleaner_queue;
 #endif
 
+  DefragThread defrag_thread;
+  ceph::mutex defrag_lock = ceph::make_mutex("BlueStore::defrag_lock");
+  ceph::condition_variable defrag_cond;
+  bool defrag_running = false;
+  bool defrag_stopping = false;
+  defrag_progress_t defrag_progress;
+
+  class SocketHook;
+  SocketHook* asok_hook = nullptr;
+
   PerfCounters *logger = nullptr;
 
   std::list<CollectionRef> removed_collections;
@@ -2332,6 +2515,11 @@ private:
   CompressorRef compressor;
   std::atomic<uint64_t> comp_min_blob_size = {0};
   std::atomic<uint64_t> comp_max_blob_size = {0};
+  ///< bytes sampled to estimate compressibility, 0 to always compress
+  std::atomic<uint64_t> comp_estimate_sample_size = {0};
+  ///< totals of actual compression work, to estimate the cost of skipped one
+  std::atomic<uint64_t> comp_total_ns = {0};
+  std::atomic<uint64_t> comp_total_bytes = {0};
 
   std::atomic<uint64_t> max_blob_size = {0};  ///< maximum blob size
 
@@ -2377,6 +2565,11 @@ private:
     std::shared_ptr<PriorityCache::PriCache> binned_kv_cache = nullptr;
     std::shared_ptr<PriorityCache::PriCache> binned_kv_onode_cache = nullptr;
     std::shared_ptr<PriorityCache::Manager> pcm = nullptr;
+    /// caches added by add_priority_cache()
+    std::map<std::string, std::shared_ptr<PriorityCache::PriCache>>
+      external_caches;
+    std::map<std::string, std::shared_ptr<PriorityCache::PriCache>>
+      pending_external_caches;
 
     struct MempoolCache : public PriorityCache::PriCache {
       BlueStore *store;
@@ -2593,9 +2786,15 @@ private:
       lock.unlock();
       join();
     }
+    void add_cache(const std::string& name,
+		   std::shared_ptr<PriorityCache::PriCache> c) {
+      std::lock_guard l{lock};
+      pending_external_caches[name] = c;
+    }
 
   private:
     void _update_cache_settings();
+    void _add_external_caches();
     void _resize_shards(bool interval_stats);
   } mempool_thread;
 
@@ -2741,7 +2940,14 @@ private:
   void _kv_start();
   void _kv_stop();
   void _kv_sync_thread();
+  void _kv_sync_shard_thread(KVSyncShard *shard);
   void _kv_finalize_thread();
+  bool _kv_need_prealloc_ids() const;
+  void _kv_prealloc_ids(KeyValueDB::Transaction t,
+			uint64_t *new_nid_max,
+			uint64_t *new_blobid_max);
+  void _kv_queue_to_finalize(std::deque<TransContext*>& committing,
+			     std::deque<DeferredBatch*>& deferred_stable);
 
 #ifdef HAVE_LIBZBD
   void _zoned_cleaner_start();
@@ -2753,6 +2959,26 @@ private:
   void _clean_some(ghobject_t oid, uint32_t zone_num);
 #endif
 
+  void _defrag_thread();
+  /// count physically discontiguous runs backing the object's data
+  uint64_t _count_fragments(OnodeRef& o, bool *shared);
+  int _defrag_object(CollectionRef& c, const ghobject_t& oid,
+		     uint64_t *fragments_before, uint64_t *fragments_after,
+		     uint64_t *bytes);
+public:
+  /**
+   * defrag_start - start rewriting fragmented objects in the background
+   *
+   * Objects whose data is spread over many small physical runs are
+   * rewritten into contiguous extents, which also gives the freed runs
+   * back to the allocator to merge with their free neighbours.  Objects
+   * with shared blobs (clones) are left alone.
+   */
+  int defrag_start(std::ostream& ss);
+  void defrag_stop();
+  void defrag_dump(ceph::Formatter *f);
+private:
+
   bluestore_deferred_op_t *_get_deferred_op(TransContext *txc, uint64_t len);
   void _deferred_queue(TransContext *txc);
 public:
@@ -2928,6 +3154,11 @@ public:
   }
 
   void set_cache_shards(unsigned num) override;
+  void add_priority_cache(
+    const std::string& name,
+    std::shared_ptr<PriorityCache::PriCache> c) override {
+    mempool_thread.add_cache(name, c);
+  }
   void dump_cache_stats(ceph::Formatter *f) override {
     int onode_count = 0, buffers_bytes = 0;
     for (auto i: onode_cache_shards) {
@@ -3100,6 +3331,11 @@ private:
     uint32_t op_flags = 0,
     uint64_t retry_count = 0);
 
+  int _prepare_read_ioc_batch(
+    std::vector<blobs2read_t>& blobs2read,
+    std::vector<std::vector<ceph::buffer::list>>& compressed_blob_bls,
+    IOContext* ioc);
+
   int _fiemap(CollectionHandle &c_, const ghobject_t& oid,
 	      uint64_t offset, size_t len, interval_set<uint64_t>& destset);
 public:
@@ -3115,6 +3351,11 @@ public:
     ceph::buffer::list& bl,
     uint32_t op_flags) override;
 
+  int read_batch(
+    CollectionHandle &c_,
+    std::vector<read_batch_op_t>& ops,
+    uint32_t op_flags) override;
+
   int dump_onode(CollectionHandle &c, const ghobject_t& oid,
     const std::string& section_name, ceph::Formatter *f) override;
 
@@ -3395,6 +3636,7 @@ private:
 
     old_extent_map_t old_extents;   ///< must deref these blobs
     interval_set<uint64_t> extents_to_gc; ///< extents for garbage collection
+    PExtentVector *reserved = nullptr; ///< allocate from here first, if set
 
     struct write_item {
       uint64_t logical_offset;      ///< write logical offset
@@ -3441,6 +3683,7 @@ private:
       compress = other.compress;
       target_blob_size = other.target_blob_size;
       csum_order = other.csum_order;
+      reserved = other.reserved;
     }
     void write(
       uint64_t loffs,
@@ -3528,7 +3771,8 @@ private:
 		OnodeRef& o,
 		uint64_t offset, uint64_t length,
 		ceph::buffer::list& bl,
-		uint32_t fadvise_flags);
+		uint32_t fadvise_flags,
+		PExtentVector *reserved = nullptr);
   void _do_write_data(TransContext *txc,
                       CollectionRef& c,
                       OnodeRef& o,
@@ -0,0 +1,247 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "CachedHybridAllocator.h"
+
+#include <functional>
+#include <thread>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "common/config_proxy.h"
+#include "common/debug.h"
+
+#define dout_context cct
+#define dout_subsys ceph_subsys_bluestore
+#undef  dout_prefix
+#define dout_prefix *_dout << "CachedHybridAllocator "
+
+CachedHybridAllocator::CachedHybridAllocator(
+  CephContext* cct,
+  int64_t device_size,
+  int64_t _block_size,
+  uint64_t max_mem,
+  std::string_view name)
+  : HybridAllocator(cct, device_size, _block_size, max_mem, name),
+    num_classes(cct->_conf.get_val<uint64_t>(
+      "bluestore_allocator_cache_size_classes")),
+    shard_max_bytes(cct->_conf.get_val<Option::size_t>(
+      "bluestore_allocator_cache_shard_bytes")),
+    shards(std::max<uint64_t>(
+      1, cct->_conf.get_val<uint64_t>("bluestore_allocator_cache_shards")))
+{
+  for (auto& s : shards) {
+    s.free.resize(num_classes);
+    // no allocations while holding a shard spinlock
+    for (uint64_t i = 0; i < num_classes; ++i) {
+      s.free[i].reserve(shard_max_bytes / ((i + 1) * block_size));
+    }
+  }
+}
+
+CachedHybridAllocator::~CachedHybridAllocator()
+{
+  shutdown();
+}
+
+CachedHybridAllocator::shard_t& CachedHybridAllocator::_get_shard()
+{
+  // threads running on the same cpu, and hence the same numa node, share
+  // a shard
+#ifdef __linux__
+  int cpu = sched_getcpu();
+  if (cpu >= 0) {
+    return shards[cpu % shards.size()];
+  }
+#endif
+  return shards[std::hash<std::thread::id>{}(std::this_thread::get_id()) %
+		shards.size()];
+}
+
+bool CachedHybridAllocator::_refill(
+  shard_t& s,
+  uint64_t cls,
+  int64_t hint,
+  uint64_t *offset)
+{
+  uint64_t want = cls * block_size;
+  PExtentVector extents;
+  auto r = HybridAllocator::allocate(want * REFILL_EXTENTS, block_size,
+				     want * REFILL_EXTENTS, hint, &extents);
+  interval_set<uint64_t> rest;
+  bool got = false;
+  {
+    std::lock_guard l(s.lock);
+    auto& v = s.free[cls - 1];
+    for (auto& e : extents) {
+      uint64_t o = e.offset;
+      uint64_t end = e.offset + e.length;
+      if (r > 0) {
+	for (; o + want <= end; o += want) {
+	  if (!got) {
+	    *offset = o;
+	    got = true;
+	  } else if (s.bytes + want <= shard_max_bytes &&
+		     v.size() < v.capacity()) {
+	    v.push_back(o);
+	    s.bytes += want;
+	    cached_bytes += want;
+	  } else {
+	    break;
+	  }
+	}
+      }
+      if (o < end) {
+	rest.insert(o, end - o);
+      }
+    }
+  }
+  if (!rest.empty()) {
+    HybridAllocator::release(rest);
+  }
+  return got;
+}
+
+int64_t CachedHybridAllocator::allocate(
+  uint64_t want,
+  uint64_t unit,
+  uint64_t max_alloc_size,
+  int64_t  hint,
+  PExtentVector* extents)
+{
+  uint64_t cls = 0;
+  if (unit == (uint64_t)block_size &&
+      (max_alloc_size == 0 || max_alloc_size >= want)) {
+    cls = _size_class(0, want);
+  }
+  if (cls) {
+    auto& s = _get_shard();
+    uint64_t offset = 0;
+    bool got = false;
+    {
+      std::lock_guard l(s.lock);
+      auto& v = s.free[cls - 1];
+      if (!v.empty()) {
+	offset = v.back();
+	v.pop_back();
+	s.bytes -= want;
+	got = true;
+      }
+    }
+    if (got) {
+      cached_bytes -= want;
+      ++cache_hits;
+    } else {
+      ++cache_misses;
+      got = _refill(s, cls, hint, &offset);
+    }
+    if (got) {
+      ldout(cct, 20) << __func__ << std::hex << " cached 0x" << offset
+		     << "~" << want << std::dec << dendl;
+      extents->emplace_back(offset, want);
+      return want;
+    }
+  }
+  int64_t r = HybridAllocator::allocate(want, unit, max_alloc_size, hint,
+					extents);
+  uint64_t got = r > 0 ? r : 0;
+  if (got < want && cached_bytes > 0) {
+    // what is missing may be sitting in the caches
+    ldout(cct, 10) << __func__ << std::hex << " short of 0x" << want - got
+		   << ", flushing 0x" << cached_bytes << " cached bytes"
+		   << std::dec << dendl;
+    _flush_caches();
+    int64_t r2 = HybridAllocator::allocate(want - got, unit, max_alloc_size,
+					   hint, extents);
+    if (r2 > 0) {
+      r = got + r2;
+    }
+  }
+  return r;
+}
+
+void CachedHybridAllocator::release(const interval_set<uint64_t>& release_set)
+{
+  interval_set<uint64_t> rest;
+  auto& s = _get_shard();
+  {
+    std::lock_guard l(s.lock);
+    for (auto& [offset, length] : release_set) {
+      auto cls = _size_class(offset, length);
+      if (cls &&
+	  s.bytes + length <= shard_max_bytes &&
+	  s.free[cls - 1].size() < s.free[cls - 1].capacity()) {
+	s.free[cls - 1].push_back(offset);
+	s.bytes += length;
+	cached_bytes += length;
+      } else {
+	rest.insert(offset, length);
+      }
+    }
+  }
+  if (!rest.empty()) {
+    HybridAllocator::release(rest);
+  }
+}
+
+void CachedHybridAllocator::_flush_caches()
+{
+  interval_set<uint64_t> rest;
+  for (auto& s : shards) {
+    std::lock_guard l(s.lock);
+    for (uint64_t i = 0; i < num_classes; ++i) {
+      for (auto offset : s.free[i]) {
+	rest.insert(offset, (i + 1) * block_size);
+      }
+      s.free[i].clear();
+    }
+    cached_bytes -= s.bytes;
+    s.bytes = 0;
+  }
+  if (!rest.empty()) {
+    HybridAllocator::release(rest);
+  }
+}
+
+uint64_t CachedHybridAllocator::get_free()
+{
+  return HybridAllocator::get_free() + cached_bytes;
+}
+
+void CachedHybridAllocator::dump()
+{
+  HybridAllocator::dump();
+  ldout(cct, 0) << __func__
+    << " cached: " << cached_bytes
+    << " hits: " << cache_hits
+    << " misses: " << cache_misses
+    << dendl;
+}
+
+void CachedHybridAllocator::foreach(
+  std::function<void(uint64_t offset, uint64_t length)> notify)
+{
+  for (auto& s : shards) {
+    std::lock_guard l(s.lock);
+    for (uint64_t i = 0; i < num_classes; ++i) {
+      for (auto offset : s.free[i]) {
+	notify(offset, (i + 1) * block_size);
+      }
+    }
+  }
+  HybridAllocator::foreach(notify);
+}
+
+void CachedHybridAllocator::init_rm_free(uint64_t offset, uint64_t length)
+{
+  // the range may be sitting in a cache
+  _flush_caches();
+  HybridAllocator::init_rm_free(offset, length);
+}
+
+void CachedHybridAllocator::shutdown()
+{
+  _flush_caches();
+  HybridAllocator::shutdown();
+}
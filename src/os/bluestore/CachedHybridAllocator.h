@@ -0,0 +1,82 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <atomic>
+
+#include "HybridAllocator.h"
+#include "include/mempool.h"
+#include "include/spinlock.h"
+
+/*
+ * Hybrid allocator with sharded free extent caches in front of it.
+ *
+ * Allocations and releases of small, min_alloc_size multiple extents
+ * (size classes 1..N units) are served from a per CPU shard cache, which
+ * only takes that shard's spinlock.  Empty classes are refilled in one
+ * go from the AVL/bitmap backing allocator, and released extents that do
+ * not fit into the cache go back to it.  Keeping same sized extents
+ * together for reuse also slows down fragmentation of the backing tree
+ * under workloads that keep rewriting objects of the same size.
+ */
+class CachedHybridAllocator : public HybridAllocator {
+  struct alignas(64) shard_t {
+    ceph::spinlock lock;
+    /// free extent offsets per size class, class i holds (i + 1) units
+    std::vector<mempool::bluestore_alloc::vector<uint64_t>> free;
+    uint64_t bytes = 0;
+  };
+
+  const uint64_t num_classes;
+  const uint64_t shard_max_bytes;
+  std::vector<shard_t> shards;
+  std::atomic<uint64_t> cached_bytes = {0};
+  std::atomic<uint64_t> cache_hits = {0};
+  std::atomic<uint64_t> cache_misses = {0};
+
+  static constexpr unsigned REFILL_EXTENTS = 8;
+
+  shard_t& _get_shard();
+  /// @return size class index + 1 for a cacheable extent, 0 otherwise
+  uint64_t _size_class(uint64_t offset, uint64_t length) const {
+    uint64_t bs = block_size;
+    if (offset % bs || length % bs) {
+      return 0;
+    }
+    uint64_t n = length / bs;
+    return n <= num_classes ? n : 0;
+  }
+  bool _refill(shard_t& s, uint64_t cls, int64_t hint, uint64_t *offset);
+  void _flush_caches();
+
+public:
+  CachedHybridAllocator(CephContext* cct, int64_t device_size,
+			int64_t _block_size, uint64_t max_mem,
+			std::string_view name);
+  ~CachedHybridAllocator() override;
+
+  const char* get_type() const override
+  {
+    return "hybrid_cached";
+  }
+  int64_t allocate(
+    uint64_t want,
+    uint64_t unit,
+    uint64_t max_alloc_size,
+    int64_t  hint,
+    PExtentVector *extents) override;
+  using Allocator::release;
+  void release(const interval_set<uint64_t>& release_set) override;
+  uint64_t get_free() override;
+
+  void dump() override;
+  void foreach(
+    std::function<void(uint64_t offset, uint64_t length)> notify) override;
+  void init_rm_free(uint64_t offset, uint64_t length) override;
+  void shutdown() override;
+
+  uint64_t get_cached_bytes() const {
+    return cached_bytes;
+  }
+};
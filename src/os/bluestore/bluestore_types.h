@@ -20,6 +20,7 @@
 #include <type_traits>
 #include <vector>
 #include <array>
+#include <boost/container/small_vector.hpp>
 #include "include/mempool.h"
 #include "include/types.h"
 #include "include/interval_set.h"
@@ -113,7 +114,12 @@ WRITE_CLASS_DENC(bluestore_pextent_t)
 
 std::ostream& operator<<(std::ostream& out, const bluestore_pextent_t& o);
 
-typedef mempool::bluestore_cache_other::vector<bluestore_pextent_t> PExtentVector;
+/// most blobs (small objects, uncompressed writes) map to a single
+/// physical extent; keep that one inline to save a heap allocation
+typedef boost::container::small_vector<
+  bluestore_pextent_t, 1,
+  mempool::bluestore_cache_other::pool_allocator<bluestore_pextent_t>>
+  PExtentVector;
 
 template<>
 struct denc_traits<PExtentVector> {
@@ -2140,6 +2140,7 @@ int KStore::queue_transactions(
   Collection *c = static_cast<Collection*>(ch.get());
   OpSequencer *osr = c->osr.get();
   dout(10) << __func__ << " ch " << ch.get() << " " << c->cid << dendl;
+  trace_transactions(ch, tls);
 
   // prepare
   TransContext *txc = _txc_create(osr);
@@ -654,6 +654,7 @@ int MemStore::queue_transactions(
   // while allowing operations on different sequencers to happen in parallel
   Collection *c = static_cast<Collection*>(ch.get());
   std::unique_lock lock{c->sequencer_mutex};
+  trace_transactions(ch, tls);
 
   for (auto p = tls.begin(); p != tls.end(); ++p) {
     // poke the TPHandle heartbeat just to exercise that code path
@@ -12,6 +12,7 @@
  *
  */
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -63,7 +64,7 @@ struct ECRecoveryHandle : public PGBackend::RecoveryHandle {
 ostream &operator<<(ostream &lhs, const ECBackend::pipeline_state_t &rhs) {
   switch (rhs.pipeline_state) {
   case ECBackend::pipeline_state_t::CACHE_VALID:
-    return lhs << "CACHE_VALID";
+    return lhs << (rhs.keep_clean ? "CACHE_VALID" : "CACHE_VALID_NO_CLEAN");
   case ECBackend::pipeline_state_t::CACHE_INVALID:
     return lhs << "CACHE_INVALID";
   default:
@@ -176,6 +177,7 @@ ostream &operator<<(ostream &lhs, const ECBackend::Op &rhs)
       << " pending_commit=" << rhs.pending_commit
       << " plan.to_read=" << rhs.plan.to_read
       << " plan.will_write=" << rhs.plan.will_write
+      << " plan.delta_shards=" << rhs.plan.delta_shards
       << ")";
   return lhs;
 }
@@ -216,12 +218,26 @@ ECBackend::ECBackend(
   ObjectStore *store,
   CephContext *cct,
   ErasureCodeInterfaceRef ec_impl,
-  uint64_t stripe_width)
+  uint64_t stripe_width,
+  std::shared_ptr<ExtentCacheBudget> cache_budget)
   : PGBackend(cct, pg, store, coll, ch),
+    cache_budget(std::move(cache_budget)),
     ec_impl(ec_impl),
     sinfo(ec_impl->get_data_chunk_count(), stripe_width) {
   ceph_assert((ec_impl->get_data_chunk_count() *
 	  ec_impl->get_chunk_size(stripe_width)) == stripe_width);
+  if (this->cache_budget) {
+    this->cache_budget->register_backend();
+  }
+}
+
+ECBackend::~ECBackend()
+{
+  cache.clear_clean();
+  if (cache_budget) {
+    cache_budget->update(cache_clean_bytes, 0);
+    cache_budget->unregister_backend();
+  }
 }
 
 PGBackend::RecoveryHandle *ECBackend::open_recovery_op()
@@ -463,6 +479,7 @@ void ECBackend::handle_recovery_read_complete(
   int r;
   r = ECUtil::decode(sinfo, ec_impl, from, target);
   ceph_assert(r == 0);
+  update_decode_cache_stats();
   if (attrs) {
     op.xattrs.swap(*attrs);
 
@@ -1490,6 +1507,9 @@ void ECBackend::on_change()
     cache.release_write_pin(op.second.pin);
   }
   tid_to_op_map.clear();
+  // the new interval may roll back what we cached
+  cache.clear_clean();
+  update_clean_cache();
 
   for (map<ceph_tid_t, ReadOp>::iterator i = tid_to_read_map.begin();
        i != tid_to_read_map.end();
@@ -1915,19 +1935,194 @@ void ECBackend::start_rmw(Op *op, PGTransactionUPtr &&t)
     },
     get_parent()->get_dpp());
 
+  if (op->requires_rmw() &&
+      ec_impl->supports_parity_delta() &&
+      cct->_conf.get_val<bool>("osd_ec_parity_delta_writes")) {
+    ECTransaction::plan_parity_delta(
+      op->plan,
+      sinfo,
+      ec_impl,
+      get_parent()->get_dpp());
+  }
+
   dout(10) << __func__ << ": " << *op << dendl;
 
   waiting_state.push_back(*op);
   check_ops();
 }
 
+void ECBackend::start_remote_read(Op *op)
+{
+  ceph_assert(get_parent()->get_pool().allows_ecoverwrites());
+  objects_read_async_no_cache(
+    op->remote_read,
+    [this, op](map<hobject_t,pair<int, extent_map> > &&results) {
+      for (auto &&i: results) {
+	op->remote_read_result.emplace(i.first, i.second.second);
+      }
+      check_ops();
+    });
+}
+
+struct FinishParityDeltaRead :
+  public GenContext<pair<RecoveryMessages*, ECBackend::read_result_t& > &> {
+  ECBackend *ec;
+  ECBackend::Op *op;
+  hobject_t hoid;
+  FinishParityDeltaRead(ECBackend *ec, ECBackend::Op *op, const hobject_t &hoid)
+    : ec(ec), op(op), hoid(hoid) {}
+  void finish(pair<RecoveryMessages *, ECBackend::read_result_t &> &in) override {
+    ec->handle_parity_delta_read(op, hoid, in.second);
+  }
+};
+
+void ECBackend::start_parity_delta_read(Op *op)
+{
+  map<hobject_t, set<int>> want_to_read;
+  map<hobject_t, read_request_t> for_read_op;
+  for (auto i = op->plan.delta_shards.begin();
+       i != op->plan.delta_shards.end();
+       ) {
+    const hobject_t &hoid = i->first;
+    set<int> need = i->second;
+    for (unsigned j = ec_impl->get_data_chunk_count();
+	 j < ec_impl->get_chunk_count();
+	 ++j) {
+      need.insert(j);
+    }
+    set<int> have;
+    map<shard_id_t, pg_shard_t> avail;
+    get_all_avail_shards(hoid, set<pg_shard_t>(), have, avail, false);
+    if (!std::includes(have.begin(), have.end(), need.begin(), need.end())) {
+      dout(10) << __func__ << ": " << hoid << " needs shards " << need
+	       << " but only " << have << " are available, reading whole"
+	       << " stripes" << dendl;
+      i = op->plan.delta_shards.erase(i);
+      continue;
+    }
+    map<pg_shard_t, vector<pair<int, int>>> shards;
+    for (int shard : need) {
+      shards[avail[shard_id_t(shard)]].push_back(
+	make_pair(0, ec_impl->get_sub_chunk_count()));
+    }
+    list<boost::tuple<uint64_t, uint64_t, uint32_t> > to_read;
+    for (auto &&extent : op->plan.to_read.at(hoid)) {
+      to_read.emplace_back(extent.first, extent.second, 0);
+    }
+    for_read_op.emplace(
+      hoid,
+      read_request_t(
+	to_read,
+	shards,
+	false,
+	new FinishParityDeltaRead(this, op, hoid)));
+    want_to_read.emplace(hoid, std::move(need));
+    ++i;
+  }
+  // everything else is read the usual way once the deltas are in
+  for (auto &&[hoid, extents] : op->plan.to_read) {
+    if (!op->plan.delta_shards.count(hoid)) {
+      op->remote_read[hoid] = extents;
+    }
+  }
+  op->delta_reads_pending = for_read_op.size();
+  if (!for_read_op.empty()) {
+    start_read_op(
+      CEPH_MSG_PRIO_DEFAULT,
+      want_to_read,
+      for_read_op,
+      OpRequestRef(),
+      false, false);
+  } else if (!op->remote_read.empty()) {
+    start_remote_read(op);
+  }
+}
+
+void ECBackend::handle_parity_delta_read(
+  Op *op,
+  const hobject_t &hoid,
+  read_result_t &res)
+{
+  ceph_assert(op->delta_reads_pending);
+  set<int> need = op->plan.delta_shards.at(hoid);
+  for (unsigned j = ec_impl->get_data_chunk_count();
+       j < ec_impl->get_chunk_count();
+       ++j) {
+    need.insert(j);
+  }
+  bool ok = res.r == 0;
+  map<int, extent_map> chunks;
+  for (auto &&extent : res.returned) {
+    if (!ok) {
+      break;
+    }
+    uint64_t off = sinfo.aligned_logical_offset_to_chunk_offset(
+      extent.get<0>());
+    uint64_t len = sinfo.aligned_logical_offset_to_chunk_offset(
+      extent.get<1>());
+    set<int> got;
+    for (auto &&[shard, bl] : extent.get<2>()) {
+      if (need.count(shard.shard) && bl.length() == len) {
+	got.insert(shard.shard);
+	chunks[shard.shard].insert(off, len, bl);
+      }
+    }
+    // if a shard failed the read op fell back to other shards, which
+    // we have no use for
+    ok = got == need;
+  }
+  if (ok) {
+    op->delta_read_result[hoid] = std::move(chunks);
+  } else {
+    // safe for the same reason as the partial read, see
+    // try_state_to_reads()
+    dout(10) << __func__ << ": " << hoid << " partial read failed,"
+	     << " reading whole stripes" << dendl;
+    op->plan.delta_shards.erase(hoid);
+    op->remote_read[hoid] = op->plan.to_read.at(hoid);
+  }
+  if (--op->delta_reads_pending == 0 && !op->remote_read.empty()) {
+    start_remote_read(op);
+  }
+  check_ops();
+}
+
+bool ECBackend::reads_pending_commit(const Op *op) const
+{
+  for (auto &&i : waiting_commit) {
+    for (auto &&[hoid, extents] : op->plan.to_read) {
+      if (i.plan.will_write.count(hoid)) {
+	return true;
+      }
+    }
+  }
+  return false;
+}
+
 bool ECBackend::try_state_to_reads()
 {
   if (waiting_state.empty())
     return false;
 
   Op *op = &(waiting_state.front());
-  if (op->requires_rmw() && pipeline_state.cache_invalid()) {
+  if (op->parity_delta()) {
+    // deltas are taken against what the shards have, every write ahead
+    // of us to the objects we read must have been applied by them.
+    // This also covers the whole stripe reads we fall back to: nothing
+    // can enter waiting_commit ahead of us once we are in waiting_reads.
+    if (!waiting_reads.empty()) {
+      dout(20) << __func__ << ": blocking " << *op
+	       << " because it is a parity delta write behind pending reads"
+	       << dendl;
+      return false;
+    }
+    if (reads_pending_commit(op)) {
+      dout(20) << __func__ << ": blocking " << *op
+	       << " because it is a parity delta write behind uncommitted"
+	       << " writes to the same object" << dendl;
+      return false;
+    }
+  } else if (op->requires_rmw() && pipeline_state.cache_invalid()) {
     ceph_assert(get_parent()->get_pool().allows_ecoverwrites());
     dout(20) << __func__ << ": blocking " << *op
 	     << " because it requires an rmw and the cache is invalid "
@@ -1936,17 +2131,36 @@ bool ECBackend::try_state_to_reads()
     return false;
   }
 
-  if (!pipeline_state.caching_enabled()) {
+  if (op->parity_delta()) {
+    // the cache won't see the stripes we update, later rmws have to
+    // read them back from the shards
+    op->using_cache = false;
+    pipeline_state.invalidate();
+  } else if (!pipeline_state.caching_enabled()) {
     op->using_cache = false;
   } else if (op->invalidates_cache()) {
     dout(20) << __func__ << ": invalidating cache after this op"
 	     << dendl;
     pipeline_state.invalidate();
   }
+  if (op->plan.invalidates_clean) {
+    pipeline_state.drop_clean();
+  }
+  if (!pipeline_state.keeps_clean()) {
+    // cached stripes may be overwritten behind the cache's back or end
+    // up past the end of their object
+    cache.clear_clean();
+  }
 
   waiting_state.pop_front();
   waiting_reads.push_back(*op);
 
+  if (op->parity_delta()) {
+    dout(10) << __func__ << ": " << *op << dendl;
+    start_parity_delta_read(op);
+    return true;
+  }
+
   if (op->using_cache) {
     cache.open_write_pin(op->pin);
 
@@ -1966,6 +2180,10 @@ bool ECBackend::try_state_to_reads()
 
       extent_set pending_read = to_read_plan;
       pending_read.subtract(remote_read);
+      get_parent()->get_logger()->inc(
+	l_osd_ec_cache_hit_bytes, pending_read.size());
+      get_parent()->get_logger()->inc(
+	l_osd_ec_cache_miss_bytes, remote_read.size());
 
       if (!remote_read.empty()) {
 	op->remote_read[hpair.first] = std::move(remote_read);
@@ -1976,20 +2194,16 @@ bool ECBackend::try_state_to_reads()
     }
   } else {
     op->remote_read = op->plan.to_read;
+    for (auto &&hpair: op->remote_read) {
+      get_parent()->get_logger()->inc(
+	l_osd_ec_cache_miss_bytes, hpair.second.size());
+    }
   }
 
   dout(10) << __func__ << ": " << *op << dendl;
 
   if (!op->remote_read.empty()) {
-    ceph_assert(get_parent()->get_pool().allows_ecoverwrites());
-    objects_read_async_no_cache(
-      op->remote_read,
-      [this, op](map<hobject_t,pair<int, extent_map> > &&results) {
-	for (auto &&i: results) {
-	  op->remote_read_result.emplace(i.first, i.second.second);
-	}
-	check_ops();
-      });
+    start_remote_read(op);
   }
 
   return true;
@@ -2043,6 +2257,7 @@ bool ECBackend::try_reads_to_commit()
       get_parent()->get_info().pgid.pgid,
       sinfo,
       op->remote_read_result,
+      op->delta_read_result,
       op->log_entries,
       &written,
       &trans,
@@ -2068,6 +2283,12 @@ bool ECBackend::try_reads_to_commit()
 
   map<hobject_t,extent_set> written_set;
   for (auto &&i: written) {
+    if (op->plan.delta_shards.count(i.first)) {
+      // parity deltas are written per shard, not as logical stripes
+      ceph_assert(i.second.empty());
+      written_set[i.first] = op->plan.will_write.at(i.first);
+      continue;
+    }
     written_set[i.first] = i.second.get_interval_set();
   }
   dout(20) << __func__ << ": written_set: " << written_set << dendl;
@@ -2081,6 +2302,7 @@ bool ECBackend::try_reads_to_commit()
   }
   op->remote_read.clear();
   op->remote_read_result.clear();
+  op->delta_read_result.clear();
 
   ObjectStore::Transaction empty;
   bool should_write_local = false;
@@ -2194,7 +2416,11 @@ bool ECBackend::try_finish_rmw()
   }
 
   if (op->using_cache) {
-    cache.release_write_pin(op->pin);
+    cache.release_write_pin(
+      op->pin,
+      cache_budget &&
+      pipeline_state.keeps_clean() &&
+      get_parent()->get_pool().allows_ecoverwrites());
   }
   tid_to_op_map.erase(op->tid);
 
@@ -2213,6 +2439,41 @@ void ECBackend::check_ops()
   while (try_state_to_reads() ||
 	 try_reads_to_commit() ||
 	 try_finish_rmw());
+  update_clean_cache();
+}
+
+void ECBackend::update_decode_cache_stats()
+{
+  uint64_t hits, misses;
+  ec_impl->get_decode_cache_stats(&hits, &misses);
+  auto logger = get_parent()->get_logger();
+  if (hits > decode_cache_hits) {
+    logger->inc(l_osd_ec_decode_cache_hit, hits - decode_cache_hits);
+    decode_cache_hits = hits;
+  }
+  if (misses > decode_cache_misses) {
+    logger->inc(l_osd_ec_decode_cache_miss, misses - decode_cache_misses);
+    decode_cache_misses = misses;
+  }
+}
+
+void ECBackend::update_clean_cache()
+{
+  if (cache_budget) {
+    cache.trim_clean(cache_budget->get_share());
+  } else {
+    cache.clear_clean();
+  }
+  uint64_t bytes = cache.get_clean_bytes();
+  if (bytes == cache_clean_bytes) {
+    return;
+  }
+  dout(20) << __func__ << ": " << cache_clean_bytes << " -> " << bytes
+	   << dendl;
+  cache_budget->update(cache_clean_bytes, bytes);
+  cache_clean_bytes = bytes;
+  get_parent()->get_logger()->set(
+    l_osd_ec_cache_bytes, cache_budget->get_used_bytes());
 }
 
 int ECBackend::objects_read_sync(
@@ -2382,6 +2643,7 @@ struct CallClientContexts :
 	ec->ec_impl,
 	to_decode,
 	&bl);
+      ec->update_decode_cache_stats();
       if (r < 0) {
         res.r = r;
         goto out;
@@ -473,6 +473,7 @@ public:
     ECTransaction::WritePlan plan;
     bool requires_rmw() const { return !plan.to_read.empty(); }
     bool invalidates_cache() const { return plan.invalidates_cache; }
+    bool parity_delta() const { return !plan.delta_shards.empty(); }
 
     // must be true if requires_rmw(), must be false if invalidates_cache()
     bool using_cache = true;
@@ -481,8 +482,12 @@ public:
     std::map<hobject_t,extent_set> pending_read; // subset already being read
     std::map<hobject_t,extent_set> remote_read;  // subset we must read
     std::map<hobject_t,extent_map> remote_read_result;
+    unsigned delta_reads_pending = 0;
+    /// old chunks of the shards read for plan.delta_shards
+    std::map<hobject_t,std::map<int,extent_map>> delta_read_result;
     bool read_in_progress() const {
-      return !remote_read.empty() && remote_read_result.empty();
+      return delta_reads_pending ||
+	(!remote_read.empty() && remote_read_result.empty());
     }
 
     /// In progress write state.
@@ -511,8 +516,19 @@ public:
   friend ostream &operator<<(ostream &lhs, const Op &rhs);
 
   ExtentCache cache;
+  /// shared by the PGs of the OSD, may be null
+  std::shared_ptr<ExtentCacheBudget> cache_budget;
+  uint64_t cache_clean_bytes = 0;   ///< what we accounted to cache_budget
   std::map<ceph_tid_t, Op> tid_to_op_map; /// Owns Op structure
 
+  /// trim Clean extents to our share and update the shared accounting
+  void update_clean_cache();
+
+  uint64_t decode_cache_hits = 0;   ///< what we accounted to the perf counters
+  uint64_t decode_cache_misses = 0;
+  /// add the decode cache use of ec_impl since the last call to the perf counters
+  void update_decode_cache_stats();
+
   /**
    * We model the possible rmw states as a std::set of waitlists.
    * All writes at this time complete in order, so a write blocked
@@ -538,6 +554,7 @@ public:
       CACHE_VALID = 0,
       CACHE_INVALID = 1
     } pipeline_state = CACHE_VALID;
+    bool keep_clean = true;
   public:
     bool caching_enabled() const {
       return pipeline_state == CACHE_VALID;
@@ -545,11 +562,20 @@ public:
     bool cache_invalid() const {
       return !caching_enabled();
     }
+    /// may released extents stay cached, see ExtentCache::release_write_pin
+    bool keeps_clean() const {
+      return caching_enabled() && keep_clean;
+    }
     void invalidate() {
       pipeline_state = CACHE_INVALID;
     }
+    /// until the pipeline drains, e.g. after a delete or truncate
+    void drop_clean() {
+      keep_clean = false;
+    }
     void clear() {
       pipeline_state = CACHE_VALID;
+      keep_clean = true;
     }
     friend ostream &operator<<(ostream &lhs, const pipeline_state_t &rhs);
   } pipeline_state;
@@ -561,6 +587,15 @@ public:
   eversion_t completed_to;
   eversion_t committed_to;
   void start_rmw(Op *op, PGTransactionUPtr &&t);
+  void start_remote_read(Op *op);
+  friend struct FinishParityDeltaRead;
+  void start_parity_delta_read(Op *op);
+  void handle_parity_delta_read(
+    Op *op,
+    const hobject_t &hoid,
+    read_result_t &res);
+  /// true if an op waiting on its commit writes to any object op reads
+  bool reads_pending_commit(const Op *op) const;
   bool try_state_to_reads();
   bool try_reads_to_commit();
   bool try_finish_rmw();
@@ -640,7 +675,9 @@ public:
     ObjectStore *store,
     CephContext *cct,
     ceph::ErasureCodeInterfaceRef ec_impl,
-    uint64_t stripe_width);
+    uint64_t stripe_width,
+    std::shared_ptr<ExtentCacheBudget> cache_budget);
+  ~ECBackend() override;
 
   /// Returns to_read replicas sufficient to reconstruct want
   int get_min_avail_to_read_shards(
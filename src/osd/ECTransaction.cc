@@ -93,6 +93,140 @@ void encode_and_write(
   }
 }
 
+void delta_and_write(
+  pg_t pgid,
+  const hobject_t &oid,
+  const ECUtil::stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ecimpl,
+  const extent_map &to_write,
+  const map<int, extent_map> &old_chunks,
+  uint32_t flags,
+  map<shard_id_t, ObjectStore::Transaction> *transactions,
+  DoutPrefixProvider *dpp) {
+  const uint64_t k = ecimpl->get_data_chunk_count();
+  const uint64_t cs = sinfo.get_chunk_size();
+
+  auto get_old_chunk = [&](int shard, uint64_t chunk_off) {
+    auto i = old_chunks.find(shard);
+    ceph_assert(i != old_chunks.end());
+    auto chunk = i->second.intersect(chunk_off, cs);
+    ceph_assert(chunk.ext_count() == 1);
+    ceph_assert(chunk.begin().get_off() == chunk_off);
+    ceph_assert(chunk.begin().get_len() == cs);
+    return chunk.begin().get_val();
+  };
+
+  extent_set stripes;
+  for (auto &&extent : to_write) {
+    uint64_t start = sinfo.logical_to_prev_stripe_offset(extent.get_off());
+    uint64_t end = sinfo.logical_to_next_stripe_offset(
+      extent.get_off() + extent.get_len());
+    stripes.union_insert(start, end - start);
+  }
+  for (auto &&range : stripes) {
+    for (uint64_t stripe = range.first;
+	 stripe < range.first + range.second;
+	 stripe += sinfo.get_stripe_width()) {
+      uint64_t chunk_off = sinfo.aligned_logical_offset_to_chunk_offset(stripe);
+      map<int, bufferlist> new_data, deltas, parity;
+      for (uint64_t i = 0; i < k; ++i) {
+	uint64_t data_off = stripe + i * cs;
+	auto updates = to_write.intersect(data_off, cs);
+	if (updates.empty()) {
+	  continue;
+	}
+	bufferlist old_data = get_old_chunk(i, chunk_off);
+	bufferlist &data = new_data[i];
+	uint64_t pos = data_off;
+	for (auto &&u : updates) {
+	  if (u.get_off() > pos) {
+	    bufferlist keep;
+	    keep.substr_of(old_data, pos - data_off, u.get_off() - pos);
+	    data.claim_append(keep);
+	  }
+	  data.append(u.get_val());
+	  pos = u.get_off() + u.get_len();
+	}
+	if (pos < data_off + cs) {
+	  bufferlist keep;
+	  keep.substr_of(old_data, pos - data_off, data_off + cs - pos);
+	  data.claim_append(keep);
+	}
+	ceph_assert(data.length() == cs);
+	ecimpl->encode_delta(old_data, data, &deltas[i]);
+      }
+      if (new_data.empty()) {
+	continue;
+      }
+      for (uint64_t i = k; i < ecimpl->get_chunk_count(); ++i) {
+	// updated in place, do not scribble over the read buffers
+	bufferlist old_parity = get_old_chunk(i, chunk_off);
+	ceph::bufferptr p(ceph::buffer::create_page_aligned(cs));
+	old_parity.begin().copy(cs, p.c_str());
+	parity[i].push_back(std::move(p));
+      }
+      int r = ecimpl->apply_delta(deltas, &parity);
+      ceph_assert(r == 0);
+
+      ldpp_dout(dpp, 20) << __func__ << ": " << oid << " stripe " << stripe
+			 << " data shards " << new_data.size()
+			 << " via parity delta" << dendl;
+      new_data.merge(parity);
+      for (auto &&[shard, bl] : new_data) {
+	auto t = transactions->find(shard_id_t(shard));
+	ceph_assert(t != transactions->end());
+	t->second.write(
+	  coll_t(spg_t(pgid, t->first)),
+	  ghobject_t(oid, ghobject_t::NO_GEN, t->first),
+	  chunk_off,
+	  bl.length(),
+	  bl,
+	  flags);
+      }
+    }
+  }
+}
+
+void ECTransaction::plan_parity_delta(
+  WritePlan &plan,
+  const ECUtil::stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ecimpl,
+  DoutPrefixProvider *dpp)
+{
+  ceph_assert(plan.t);
+  const uint64_t k = ecimpl->get_data_chunk_count();
+  const uint64_t m = ecimpl->get_coding_chunk_count();
+  const uint64_t cs = sinfo.get_chunk_size();
+  for (auto &&[oid, to_read] : plan.to_read) {
+    auto opiter = plan.t->op_map.find(oid);
+    if (opiter == plan.t->op_map.end()) {
+      continue;
+    }
+    auto &op = opiter->second;
+    // plain overwrites of partial stripes only: no stripe is appended,
+    // truncated or written whole
+    if (!op.is_none() || op.truncate ||
+	!(plan.will_write.at(oid) == to_read)) {
+      continue;
+    }
+    set<int> shards;
+    for (auto &&extent : op.buffer_updates) {
+      for (uint64_t c = extent.get_off() / cs;
+	   c * cs < extent.get_off() + extent.get_len() &&
+	     shards.size() + m <= k;
+	   ++c) {
+	shards.insert(c % k);
+      }
+    }
+    if (shards.empty() || shards.size() + m > k) {
+      continue;
+    }
+    ldpp_dout(dpp, 20) << __func__ << ": " << oid << " data shards "
+		       << shards << dendl;
+    plan.delta_shards.emplace(oid, std::move(shards));
+  }
+}
+
 bool ECTransaction::requires_overwrite(
   uint64_t prev_size,
   const PGTransaction::ObjectOperation &op) {
@@ -112,6 +246,7 @@ void ECTransaction::generate_transactions(
   pg_t pgid,
   const ECUtil::stripe_info_t &sinfo,
   const map<hobject_t,extent_map> &partial_extents,
+  const map<hobject_t,map<int,extent_map>> &delta_chunks,
   vector<pg_log_entry_t> &entries,
   map<hobject_t,extent_map> *written_map,
   map<shard_id_t, ObjectStore::Transaction> *transactions,
@@ -558,6 +693,58 @@ void ECTransaction::generate_transactions(
       ldpp_dout(dpp, 20) << __func__ << ": to_overwrite: "
 			 << to_overwrite
 			 << dendl;
+      if (auto dciter = delta_chunks.find(oid);
+	  dciter != delta_chunks.end()) {
+	// partial stripes, only the chunks being written and the coding
+	// chunks were read
+	ceph_assert(plan.delta_shards.count(oid));
+	ceph_assert(to_overwrite == to_write);
+	extent_set stripes;
+	for (auto &&extent : to_overwrite) {
+	  uint64_t start =
+	    sinfo.logical_to_prev_stripe_offset(extent.get_off());
+	  stripes.union_insert(
+	    start,
+	    sinfo.logical_to_next_stripe_offset(
+	      extent.get_off() + extent.get_len()) - start);
+	}
+	if (entry) {
+	  if (rollback_extents.empty()) {
+	    for (auto &&st : *transactions) {
+	      st.second.touch(
+		coll_t(spg_t(pgid, st.first)),
+		ghobject_t(oid, entry->version.version, st.first));
+	    }
+	  }
+	  for (auto &&range : stripes) {
+	    uint64_t restore_from =
+	      sinfo.aligned_logical_offset_to_chunk_offset(range.first);
+	    uint64_t restore_len =
+	      sinfo.aligned_logical_offset_to_chunk_offset(range.second);
+	    rollback_extents.emplace_back(make_pair(restore_from, restore_len));
+	    for (auto &&st : *transactions) {
+	      st.second.clone_range(
+		coll_t(spg_t(pgid, st.first)),
+		ghobject_t(oid, ghobject_t::NO_GEN, st.first),
+		ghobject_t(oid, entry->version.version, st.first),
+		restore_from,
+		restore_len,
+		restore_from);
+	    }
+	  }
+	}
+	delta_and_write(
+	  pgid,
+	  oid,
+	  sinfo,
+	  ecimpl,
+	  to_overwrite,
+	  dciter->second,
+	  fadvise_flags,
+	  transactions,
+	  dpp);
+	to_overwrite.clear();
+      }
       for (auto &&extent: to_overwrite) {
 	ceph_assert(extent.get_off() + extent.get_len() <= append_after);
 	ceph_assert(sinfo.logical_offset_is_stripe_aligned(extent.get_off()));
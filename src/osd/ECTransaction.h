@@ -26,9 +26,15 @@ namespace ECTransaction {
   struct WritePlan {
     PGTransactionUPtr t;
     bool invalidates_cache = false; // Yes, both are possible
+    bool invalidates_clean = false; // deletes or truncates an object
     std::map<hobject_t,extent_set> to_read;
     std::map<hobject_t,extent_set> will_write; // superset of to_read
 
+    /// objects whose partial stripes in to_read are updated from parity
+    /// deltas, with the data shards the write touches: only those and
+    /// the coding shards are read and written
+    std::map<hobject_t,std::set<int>> delta_shards;
+
     std::map<hobject_t,ECUtil::HashInfoRef> hash_infos;
   };
 
@@ -56,6 +62,10 @@ namespace ECTransaction {
 			     << " to 0" << dendl;
 	  projected_size = 0;
 	}
+	if (i.second.deletes_first() || i.second.truncate) {
+	  // stripes cached past the new end must not be read back
+	  plan.invalidates_clean = true;
+	}
 
 	hobject_t source;
 	if (i.second.has_source(&source)) {
@@ -182,12 +192,25 @@ namespace ECTransaction {
     return plan;
   }
 
+  /**
+   * Fill in plan.delta_shards with the objects of the plan that only
+   * overwrite parts of existing stripes, touching at most k - m data
+   * shards of them, so that reading the old content of those and of
+   * the coding shards costs no more than reading the whole stripes.
+   */
+  void plan_parity_delta(
+    WritePlan &plan,
+    const ECUtil::stripe_info_t &sinfo,
+    ceph::ErasureCodeInterfaceRef &ecimpl,
+    DoutPrefixProvider *dpp);
+
   void generate_transactions(
     WritePlan &plan,
     ceph::ErasureCodeInterfaceRef &ecimpl,
     pg_t pgid,
     const ECUtil::stripe_info_t &sinfo,
     const std::map<hobject_t,extent_map> &partial_extents,
+    const std::map<hobject_t,std::map<int,extent_map>> &delta_chunks,
     std::vector<pg_log_entry_t> &entries,
     std::map<hobject_t,extent_map> *written,
     std::map<shard_id_t, ObjectStore::Transaction> *transactions,
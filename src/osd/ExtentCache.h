@@ -15,6 +15,8 @@
 #ifndef EXTENT_CACHE_H
 #define EXTENT_CACHE_H
 
+#include <algorithm>
+#include <atomic>
 #include <map>
 #include <list>
 #include <vector>
@@ -26,6 +28,7 @@
 #include "common/interval_map.h"
 #include "include/buffer.h"
 #include "common/hobject.h"
+#include "common/PriorityCache.h"
 
 /**
    ExtentCache
@@ -92,6 +95,19 @@
    All of the above suggests that there are 3 things users can
    ask of the cache corresponding to the 3 Write pipelines
    states.
+
+   Released extents may also be kept rather than destroyed, so that
+   sequential small writes to the same stripes do not read them back
+   from the shards over and over:
+
+   3) Clean:
+      - This extent has the data of the last write to it, it is not
+        pinned by any op and sits in an LRU list
+      - reserve_extents_for_rmw() pins it again, Clean -> Write Pinned
+      - trim_clean() evicts the least recently released ones
+
+   Callers are responsible for only keeping released extents when no
+   write could have bypassed the cache, see release_write_pin().
  */
 
 /// If someone wants these types, but not ExtentCache, move to another file
@@ -353,6 +369,7 @@ private:
     };
     pin_type_t pin_type = NONE;
     bool is_write() const { return pin_type == WRITE; }
+    uint64_t bytes = 0; ///< total length of the extents in pin_list
 
     pin_state(const pin_state &other) = delete;
     pin_state &operator=(const pin_state &other) = delete;
@@ -378,20 +395,39 @@ private:
     }
   };
 
-  void release_pin(pin_state &p) {
+  /// unpinned extents, least recently released first
+  pin_state clean;
+
+  void destroy_extent(extent *ext) {
+    std::unique_ptr<extent> extent(ext); // we now own this
+    ceph_assert(extent->parent_extent_set);
+    auto &eset = *(extent->parent_extent_set);
+    extent->unlink();
+    remove_and_destroy_if_empty(eset);
+  }
+
+  void release_pin(pin_state &p, bool keep) {
     for (auto iter = p.pin_list.begin(); iter != p.pin_list.end(); ) {
-      std::unique_ptr<extent> extent(&*iter); // we now own this
+      extent *ext = &*iter;
       iter++; // unlink will invalidate
-      ceph_assert(extent->parent_extent_set);
-      auto &eset = *(extent->parent_extent_set);
-      extent->unlink();
-      remove_and_destroy_if_empty(eset);
+      if (keep && ext->bl) {
+	ext->move(clean);
+      } else {
+	destroy_extent(ext);
+      }
     }
     p.tid = 0;
     p.pin_type = pin_state::NONE;
   }
 
 public:
+  ExtentCache() = default;
+  ExtentCache(const ExtentCache &) = delete;
+  ExtentCache &operator=(const ExtentCache &) = delete;
+  ~ExtentCache() {
+    clear_clean();
+  }
+
   class write_pin : private pin_state {
     friend class ExtentCache;
   private:
@@ -475,10 +511,33 @@ public:
 
   /**
    * Release all buffers pinned by pin
+   *
+   * With keep, the extents written by the op become Clean instead of
+   * being destroyed.  This is only correct if every write to their
+   * objects since they were pinned went through this cache.
    */
   void release_write_pin(
-    write_pin &pin) {
-    release_pin(pin);
+    write_pin &pin,
+    bool keep = false) {
+    release_pin(pin, keep);
+  }
+
+  /// Evict Clean extents, least recently released first, down to max bytes
+  void trim_clean(uint64_t max) {
+    while (clean.bytes > max) {
+      ceph_assert(!clean.pin_list.empty());
+      destroy_extent(&clean.pin_list.front());
+    }
+  }
+
+  /// Destroy all Clean extents, e.g. because a write bypassed the cache
+  void clear_clean() {
+    trim_clean(0);
+  }
+
+  /// Total length of the Clean extents
+  uint64_t get_clean_bytes() const {
+    return clean.bytes;
   }
 
   std::ostream &print(std::ostream &out) const;
@@ -486,4 +545,117 @@ public:
 
 std::ostream &operator <<(std::ostream &lhs, const ExtentCache &cache);
 
+/**
+ * ExtentCacheBudget
+ *
+ * Memory shared by the Clean extents of all the ExtentCaches of an OSD.
+ * Each cache trims itself to an equal share of the target, which is
+ * max_bytes unless the object store memory autotuner hands less to this
+ * PriCache.
+ */
+class ExtentCacheBudget : public PriorityCache::PriCache {
+  std::atomic<uint64_t> max_bytes;
+  std::atomic<uint64_t> target_bytes;
+  std::atomic<uint64_t> used_bytes = {0};
+  std::atomic<uint32_t> num_users = {0};   ///< caches holding Clean extents
+  std::atomic<uint32_t> num_backends = {0};  ///< EC PGs sharing the budget
+  std::atomic<bool> tuned = {false};       ///< sized by an autotuner
+
+  int64_t cache_bytes[PriorityCache::Priority::LAST+1] = {0};
+  int64_t committed_bytes = 0;
+  double cache_ratio;
+
+public:
+  ExtentCacheBudget(uint64_t max_bytes, double ratio)
+    : max_bytes(max_bytes), target_bytes(max_bytes), cache_ratio(ratio) {}
+
+  void set_max_bytes(uint64_t max) {
+    max_bytes = max;
+    if (!tuned || target_bytes > max) {
+      target_bytes = max;
+    }
+  }
+  uint64_t get_used_bytes() const {
+    return used_bytes;
+  }
+  void register_backend() {
+    ++num_backends;
+  }
+  void unregister_backend() {
+    --num_backends;
+  }
+  /// bytes of Clean extents a cache may keep
+  uint64_t get_share() const {
+    uint32_t n = num_users;
+    return target_bytes / std::max<uint32_t>(n, 1);
+  }
+  /// account for a cache going from prev to cur bytes of Clean extents
+  void update(uint64_t prev, uint64_t cur) {
+    if (prev == cur) {
+      return;
+    }
+    used_bytes += cur - prev;
+    if (prev == 0) {
+      ++num_users;
+    } else if (cur == 0) {
+      --num_users;
+    }
+  }
+
+  int64_t request_cache_bytes(
+    PriorityCache::Priority pri, uint64_t total_cache) const override {
+    if (pri != PriorityCache::Priority::PRI1) {
+      return 0;
+    }
+    // everything we hold was written recently
+    int64_t request = std::min<uint64_t>(used_bytes, max_bytes);
+    int64_t assigned = get_cache_bytes(pri);
+    return request > assigned ? request - assigned : 0;
+  }
+  int64_t get_cache_bytes(PriorityCache::Priority pri) const override {
+    return cache_bytes[pri];
+  }
+  int64_t get_cache_bytes() const override {
+    int64_t total = 0;
+    for (int i = 0; i < PriorityCache::Priority::LAST + 1; i++) {
+      total += cache_bytes[i];
+    }
+    return total;
+  }
+  void set_cache_bytes(PriorityCache::Priority pri, int64_t bytes) override {
+    cache_bytes[pri] = bytes;
+  }
+  void add_cache_bytes(PriorityCache::Priority pri, int64_t bytes) override {
+    cache_bytes[pri] += bytes;
+  }
+  int64_t commit_cache_size(uint64_t total_cache) override {
+    committed_bytes = std::min<int64_t>(
+      PriorityCache::get_chunk(get_cache_bytes(), total_cache), max_bytes);
+    target_bytes = committed_bytes;
+    tuned = true;
+    return committed_bytes;
+  }
+  int64_t get_committed_size() const override {
+    return committed_bytes;
+  }
+  double get_cache_ratio() const override {
+    // leave the memory to the other caches while disabled or unused, the
+    // headroom of get_chunk() lets us start caching again
+    return max_bytes && num_backends && used_bytes ? cache_ratio : 0;
+  }
+  void set_cache_ratio(double ratio) override {
+    cache_ratio = ratio;
+  }
+  std::string get_cache_name() const override {
+    return "EC Stripe Cache";
+  }
+  // no age bins, PRI1 covers it all
+  void shift_bins() override {}
+  void import_bins(const std::vector<uint64_t> &bins) override {}
+  void set_bins(PriorityCache::Priority pri, uint64_t end_bin) override {}
+  uint64_t get_bins(PriorityCache::Priority pri) const override {
+    return 0;
+  }
+};
+
 #endif
@@ -64,6 +64,7 @@
 #endif
 
 #include "PrimaryLogPG.h"
+#include "ExtentCache.h"
 
 #include "msg/Messenger.h"
 #include "msg/Message.h"
@@ -257,6 +258,9 @@ OSDService::OSDService(OSD *osd, ceph::async::io_context_pool& poolctx) :
   monc(osd->monc),
   osd_max_object_size(cct->_conf, "osd_max_object_size"),
   osd_skip_data_digest(cct->_conf, "osd_skip_data_digest"),
+  ec_cache_budget(std::make_shared<ExtentCacheBudget>(
+    cct->_conf.get_val<Option::size_t>("osd_ec_stripe_cache_size"),
+    cct->_conf.get_val<double>("osd_ec_stripe_cache_ratio"))),
   publish_lock{ceph::make_mutex("OSDService::publish_lock")},
   pre_publish_lock{ceph::make_mutex("OSDService::pre_publish_lock")},
   m_scrub_queue{cct, *this},
@@ -2387,6 +2391,8 @@ OSD::OSD(CephContext *cct_,
 
   // initialize shards
   num_shards = get_num_op_shards();
+  op_queue_steal_threshold =
+    cct->_conf.get_val<uint64_t>("osd_op_queue_steal_threshold");
   for (uint32_t i = 0; i < num_shards; i++) {
     OSDShard *one_shard = new OSDShard(
       i,
@@ -2903,6 +2909,30 @@ will start to track new ops received afterwards.";
     store->generate_db_histogram(f);
   } else if (prefix == "flush_store_cache") {
     store->flush_cache(&ss);
+  } else if (prefix == "objectstore_trace_start") {
+    string path;
+    cmd_getval(cmdmap, "path", path);
+    ret = store->trace_start(path);
+    if (ret < 0) {
+      ss << "unable to start tracing to '" << path << "': "
+	 << cpp_strerror(ret);
+      goto out;
+    }
+    ss << "tracing transactions to '" << path << "'";
+  } else if (prefix == "objectstore_trace_stop") {
+    uint64_t records = 0, bytes = 0;
+    ret = store->trace_stop(&records, &bytes);
+    if (ret == -ENOENT) {
+      ss << "not tracing";
+      goto out;
+    }
+    f->open_object_section("objectstore_trace");
+    f->dump_unsigned("records", records);
+    f->dump_unsigned("bytes", bytes);
+    if (ret < 0) {
+      f->dump_string("error", cpp_strerror(ret));
+    }
+    f->close_section();
   } else if (prefix == "rotate-stored-key") {
     store->write_meta("osd_key", inbl.to_str());
   } else if (prefix == "dump_pgstate_history") {
@@ -2919,6 +2949,28 @@ will start to track new ops received afterwards.";
     }
     f->close_section();
     f->close_section();
+  } else if (prefix == "dump_pg_log_mem") {
+    PGLog::IndexedLog::mem_usage_t total;
+    f->open_object_section("pg_log_mem");
+    f->open_array_section("pgs");
+    vector<PGRef> pgs;
+    _get_pgs(&pgs);
+    for (auto& pg : pgs) {
+      PGLog::IndexedLog::mem_usage_t usage;
+      pg->get_pg_log_mem_usage(&usage);
+      f->open_object_section("pg");
+      f->dump_stream("pg") << pg->pg_id;
+      usage.dump(f);
+      f->close_section();
+      total += usage;
+    }
+    f->close_section();
+    f->open_object_section("total");
+    total.dump(f);
+    f->close_section();
+    f->dump_unsigned("mempool_osd_pglog_bytes",
+		     mempool::osd_pglog::allocated_bytes());
+    f->close_section();
   } else if (prefix == "compact") {
     dout(1) << "triggering manual compaction" << dendl;
     auto start = ceph::coarse_mono_clock::now();
@@ -3625,6 +3677,7 @@ int OSD::init()
   journal_is_rotational = store->is_journal_rotational();
   dout(2) << "journal looks like " << (journal_is_rotational ? "hdd" : "ssd")
           << dendl;
+  store->add_priority_cache("ec_stripe", service.ec_cache_budget);
 
   enable_disable_fuse(false);
 
@@ -4106,6 +4159,15 @@ void OSD::final_init()
                                      asok_hook,
                                      "Flush bluestore internal cache");
   ceph_assert(r == 0);
+  r = admin_socket->register_command("objectstore_trace_start "
+				     "name=path,type=CephString",
+				     asok_hook,
+				     "Record objectstore transactions to a trace file");
+  ceph_assert(r == 0);
+  r = admin_socket->register_command("objectstore_trace_stop",
+				     asok_hook,
+				     "Stop recording objectstore transactions");
+  ceph_assert(r == 0);
   r = admin_socket->register_command("rotate-stored-key",
                                      asok_hook,
                                      "Update the stored osd_key");
@@ -4114,6 +4176,10 @@ void OSD::final_init()
 				     asok_hook,
 				     "show recent state history");
   ceph_assert(r == 0);
+  r = admin_socket->register_command("dump_pg_log_mem",
+				     asok_hook,
+				     "show pg log memory usage and bytes per entry");
+  ceph_assert(r == 0);
 
   r = admin_socket->register_command("compact",
 				     asok_hook,
@@ -9755,6 +9821,7 @@ const char** OSD::get_tracked_conf_keys() const
     "osd_object_clean_region_max_num_intervals",
     "osd_scrub_min_interval",
     "osd_scrub_max_interval",
+    "osd_ec_stripe_cache_size",
     NULL
   };
   return KEYS;
@@ -9871,6 +9938,11 @@ void OSD::handle_conf_change(const ConfigProxy& conf,
     ObjectCleanRegions::set_max_num_intervals(cct->_conf->osd_object_clean_region_max_num_intervals);
   }
 
+  if (changed.count("osd_ec_stripe_cache_size")) {
+    service.ec_cache_budget->set_max_bytes(
+      cct->_conf.get_val<Option::size_t>("osd_ec_stripe_cache_size"));
+  }
+
   if (changed.count("osd_scrub_min_interval") ||
       changed.count("osd_scrub_max_interval")) {
     resched_all_scrubs();
@@ -10497,6 +10569,7 @@ int OSDShard::_wake_pg_slot(
   }
   slot->waiting_peering.clear();
   ++slot->requeue_seq;
+  note_queued(count);
   return count;
 }
 
@@ -10721,6 +10794,14 @@ OSDShard::OSDShard(
     context_queue(sdata_wait_lock, sdata_cond)
 {
   dout(0) << "using op scheduler " << *scheduler << dendl;
+  logger = build_osd_shard_perf(cct, id);
+  cct->get_perfcounters_collection()->add(logger);
+}
+
+OSDShard::~OSDShard()
+{
+  cct->get_perfcounters_collection()->remove(logger);
+  delete logger;
 }
 
 
@@ -10766,6 +10847,14 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
   // callback.
   bool is_smallest_thread_index = thread_index < osd->num_shards;
 
+  // completions queued for this thread come first, they unblock clients
+  // and the shard's own ops
+  if (osd->op_queue_steal_threshold &&
+      !(is_smallest_thread_index && !sdata->context_queue.empty()) &&
+      _steal(sdata, hb)) {
+    return;
+  }
+
   // peek at spg_t
   sdata->shard_lock.lock();
   if (sdata->scheduler->empty() &&
@@ -10778,7 +10867,9 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       dout(20) << __func__ << " empty q, waiting" << dendl;
       osd->cct->get_heartbeat_map()->clear_timeout(hb);
       sdata->shard_lock.unlock();
+      ++sdata->idle_threads;
       sdata->sdata_cond.wait(wait_lock);
+      --sdata->idle_threads;
       wait_lock.unlock();
       sdata->shard_lock.lock();
       if (sdata->scheduler->empty() &&
@@ -10801,7 +10892,17 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
   if (is_smallest_thread_index) {
     sdata->context_queue.move_to(oncommits);
   }
+  _process_shard(sdata, is_smallest_thread_index, false, oncommits, hb);
+}
 
+bool OSD::ShardedOpWQ::_process_shard(
+  OSDShard *sdata,
+  bool is_smallest_thread_index,
+  bool stealing,
+  list<Context*>& oncommits,
+  heartbeat_handle_d *hb)
+{
+  const uint32_t shard_index = sdata->shard_id;  // for dout_prefix
   WorkItem work_item;
   while (!std::get_if<OpSchedulerItem>(&work_item)) {
     if (sdata->scheduler->empty()) {
@@ -10811,26 +10912,34 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
           dout(10) << __func__ << " discarding in-flight oncommit " << c << dendl;
           delete c;
         }
-        return;    // OSD shutdown, discard.
+        return false;    // OSD shutdown, discard.
       }
       sdata->shard_lock.unlock();
       handle_oncommits(oncommits);
-      return;
+      return false;
     }
 
     work_item = sdata->scheduler->dequeue();
+    if (std::get_if<OpSchedulerItem>(&work_item)) {
+      sdata->note_queued(-1);
+    }
     if (osd->is_stopping()) {
       sdata->shard_lock.unlock();
       for (auto c : oncommits) {
         dout(10) << __func__ << " discarding in-flight oncommit " << c << dendl;
         delete c;
       }
-      return;    // OSD shutdown, discard.
+      return false;    // OSD shutdown, discard.
     }
 
     // If the work item is scheduled in the future, wait until
     // the time returned in the dequeue response before retrying.
     if (auto when_ready = std::get_if<double>(&work_item)) {
+      if (stealing) {
+	// leave items scheduled in the future to the shard's own threads
+	sdata->shard_lock.unlock();
+	return false;
+      }
       if (is_smallest_thread_index) {
         sdata->shard_lock.unlock();
         handle_oncommits(oncommits);
@@ -10866,7 +10975,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       dout(10) << __func__ << " discarding in-flight oncommit " << c << dendl;
       delete c;
     }
-    return;    // OSD shutdown, discard.
+    return true;    // OSD shutdown, discard.
   }
 
   const auto token = item.get_ordering_token();
@@ -10907,7 +11016,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       pg->unlock();
       sdata->shard_lock.unlock();
       handle_oncommits(oncommits);
-      return;
+      return true;
     }
     slot = q->second.get();
     --slot->num_running;
@@ -10919,7 +11028,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       pg->unlock();
       sdata->shard_lock.unlock();
       handle_oncommits(oncommits);
-      return;
+      return true;
     }
     if (requeue_seq != slot->requeue_seq) {
       dout(20) << __func__ << " " << token
@@ -10929,7 +11038,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       pg->unlock();
       sdata->shard_lock.unlock();
       handle_oncommits(oncommits);
-      return;
+      return true;
     }
     if (slot->pg != pg) {
       // this can happen if we race with pg removal.
@@ -11028,12 +11137,12 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
 	sdata->shard_lock.unlock();
 	osd->service.release_reserved_pushes(pushes_to_free);
 	handle_oncommits(oncommits);
-	return;
+	return true;
       }
     }
     sdata->shard_lock.unlock();
     handle_oncommits(oncommits);
-    return;
+    return true;
   }
   if (qi.is_peering()) {
     OSDMapRef osdmap = sdata->shard_osdmap;
@@ -11042,7 +11151,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       sdata->shard_lock.unlock();
       pg->unlock();
       handle_oncommits(oncommits);
-      return;
+      return true;
     }
   }
   sdata->shard_lock.unlock();
@@ -11090,6 +11199,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
   }
 
   handle_oncommits(oncommits);
+  return true;
 }
 
 void OSD::ShardedOpWQ::_enqueue(OpSchedulerItem&& item) {
@@ -11111,6 +11221,7 @@ void OSD::ShardedOpWQ::_enqueue(OpSchedulerItem&& item) {
     std::lock_guard l{sdata->shard_lock};
     empty = sdata->scheduler->empty();
     sdata->scheduler->enqueue(std::move(item));
+    sdata->note_queued(1);
   }
 
   {
@@ -11121,6 +11232,60 @@ void OSD::ShardedOpWQ::_enqueue(OpSchedulerItem&& item) {
       sdata->sdata_cond.notify_one();
     }
   }
+
+  if (osd->op_queue_steal_threshold &&
+      sdata->queue_depth >= (int64_t)osd->op_queue_steal_threshold) {
+    _wake_idle_shard(sdata);
+  }
+}
+
+bool OSD::ShardedOpWQ::_steal(OSDShard *sdata, heartbeat_handle_d *hb)
+{
+  const uint32_t shard_index = sdata->shard_id;  // for dout_prefix
+  if (sdata->queue_depth > 0) {
+    return false;
+  }
+  // help the most backlogged shard
+  OSDShard *victim = nullptr;
+  int64_t max_depth = (int64_t)osd->op_queue_steal_threshold - 1;
+  for (auto s : osd->shards) {
+    int64_t depth = s->queue_depth;
+    if (s != sdata && depth > max_depth) {
+      victim = s;
+      max_depth = depth;
+    }
+  }
+  if (!victim) {
+    return false;
+  }
+  victim->shard_lock.lock();
+  if (victim->scheduler->empty()) {
+    victim->shard_lock.unlock();
+    return false;
+  }
+  dout(20) << __func__ << " " << sdata->shard_name << " helping "
+	   << victim->shard_name << " queue_depth " << max_depth << dendl;
+  // the item runs through the victim's pg slot and is ordered against its
+  // own threads there; completions stay with the victim's threads
+  list<Context*> oncommits;
+  if (!_process_shard(victim, false, true, oncommits, hb)) {
+    // only items scheduled in the future, wait for work of our own
+    return false;
+  }
+  victim->logger->inc(l_osd_shard_stolen);
+  sdata->logger->inc(l_osd_shard_steals);
+  return true;
+}
+
+void OSD::ShardedOpWQ::_wake_idle_shard(OSDShard *sdata)
+{
+  for (auto s : osd->shards) {
+    if (s != sdata && s->idle_threads > 0) {
+      std::lock_guard l{s->sdata_wait_lock};
+      s->sdata_cond.notify_one();
+      return;
+    }
+  }
 }
 
 void OSD::ShardedOpWQ::_enqueue_front(OpSchedulerItem&& item)
@@ -11151,6 +11316,7 @@ void OSD::ShardedOpWQ::_enqueue_front(OpSchedulerItem&& item)
     dout(20) << __func__ << " " << item << dendl;
   }
   sdata->scheduler->enqueue_front(std::move(item));
+  sdata->note_queued(1);
   sdata->shard_lock.unlock();
   std::lock_guard l{sdata->sdata_wait_lock};
   sdata->sdata_cond.notify_one();
@@ -11170,6 +11336,7 @@ void OSD::ShardedOpWQ::stop_for_fast_shutdown()
       auto work_item = sdata->scheduler->dequeue();
       work_count++;
     }
+    sdata->note_queued(-sdata->queue_depth);
     sdata->shard_lock.unlock();
   }
 }
@@ -79,6 +79,7 @@ class KeyStore;
 
 class Watch;
 class PrimaryLogPG;
+class ExtentCacheBudget;
 
 class TestOpsSocketHook;
 struct C_FinishSplits;
@@ -116,6 +117,9 @@ public:
   md_config_cacher_t<Option::size_t> osd_max_object_size;
   md_config_cacher_t<bool> osd_skip_data_digest;
 
+  /// memory for the stripes EC PGs keep cached after writes
+  std::shared_ptr<ExtentCacheBudget> ec_cache_budget;
+
   void enqueue_back(OpSchedulerItem&& qi);
   void enqueue_front(OpSchedulerItem&& qi);
 
@@ -980,6 +984,17 @@ struct OSDShard {
   ceph::mutex sdata_wait_lock;
   ceph::condition_variable sdata_cond;
   int waiting_threads = 0;
+  /// threads waiting for work with an empty queue, see _wake_idle_shard()
+  std::atomic<int> idle_threads = {0};
+
+  /// items in scheduler, readable without shard_lock to pick a shard to
+  /// steal work from
+  std::atomic<int64_t> queue_depth = {0};
+  PerfCounters *logger = nullptr;
+
+  void note_queued(int64_t n) {
+    logger->set(l_osd_shard_queue_depth, queue_depth += n);
+  }
 
   ceph::mutex osdmap_lock;  ///< protect shard_osdmap updates vs users w/o shard_lock
   OSDMapRef shard_osdmap;
@@ -1056,6 +1071,7 @@ struct OSDShard {
     int id,
     CephContext *cct,
     OSD *osd);
+  ~OSDShard();
 };
 
 class OSD : public Dispatcher,
@@ -1590,6 +1606,21 @@ protected:
     /// try to do some work
     void _process(uint32_t thread_index, ceph::heartbeat_handle_d *hb) override;
 
+    /**
+     * dequeue and run an item of sdata, called with shard_lock held
+     *
+     * @return false if no item was dequeued
+     */
+    bool _process_shard(OSDShard *sdata,
+			bool is_smallest_thread_index,
+			bool stealing,
+			std::list<Context*>& oncommits,
+			ceph::heartbeat_handle_d *hb);
+    /// run an item of a backlogged shard if we have nothing to do
+    bool _steal(OSDShard *sdata, ceph::heartbeat_handle_d *hb);
+    /// wake an idle thread of another shard to help sdata
+    void _wake_idle_shard(OSDShard *sdata);
+
     void stop_for_fast_shutdown();
 
     /// enqueue a new item
@@ -1732,6 +1763,7 @@ public:
   // -- shards --
   std::vector<OSDShard*> shards;
   uint32_t num_shards = 0;
+  uint64_t op_queue_steal_threshold = 0;  ///< 0 if work stealing is off
 
   void inc_num_pgs() {
     ++num_pgs;
@@ -962,12 +962,19 @@ void PG::prepare_write(
       this);
     ceph_assert(ret == 0);
   }
+  PGLog::write_stats_t stats;
   pglog.write_log_and_missing(
-    t, &km, coll, pgmeta_oid, pool.info.require_rollback());
+    t, &km, coll, pgmeta_oid, pool.info.require_rollback(), &stats);
   if (!km.empty())
     t.omap_setkeys(coll, pgmeta_oid, km);
-  if (!key_to_remove.empty())
+  if (!key_to_remove.empty()) {
     t.omap_rmkey(coll, pgmeta_oid, key_to_remove);
+    ++stats.keys_removed;
+  }
+  osd->logger->inc(l_osd_pg_meta_keys_written, km.size());
+  osd->logger->inc(l_osd_pg_meta_keys_removed, stats.keys_removed);
+  osd->logger->inc(l_osd_pg_meta_key_ranges_removed,
+		   stats.key_ranges_removed);
 }
 
 #pragma GCC diagnostic ignored "-Wpragmas"
@@ -2802,6 +2809,12 @@ void PG::dump_pgstate_history(Formatter *f)
   recovery_state.dump_history(f);
 }
 
+void PG::get_pg_log_mem_usage(PGLog::IndexedLog::mem_usage_t *usage)
+{
+  std::scoped_lock l{*this};
+  recovery_state.get_pg_log().get_log().get_mem_usage(usage);
+}
+
 void PG::dump_missing(Formatter *f)
 {
   for (auto& i : recovery_state.get_pg_log().get_missing().get_items()) {
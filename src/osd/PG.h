@@ -692,6 +692,7 @@ public:
   virtual void get_watchers(std::list<obj_watch_item_t> *ls) = 0;
 
   void dump_pgstate_history(ceph::Formatter *f);
+  void get_pg_log_mem_usage(PGLog::IndexedLog::mem_usage_t *usage);
   void dump_missing(ceph::Formatter *f);
 
   void with_pg_stats(ceph::coarse_real_clock::time_point now_is,
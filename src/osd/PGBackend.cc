@@ -574,7 +574,8 @@ PGBackend *PGBackend::build_pg_backend(
   coll_t coll,
   ObjectStore::CollectionHandle &ch,
   ObjectStore *store,
-  CephContext *cct)
+  CephContext *cct,
+  std::shared_ptr<ExtentCacheBudget> ec_cache_budget)
 {
   ErasureCodeProfile ec_profile = profile;
   switch (pool.type) {
@@ -598,7 +599,8 @@ PGBackend *PGBackend::build_pg_backend(
       store,
       cct,
       ec_impl,
-      pool.stripe_width);
+      pool.stripe_width,
+      ec_cache_budget);
   }
   default:
     ceph_abort();
@@ -35,6 +35,7 @@ struct inconsistent_obj_wrapper;
 
 //forward declaration
 class OSDMap;
+class ExtentCacheBudget;
 class PGLog;
 typedef std::shared_ptr<const OSDMap> OSDMapRef;
 
@@ -601,7 +602,8 @@ typedef std::shared_ptr<const OSDMap> OSDMapRef;
      coll_t coll,
      ObjectStore::CollectionHandle &ch,
      ObjectStore *store,
-     CephContext *cct);
+     CephContext *cct,
+     std::shared_ptr<ExtentCacheBudget> ec_cache_budget);
 };
 
 #endif
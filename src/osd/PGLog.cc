@@ -160,6 +160,76 @@ void PGLog::IndexedLog::trim(
 				 << " s=" << s << dendl;
 }
 
+static uint64_t heap_bytes(const string& s)
+{
+  // short strings live in the string object itself
+  return s.capacity() > 15 ? s.capacity() + 1 : 0;
+}
+
+static uint64_t heap_bytes(const hobject_t& oid)
+{
+  return heap_bytes(oid.oid.name) + heap_bytes(oid.get_key()) +
+    heap_bytes(oid.nspace);
+}
+
+static uint64_t heap_bytes(const std::vector<pg_log_op_return_item_t>& v)
+{
+  uint64_t bytes = v.capacity() * sizeof(pg_log_op_return_item_t);
+  for (auto& i : v) {
+    bytes += i.bl.length();
+  }
+  return bytes;
+}
+
+void PGLog::IndexedLog::get_mem_usage(mem_usage_t *usage) const
+{
+  // list nodes carry two pointers besides the value
+  constexpr uint64_t list_node = 2 * sizeof(void*);
+  // unordered_multimap node: next pointer, value and cached hash
+  constexpr uint64_t hash_node = sizeof(void*) +
+    sizeof(std::pair<const osd_reqid_t, pg_log_entry_t*>) + sizeof(size_t);
+  // rb tree node: color, parent, left, right and the value
+  constexpr uint64_t map_node = 4 * sizeof(void*) +
+    sizeof(std::pair<const uint32_t, int>);
+
+  for (auto& e : log) {
+    usage->entry_bytes += list_node + sizeof(e) +
+      heap_bytes(e.soid) +
+      e.mod_desc.bl.length() +
+      e.snaps.length() +
+      e.extra_reqids.capacity() * sizeof(e.extra_reqids[0]) +
+      e.extra_reqid_return_codes.size() * map_node +
+      heap_bytes(e.op_returns);
+  }
+  for (auto& d : dups) {
+    usage->dup_bytes += list_node + sizeof(d) + heap_bytes(d.op_returns);
+  }
+  usage->entries += log.size();
+  usage->dups += dups.size();
+  usage->index_bytes += objects.get_mem_usage() +
+    caller_ops.get_mem_usage() +
+    dup_index.get_mem_usage() +
+    extra_caller_ops.size() * hash_node +
+    extra_caller_ops.bucket_count() * sizeof(void*);
+}
+
+void PGLog::IndexedLog::mem_usage_t::dump(ceph::Formatter *f) const
+{
+  f->dump_unsigned("entries", entries);
+  f->dump_unsigned("dups", dups);
+  f->dump_unsigned("entry_bytes", entry_bytes);
+  f->dump_unsigned("dup_bytes", dup_bytes);
+  f->dump_unsigned("index_bytes", index_bytes);
+  f->dump_unsigned("total_bytes", entry_bytes + dup_bytes + index_bytes);
+  // index bytes cover both the entries and the dups
+  f->dump_float("bytes_per_entry",
+		entries ? double(entry_bytes) / entries : 0);
+  f->dump_float("bytes_per_dup",
+		dups ? double(dup_bytes) / dups : 0);
+  f->dump_float("index_bytes_per_item",
+		entries + dups ? double(index_bytes) / (entries + dups) : 0);
+}
+
 ostream& PGLog::IndexedLog::print(ostream& out) const
 {
   out << *this << std::endl;
@@ -635,7 +705,8 @@ void PGLog::write_log_and_missing(
   map<string,bufferlist> *km,
   const coll_t& coll,
   const ghobject_t &log_oid,
-  bool require_rollback)
+  bool require_rollback,
+  write_stats_t *stats)
 {
   if (needs_write()) {
     dout(6) << "write_log_and_missing with: "
@@ -662,6 +733,8 @@ void PGLog::write_log_and_missing(
       write_from_dups,
       &may_include_deletes_in_missing_dirty,
       (pg_log_debug ? &log_keys_debug : nullptr),
+      cct->_conf->osd_pg_log_trim_range_delete,
+      stats,
       this);
     undirty();
   } else {
@@ -711,7 +784,7 @@ void PGLog::write_log_and_missing(
     eversion_t::max(),
     eversion_t(),
     eversion_t(),
-    may_include_deletes_in_missing_dirty, nullptr, dpp);
+    may_include_deletes_in_missing_dirty, nullptr, false, nullptr, dpp);
 }
 
 // static
@@ -865,6 +938,8 @@ void PGLog::_write_log_and_missing(
   eversion_t write_from_dups,
   bool *may_include_deletes_in_missing_dirty, // in/out param
   set<string> *log_keys_debug,
+  bool trim_range,
+  write_stats_t *stats,
   const DoutPrefixProvider *dpp
   ) {
   ldpp_dout(dpp, 10) << __func__ << " clearing up to " << dirty_to
@@ -873,7 +948,17 @@ void PGLog::_write_log_and_missing(
 		     << " write_from_dups=" << write_from_dups
 		     << " trimmed_dups.size()=" << trimmed_dups.size() << dendl;
   set<string> to_remove;
-  to_remove.swap(trimmed_dups);
+  // trimming always removes the oldest entries and dups, so with
+  // trim_range everything up to the newest trimmed key goes at once
+  // rather than key by key
+  map<string, string> remove_ranges;
+  if (trim_range && !trimmed_dups.empty()) {
+    remove_ranges.emplace(pg_log_dup_t().get_key_name(),
+			  *trimmed_dups.rbegin() + '\0');
+    trimmed_dups.clear();
+  } else {
+    to_remove.swap(trimmed_dups);
+  }
   for (auto& t : trimmed) {
     string key = t.get_key_name();
     if (log_keys_debug) {
@@ -881,7 +966,14 @@ void PGLog::_write_log_and_missing(
       ceph_assert(it != log_keys_debug->end());
       log_keys_debug->erase(it);
     }
-    to_remove.emplace(std::move(key));
+    if (!trim_range) {
+      to_remove.emplace(std::move(key));
+    }
+  }
+  if (trim_range && !trimmed.empty()) {
+    eversion_t last = *trimmed.rbegin();
+    ++last.version;
+    remove_ranges.emplace(eversion_t().get_key_name(), last.get_key_name());
   }
   trimmed.clear();
 
@@ -892,6 +984,9 @@ void PGLog::_write_log_and_missing(
       coll, log_oid,
       eversion_t().get_key_name(), dirty_to.get_key_name());
     clear_up_to(log_keys_debug, dirty_to.get_key_name());
+    if (stats) {
+      ++stats->key_ranges_removed;
+    }
   }
   if (dirty_to != eversion_t::max() && dirty_from != eversion_t::max()) {
     ldpp_dout(dpp, 10) << "write_log_and_missing, clearing from "
@@ -900,6 +995,9 @@ void PGLog::_write_log_and_missing(
       coll, log_oid,
       dirty_from.get_key_name(), eversion_t::max().get_key_name());
     clear_after(log_keys_debug, dirty_from.get_key_name());
+    if (stats) {
+      ++stats->key_ranges_removed;
+    }
   }
 
   for (auto p = log.log.begin();
@@ -941,6 +1039,9 @@ void PGLog::_write_log_and_missing(
     t.omap_rmkeyrange(
       coll, log_oid,
       min.get_key_name(), dirty_to_dup.get_key_name());
+    if (stats) {
+      ++stats->key_ranges_removed;
+    }
   }
   if (dirty_to_dups != eversion_t::max() && dirty_from_dups != eversion_t::max()) {
     pg_log_dup_t max, dirty_from_dup;
@@ -952,6 +1053,9 @@ void PGLog::_write_log_and_missing(
     t.omap_rmkeyrange(
       coll, log_oid,
       dirty_from_dup.get_key_name(), max.get_key_name());
+    if (stats) {
+      ++stats->key_ranges_removed;
+    }
   }
 
   ldpp_dout(dpp, 10) << __func__ << " going to encode log.dups.size()="
@@ -1008,8 +1112,19 @@ void PGLog::_write_log_and_missing(
       (*km)["rollback_info_trimmed_to"]);
   }
 
+  // same place in the transaction as the point deletes they replace,
+  // i.e. before the caller sets the keys in km
+  for (auto& [first, last] : remove_ranges) {
+    ldpp_dout(dpp, 10) << __func__ << " trim range " << first
+		       << " to " << last << dendl;
+    t.omap_rmkeyrange(coll, log_oid, first, last);
+  }
   if (!to_remove.empty())
     t.omap_rmkeys(coll, log_oid, to_remove);
+  if (stats) {
+    stats->keys_removed += to_remove.size();
+    stats->key_ranges_removed += remove_ranges.size();
+  }
   ldpp_dout(dpp, 10) << "end of " << __func__ << dendl;
 }
 
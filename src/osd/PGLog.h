@@ -20,6 +20,7 @@
 #include "include/ceph_assert.h"
 #include "include/common_fwd.h"
 #include "osd_types.h"
+#include "PGLogIndex.h"
 #include "os/ObjectStore.h"
 #include <list>
 
@@ -146,10 +147,14 @@ public:
    * plus some methods to manipulate it all.
    */
   struct IndexedLog : public pg_log_t {
-    mutable ceph::unordered_map<hobject_t,pg_log_entry_t*> objects;  // ptrs into log.  be careful!
-    mutable ceph::unordered_map<osd_reqid_t,pg_log_entry_t*> caller_ops;
+    // ptrs into log.  be careful!
+    mutable PGLogIndex<hobject_t, pg_log_entry_t,
+		       &pg_log_entry_t::soid> objects;
+    mutable PGLogIndex<osd_reqid_t, pg_log_entry_t,
+		       &pg_log_entry_t::reqid> caller_ops;
     mutable ceph::unordered_multimap<osd_reqid_t,pg_log_entry_t*> extra_caller_ops;
-    mutable ceph::unordered_map<osd_reqid_t,pg_log_dup_t*> dup_index;
+    mutable PGLogIndex<osd_reqid_t, pg_log_dup_t,
+		       &pg_log_dup_t::reqid> dup_index;
 
     // recovery pointers
     std::list<pg_log_entry_t>::iterator complete_to; // not inclusive of referenced item
@@ -363,20 +368,20 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS)) {
         index_extra_caller_ops();
       }
-      p = extra_caller_ops.find(r);
-      if (p != extra_caller_ops.end()) {
+      auto e = extra_caller_ops.find(r);
+      if (e != extra_caller_ops.end()) {
 	uint32_t idx = 0;
-	for (auto i = p->second->extra_reqids.begin();
-	     i != p->second->extra_reqids.end();
+	for (auto i = e->second->extra_reqids.begin();
+	     i != e->second->extra_reqids.end();
 	     ++idx, ++i) {
 	  if (i->first == r) {
-	    *version = p->second->version;
+	    *version = e->second->version;
 	    *user_version = i->second;
-	    *return_code = p->second->return_code;
-	    *op_returns = p->second->op_returns;
+	    *return_code = e->second->return_code;
+	    *op_returns = e->second->op_returns;
 	    if (*return_code >= 0) {
-	      auto it = p->second->extra_reqid_return_codes.find(idx);
-	      if (it != p->second->extra_reqid_return_codes.end()) {
+	      auto it = e->second->extra_reqid_return_codes.find(idx);
+	      if (it != e->second->extra_reqid_return_codes.end()) {
 		*return_code = it->second;
 	      }
 	    }
@@ -459,7 +464,7 @@ public:
       if (to_index & PGLOG_INDEXED_DUPS) {
 	dup_index.clear();
 	for (auto& i : dups) {
-	  dup_index[i.reqid] = const_cast<pg_log_dup_t*>(&i);
+	  dup_index.insert_or_assign(const_cast<pg_log_dup_t*>(&i));
 	}
       }
 
@@ -472,13 +477,13 @@ public:
 	for (auto i = log.begin(); i != log.end(); ++i) {
 	  if (to_index & PGLOG_INDEXED_OBJECTS) {
 	    if (i->object_is_indexed()) {
-	      objects[i->soid] = const_cast<pg_log_entry_t*>(&(*i));
+	      objects.insert_or_assign(const_cast<pg_log_entry_t*>(&(*i)));
 	    }
 	  }
 
 	  if (to_index & PGLOG_INDEXED_CALLER_OPS) {
 	    if (i->reqid_is_indexed()) {
-	      caller_ops[i->reqid] = const_cast<pg_log_entry_t*>(&(*i));
+	      caller_ops.insert_or_assign(const_cast<pg_log_entry_t*>(&(*i)));
 	    }
 	  }
 
@@ -514,14 +519,15 @@ public:
 
     void index(pg_log_entry_t& e) {
       if ((indexed_data & PGLOG_INDEXED_OBJECTS) && e.object_is_indexed()) {
-        if (objects.count(e.soid) == 0 ||
-            objects[e.soid]->version < e.version)
-          objects[e.soid] = &e;
+        auto it = objects.find(e.soid);
+        if (it == objects.end() ||
+            it->second->version < e.version)
+          objects.insert_or_assign(&e);
       }
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
 	// divergent merge_log indexes new before unindexing old
         if (e.reqid_is_indexed()) {
-	  caller_ops[e.reqid] = &e;
+	  caller_ops.insert_or_assign(&e);
         }
       }
       if (indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS) {
@@ -574,7 +580,7 @@ public:
 
     void index(pg_log_dup_t& e) {
       if (indexed_data & PGLOG_INDEXED_DUPS) {
-	dup_index[e.reqid] = &e;
+	dup_index.insert_or_assign(&e);
       }
     }
 
@@ -609,11 +615,11 @@ public:
 
       // to our index
       if ((indexed_data & PGLOG_INDEXED_OBJECTS) && e.object_is_indexed()) {
-        objects[e.soid] = &(log.back());
+        objects.insert_or_assign(&(log.back()));
       }
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
         if (e.reqid_is_indexed()) {
-	  caller_ops[e.reqid] = &(log.back());
+	  caller_ops.insert_or_assign(&(log.back()));
         }
       }
 
@@ -638,6 +644,26 @@ public:
       eversion_t *write_from_dups);
 
     std::ostream& print(std::ostream& out) const;
+
+    /// approximate memory used by the log, its dups and indexes
+    struct mem_usage_t {
+      uint64_t entries = 0;
+      uint64_t dups = 0;
+      uint64_t entry_bytes = 0;
+      uint64_t dup_bytes = 0;
+      uint64_t index_bytes = 0;
+
+      mem_usage_t& operator+=(const mem_usage_t& rhs) {
+	entries += rhs.entries;
+	dups += rhs.dups;
+	entry_bytes += rhs.entry_bytes;
+	dup_bytes += rhs.dup_bytes;
+	index_bytes += rhs.index_bytes;
+	return *this;
+      }
+      void dump(ceph::Formatter *f) const;
+    };
+    void get_mem_usage(mem_usage_t *usage) const;
   }; // IndexedLog
 
 
@@ -1328,12 +1354,19 @@ public:
     return invalidate_stats;
   }
 
+  /// omap key removals issued by a log write-out
+  struct write_stats_t {
+    uint64_t keys_removed = 0;
+    uint64_t key_ranges_removed = 0;
+  };
+
   void write_log_and_missing(
     ObjectStore::Transaction& t,
     std::map<std::string,ceph::buffer::list> *km,
     const coll_t& coll,
     const ghobject_t &log_oid,
-    bool require_rollback);
+    bool require_rollback,
+    write_stats_t *stats = nullptr);
 
   static void write_log_and_missing_wo_missing(
     ObjectStore::Transaction& t,
@@ -1393,6 +1426,8 @@ public:
     eversion_t write_from_dups,
     bool *may_include_deletes_in_missing_dirty,
     std::set<std::string> *log_keys_debug,
+    bool trim_range,
+    write_stats_t *stats,
     const DoutPrefixProvider *dpp = nullptr
     );
 
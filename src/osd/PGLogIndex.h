@@ -0,0 +1,222 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+#include "include/ceph_assert.h"
+#include "include/mempool.h"
+
+/**
+ * PGLogIndex
+ *
+ * Open addressing index of pg log entries (or dups) by one of their
+ * members, e.g. pg_log_entry_t::soid.  A node based hash map copies the
+ * key into a heap node for every entry, which for hobject_t keys costs
+ * more than the log entry itself.  This one only keeps a packed array of
+ * (hash, pointer) slots, linear probing and backward shift deletion, and
+ * reads the key through the pointer.
+ *
+ * Keys are only compared, and hence entries only dereferenced, for
+ * slots whose hash matches the one looked up, so indexed entries must
+ * stay alive until they are erased, as for the maps it replaces.
+ *
+ * Lookups return iterators whose value has the std::pair like members
+ * first (the key) and second (the entry pointer).
+ */
+template <typename K, typename V, K V::*key>
+class PGLogIndex {
+  struct slot_t {
+    uint64_t hash = 0;
+    V *v = nullptr;
+  };
+  mempool::osd_pglog::vector<slot_t> slots;  ///< empty or a power of 2
+  size_t num = 0;
+
+  static constexpr size_t MIN_SLOTS = 16;
+
+  static uint64_t hash_key(const K& k) {
+    // std::hash<osd_reqid_t> is barely more than the tid, mix it up
+    // before masking off the high bits (murmur3 finalizer)
+    uint64_t h = std::hash<K>{}(k);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+  size_t mask() const {
+    return slots.size() - 1;
+  }
+  size_t _find(const K& k, uint64_t h) const {
+    if (slots.empty()) {
+      return npos;
+    }
+    for (size_t i = h & mask(); slots[i].v; i = (i + 1) & mask()) {
+      if (slots[i].hash == h && slots[i].v->*key == k) {
+	return i;
+      }
+    }
+    return npos;
+  }
+  void _rehash(size_t n) {
+    mempool::osd_pglog::vector<slot_t> old(n);
+    old.swap(slots);
+    for (auto& s : old) {
+      if (s.v) {
+	size_t i = s.hash & mask();
+	while (slots[i].v) {
+	  i = (i + 1) & mask();
+	}
+	slots[i] = s;
+      }
+    }
+  }
+
+public:
+  static constexpr size_t npos = SIZE_MAX;
+
+  struct value_type {
+    const K& first;
+    V *second;
+  };
+
+  class iterator {
+    const PGLogIndex *index = nullptr;
+    size_t pos = npos;
+    friend class PGLogIndex;
+
+    struct arrow_t {
+      value_type v;
+      const value_type *operator->() const {
+	return &v;
+      }
+    };
+
+    void skip_empty() {
+      while (pos < index->slots.size() && !index->slots[pos].v) {
+	++pos;
+      }
+      if (pos >= index->slots.size()) {
+	pos = npos;
+      }
+    }
+  public:
+    iterator() = default;
+    iterator(const PGLogIndex *index, size_t pos) : index(index), pos(pos) {}
+
+    value_type operator*() const {
+      V *v = index->slots[pos].v;
+      return value_type{v->*key, v};
+    }
+    arrow_t operator->() const {
+      return arrow_t{**this};
+    }
+    iterator& operator++() {
+      ++pos;
+      skip_empty();
+      return *this;
+    }
+    bool operator==(const iterator& rhs) const {
+      return pos == rhs.pos;
+    }
+    bool operator!=(const iterator& rhs) const {
+      return pos != rhs.pos;
+    }
+  };
+  using const_iterator = iterator;
+
+  size_t size() const {
+    return num;
+  }
+  bool empty() const {
+    return num == 0;
+  }
+  /// bytes used by the index itself
+  size_t get_mem_usage() const {
+    return slots.capacity() * sizeof(slot_t);
+  }
+
+  iterator begin() const {
+    iterator it(this, 0);
+    if (slots.empty()) {
+      it.pos = npos;
+    } else {
+      it.skip_empty();
+    }
+    return it;
+  }
+  iterator end() const {
+    return iterator(this, npos);
+  }
+  iterator find(const K& k) const {
+    return iterator(this, _find(k, hash_key(k)));
+  }
+  size_t count(const K& k) const {
+    return _find(k, hash_key(k)) == npos ? 0 : 1;
+  }
+
+  /// index v, replacing the entry with the same key if any
+  void insert_or_assign(V *v) {
+    ceph_assert(v);
+    const K& k = v->*key;
+    uint64_t h = hash_key(k);
+    size_t i = _find(k, h);
+    if (i != npos) {
+      slots[i].v = v;
+      return;
+    }
+    // keep the load factor under 3/4
+    if ((num + 1) * 4 > slots.size() * 3) {
+      _rehash(std::max(MIN_SLOTS, slots.size() * 2));
+    }
+    for (i = h & mask(); slots[i].v; i = (i + 1) & mask());
+    slots[i] = slot_t{h, v};
+    ++num;
+  }
+
+  void erase(iterator it) {
+    ceph_assert(it.index == this && it.pos != npos);
+    size_t hole = it.pos;
+    slots[hole] = slot_t{};
+    --num;
+    // backward shift the rest of the probe run, no tombstones
+    for (size_t i = (hole + 1) & mask(); slots[i].v; i = (i + 1) & mask()) {
+      size_t home = slots[i].hash & mask();
+      // move the slot into the hole unless its home lies in (hole, i]
+      if (((i - home) & mask()) >= ((i - hole) & mask())) {
+	slots[hole] = slots[i];
+	slots[i] = slot_t{};
+	hole = i;
+      }
+    }
+  }
+  size_t erase(const K& k) {
+    auto it = find(k);
+    if (it == end()) {
+      return 0;
+    }
+    erase(it);
+    return 1;
+  }
+
+  void clear() {
+    // give the memory back, a pg's log may shrink a lot
+    mempool::osd_pglog::vector<slot_t>().swap(slots);
+    num = 0;
+  }
+};
@@ -319,6 +319,35 @@ PerfCounters *build_osd_logger(CephContext *cct) {
   osd_plb.add_u64_counter(
     l_osd_pg_biginfo, "osd_pg_biginfo", "PG updated its biginfo attr");
 
+  osd_plb.add_u64_avg(
+    l_osd_pg_meta_keys_written, "pg_meta_keys_written",
+    "PG log and info omap keys set per PG metadata write");
+  osd_plb.add_u64_avg(
+    l_osd_pg_meta_keys_removed, "pg_meta_keys_removed",
+    "PG log and info omap keys removed one by one per PG metadata write");
+  osd_plb.add_u64_avg(
+    l_osd_pg_meta_key_ranges_removed, "pg_meta_key_ranges_removed",
+    "PG log omap key ranges removed per PG metadata write");
+
+  osd_plb.add_u64_counter(
+    l_osd_ec_cache_hit_bytes, "ec_cache_hit_bytes",
+    "EC read-modify-write bytes found in the stripe cache",
+    NULL, 0, unit_t(UNIT_BYTES));
+  osd_plb.add_u64_counter(
+    l_osd_ec_cache_miss_bytes, "ec_cache_miss_bytes",
+    "EC read-modify-write bytes read from the shards",
+    NULL, 0, unit_t(UNIT_BYTES));
+  osd_plb.add_u64(
+    l_osd_ec_cache_bytes, "ec_cache_bytes",
+    "Stripes kept in the EC stripe cache after writes",
+    NULL, 0, unit_t(UNIT_BYTES));
+  osd_plb.add_u64_counter(
+    l_osd_ec_decode_cache_hit, "ec_decode_cache_hit",
+    "EC decodes that reused cached decoding tables");
+  osd_plb.add_u64_counter(
+    l_osd_ec_decode_cache_miss, "ec_decode_cache_miss",
+    "EC decodes that computed their decoding tables");
+
   return osd_plb.create_perf_counters();
 }
  
@@ -360,3 +389,20 @@ PerfCounters *build_recoverystate_perf(CephContext *cct) {
 
   return rs_perf.create_perf_counters();
 }
+
+PerfCounters *build_osd_shard_perf(CephContext *cct, unsigned shard_id)
+{
+  PerfCountersBuilder plb(
+    cct, "osd_op_shard." + std::to_string(shard_id),
+    l_osd_shard_first, l_osd_shard_last);
+  plb.add_u64(
+    l_osd_shard_queue_depth, "queue_depth",
+    "Items queued in the shard scheduler");
+  plb.add_u64_counter(
+    l_osd_shard_stolen, "stolen",
+    "Items of this shard processed by other shards' threads");
+  plb.add_u64_counter(
+    l_osd_shard_steals, "steals",
+    "Items of other shards processed by this shard's threads");
+  return plb.create_perf_counters();
+}
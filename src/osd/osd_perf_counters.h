@@ -131,6 +131,16 @@ enum {
   l_osd_pg_fastinfo,
   l_osd_pg_biginfo,
 
+  l_osd_pg_meta_keys_written,
+  l_osd_pg_meta_keys_removed,
+  l_osd_pg_meta_key_ranges_removed,
+
+  l_osd_ec_cache_hit_bytes,
+  l_osd_ec_cache_miss_bytes,
+  l_osd_ec_cache_bytes,
+  l_osd_ec_decode_cache_hit,
+  l_osd_ec_decode_cache_miss,
+
   l_osd_last,
 };
 
@@ -174,3 +184,14 @@ enum {
 };
 
 PerfCounters *build_recoverystate_perf(CephContext *cct);
+
+// OSDShard perf counters
+enum {
+  l_osd_shard_first = 30000,
+  l_osd_shard_queue_depth,
+  l_osd_shard_stolen,
+  l_osd_shard_steals,
+  l_osd_shard_last,
+};
+
+PerfCounters *build_osd_shard_perf(CephContext *cct, unsigned shard_id);
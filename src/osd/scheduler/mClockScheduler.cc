@@ -18,6 +18,9 @@
 
 #include "osd/scheduler/mClockScheduler.h"
 #include "common/dout.h"
+#include "common/strtol.h"
+#include "json_spirit/json_spirit_reader.h"
+#include "include/ceph_assert.h"  // json_spirit clobbers it
 
 namespace dmc = crimson::dmclock;
 using namespace std::placeholders;
@@ -55,6 +58,8 @@ mClockScheduler::mClockScheduler(CephContext *cct,
   set_config_defaults_from_profile();
   client_registry.update_from_config(
     cct->_conf, osd_bandwidth_capacity_per_shard);
+  set_pending_tenants_from_config();
+  update_tenants();
 }
 
 /* ClientRegistry holds the dmclock::ClientInfo configuration parameters
@@ -131,6 +136,37 @@ void mClockScheduler::ClientRegistry::update_from_config(
       get_lim(lim));
 }
 
+void mClockScheduler::ClientRegistry::update_tenants(
+  const tenant_map_t &tenants,
+  const double capacity_per_shard)
+{
+  external_client_infos.clear();
+  for (auto &[id, t] : tenants) {
+    external_client_infos.emplace(
+      id,
+      dmc::ClientInfo(
+	t.reservation ? t.reservation * capacity_per_shard : default_min,
+	t.weight,
+	t.limit ? t.limit * capacity_per_shard : default_max));
+  }
+}
+
+client_profile_id_t mClockScheduler::ClientRegistry::get_client_profile_id(
+  client_id_t owner, int64_t pool) const
+{
+  client_profile_id_t client{owner, client_profile_id};
+  if (external_client_infos.empty() ||
+      external_client_infos.count(client) || pool < 0) {
+    return client;
+  }
+  client_profile_id_t pool_client{static_cast<client_id_t>(pool),
+				  pool_profile_id};
+  if (external_client_infos.count(pool_client)) {
+    return pool_client;
+  }
+  return client;
+}
+
 const dmc::ClientInfo *mClockScheduler::ClientRegistry::get_external_client(
   const client_profile_id_t &client) const
 {
@@ -332,6 +368,135 @@ void mClockScheduler::set_config_defaults_from_profile()
   cct->_conf.apply_changes(nullptr);
 }
 
+int mClockScheduler::parse_tenant_profiles(
+  const std::string &s,
+  ClientRegistry::tenant_map_t *tenants,
+  std::ostream &err)
+{
+  tenants->clear();
+  if (s.empty()) {
+    return 0;
+  }
+  json_spirit::mValue v;
+  if (!json_spirit::read(s, v) || v.type() != json_spirit::obj_type) {
+    err << "not a json object";
+    return -EINVAL;
+  }
+  static constexpr std::string_view client_prefix = "client.";
+  static constexpr std::string_view pool_prefix = "pool.";
+  for (auto &[name, profile] : v.get_obj()) {
+    client_profile_id_t id;
+    std::string_view num;
+    if (name.starts_with(client_prefix)) {
+      id.profile_id = client_profile_id;
+      num = std::string_view(name).substr(client_prefix.size());
+    } else if (name.starts_with(pool_prefix)) {
+      id.profile_id = pool_profile_id;
+      num = std::string_view(name).substr(pool_prefix.size());
+    } else {
+      err << "invalid tenant '" << name
+	  << "', expected client.<global id> or pool.<id>";
+      return -EINVAL;
+    }
+    std::string num_err;
+    long long n = strict_strtoll(num, 10, &num_err);
+    if (!num_err.empty() || n < 0) {
+      err << "invalid tenant '" << name << "'";
+      return -EINVAL;
+    }
+    id.client_id = n;
+
+    if (profile.type() != json_spirit::obj_type) {
+      err << "profile of '" << name << "' is not a json object";
+      return -EINVAL;
+    }
+    ClientRegistry::tenant_config_t t;
+    try {
+      for (auto &[key, val] : profile.get_obj()) {
+	if (key == "res") {
+	  t.reservation = val.get_real();
+	} else if (key == "wgt") {
+	  t.weight = val.get_uint64();
+	} else if (key == "lim") {
+	  t.limit = val.get_real();
+	} else {
+	  err << "unknown key '" << key << "' in profile of '" << name << "'";
+	  return -EINVAL;
+	}
+      }
+    } catch (std::runtime_error &e) {
+      err << "invalid profile of '" << name << "': " << e.what();
+      return -EINVAL;
+    }
+    if (t.reservation < 0 || t.reservation > 1.0 ||
+	t.limit < 0 || t.limit > 1.0 || t.weight == 0) {
+      err << "profile of '" << name << "' out of range, res and lim must be "
+	  << "within [0, 1] and wgt > 0";
+      return -EINVAL;
+    }
+    (*tenants)[id] = t;
+  }
+  return 0;
+}
+
+void mClockScheduler::set_pending_tenants_from_config()
+{
+  ClientRegistry::tenant_map_t tenants;
+  std::ostringstream err;
+  int r = parse_tenant_profiles(
+    cct->_conf.get_val<std::string>("osd_mclock_scheduler_client_profiles"),
+    &tenants, err);
+  if (r < 0) {
+    if (shard_id == 0) {
+      derr << __func__ << " ignoring osd_mclock_scheduler_client_profiles: "
+	   << err.str() << dendl;
+    }
+    return;
+  }
+  std::lock_guard l{tenants_lock};
+  pending_tenants.swap(tenants);
+  tenants_changed = true;
+}
+
+void mClockScheduler::update_tenants()
+{
+  ClientRegistry::tenant_map_t tenants;
+  {
+    std::lock_guard l{tenants_lock};
+    tenants = pending_tenants;
+    tenants_changed = false;
+  }
+  auto old_registry = client_registry;
+  client_registry.update_tenants(tenants, osd_bandwidth_capacity_per_shard);
+  // the queue caches ClientInfo pointers, including those just replaced
+  scheduler.update_client_infos();
+
+  // move the queued ops of clients now scheduled under another id, so
+  // that they are not dequeued after the ops that follow them
+  std::list<OpSchedulerItem> moved;
+  scheduler.remove_by_req_filter(
+    [&](std::unique_ptr<OpSchedulerItem> &&r) {
+      if (r->get_scheduler_class() != op_scheduler_class::client) {
+	return false;
+      }
+      auto owner = r->get_owner();
+      auto pool = r->get_ordering_token().pool();
+      if (old_registry.get_client_profile_id(owner, pool) ==
+	  client_registry.get_client_profile_id(owner, pool)) {
+	return false;
+      }
+      moved.push_back(std::move(*r));
+      return true;
+    }, false);
+  for (auto &item : moved) {
+    auto id = get_scheduler_id(item);
+    auto cost = item.get_qos_cost();
+    scheduler.add_request(std::move(item), id, cost);
+  }
+  dout(10) << __func__ << " " << tenants.size() << " client profiles, moved "
+	   << moved.size() << " queued ops" << dendl;
+}
+
 uint32_t mClockScheduler::calc_scaled_cost(int item_cost)
 {
   auto cost = static_cast<uint32_t>(
@@ -364,6 +529,7 @@ void mClockScheduler::dump(ceph::Formatter &f) const
   std::ostringstream out;
   f.open_object_section("mClockClients");
   f.dump_int("client_count", scheduler.client_count());
+  f.dump_int("client_profile_count", client_registry.get_num_tenants());
   out << scheduler;
   f.dump_string("clients", out.str());
   f.close_section();
@@ -384,6 +550,7 @@ void mClockScheduler::dump(ceph::Formatter &f) const
 
 void mClockScheduler::enqueue(OpSchedulerItem&& item)
 {
+  maybe_update_tenants();
   auto id = get_scheduler_id(item);
   unsigned priority = item.get_priority();
   
@@ -449,6 +616,7 @@ void mClockScheduler::enqueue_high(unsigned priority,
 
 WorkItem mClockScheduler::dequeue()
 {
+  maybe_update_tenants();
   if (!high_priority.empty()) {
     auto iter = high_priority.begin();
     // invariant: high_priority entries are never empty
@@ -502,6 +670,7 @@ const char** mClockScheduler::get_tracked_conf_keys() const
     "osd_mclock_max_sequential_bandwidth_hdd",
     "osd_mclock_max_sequential_bandwidth_ssd",
     "osd_mclock_profile",
+    "osd_mclock_scheduler_client_profiles",
     NULL
   };
   return KEYS;
@@ -528,6 +697,14 @@ void mClockScheduler::handle_conf_change(
     client_registry.update_from_config(
       conf, osd_bandwidth_capacity_per_shard);
   }
+  if (changed.count("osd_mclock_scheduler_client_profiles") ||
+      changed.count("osd_mclock_max_capacity_iops_hdd") ||
+      changed.count("osd_mclock_max_capacity_iops_ssd") ||
+      changed.count("osd_mclock_max_sequential_bandwidth_hdd") ||
+      changed.count("osd_mclock_max_sequential_bandwidth_ssd")) {
+    // (re)resolve the tenant ratios against the current capacity
+    set_pending_tenants_from_config();
+  }
 
   auto get_changed_key = [&changed]() -> std::optional<std::string> {
     static const std::vector<std::string> qos_params = {
@@ -15,6 +15,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <ostream>
 #include <map>
@@ -27,6 +28,7 @@
 #include "osd/scheduler/OpScheduler.h"
 #include "common/config.h"
 #include "common/ceph_context.h"
+#include "common/ceph_mutex.h"
 #include "common/mClockPriorityQueue.h"
 #include "osd/scheduler/OpSchedulerItem.h"
 
@@ -41,6 +43,11 @@ constexpr double default_max = std::numeric_limits<double>::is_iec559 ?
 using client_id_t = uint64_t;
 using profile_id_t = uint64_t;
 
+/// client_id is the global id of the client, e.g. 4151 for client.4151
+constexpr profile_id_t client_profile_id = 0;
+/// client_id is the pool id, all clients of the pool share the profile
+constexpr profile_id_t pool_profile_id = 1;
+
 struct client_profile_id_t {
   client_id_t client_id;
   profile_id_t profile_id;
@@ -135,11 +142,45 @@ class mClockScheduler : public OpScheduler, md_config_obs_t {
     };
 
     crimson::dmclock::ClientInfo default_external_client_info = {1, 1, 1};
+    /// per client and per pool (tenant) infos, see tenant_config_t
     std::map<client_profile_id_t,
 	     crimson::dmclock::ClientInfo> external_client_infos;
     const crimson::dmclock::ClientInfo *get_external_client(
       const client_profile_id_t &client) const;
   public:
+    /// QoS of a tenant, res and lim are ratios of the OSD capacity
+    struct tenant_config_t {
+      double reservation = 0;
+      uint64_t weight = 1;
+      double limit = 0;
+    };
+    using tenant_map_t = std::map<client_profile_id_t, tenant_config_t>;
+
+    /**
+     * update_tenants
+     *
+     * Replaces the per client and per pool mclock parameters.  The
+     * mclock queue must be told about the change with
+     * update_client_infos() before it pulls again, since it holds on to
+     * pointers to the previous ClientInfos.
+     */
+    void update_tenants(
+      const tenant_map_t &tenants,
+      double capacity_per_shard);
+
+    /**
+     * get_client_profile_id
+     *
+     * A client with a profile of its own is scheduled on its own, clients
+     * of a pool with a profile are scheduled together as the pool, any
+     * other client gets its own queue with the default client parameters.
+     */
+    client_profile_id_t get_client_profile_id(
+      client_id_t owner, int64_t pool) const;
+    size_t get_num_tenants() const {
+      return external_client_infos.size();
+    }
+
     /**
      * update_from_config
      *
@@ -174,13 +215,53 @@ class mClockScheduler : public OpScheduler, md_config_obs_t {
   SubQueue high_priority;
   priority_t immediate_class_priority = std::numeric_limits<priority_t>::max();
 
-  static scheduler_id_t get_scheduler_id(const OpSchedulerItem &item) {
+  /**
+   * pending_tenants
+   *
+   * Tenant profiles parsed from osd_mclock_scheduler_client_profiles by
+   * the config observer, applied by the shard thread on its next
+   * enqueue or dequeue as the mclock queue is not thread safe.
+   */
+  ceph::mutex tenants_lock = ceph::make_mutex("mClockScheduler::tenants_lock");
+  ClientRegistry::tenant_map_t pending_tenants;
+  std::atomic<bool> tenants_changed = {false};
+
+  void set_pending_tenants_from_config();
+  void maybe_update_tenants() {
+    if (tenants_changed) {
+      update_tenants();
+    }
+  }
+  void update_tenants();
+
+  /**
+   * parse_tenant_profiles
+   *
+   * Parses osd_mclock_scheduler_client_profiles, a json object mapping
+   * "client.<global id>" or "pool.<pool id>" to an object with optional
+   * "res", "wgt" and "lim" members, e.g.
+   *
+   *   {"client.4151": {"lim": 0.2}, "pool.3": {"res": 0.1, "wgt": 2}}
+   *
+   * @return 0, or -EINVAL with the reason in err
+   */
+  static int parse_tenant_profiles(
+    const std::string &s,
+    ClientRegistry::tenant_map_t *tenants,
+    std::ostream &err);
+
+  scheduler_id_t get_scheduler_id(const OpSchedulerItem &item) const {
+    auto class_id = item.get_scheduler_class();
+    if (class_id != op_scheduler_class::client) {
+      return scheduler_id_t{
+	class_id,
+	client_profile_id_t{item.get_owner(), client_profile_id}
+      };
+    }
     return scheduler_id_t{
-      item.get_scheduler_class(),
-	client_profile_id_t{
-	item.get_owner(),
-	  0
-	  }
+      class_id,
+      client_registry.get_client_profile_id(
+	item.get_owner(), item.get_ordering_token().pool())
     };
   }
 
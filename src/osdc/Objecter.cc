@@ -118,6 +118,9 @@ enum {
   l_osdc_op_w,
   l_osdc_op_rmw,
   l_osdc_op_pg,
+  l_osdc_op_r_primary,
+  l_osdc_op_r_replica,
+  l_osdc_op_r_adaptive,
 
   l_osdc_osdop_stat,
   l_osdc_osdop_create,
@@ -219,6 +222,7 @@ const char** Objecter::get_tracked_conf_keys() const
     "crush_location",
     "rados_mon_op_timeout",
     "rados_osd_op_timeout",
+    "objecter_read_balance_adaptive",
     NULL
   };
   return config_keys;
@@ -237,6 +241,9 @@ void Objecter::handle_conf_change(const ConfigProxy& conf,
   if (changed.count("rados_osd_op_timeout")) {
     osd_timeout = conf.get_val<std::chrono::seconds>("rados_osd_op_timeout");
   }
+  if (changed.count("objecter_read_balance_adaptive")) {
+    read_balance_adaptive = conf.get_val<bool>("objecter_read_balance_adaptive");
+  }
 }
 
 void Objecter::update_crush_location()
@@ -276,6 +283,12 @@ void Objecter::init()
     pcb.add_u64_counter(l_osdc_op_rmw, "op_rmw", "Read-modify-write operations",
 			"rdwr", PerfCountersBuilder::PRIO_INTERESTING);
     pcb.add_u64_counter(l_osdc_op_pg, "op_pg", "PG operation");
+    pcb.add_u64_counter(l_osdc_op_r_primary, "op_r_primary",
+			"Read operations sent to the primary");
+    pcb.add_u64_counter(l_osdc_op_r_replica, "op_r_replica",
+			"Read operations sent to a replica");
+    pcb.add_u64_counter(l_osdc_op_r_adaptive, "op_r_adaptive",
+			"Balanced reads sent where the replica latency directed");
 
     pcb.add_u64_counter(l_osdc_osdop_stat, "osdop_stat", "Stat operations");
     pcb.add_u64_counter(l_osdc_osdop_create, "osdop_create",
@@ -2330,8 +2343,11 @@ void Objecter::_send_op_account(Op *op)
     logger->inc(l_osdc_op_rmw);
   else if (op->target.flags & CEPH_OSD_FLAG_WRITE)
     logger->inc(l_osdc_op_w);
-  else if (op->target.flags & CEPH_OSD_FLAG_READ)
+  else if (op->target.flags & CEPH_OSD_FLAG_READ) {
     logger->inc(l_osdc_op_r);
+    logger->inc(op->target.used_replica ? l_osdc_op_r_replica :
+		l_osdc_op_r_primary);
+  }
 
   if (op->target.flags & CEPH_OSD_FLAG_PGOP)
     logger->inc(l_osdc_op_pg);
@@ -2955,12 +2971,19 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
 		   << " acting " << t->acting
 		   << " primary " << acting_primary << dendl;
     t->used_replica = false;
+    t->used_read_balance_adaptive = false;
     if ((t->flags & (CEPH_OSD_FLAG_BALANCE_READS |
                      CEPH_OSD_FLAG_LOCALIZE_READS)) &&
         !is_write && pi->is_replicated() && t->acting.size() > 1) {
       int osd;
       ceph_assert(is_read && t->acting[0] == acting_primary);
-      if (t->flags & CEPH_OSD_FLAG_BALANCE_READS) {
+      if ((t->flags & CEPH_OSD_FLAG_BALANCE_READS) && read_balance_adaptive) {
+	int p = _choose_read_replica(t);
+	if (p)
+	  t->used_replica = true;
+	t->used_read_balance_adaptive = true;
+	osd = t->acting[p];
+      } else if (t->flags & CEPH_OSD_FLAG_BALANCE_READS) {
 	int p = rand() % t->acting.size();
 	if (p)
 	  t->used_replica = true;
@@ -3008,6 +3031,82 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
   return RECALC_OP_TARGET_NO_ACTION;
 }
 
+int Objecter::_choose_read_replica(const op_target_t *t)
+{
+  // rwlock is locked
+
+  // now and then pick a random replica, so that the latency estimate of
+  // a replica that was slow once gets refreshed
+  if (rand() % READ_BALANCE_PROBE_ONE_IN == 0) {
+    int p = rand() % t->acting.size();
+    ldout(cct, 10) << __func__ << " probing osd." << t->acting[p] << " of "
+		   << t->acting << dendl;
+    return p;
+  }
+  boost::container::small_vector<read_load_t, 4> load(t->acting.size());
+  for (unsigned i = 0; i < t->acting.size(); ++i) {
+    auto s = osd_sessions.find(t->acting[i]);
+    if (s != osd_sessions.end()) {
+      load[i].lat_ewma_us = s->second->read_lat_ewma_us;
+      load[i].inflight = s->second->num_ops_inflight;
+    }
+    ldout(cct, 20) << __func__ << " rank " << i << " osd." << t->acting[i]
+		   << " lat " << load[i].lat_ewma_us << "us inflight "
+		   << load[i].inflight << dendl;
+  }
+  int best = pick_read_target(load.data(), load.size());
+  ldout(cct, 10) << __func__ << " chose osd." << t->acting[best] << " of "
+		 << t->acting << dendl;
+  return best;
+}
+
+unsigned Objecter::pick_read_target(const read_load_t *load, unsigned n)
+{
+  unsigned best = 0;
+  uint64_t best_score = UINT64_MAX;
+  for (unsigned i = 0; i < n; ++i) {
+    uint64_t score = load[i].lat_ewma_us * (load[i].inflight + 1);
+    if (score < best_score) {
+      best = i;
+      best_score = score;
+    }
+  }
+  return best;
+}
+
+uint64_t Objecter::update_read_lat_ewma(uint64_t ewma_us, uint64_t sample_us)
+{
+  // 1/8 weight for the new sample, but never let it go back to 0
+  ewma_us = ewma_us ? (ewma_us * 7 + sample_us) / 8 : sample_us;
+  return std::max<uint64_t>(ewma_us, 1);
+}
+
+void Objecter::_update_read_latency(OSDSession *s, Op *op)
+{
+  // s->lock is locked
+  if (op->sent_stamp == ceph::mono_time()) {
+    return;
+  }
+  uint64_t lat = std::chrono::duration_cast<std::chrono::microseconds>(
+    ceph::mono_clock::now() - op->sent_stamp).count();
+  s->read_lat_ewma_us = update_read_lat_ewma(s->read_lat_ewma_us, lat);
+}
+
+void Objecter::_dump_read_balance(Formatter *fmt)
+{
+  // rwlock is locked
+  fmt->open_array_section("read_balance");
+  for (auto& [osd, s] : osd_sessions) {
+    fmt->open_object_section("osd");
+    fmt->dump_int("osd", osd);
+    fmt->dump_unsigned("ops_inflight", s->num_ops_inflight);
+    fmt->dump_unsigned("read_lat_ewma_us", s->read_lat_ewma_us);
+    fmt->dump_unsigned("reads_adaptive", s->num_reads_adaptive);
+    fmt->close_section();
+  }
+  fmt->close_section();
+}
+
 int Objecter::_map_session(op_target_t *target, OSDSession **s,
 			   shunique_lock<ceph::shared_mutex>& sul)
 {
@@ -3024,6 +3123,7 @@ void Objecter::_session_op_assign(OSDSession *to, Op *op)
   get_session(to);
   op->session = to;
   to->ops[op->tid] = op;
+  to->num_ops_inflight++;
 
   if (to->is_homeless()) {
     num_homeless_ops++;
@@ -3042,6 +3142,7 @@ void Objecter::_session_op_remove(OSDSession *from, Op *op)
   }
 
   from->ops.erase(op->tid);
+  from->num_ops_inflight--;
   put_session(from);
   op->session = NULL;
 
@@ -3204,6 +3305,11 @@ Objecter::MOSDOp *Objecter::_prepare_osd_op(Op *op)
 
   op->target.paused = false;
   op->stamp = ceph::coarse_mono_clock::now();
+  if (op->target.used_read_balance_adaptive) {
+    op->sent_stamp = ceph::mono_clock::now();
+  } else {
+    op->sent_stamp = ceph::mono_time();
+  }
 
   hobject_t hobj = op->target.get_hobj();
   auto m = new MOSDOp(client_inc, op->tid,
@@ -3273,6 +3379,10 @@ void Objecter::_send_op(Op *op)
 
   ceph_assert(op->tid > 0);
   MOSDOp *m = _prepare_osd_op(op);
+  if (op->target.used_read_balance_adaptive) {
+    logger->inc(l_osdc_op_r_adaptive);
+    ++op->session->num_reads_adaptive;
+  }
 
   if (op->target.actual_pgid != m->get_spg()) {
     ldout(cct, 10) << __func__ << " " << op->tid << " pgid change from "
@@ -3569,6 +3679,9 @@ void Objecter::handle_osd_op_reply(MOSDOpReply *m)
   }
   logger->inc(l_osdc_op_reply);
   logger->tinc(l_osdc_op_latency, ceph::coarse_mono_time::clock::now() - op->stamp);
+  if (rc >= 0) {
+    _update_read_latency(s, op);
+  }
   logger->set(l_osdc_op_inflight, num_in_flight);
 
   /* get it before we call _finish_op() */
@@ -4550,6 +4663,7 @@ void Objecter::dump_requests(Formatter *fmt)
   dump_pool_stat_ops(fmt);
   dump_statfs_ops(fmt);
   dump_command_ops(fmt);
+  _dump_read_balance(fmt);
   fmt->close_section(); // requests object
 }
 
@@ -5009,6 +5123,8 @@ Objecter::Objecter(CephContext *cct,
 {
   mon_timeout = cct->_conf.get_val<std::chrono::seconds>("rados_mon_op_timeout");
   osd_timeout = cct->_conf.get_val<std::chrono::seconds>("rados_osd_op_timeout");
+  read_balance_adaptive =
+    cct->_conf.get_val<bool>("objecter_read_balance_adaptive");
 }
 
 Objecter::~Objecter()
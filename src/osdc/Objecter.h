@@ -1798,6 +1798,7 @@ public:
     int32_t peering_crush_mandatory_member = CRUSH_ITEM_NONE;
 
     bool used_replica = false;
+    bool used_read_balance_adaptive = false;  ///< target chosen by latency
     bool paused = false;
 
     int osd = -1;      ///< the final target osd, or -1
@@ -1939,6 +1940,8 @@ public:
     epoch_t *reply_epoch = nullptr;
 
     ceph::coarse_mono_time stamp;
+    /// precise send time of balanced reads, for replica latency feedback
+    ceph::mono_time sent_stamp;
 
     epoch_t map_dne_bound = 0;
 
@@ -2396,6 +2399,11 @@ public:
     int incarnation;
     ConnectionRef con;
     int num_locks;
+
+    // read load balancing feedback, read without the session lock
+    std::atomic<uint32_t> num_ops_inflight{0};
+    std::atomic<uint64_t> read_lat_ewma_us{0};  ///< 0 until the first reply
+    std::atomic<uint64_t> num_reads_adaptive{0};  ///< sends directed here
     std::unique_ptr<std::mutex[]> completion_locks;
 
     OSDSession(CephContext *cct, int o) :
@@ -2453,6 +2461,9 @@ public:
 
   ceph::timespan mon_timeout;
   ceph::timespan osd_timeout;
+  std::atomic<bool> read_balance_adaptive{false};
+  /// one in this many adaptively balanced reads goes to a random replica
+  static constexpr int READ_BALANCE_PROBE_ONE_IN = 16;
 
   MOSDOp *_prepare_osd_op(Op *op);
   void _send_op(Op *op);
@@ -2482,6 +2493,22 @@ public:
   bool target_should_be_paused(op_target_t *op);
   int _calc_target(op_target_t *t, Connection *con,
 		   bool any_change = false);
+  int _choose_read_replica(const op_target_t *t);
+  void _update_read_latency(OSDSession *s, Op *op);
+  void _dump_read_balance(Formatter *fmt);
+
+public:
+  /// what the adaptive read balancing knows about a read target
+  struct read_load_t {
+    uint64_t lat_ewma_us = 0;  ///< 0 while unknown
+    uint32_t inflight = 0;
+  };
+  /// index of the target with the lowest expected wait, i.e. its read
+  /// latency times the ops queued ahead.  Unknown targets come first.
+  static unsigned pick_read_target(const read_load_t *load, unsigned n);
+  /// fold a read latency sample into a target's moving average
+  static uint64_t update_read_lat_ewma(uint64_t ewma_us, uint64_t sample_us);
+private:
   int _map_session(op_target_t *op, OSDSession **s,
 		   ceph::shunique_lock<ceph::shared_mutex>& lc);
 
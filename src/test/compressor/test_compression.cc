@@ -140,6 +140,45 @@ TEST_P(CompressorTest, big_round_trip_randomish)
        << " with " << GetParam() << std::endl;
 }
 
+TEST_P(CompressorTest, estimate_ratio)
+{
+  const unsigned len = 65536;
+  const size_t sample = 4096;
+
+  bufferlist zeros;
+  zeros.append_zero(len);
+  ASSERT_LT(compressor->estimate_ratio(zeros, sample), 0.01);
+
+  // 10 letters take ~3.3 bits each
+  bufferlist letters;
+  {
+    const char *alphabet = "abcdefghijklmnopqrstuvwxyz";
+    bufferptr bp(len);
+    for (unsigned i = 0; i < len; ++i) {
+      bp.c_str()[i] = alphabet[rand() % 10];
+    }
+    letters.append(bp);
+  }
+  double r = compressor->estimate_ratio(letters, sample);
+  ASSERT_GT(r, 0.35);
+  ASSERT_LT(r, 0.5);
+
+  // looks like already compressed data, split over several buffers
+  bufferlist random;
+  for (unsigned i = 0; i < 4; ++i) {
+    bufferptr bp(len / 4);
+    for (unsigned j = 0; j < len / 4; ++j) {
+      bp.c_str()[j] = rand();
+    }
+    random.append(bp);
+  }
+  ASSERT_GT(compressor->estimate_ratio(random, sample), 0.95);
+
+  // sample size larger than the input and empty input
+  ASSERT_GT(compressor->estimate_ratio(random, len * 2), 0.95);
+  ASSERT_EQ(1.0, compressor->estimate_ratio(bufferlist(), sample));
+}
+
 #if 0
 TEST_P(CompressorTest, big_round_trip_file)
 {
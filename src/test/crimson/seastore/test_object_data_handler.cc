@@ -103,13 +103,18 @@ struct object_data_handler_test_t:
     return submit_transaction(std::move(t));
   }
 
-  void read(Transaction &t, objaddr_t offset, extent_len_t len) {
+  void read(
+    Transaction &t,
+    objaddr_t offset,
+    extent_len_t len,
+    ObjectDataHandler::read_ahead_tracker_t *read_ahead = nullptr) {
     bufferlist bl = with_trans_intr(t, [&](auto &t) {
       return ObjectDataHandler(MAX_OBJECT_SIZE).read(
         ObjectDataHandler::context_t{
           *tm,
           t,
-          *onode
+          *onode,
+          read_ahead
         },
         offset,
         len);
@@ -123,9 +128,12 @@ struct object_data_handler_test_t:
     EXPECT_EQ(bl.length(), known.length());
     EXPECT_EQ(bl, known);
   }
-  void read(objaddr_t offset, extent_len_t len) {
+  void read(
+    objaddr_t offset,
+    extent_len_t len,
+    ObjectDataHandler::read_ahead_tracker_t *read_ahead = nullptr) {
     auto t = create_read_transaction();
-    read(*t, offset, len);
+    read(*t, offset, len, read_ahead);
   }
   void read_near(objaddr_t offset, extent_len_t len, extent_len_t fuzz) {
     auto fuzzes = std::vector<int32_t>{-1 * (int32_t)fuzz, 0, (int32_t)fuzz};
@@ -143,6 +151,16 @@ struct object_data_handler_test_t:
     return ret;
   }
 
+  /// true if the extent mapped at offset is in cache (or being read)
+  bool is_cached(objaddr_t offset) {
+    auto base = onode->get_layout().object_data.get().get_reserved_data_base();
+    auto t = create_read_transaction();
+    auto pin = with_trans_intr(*t, [&](auto &t) {
+      return tm->get_pin(t, base + offset);
+    }).unsafe_get0();
+    return pin->get_logical_extent(*t).has_child();
+  }
+
   seastar::future<> set_up_fut() final {
     onode = new TestOnode(
       DEFAULT_OBJECT_DATA_RESERVATION,
@@ -415,3 +433,79 @@ TEST_F(object_data_handler_test_t, multiple_split) {
     read(0, 128<<10);
   });
 }
+
+TEST_F(object_data_handler_test_t, sequential_read_ahead)
+{
+  run_async([this] {
+    // one extent per write
+    for (int i = 0; i < 16; i++) {
+      write(i * (64<<10), 64<<10, 'a' + i);
+    }
+    // start with a cold cache
+    restart();
+
+    ObjectDataHandler::read_ahead_tracker_t read_ahead(256<<10);
+    read(0, 64<<10, &read_ahead);
+    EXPECT_FALSE(is_cached(64<<10));
+
+    // sequential, reads 64K ahead
+    read(64<<10, 64<<10, &read_ahead);
+    EXPECT_TRUE(is_cached(128<<10));
+    EXPECT_FALSE(is_cached(192<<10));
+
+    // then 128K
+    read(128<<10, 64<<10, &read_ahead);
+    EXPECT_TRUE(is_cached(192<<10));
+    EXPECT_TRUE(is_cached(256<<10));
+    EXPECT_FALSE(is_cached(320<<10));
+
+    // a random read doesn't read ahead
+    read(768<<10, 64<<10, &read_ahead);
+    EXPECT_FALSE(is_cached(832<<10));
+
+    // and doesn't end the sequential stream, whose window keeps growing
+    // until read_ahead_size
+    read(192<<10, 128<<10, &read_ahead);
+    EXPECT_TRUE(is_cached(320<<10));
+    EXPECT_TRUE(is_cached(512<<10));
+    EXPECT_FALSE(is_cached(576<<10));
+
+    read(0, 1<<20);
+  });
+}
+
+TEST_F(object_data_handler_test_t, read_ahead_error)
+{
+  run_async([this] {
+    for (int i = 0; i < 4; i++) {
+      write(i * (64<<10), 64<<10, 'a' + i);
+    }
+    restart();
+
+    auto base = onode->get_layout().object_data.get().get_reserved_data_base();
+    paddr_t addr;
+    {
+      auto t = create_read_transaction();
+      auto pin = with_trans_intr(*t, [&](auto &t) {
+        return tm->get_pin(t, base + (128<<10));
+      }).unsafe_get0();
+      addr = pin->get_val();
+    }
+    auto sm = static_cast<segment_manager::EphemeralSegmentManager*>(
+      devices->get_primary_device());
+    sm->inject_read_error(addr);
+
+    // reads 128K~64K ahead, which fails
+    ObjectDataHandler::read_ahead_tracker_t read_ahead(256<<10);
+    read(0, 64<<10, &read_ahead);
+    read(64<<10, 64<<10, &read_ahead);
+    seastar::sleep(std::chrono::milliseconds(100)).get0();
+    // dropped from the cache and from the lba leaf
+    EXPECT_FALSE(is_cached(128<<10));
+
+    sm->clear_read_errors();
+    read(128<<10, 64<<10);
+    EXPECT_TRUE(is_cached(128<<10));
+    read(0, 256<<10);
+  });
+}
@@ -158,6 +158,35 @@ TEST(ErasureCodeTest, encode_misaligned_non_contiguous)
   }
 }
 
+TEST(ErasureCodeTest, decode_cache)
+{
+  ErasureCodeDecodeCache cache(2);
+  EXPECT_EQ("", ErasureCodeDecodeCache::signature(set<int>()));
+  EXPECT_EQ("1,4", ErasureCodeDecodeCache::signature(set<int>{4, 1}));
+
+  EXPECT_EQ(0u, cache.get("1").length());
+  EXPECT_EQ(1u, cache.get_misses());
+  bufferptr one(buffer::copy("one", 3));
+  cache.put("1", one);
+  cache.put("2", bufferptr(buffer::copy("two", 3)));
+  // "1" is the most recently used, "2" goes first
+  ASSERT_EQ(3u, cache.get("1").length());
+  EXPECT_EQ(0, memcmp("one", cache.get("1").c_str(), 3));
+  EXPECT_EQ(2u, cache.get_hits());
+  bufferptr three(buffer::copy("three", 5));
+  cache.put("3", three);
+  EXPECT_EQ(2u, cache.size());
+  EXPECT_EQ(0u, cache.get("2").length());
+  EXPECT_EQ(5u, cache.get("3").length());
+  EXPECT_EQ(3u, cache.get("1").length());
+  EXPECT_EQ(2u, cache.get_misses());
+
+  // evicted tables stay valid for whoever holds them
+  cache.clear();
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_EQ(0, memcmp("three", three.c_str(), 5));
+}
+
 /*
  * Local Variables:
  * compile-command: "cd ../.. ;
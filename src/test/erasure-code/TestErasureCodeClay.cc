@@ -362,6 +362,89 @@ TEST(ErasureCodeClay, encode_decode_shortening_case)
   }
 }
 
+TEST(ErasureCodeClay, threads)
+{
+  {
+    ErasureCodeClay clay(g_conf().get_val<std::string>("erasure_code_dir"));
+    ErasureCodeProfile profile;
+    profile["k"] = "4";
+    profile["m"] = "2";
+    profile["threads"] = "0";
+    ostringstream errors;
+    EXPECT_EQ(-EINVAL, clay.init(profile, &errors));
+    EXPECT_NE(std::string::npos, errors.str().find("must be >= 1"));
+  }
+
+  // reed_sol_van transforms are applied by the clay plugin itself,
+  // cauchy_good ones by the jerasure plugin
+  for (auto technique : {"reed_sol_van", "cauchy_good"}) {
+    map<int, bufferlist> encoded[2];
+    ErasureCodeClay serial(g_conf().get_val<std::string>("erasure_code_dir"));
+    ErasureCodeClay parallel(g_conf().get_val<std::string>("erasure_code_dir"));
+    ErasureCodeClay *clays[2] = {&serial, &parallel};
+    for (int c = 0; c < 2; c++) {
+      ErasureCodeProfile profile;
+      profile["k"] = "4";
+      profile["m"] = "3";
+      profile["d"] = "6";
+      profile["technique"] = technique;
+      profile["threads"] = c ? "4" : "1";
+      ASSERT_EQ(0, clays[c]->init(profile, &cerr));
+
+      bufferlist in;
+      for (unsigned i = 0; i < 8192; i++) {
+	in.append((char)(i * 31 + i / 256));
+      }
+      set<int> want_to_encode;
+      for (int i = 0; i < 7; i++) {
+	want_to_encode.insert(i);
+      }
+      ASSERT_EQ(0, clays[c]->encode(want_to_encode, in, &encoded[c]));
+    }
+    unsigned length = encoded[0][0].length();
+    for (int i = 0; i < 7; i++) {
+      EXPECT_TRUE(encoded[0][i].contents_equal(encoded[1][i]));
+    }
+
+    // every two chunks missing
+    for (int i = 1; i < 7; i++) {
+      for (int j = 0; j < i; j++) {
+	map<int, bufferlist> degraded = encoded[0];
+	degraded.erase(i);
+	degraded.erase(j);
+	map<int, bufferlist> decoded;
+	EXPECT_EQ(0, parallel._decode(set<int>{i, j}, degraded, &decoded));
+	EXPECT_TRUE(decoded[i].contents_equal(encoded[0][i]));
+	EXPECT_TRUE(decoded[j].contents_equal(encoded[0][j]));
+      }
+    }
+
+    // every chunk repaired from the sub-chunks of d helpers
+    int sc_size = length / parallel.sub_chunk_no;
+    for (int i = 0; i < 7; i++) {
+      set<int> available;
+      for (int j = 0; j < 7; j++) {
+	if (j != i) {
+	  available.insert(j);
+	}
+      }
+      map<int, vector<pair<int,int>>> minimum;
+      EXPECT_EQ(0, parallel.minimum_to_decode(set<int>{i}, available, &minimum));
+      map<int, bufferlist> helper;
+      for (auto& [chunk, ranges] : minimum) {
+	for (auto& [index, count] : ranges) {
+	  bufferlist temp;
+	  temp.substr_of(encoded[0][chunk], index * sc_size, count * sc_size);
+	  helper[chunk].append(temp);
+	}
+      }
+      map<int, bufferlist> decoded;
+      EXPECT_EQ(0, parallel.decode(set<int>{i}, helper, &decoded, length));
+      EXPECT_TRUE(decoded[i].contents_equal(encoded[0][i]));
+    }
+  }
+}
+
 TEST(ErasureCodeClay, minimum_to_decode)
 {
   ErasureCodeClay clay(g_conf().get_val<std::string>("erasure_code_dir"));
@@ -876,6 +876,64 @@ TEST_F(IsaErasureCodeTest, isa_xor_codec)
   EXPECT_EQ(5, cnt_cf);
 }
 
+TEST_F(IsaErasureCodeTest, parity_delta)
+{
+  const char *coding_chunks[] = { "1", "3" };
+  for (auto m : coding_chunks) {
+    ErasureCodeIsaDefault Isa(tcache);
+    ErasureCodeProfile profile;
+    profile["k"] = "5";
+    profile["m"] = m;
+    Isa.init(profile, &cerr);
+    EXPECT_TRUE(Isa.supports_parity_delta());
+
+    unsigned k = Isa.get_data_chunk_count();
+    unsigned n = Isa.get_chunk_count();
+    unsigned object_size = Isa.get_alignment() * k * 2;
+    bufferlist in;
+    for (unsigned i = 0; i < object_size; i++)
+      in.append((char)(rand() & 0xff));
+    set<int> want_to_encode;
+    for (unsigned i = 0; i < n; i++)
+      want_to_encode.insert(i);
+    map<int,bufferlist> encoded;
+    EXPECT_EQ(0, Isa.encode(want_to_encode, in, &encoded));
+    unsigned chunk_size = encoded[0].length();
+
+    // overwrite chunks 0 and 2
+    bufferlist modified;
+    map<int,bufferlist> deltas;
+    for (unsigned i = 0; i < k; i++) {
+      bufferlist chunk;
+      chunk.substr_of(in, i * chunk_size, chunk_size);
+      if (i == 0 || i == 2) {
+	bufferlist updated;
+	for (unsigned j = 0; j < chunk_size; j++)
+	  updated.append((char)(rand() & 0xff));
+	Isa.encode_delta(chunk, updated, &deltas[i]);
+	chunk = updated;
+      }
+      modified.append(chunk);
+    }
+
+    // only ask for the last coding chunk, the others are updated in
+    // scratch space
+    map<int,bufferlist> parity;
+    parity[n - 1].append(encoded[n - 1].c_str(), chunk_size);
+    EXPECT_EQ(0, Isa.apply_delta(deltas, &parity));
+
+    map<int,bufferlist> reencoded;
+    EXPECT_EQ(0, Isa.encode(want_to_encode, modified, &reencoded));
+    EXPECT_EQ(1u, parity.size());
+    EXPECT_TRUE(parity[n - 1].contents_equal(reencoded[n - 1]));
+
+    // deltas for coding chunks are rejected
+    map<int,bufferlist> bad;
+    bad[k] = deltas[0];
+    EXPECT_EQ(-EINVAL, Isa.apply_delta(bad, &parity));
+  }
+}
+
 TEST_F(IsaErasureCodeTest, create_rule)
 {
   std::unique_ptr<CrushWrapper> c = std::make_unique<CrushWrapper>();
@@ -278,6 +278,221 @@ TEST(ErasureCodeTest, encode)
   }
 }
 
+TEST(ErasureCodeTest, parity_delta)
+{
+  ErasureCodeJerasureReedSolomonVandermonde vandermonde;
+  ErasureCodeJerasureReedSolomonRAID6 raid6;
+  ErasureCodeJerasureCauchyGood cauchy;
+  ErasureCodeProfile profile;
+  profile["k"] = "4";
+  profile["m"] = "2";
+  profile["w"] = "8";
+  vandermonde.init(profile, &cerr);
+  raid6.init(profile, &cerr);
+  profile["packetsize"] = "8";
+  cauchy.init(profile, &cerr);
+  EXPECT_TRUE(vandermonde.supports_parity_delta());
+  EXPECT_TRUE(raid6.supports_parity_delta());
+  EXPECT_FALSE(cauchy.supports_parity_delta());
+
+  ErasureCodeJerasure *codes[] = { &vandermonde, &raid6 };
+  for (auto jerasure : codes) {
+    unsigned k = jerasure->get_data_chunk_count();
+    unsigned n = jerasure->get_chunk_count();
+    unsigned object_size = jerasure->get_alignment() * k * 2;
+    bufferlist in;
+    for (unsigned i = 0; i < object_size; i++)
+      in.append((char)(rand() & 0xff));
+    set<int> want_to_encode;
+    for (unsigned i = 0; i < n; i++)
+      want_to_encode.insert(i);
+    map<int,bufferlist> encoded;
+    EXPECT_EQ(0, jerasure->encode(want_to_encode, in, &encoded));
+    unsigned chunk_size = encoded[0].length();
+
+    // overwrite chunks 1 and 3
+    bufferlist modified;
+    map<int,bufferlist> deltas;
+    for (unsigned i = 0; i < k; i++) {
+      bufferlist chunk;
+      chunk.substr_of(in, i * chunk_size, chunk_size);
+      if (i == 1 || i == 3) {
+	bufferlist updated;
+	for (unsigned j = 0; j < chunk_size; j++)
+	  updated.append((char)(rand() & 0xff));
+	jerasure->encode_delta(chunk, updated, &deltas[i]);
+	EXPECT_EQ(chunk_size, deltas[i].length());
+	chunk = updated;
+      }
+      modified.append(chunk);
+    }
+
+    map<int,bufferlist> parity;
+    for (unsigned i = k; i < n; i++)
+      parity[i].append(encoded[i].c_str(), chunk_size);
+    EXPECT_EQ(0, jerasure->apply_delta(deltas, &parity));
+
+    map<int,bufferlist> reencoded;
+    EXPECT_EQ(0, jerasure->encode(want_to_encode, modified, &reencoded));
+    for (unsigned i = k; i < n; i++) {
+      EXPECT_EQ(chunk_size, parity[i].length());
+      EXPECT_TRUE(parity[i].contents_equal(reencoded[i]));
+    }
+  }
+}
+
+template <typename T>
+void check_simd_matches(ErasureCodeProfile profile)
+{
+  using ceph::jerasure_simd::isa_t;
+  T reference;
+  profile["jerasure-simd"] = "none";
+  ASSERT_EQ(0, reference.init(profile, &cerr));
+  unsigned k = reference.get_data_chunk_count();
+  unsigned n = reference.get_chunk_count();
+  // more than one stripe, not a multiple of the vector sizes
+  unsigned object_size = reference.get_alignment() * 3 + 1;
+  bufferlist in;
+  for (unsigned i = 0; i < object_size; i++)
+    in.append((char)(rand() & 0xff));
+  set<int> want_to_encode;
+  for (unsigned i = 0; i < n; i++)
+    want_to_encode.insert(i);
+  map<int,bufferlist> expected;
+  ASSERT_EQ(0, reference.encode(want_to_encode, in, &expected));
+
+  for (auto isa : { isa_t::avx2, isa_t::avx512,
+		    isa_t::gfni_avx2, isa_t::gfni_avx512 }) {
+    if (!ceph::jerasure_simd::is_supported(isa))
+      continue;
+    T jerasure;
+    profile["jerasure-simd"] = ceph::jerasure_simd::get_name(isa);
+    ASSERT_EQ(0, jerasure.init(profile, &cerr));
+    ASSERT_EQ(isa, jerasure.simd);
+    map<int,bufferlist> encoded;
+    ASSERT_EQ(0, jerasure.encode(want_to_encode, in, &encoded));
+    for (unsigned i = 0; i < n; i++)
+      EXPECT_TRUE(encoded[i].contents_equal(expected[i]))
+	<< profile << " chunk " << i;
+
+    // lose every pair of chunks
+    for (unsigned a = 0; a < n; a++) {
+      for (unsigned b = a + 1; b < n; b++) {
+	map<int,bufferlist> degraded = encoded;
+	degraded.erase(a);
+	degraded.erase(b);
+	map<int,bufferlist> decoded;
+	EXPECT_EQ(0, jerasure._decode(want_to_encode, degraded, &decoded));
+	for (unsigned i = 0; i < n; i++)
+	  EXPECT_TRUE(decoded[i].contents_equal(expected[i]))
+	    << profile << " chunk " << i << " lost " << a << "," << b;
+      }
+    }
+
+    if (jerasure.supports_parity_delta()) {
+      unsigned chunk_size = encoded[0].length();
+      bufferlist updated;
+      for (unsigned i = 0; i < chunk_size; i++)
+	updated.append((char)(rand() & 0xff));
+      map<int,bufferlist> deltas;
+      jerasure.encode_delta(encoded[k - 1], updated, &deltas[k - 1]);
+      map<int,bufferlist> parity, expected_parity;
+      for (unsigned i = k; i < n; i++) {
+	parity[i].append(encoded[i].c_str(), chunk_size);
+	expected_parity[i].append(encoded[i].c_str(), chunk_size);
+      }
+      EXPECT_EQ(0, jerasure.apply_delta(deltas, &parity));
+      EXPECT_EQ(0, reference.apply_delta(deltas, &expected_parity));
+      for (unsigned i = k; i < n; i++)
+	EXPECT_TRUE(parity[i].contents_equal(expected_parity[i]));
+    }
+  }
+}
+
+TEST(ErasureCodeTest, simd)
+{
+  ErasureCodeProfile profile;
+  {
+    ErasureCodeJerasureReedSolomonVandermonde jerasure;
+    profile["jerasure-simd"] = "sse1";
+    EXPECT_EQ(-EINVAL, jerasure.init(profile, &cerr));
+  }
+  for (const char *per_chunk_alignment : { "false", "true" }) {
+    profile.clear();
+    profile["k"] = "5";
+    profile["m"] = "3";
+    profile["w"] = "8";
+    profile["jerasure-per-chunk-alignment"] = per_chunk_alignment;
+    check_simd_matches<ErasureCodeJerasureReedSolomonVandermonde>(profile);
+    profile["packetsize"] = "40";
+    check_simd_matches<ErasureCodeJerasureCauchyGood>(profile);
+  }
+  profile.clear();
+  profile["k"] = "6";
+  profile["m"] = "2";
+  profile["w"] = "8";
+  check_simd_matches<ErasureCodeJerasureReedSolomonRAID6>(profile);
+  profile["w"] = "16";
+  check_simd_matches<ErasureCodeJerasureReedSolomonVandermonde>(profile);
+  profile["k"] = "5";
+  profile["w"] = "7";
+  profile["packetsize"] = "8";
+  check_simd_matches<ErasureCodeJerasureLiberation>(profile);
+}
+
+TEST(ErasureCodeTest, decode_cache)
+{
+  for (const char *simd : { "none", "auto" }) {
+    ErasureCodeJerasureReedSolomonVandermonde jerasure;
+    ErasureCodeProfile profile;
+    profile["k"] = "4";
+    profile["m"] = "2";
+    profile["w"] = "8";
+    profile["jerasure-simd"] = simd;
+    ASSERT_EQ(0, jerasure.init(profile, &cerr));
+    unsigned object_size = jerasure.get_alignment() * 4;
+    bufferlist in;
+    for (unsigned i = 0; i < object_size; i++)
+      in.append((char)(rand() & 0xff));
+    set<int> want_to_read = { 0, 1, 2, 3, 4, 5 };
+    map<int,bufferlist> encoded;
+    ASSERT_EQ(0, jerasure.encode(want_to_read, in, &encoded));
+
+    auto decode = [&](set<int> lost) {
+      map<int,bufferlist> degraded = encoded;
+      for (auto i : lost)
+	degraded.erase(i);
+      map<int,bufferlist> decoded;
+      EXPECT_EQ(0, jerasure._decode(want_to_read, degraded, &decoded));
+      for (auto i : lost)
+	EXPECT_TRUE(decoded[i].contents_equal(encoded[i]));
+    };
+    // only coding chunks lost: nothing to invert
+    decode({ 4, 5 });
+    EXPECT_EQ(0u, jerasure.decode_cache.get_misses());
+    decode({ 1, 4 });
+    EXPECT_EQ(1u, jerasure.decode_cache.get_misses());
+    EXPECT_EQ(0u, jerasure.decode_cache.get_hits());
+    decode({ 1, 4 });
+    EXPECT_EQ(1u, jerasure.decode_cache.get_hits());
+    // the same data chunk lost with another coding chunk reads
+    // different chunks
+    decode({ 1, 5 });
+    EXPECT_EQ(2u, jerasure.decode_cache.get_misses());
+    decode({ 0, 3 });
+    decode({ 1, 4 });
+    EXPECT_EQ(3u, jerasure.decode_cache.get_misses());
+    EXPECT_EQ(2u, jerasure.decode_cache.get_hits());
+    EXPECT_EQ(3u, jerasure.decode_cache.size());
+    // as seen through the interface by the OSD
+    uint64_t hits, misses;
+    const ErasureCodeInterface &interface = jerasure;
+    interface.get_decode_cache_stats(&hits, &misses);
+    EXPECT_EQ(2u, hits);
+    EXPECT_EQ(3u, misses);
+  }
+}
+
 TEST(ErasureCodeTest, create_rule)
 {
   std::unique_ptr<CrushWrapper> c = std::make_unique<CrushWrapper>();
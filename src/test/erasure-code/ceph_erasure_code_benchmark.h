@@ -25,6 +25,7 @@
 #include <boost/intrusive_ptr.hpp>
 
 #include "include/buffer.h"
+#include "include/utime.h"
 
 #include "common/ceph_context.h"
 
@@ -46,6 +47,7 @@ class ErasureCodeBench {
   ceph::ErasureCodeProfile profile;
 
   bool verbose;
+  bool throughput;
   boost::intrusive_ptr<CephContext> cct;
 public:
   int setup(int argc, char** argv);
@@ -57,6 +59,9 @@ public:
 		      ErasureCodeInterfaceRef erasure_code);
   int decode();
   int encode();
+  int delta();
+  int repair();
+  void report(utime_t begin_time, utime_t end_time);
 };
 
 #endif
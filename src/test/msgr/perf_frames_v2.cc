@@ -0,0 +1,208 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * Assembles and disassembles msgr2 message frames the way ProtocolV2
+ * does, without any networking, and reports the throughput of both
+ * sides, e.g.
+ *
+ *   ceph_perf_frames_v2 4096 64 1000
+ *
+ * assembles 1000 batches of 64 secure msgr2.1 frames, each with a 4 KiB
+ * data segment, then disassembles them.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "auth/Auth.h"
+#include "common/ceph_argparse.h"
+#include "common/ceph_time.h"
+#include "global/global_init.h"
+#include "global/global_context.h"
+#include "msg/async/compression_meta.h"
+#include "msg/async/frames_v2.h"
+
+using namespace std;
+using namespace ceph::msgr::v2;
+
+static void usage(const char *name) {
+  cout << "usage: " << name
+       << " <data bytes> <frames per batch> <batches>"
+       << " [--crc] [--rev0] [--front-bytes N] [--fragment-bytes N]\n"
+       << "\n"
+       << "  --crc             crc mode instead of secure mode\n"
+       << "  --rev0            msgr2.0 framing instead of msgr2.1\n"
+       << "  --front-bytes     size of the front segment (default 256)\n"
+       << "  --fragment-bytes  split the segments in buffers of that size\n"
+       << std::endl;
+}
+
+static bufferlist make_segment(size_t len, size_t fragment_len) {
+  bufferlist bl;
+  for (size_t off = 0; off < len; off += fragment_len) {
+    size_t n = std::min(fragment_len, len - off);
+    bufferptr p(buffer::create_small_page_aligned(n));
+    for (size_t i = 0; i < n; i++) {
+      p[i] = static_cast<char>(off + i);
+    }
+    bl.append(std::move(p));
+  }
+  return bl;
+}
+
+static bool disassemble_frame(FrameAssembler& frame_asm, bufferlist& frame_bl,
+                              segment_bls_t& segment_bls) {
+  bufferlist preamble_bl;
+  frame_bl.splice(0, frame_asm.get_preamble_onwire_len(), &preamble_bl);
+  frame_asm.disassemble_preamble(preamble_bl);
+  do {
+    size_t seg_idx = segment_bls.size();
+    segment_bls.emplace_back();
+    uint32_t onwire_len = frame_asm.get_segment_onwire_len(seg_idx);
+    if (onwire_len > 0) {
+      frame_bl.splice(0, onwire_len, &segment_bls.back());
+    }
+  } while (segment_bls.size() < frame_asm.get_num_segments());
+  bufferlist epilogue_bl;
+  uint32_t epilogue_onwire_len = frame_asm.get_epilogue_onwire_len();
+  if (epilogue_onwire_len > 0) {
+    frame_bl.splice(0, epilogue_onwire_len, &epilogue_bl);
+  }
+  return frame_asm.disassemble_segments(preamble_bl, segment_bls.data(),
+                                        epilogue_bl);
+}
+
+int main(int argc, char **argv)
+{
+  auto args = argv_to_vec(argc, argv);
+
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_CLIENT,
+                         CODE_ENVIRONMENT_UTILITY,
+                         CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  bool secure = true;
+  bool is_rev1 = true;
+  size_t front_len = 256;
+  size_t fragment_len = 0;
+  std::vector<const char*> pos;
+  std::string val;
+  for (auto i = args.begin(); i != args.end(); ) {
+    if (ceph_argparse_double_dash(args, i)) {
+      break;
+    } else if (ceph_argparse_flag(args, i, "--crc", (char*)nullptr)) {
+      secure = false;
+    } else if (ceph_argparse_flag(args, i, "--rev0", (char*)nullptr)) {
+      is_rev1 = false;
+    } else if (ceph_argparse_witharg(args, i, &val, "--front-bytes",
+                                     (char*)nullptr)) {
+      front_len = std::stoul(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--fragment-bytes",
+                                     (char*)nullptr)) {
+      fragment_len = std::stoul(val);
+    } else {
+      pos.push_back(*i);
+      ++i;
+    }
+  }
+  if (pos.size() < 3) {
+    usage(argv[0]);
+    return 1;
+  }
+  size_t data_len = std::stoul(pos[0]);
+  int frames_per_batch = std::stoi(pos[1]);
+  int batches = std::stoi(pos[2]);
+  if (fragment_len == 0) {
+    fragment_len = std::max(front_len, data_len) + 1;
+  }
+
+  ceph::crypto::onwire::rxtx_t tx_crypto;
+  ceph::crypto::onwire::rxtx_t rx_crypto;
+  if (secure) {
+    AuthConnectionMeta auth_meta;
+    auth_meta.con_mode = CEPH_CON_MODE_SECURE;
+    auth_meta.connection_secret.resize(64);
+    g_ceph_context->random()->get_bytes(auth_meta.connection_secret.data(),
+                                        auth_meta.connection_secret.size());
+    tx_crypto = ceph::crypto::onwire::rxtx_t::create_handler_pair(
+      g_ceph_context, auth_meta, is_rev1, false);
+    rx_crypto = ceph::crypto::onwire::rxtx_t::create_handler_pair(
+      g_ceph_context, auth_meta, is_rev1, true);
+  }
+  ceph::compression::onwire::rxtx_t tx_comp;
+  ceph::compression::onwire::rxtx_t rx_comp;
+  FrameAssembler tx_frame_asm(&tx_crypto, is_rev1, true, &tx_comp);
+  FrameAssembler rx_frame_asm(&rx_crypto, is_rev1, true, &rx_comp);
+
+  cout << " mode " << (is_rev1 ? "msgr2.1" : "msgr2.0")
+       << (secure ? "-secure" : "-crc") << std::endl;
+  cout << " front bytes " << front_len << std::endl;
+  cout << " data bytes " << data_len << std::endl;
+  cout << " fragment bytes " << fragment_len << std::endl;
+  cout << " frames per batch " << frames_per_batch << std::endl;
+  cout << " batches " << batches << std::endl;
+
+  const auto front = make_segment(front_len, fragment_len);
+  const auto data = make_segment(data_len, fragment_len);
+  ceph_msg_header2 header2{};
+  ceph::timespan asm_time = ceph::timespan::zero();
+  ceph::timespan disasm_time = ceph::timespan::zero();
+  uint64_t logical_bytes = 0;
+  uint64_t onwire_bytes = 0;
+  for (int b = 0; b < batches; b++) {
+    bufferlist onwire_bl;
+    auto start = ceph::mono_clock::now();
+    for (int f = 0; f < frames_per_batch; f++) {
+      auto frame = MessageFrame::Encode(header2, front, {}, data);
+      auto bl = frame.get_buffer(tx_frame_asm);
+      // same as ProtocolV2::append_frame()
+      if (secure) {
+        for (const auto& p : bl.buffers()) {
+          onwire_bl.append(p, 0, p.length());
+        }
+      } else {
+        onwire_bl.claim_append(bl);
+      }
+      logical_bytes += tx_frame_asm.get_frame_logical_len();
+    }
+    if (tx_crypto.tx) {
+      tx_crypto.tx->end_tx_batch();
+    }
+    auto mid = ceph::mono_clock::now();
+    onwire_bytes += onwire_bl.length();
+    for (int f = 0; f < frames_per_batch; f++) {
+      segment_bls_t segment_bls;
+      if (!disassemble_frame(rx_frame_asm, onwire_bl, segment_bls)) {
+        cerr << "frame " << f << " of batch " << b << " was aborted"
+             << std::endl;
+        return 1;
+      }
+    }
+    auto end = ceph::mono_clock::now();
+    asm_time += mid - start;
+    disasm_time += end - mid;
+  }
+
+  auto gbps = [](uint64_t bytes, ceph::timespan t) {
+    return bytes / std::max(1e-9, std::chrono::duration<double>(t).count()) /
+      (1ull << 30);
+  };
+  cout << " logical bytes " << logical_bytes
+       << " onwire bytes " << onwire_bytes << std::endl;
+  cout << " assemble " << asm_time << " " << gbps(logical_bytes, asm_time)
+       << " GiB/s" << std::endl;
+  cout << " disassemble " << disasm_time << " "
+       << gbps(logical_bytes, disasm_time) << " GiB/s" << std::endl;
+  return 0;
+}
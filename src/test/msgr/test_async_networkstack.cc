@@ -26,6 +26,7 @@
 
 #include "acconfig.h"
 #include "common/config_obs.h"
+#include "common/perf_counters.h"
 #include "include/Context.h"
 #include "msg/async/Event.h"
 #include "msg/async/Stack.h"
@@ -1042,6 +1043,94 @@ class StressFactory {
   }
 };
 
+TEST_P(NetworkWorkerTest, ZeroCopyTest) {
+  if (strcmp(GetParam(), "posix")) {
+    GTEST_SKIP() << "only the posix stack uses MSG_ZEROCOPY";
+  }
+  g_ceph_context->_conf.set_val_or_die("ms_tcp_zerocopy", "true");
+  g_ceph_context->_conf.set_val_or_die("ms_tcp_zerocopy_min_bytes", "4096");
+  entity_addr_t bind_addr;
+  ASSERT_TRUE(bind_addr.parse(get_addr().c_str()));
+
+  exec_events([this, bind_addr](Worker *worker) mutable {
+    if (worker->id != 0)
+      return;
+    EventCenter *center = &worker->center;
+    entity_addr_t cli_addr;
+    SocketOptions options;
+    ServerSocket bind_socket;
+    ASSERT_EQ(0, worker->listen(bind_addr, 0, options, &bind_socket));
+
+    ConnectedSocket cli_socket, srv_socket;
+    ASSERT_EQ(0, worker->connect(bind_addr, options, &cli_socket));
+    {
+      C_poll cb(center);
+      center->create_file_event(bind_socket.fd(), EVENT_READABLE, &cb);
+      ASSERT_TRUE(cb.poll(500));
+      center->delete_file_event(bind_socket.fd(), EVENT_READABLE);
+    }
+    ASSERT_EQ(0, bind_socket.accept(&srv_socket, options, &cli_addr, worker));
+    {
+      C_poll cb(center);
+      center->create_file_event(cli_socket.fd(), EVENT_READABLE, &cb);
+      ssize_t r = cli_socket.is_connected();
+      if (r == 0) {
+        ASSERT_TRUE(cb.poll(500));
+        r = cli_socket.is_connected();
+      }
+      ASSERT_EQ(1, r);
+      center->delete_file_event(cli_socket.fd(), EVENT_READABLE);
+    }
+
+    // the sent buffers must stay valid until the kernel is done with them,
+    // whatever happens to the bufferlist handed to send()
+    const unsigned len = 8 << 20;
+    bufferptr ptr(buffer::create_page_aligned(len));
+    for (unsigned i = 0; i < len; i++) {
+      ptr[i] = (char)(i * 7 + i / 4096);
+    }
+    bufferlist to_send;
+    to_send.push_back(ptr);
+    string received;
+    char buf[65536];
+    C_poll cb(center);
+    center->create_file_event(srv_socket.fd(), EVENT_READABLE, &cb);
+    while (received.size() < len) {
+      if (to_send.length()) {
+        ASSERT_LE(0, cli_socket.send(to_send, false));
+      }
+      ssize_t r = srv_socket.read(buf, sizeof(buf));
+      if (r == -EAGAIN) {
+        cb.poll(10);
+        cb.reset();
+        continue;
+      }
+      ASSERT_LT(0, r);
+      received.append(buf, r);
+    }
+    ASSERT_EQ(0, memcmp(received.data(), ptr.c_str(), len));
+
+    PerfCounters *logger = worker->get_perf_counter();
+    if (logger->get(l_msgr_send_zerocopy_bytes) > 0) {
+      // the completions come in through the error queue of the socket
+      for (int i = 0; i < 1000; i++) {
+        cli_socket.reap_send_completions();
+        if (logger->get(l_msgr_send_zerocopy_pending_bytes) == 0)
+          break;
+        usleep(1000);
+      }
+      ASSERT_EQ(0u, logger->get(l_msgr_send_zerocopy_pending_bytes));
+    } else {
+      cerr << "MSG_ZEROCOPY is not supported here" << std::endl;
+    }
+    center->delete_file_event(srv_socket.fd(), EVENT_READABLE);
+    srv_socket.close();
+    cli_socket.close();
+    bind_socket.abort_accept();
+  });
+  g_ceph_context->_conf.set_val_or_die("ms_tcp_zerocopy", "false");
+}
+
 TEST_P(NetworkWorkerTest, StressTest) {
   StressFactory factory(stack, get_addr(), 16, 16, 10000, 1024);
   StressFactory *f = &factory;
@@ -279,6 +279,53 @@ TEST_P(RoundTripTest, Reuse) {
   }
 }
 
+static bufferlist fragment(const bufferlist& bl, size_t len) {
+  bufferlist fragmented;
+  for (size_t off = 0; off < bl.length(); off += len) {
+    bufferlist piece;
+    piece.substr_of(bl, off, std::min(len, bl.length() - off));
+    piece.rebuild();
+    fragmented.claim_append(piece);
+  }
+  return fragmented;
+}
+
+TEST_P(RoundTripTest, Batch) {
+  // in secure mode, frames assembled back to back share ciphertext
+  // buffers and are merged into a single stream like ProtocolV2 does
+  const int num_frames = 8;
+  bufferlist onwire_bl;
+  for (int i = 0; i < num_frames; i++) {
+    // odd frames come in small fragments
+    auto seg = [i](const bufferlist& bl) {
+      return i % 2 ? fragment(bl, 7) : bl;
+    };
+    auto tx_frame = TestFrame::Encode(seg(m_header), seg(m_front),
+                                      seg(m_middle), seg(m_data));
+    auto bl = tx_frame.get_buffer(m_tx_frame_asm);
+    for (const auto& p : bl.buffers()) {
+      onwire_bl.append(p, 0, p.length());
+    }
+  }
+  if (m_tx_crypto.tx) {
+    m_tx_crypto.tx->end_tx_batch();
+  }
+
+  for (int i = 0; i < num_frames; i++) {
+    Tag rx_tag;
+    segment_bls_t rx_segment_bls;
+    ASSERT_TRUE(disassemble_frame(m_rx_frame_asm, onwire_bl, rx_tag,
+                                  rx_segment_bls));
+    EXPECT_EQ(TestFrame::tag, rx_tag);
+    auto rx_frame = TestFrame::Decode(rx_segment_bls);
+    EXPECT_TRUE(m_header.contents_equal(rx_frame.header()));
+    EXPECT_TRUE(m_front.contents_equal(rx_frame.front()));
+    EXPECT_TRUE(m_middle.contents_equal(rx_frame.middle()));
+    EXPECT_TRUE(m_data.contents_equal(rx_frame.data()));
+  }
+  EXPECT_EQ(0, onwire_bl.length());
+}
+
 static const round_trip_instance_t round_trip_instances[] = {
   // first segment is empty
   { 0,   0,   0,   0, 1, {{32,  0,  17,   0,   0,  0},
@@ -2083,6 +2083,38 @@ TEST_P(MessengerTest, SyntheticStressTest1) {
 }
 
 
+TEST_P(MessengerTest, SyntheticCoalesceTest) {
+  g_ceph_context->_conf.set_val("ms_async_coalesce_bytes", "65536");
+  g_ceph_context->_conf.set_val("ms_inject_socket_failures", "100");
+  SyntheticWorkload test_msg(8, 32, GetParam(), 100,
+                             Messenger::Policy::stateful_server(0),
+                             Messenger::Policy::lossless_client(0));
+  for (int i = 0; i < 20; ++i) {
+    test_msg.generate_connection();
+  }
+  gen_type rng(time(NULL));
+  for (int i = 0; i < 2000; ++i) {
+    if (!(i % 100)) {
+      lderr(g_ceph_context) << "Op " << i << ": " << dendl;
+      test_msg.print_internal_state();
+    }
+    boost::uniform_int<> true_false(0, 99);
+    int val = true_false(rng);
+    if (val > 95) {
+      test_msg.drop_connection();
+      test_msg.generate_connection();
+    } else if (val > 2) {
+      // bursts, so that messages queue up on the connections
+      test_msg.send_message();
+    } else {
+      usleep(rand() % 1000 + 500);
+    }
+  }
+  test_msg.wait_for_done();
+  g_ceph_context->_conf.set_val("ms_inject_socket_failures", "0");
+  g_ceph_context->_conf.set_val("ms_async_coalesce_bytes", "0");
+}
+
 TEST_P(MessengerTest, SyntheticInjectTest) {
   uint64_t dispatch_throttle_bytes = g_ceph_context->_conf->ms_dispatch_throttle_bytes;
   g_ceph_context->_conf.set_val("ms_inject_socket_failures", "30");
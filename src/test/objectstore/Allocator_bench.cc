@@ -4,11 +4,14 @@
  * In memory space allocator benchmarks.
  * Author: Igor Fedotov, ifedotov@suse.com
  */
+#include <algorithm>
 #include <iostream>
+#include <thread>
 #include <boost/scoped_ptr.hpp>
 #include <gtest/gtest.h>
 
 #include "common/Cond.h"
+#include "common/ceph_time.h"
 #include "common/errno.h"
 #include "include/stringify.h"
 #include "include/Context.h"
@@ -328,6 +331,73 @@ TEST_P(AllocTest, test_alloc_bench_10_300)
   doOverwriteTest(capacity, prefill, overwrite);
 }
 
+TEST_P(AllocTest, test_alloc_bench_frag_latency)
+{
+  // concurrent small allocations and random releases from several threads,
+  // reporting allocation latency and how fragmented the free space ends up
+  uint64_t capacity = uint64_t(64) * 1024 * 1024 * 1024;
+  uint64_t alloc_unit = 4096;
+  const unsigned num_threads = 8;
+  const unsigned ops_per_thread = 200000;
+  const size_t max_live = 4096;
+  init_alloc(capacity, alloc_unit);
+  alloc->init_add_free(0, capacity);
+
+  vector<vector<uint64_t>> lat(num_threads);
+  vector<vector<PExtentVector>> live(num_threads);
+  vector<std::thread> threads;
+  auto start = ceph::mono_clock::now();
+  for (unsigned t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      gen_type rng(t);
+      boost::uniform_int<> u1(0, 4);
+      lat[t].reserve(ops_per_thread);
+      for (unsigned i = 0; i < ops_per_thread; ++i) {
+	uint64_t want = alloc_unit << u1(rng);
+	PExtentVector tmp;
+	auto t0 = ceph::mono_clock::now();
+	auto r = alloc->allocate(want, alloc_unit, 0, 0, &tmp);
+	lat[t].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+	  ceph::mono_clock::now() - t0).count());
+	EXPECT_EQ((int64_t)want, r);
+	live[t].push_back(std::move(tmp));
+	if (live[t].size() > max_live) {
+	  auto victim = rng() % live[t].size();
+	  alloc->release(live[t][victim]);
+	  std::swap(live[t][victim], live[t].back());
+	  live[t].pop_back();
+	}
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  double secs = ceph::to_seconds<double>(ceph::mono_clock::now() - start);
+
+  vector<uint64_t> all;
+  for (auto& l : lat) {
+    all.insert(all.end(), l.begin(), l.end());
+  }
+  std::sort(all.begin(), all.end());
+  auto pct = [&](double p) {
+    return all[std::min(all.size() - 1, size_t(p * all.size()))];
+  };
+  std::cout << GetParam() << ": " << all.size() << " allocations in "
+	    << secs << "s, latency ns p50 " << pct(.5)
+	    << " p99 " << pct(.99) << " p99.9 " << pct(.999)
+	    << " max " << all.back() << std::endl;
+  std::cout << GetParam() << ": fragmentation " << alloc->get_fragmentation()
+	    << " score " << alloc->get_fragmentation_score() << std::endl;
+
+  for (auto& l : live) {
+    for (auto& e : l) {
+      alloc->release(e);
+    }
+  }
+  EXPECT_EQ(capacity, alloc->get_free());
+}
+
 TEST_P(AllocTest, mempoolAccounting)
 {
   uint64_t bytes = mempool::bluestore_alloc::allocated_bytes();
@@ -365,4 +435,5 @@ TEST_P(AllocTest, mempoolAccounting)
 INSTANTIATE_TEST_SUITE_P(
   Allocator,
   AllocTest,
-  ::testing::Values("stupid", "bitmap", "avl", "btree", "hybrid"));
+  ::testing::Values("stupid", "bitmap", "avl", "btree", "hybrid",
+		    "hybrid_cached"));
@@ -0,0 +1,91 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Onode cache lookup benchmark: hit throughput with and without
+ * lockless lookups, over a growing number of threads.
+ */
+#include <iostream>
+#include <random>
+#include <thread>
+#include <gtest/gtest.h>
+
+#include "common/ceph_time.h"
+#include "common/perf_counters.h"
+#include "global/global_context.h"
+#include "include/stringify.h"
+#include "os/bluestore/BlueStore.h"
+
+using namespace std;
+
+class OnodeCacheBench : public ::testing::TestWithParam<bool> {
+};
+
+TEST_P(OnodeCacheBench, lookup_hits)
+{
+  const bool lockless = GetParam();
+  const unsigned num_onodes = 10000;
+  const unsigned lookups_per_thread = 1000000;
+
+  g_ceph_context->_conf.set_val_or_die("bluestore_onode_lockless_lookup",
+				       lockless ? "true" : "false");
+
+  PerfCountersBuilder b(g_ceph_context, "onode_cache_bench",
+			l_bluestore_pinned_onodes, l_bluestore_onode_shard_hits);
+  b.add_u64_counter(l_bluestore_onode_hits, "onode_hits", "");
+  b.add_u64_counter(l_bluestore_onode_misses, "onode_misses", "");
+  std::unique_ptr<PerfCounters> logger(b.create_perf_counters());
+
+  BlueStore store(g_ceph_context, "", 4096);
+  BlueStore::OnodeCacheShard *oc = BlueStore::OnodeCacheShard::create(
+    g_ceph_context, "lru", logger.get());
+  BlueStore::BufferCacheShard *bc = BlueStore::BufferCacheShard::create(
+    g_ceph_context, "lru", NULL);
+  oc->set_max(num_onodes * 2);
+  ASSERT_EQ(lockless, oc->lockless_lookup);
+
+  auto coll = ceph::make_ref<BlueStore::Collection>(&store, oc, bc, coll_t());
+  vector<ghobject_t> oids;
+  for (unsigned i = 0; i < num_onodes; ++i) {
+    ghobject_t oid(hobject_t(sobject_t("Object " + stringify(i), CEPH_NOSNAP)));
+    BlueStore::OnodeRef o(new BlueStore::Onode(coll.get(), oid, string()));
+    o->exists = true;
+    coll->onode_space.add_onode(oid, o);
+    oids.push_back(oid);
+  }
+
+  for (unsigned num_threads : {1, 2, 4, 8, 16, 32, 64}) {
+    std::atomic<uint64_t> misses = {0};
+    vector<std::thread> threads;
+    auto start = ceph::mono_clock::now();
+    for (unsigned t = 0; t < num_threads; ++t) {
+      threads.emplace_back([&, t] {
+	std::mt19937 rng(t);
+	uint64_t m = 0;
+	for (unsigned i = 0; i < lookups_per_thread; ++i) {
+	  auto o = coll->onode_space.lookup(oids[rng() % oids.size()]);
+	  if (!o) {
+	    ++m;
+	  }
+	}
+	misses += m;
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    double secs = ceph::to_seconds<double>(ceph::mono_clock::now() - start);
+    ASSERT_EQ(0u, misses.load());
+    std::cout << (lockless ? "lockless" : "locked")
+	      << " threads " << num_threads
+	      << " lookups " << (uint64_t)num_threads * lookups_per_thread
+	      << " in " << secs << "s, "
+	      << (uint64_t)(num_threads * lookups_per_thread / secs)
+	      << " hits/s" << std::endl;
+  }
+  coll->onode_space.clear();
+}
+
+INSTANTIATE_TEST_SUITE_P(
+  OnodeCache,
+  OnodeCacheBench,
+  ::testing::Values(false, true));
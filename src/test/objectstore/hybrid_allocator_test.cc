@@ -4,6 +4,7 @@
 #include <iostream>
 #include <gtest/gtest.h>
 
+#include "os/bluestore/CachedHybridAllocator.h"
 #include "os/bluestore/HybridAllocator.h"
 
 class TestHybridAllocator : public HybridAllocator {
@@ -229,3 +230,74 @@ TEST(HybridAllocator, fragmentation)
     ASSERT_EQ(0.5 * 7 / 8 + 1.0 / 8, ha.get_fragmentation());
   }
 }
+
+TEST(CachedHybridAllocator, cache)
+{
+  uint64_t block_size = 0x1000;
+  uint64_t capacity = 0x1000 * 0x1000; // = 16M
+  CachedHybridAllocator ha(g_ceph_context, capacity, block_size,
+    64 * _1m, "test_cached_hybrid_allocator");
+  ha.init_add_free(0, capacity);
+
+  // the first allocation refills the cache of its size class
+  PExtentVector extents;
+  ASSERT_EQ(0x2000, ha.allocate(0x2000, block_size, 0, 0, &extents));
+  ASSERT_EQ(1u, extents.size());
+  ASSERT_EQ(0x2000u, extents[0].length);
+  ASSERT_EQ(capacity - 0x2000, ha.get_free());
+  ASSERT_LT(0u, ha.get_cached_bytes());
+
+  // cached extents are still reported as free
+  uint64_t free = 0;
+  ha.foreach([&](uint64_t offset, uint64_t length) {
+    free += length;
+  });
+  ASSERT_EQ(capacity - 0x2000, free);
+
+  // a released small extent goes to a cache, not to the tree
+  auto cached = ha.get_cached_bytes();
+  ha.release(extents);
+  ASSERT_EQ(capacity, ha.get_free());
+  ASSERT_EQ(cached + 0x2000, ha.get_cached_bytes());
+  extents.clear();
+  ASSERT_EQ(0x2000, ha.allocate(0x2000, block_size, 0, 0, &extents));
+
+  // larger requests bypass the cache
+  PExtentVector big;
+  ASSERT_EQ((int64_t)_1m, ha.allocate(_1m, block_size, 0, 0, &big));
+  ASSERT_EQ(capacity - 0x2000 - _1m, ha.get_free());
+  ha.release(big);
+  ha.release(extents);
+
+  // shutdown hands all cached extents back
+  ha.shutdown();
+  ASSERT_EQ(0u, ha.get_cached_bytes());
+}
+
+TEST(CachedHybridAllocator, flush_on_shortfall)
+{
+  uint64_t block_size = 0x1000;
+  uint64_t capacity = 0x1000 * 0x1000; // = 16M
+  CachedHybridAllocator ha(g_ceph_context, capacity, block_size,
+    64 * _1m, "test_cached_hybrid_allocator");
+  ha.init_add_free(0, capacity);
+
+  PExtentVector extents;
+  ASSERT_EQ(0x2000, ha.allocate(0x2000, block_size, 0, 0, &extents));
+  ASSERT_LT(0u, ha.get_cached_bytes());
+
+  // the rest of the device is only available once the caches are flushed
+  PExtentVector rest;
+  uint64_t want = capacity - 0x2000;
+  ASSERT_EQ((int64_t)want, ha.allocate(want, block_size, 0, 0, &rest));
+  ASSERT_EQ(0u, ha.get_cached_bytes());
+  ASSERT_EQ(0u, ha.get_free());
+  uint64_t got = 0;
+  for (auto& e : rest) {
+    got += e.length;
+  }
+  ASSERT_EQ(want, got);
+  ha.release(rest);
+  ha.release(extents);
+  ha.shutdown();
+}
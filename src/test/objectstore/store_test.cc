@@ -17,6 +17,7 @@
 #include <string.h>
 #include <iostream>
 #include <memory>
+#include <thread>
 #include <time.h>
 #include <sys/mount.h>
 #include <boost/random/mersenne_twister.hpp>
@@ -1482,6 +1483,159 @@ TEST_P(StoreTest, SimpleObjectTest) {
 
 #if defined(WITH_BLUESTORE)
 
+TEST_P(StoreTestSpecificAUSize, ShardedKVSync) {
+  if(string(GetParam()) != "bluestore")
+    return;
+
+  SetVal(g_conf(), "bluestore_kv_sync_shards", "3");
+  g_conf().apply_changes(nullptr);
+  StartDeferred(4096);
+
+  int r;
+  const int num_colls = 6;
+  const int num_objects = 50;
+  // collections map to different kv sync shards by their sequencer
+  vector<coll_t> cids;
+  vector<ObjectStore::CollectionHandle> chs;
+  for (int i = 0; i < num_colls; ++i) {
+    cids.push_back(coll_t(spg_t(pg_t(0, i + 1), shard_id_t::NO_SHARD)));
+    chs.push_back(store->create_new_collection(cids.back()));
+    ObjectStore::Transaction t;
+    t.create_collection(cids.back(), 0);
+    r = queue_transaction(store, chs.back(), std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  auto obj = [](int c, int o) {
+    return ghobject_t(hobject_t(sobject_t("Object " + stringify(o),
+                                          CEPH_NOSNAP),
+                                "", o, c + 1, ""));
+  };
+  auto data = [](int c, int o) {
+    bufferlist bl;
+    bl.append(string(4096 + o, 'a' + (c + o) % 26));
+    return bl;
+  };
+  // interleave small writes (deferred and not) across all collections
+  for (int o = 0; o < num_objects; ++o) {
+    for (int c = 0; c < num_colls; ++c) {
+      ObjectStore::Transaction t;
+      bufferlist bl = data(c, o);
+      t.write(cids[c], obj(c, o), 0, bl.length(), bl);
+      r = queue_transaction(store, chs[c], std::move(t));
+      ASSERT_EQ(r, 0);
+    }
+  }
+  chs.clear();
+  r = store->umount();
+  ASSERT_EQ(r, 0);
+  r = store->mount();
+  ASSERT_EQ(r, 0);
+  for (int c = 0; c < num_colls; ++c) {
+    auto ch = store->open_collection(cids[c]);
+    ASSERT_TRUE(ch);
+    for (int o = 0; o < num_objects; ++o) {
+      bufferlist exp = data(c, o), in;
+      r = store->read(ch, obj(c, o), 0, exp.length(), in);
+      ASSERT_EQ((int)exp.length(), r);
+      ASSERT_TRUE(bl_eq(exp, in));
+    }
+    ObjectStore::Transaction t;
+    for (int o = 0; o < num_objects; ++o) {
+      t.remove(cids[c], obj(c, o));
+    }
+    t.remove_collection(cids[c]);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
+TEST_P(StoreTestSpecificAUSize, OnlineDefrag) {
+  if(string(GetParam()) != "bluestore")
+    return;
+
+  SetVal(g_conf(), "bluestore_compression_mode", "none");
+  SetVal(g_conf(), "bluestore_defrag_min_fragments", "4");
+  SetVal(g_conf(), "bluestore_defrag_max_bytes_per_sec", "0");
+  g_conf().apply_changes(nullptr);
+  StartDeferred(4096);
+  BlueStore* bstore = dynamic_cast<BlueStore*> (store.get());
+  ASSERT_TRUE(bstore);
+
+  int r;
+  coll_t cid;
+  ghobject_t a(hobject_t(sobject_t("Object a", CEPH_NOSNAP)));
+  ghobject_t b(hobject_t(sobject_t("Object b", CEPH_NOSNAP)));
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // interleave appends to both objects so that their blocks alternate on
+  // disk, then drop one of them
+  bufferlist expected;
+  for (int i = 0; i < 32; ++i) {
+    for (auto& oid : {a, b}) {
+      ObjectStore::Transaction t;
+      bufferlist bl;
+      bl.append(string(4096, 'a' + i % 26));
+      t.write(cid, oid, i * 4096, bl.length(), bl);
+      if (oid == a) {
+        expected.append(bl);
+      }
+      r = queue_transaction(store, ch, std::move(t));
+      ASSERT_EQ(r, 0);
+    }
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, b);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+
+  auto dump = [&]() {
+    JSONFormatter f;
+    bstore->defrag_dump(&f);
+    stringstream ss;
+    f.flush(ss);
+    return ss.str();
+  };
+  stringstream err;
+  ASSERT_EQ(0, bstore->defrag_start(err));
+  while (dump().find("\"running\":false") == string::npos) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  string status = dump();
+  cout << status << std::endl;
+  ASSERT_NE(string::npos, status.find("\"objects_rewritten\":1,"));
+
+  bufferlist in;
+  r = store->read(ch, a, 0, expected.length(), in);
+  ASSERT_EQ((int)expected.length(), r);
+  ASSERT_TRUE(bl_eq(expected, in));
+
+  // the rewrite survives a remount
+  ch.reset();
+  r = store->umount();
+  ASSERT_EQ(r, 0);
+  r = store->mount();
+  ASSERT_EQ(r, 0);
+  ch = store->open_collection(cid);
+  in.clear();
+  r = store->read(ch, a, 0, expected.length(), in);
+  ASSERT_EQ((int)expected.length(), r);
+  ASSERT_TRUE(bl_eq(expected, in));
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, a);
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 TEST_P(StoreTestSpecificAUSize, ReproBug41901Test) {
   if(string(GetParam()) != "bluestore")
     return;
@@ -2367,6 +2521,68 @@ TEST_P(StoreTest, ManySmallWrite) {
   }
 }
 
+TEST_P(StoreTest, ReadBatch) {
+  int r;
+  coll_t cid;
+  const int num_objects = 16;
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    cerr << "Creating collection " << cid << std::endl;
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  vector<ghobject_t> oids;
+  vector<bufferlist> data;
+  for (int i = 0; i < num_objects; ++i) {
+    oids.emplace_back(hobject_t(sobject_t("Object " + stringify(i),
+                                          CEPH_NOSNAP)));
+    bufferlist bl;
+    bl.append(string(4096 * (1 + i % 3), 'a' + i));
+    data.push_back(bl);
+    ObjectStore::Transaction t;
+    t.write(cid, oids.back(), 0, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ghobject_t missing(hobject_t(sobject_t("Missing", CEPH_NOSNAP)));
+  {
+    vector<ObjectStore::read_batch_op_t> ops;
+    for (int i = 0; i < num_objects; ++i) {
+      ops.emplace_back(oids[i], 0, data[i].length());
+    }
+    ops.emplace_back(oids[0], 1024, 2048);
+    ops.emplace_back(oids[1], 0, 0);          // whole object
+    ops.emplace_back(oids[2], 1 << 20, 4096); // past eof
+    ops.emplace_back(missing, 0, 4096);
+    r = store->read_batch(ch, ops);
+    ASSERT_EQ(r, 0);
+    for (int i = 0; i < num_objects; ++i) {
+      ASSERT_EQ((int)data[i].length(), ops[i].rval);
+      ASSERT_TRUE(bl_eq(data[i], ops[i].bl));
+    }
+    bufferlist exp;
+    exp.substr_of(data[0], 1024, 2048);
+    ASSERT_EQ(2048, ops[num_objects].rval);
+    ASSERT_TRUE(bl_eq(exp, ops[num_objects].bl));
+    ASSERT_EQ((int)data[1].length(), ops[num_objects + 1].rval);
+    ASSERT_TRUE(bl_eq(data[1], ops[num_objects + 1].bl));
+    ASSERT_EQ(0, ops[num_objects + 2].rval);
+    ASSERT_EQ(-ENOENT, ops[num_objects + 3].rval);
+  }
+  {
+    ObjectStore::Transaction t;
+    for (auto& oid : oids) {
+      t.remove(cid, oid);
+    }
+    t.remove_collection(cid);
+    cerr << "Cleaning" << std::endl;
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 TEST_P(StoreTest, MultiSmallWriteSameBlock) {
   int r;
   coll_t cid;
@@ -2335,6 +2335,30 @@ TEST(bluestore_blob_use_tracker_t, mempool_stats_test)
   }
 }
 
+TEST(bluestore_blob_t, single_extent_inline)
+{
+  using mempool::bluestore_cache_other::allocated_items;
+  using mempool::bluestore_cache_other::allocated_bytes;
+  uint64_t other_items0 = allocated_items();
+  uint64_t other_bytes0 = allocated_bytes();
+  {
+    bluestore_blob_t b;
+    b.allocated_test(bluestore_pextent_t(0x10000, 0x1000));
+    // a single pextent is stored inline
+    ASSERT_EQ(1u, b.get_extents().size());
+    ASSERT_EQ(allocated_items(), other_items0);
+    ASSERT_EQ(allocated_bytes(), other_bytes0);
+
+    b.allocated_test(bluestore_pextent_t(0x20000, 0x1000));
+    ASSERT_EQ(2u, b.get_extents().size());
+    ASSERT_LT(other_items0, allocated_items());
+    ASSERT_EQ(0x10000u, b.get_extents()[0].offset);
+    ASSERT_EQ(0x20000u, b.get_extents()[1].offset);
+  }
+  ASSERT_EQ(allocated_items(), other_items0);
+  ASSERT_EQ(allocated_bytes(), other_bytes0);
+}
+
 int main(int argc, char **argv) {
   auto args = argv_to_vec(argc, argv);
   auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
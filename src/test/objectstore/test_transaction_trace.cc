@@ -0,0 +1,133 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "include/stringify.h"
+#include "os/TransactionTrace.h"
+
+using namespace std;
+using ceph::os::Transaction;
+using ceph::os::TransactionTraceReader;
+using ceph::os::TransactionTraceWriter;
+using ceph::os::transaction_trace_record_t;
+
+class TransactionTraceTest : public ::testing::Test {
+protected:
+  const string path =
+    "ceph_test_transaction_trace.tmp." + stringify(getpid());
+
+  void TearDown() override {
+    ::unlink(path.c_str());
+  }
+
+  static ceph::buffer::list encoded(const Transaction& t) {
+    ceph::buffer::list bl;
+    encode(t, bl);
+    return bl;
+  }
+};
+
+TEST_F(TransactionTraceTest, RoundTrip)
+{
+  coll_t cid(spg_t(pg_t(1, 2), shard_id_t::NO_SHARD));
+  ghobject_t oid(hobject_t(sobject_t("obj", CEPH_NOSNAP)));
+  ceph::buffer::list data;
+  data.append(string(8192, 'x'));
+
+  Transaction t1;
+  t1.touch(cid, oid);
+  t1.write(cid, oid, 0, data.length(), data);
+  Transaction t2;
+  t2.setattr(cid, oid, "attr", data);
+  t2.truncate(cid, oid, 100);
+  Transaction t3;
+  t3.remove(cid, oid);
+
+  {
+    TransactionTraceWriter writer;
+    ASSERT_EQ(0, writer.open(path));
+    ASSERT_TRUE(writer.is_open());
+    writer.append(cid, {t1, t2});
+    writer.append(coll_t::meta(), {t3});
+    uint64_t records, bytes;
+    writer.get_stats(&records, &bytes);
+    EXPECT_EQ(2u, records);
+    ASSERT_EQ(0, writer.close());
+    EXPECT_FALSE(writer.is_open());
+    struct stat st;
+    ASSERT_EQ(0, ::stat(path.c_str(), &st));
+    EXPECT_EQ(bytes, (uint64_t)st.st_size);
+  }
+
+  TransactionTraceReader reader;
+  ASSERT_EQ(0, reader.open(path));
+  transaction_trace_record_t rec;
+  ASSERT_EQ(1, reader.next(&rec));
+  EXPECT_EQ(cid, rec.cid);
+  ASSERT_EQ(2u, rec.tls.size());
+  EXPECT_EQ(t1.get_num_ops(), rec.tls[0].get_num_ops());
+  EXPECT_TRUE(encoded(t1).contents_equal(encoded(rec.tls[0])));
+  EXPECT_TRUE(encoded(t2).contents_equal(encoded(rec.tls[1])));
+  uint64_t first_stamp = rec.stamp_ns;
+
+  ASSERT_EQ(1, reader.next(&rec));
+  EXPECT_EQ(coll_t::meta(), rec.cid);
+  ASSERT_EQ(1u, rec.tls.size());
+  EXPECT_TRUE(encoded(t3).contents_equal(encoded(rec.tls[0])));
+  EXPECT_LE(first_stamp, rec.stamp_ns);
+
+  EXPECT_EQ(0, reader.next(&rec));
+}
+
+TEST_F(TransactionTraceTest, Empty)
+{
+  TransactionTraceWriter writer;
+  ASSERT_EQ(0, writer.open(path));
+  ASSERT_EQ(0, writer.close());
+
+  TransactionTraceReader reader;
+  ASSERT_EQ(0, reader.open(path));
+  transaction_trace_record_t rec;
+  EXPECT_EQ(0, reader.next(&rec));
+}
+
+TEST_F(TransactionTraceTest, Truncated)
+{
+  coll_t cid(spg_t(pg_t(1, 2), shard_id_t::NO_SHARD));
+  ghobject_t oid(hobject_t(sobject_t("obj", CEPH_NOSNAP)));
+  Transaction t;
+  t.touch(cid, oid);
+  {
+    TransactionTraceWriter writer;
+    ASSERT_EQ(0, writer.open(path));
+    writer.append(cid, {t});
+    writer.append(cid, {t});
+    ASSERT_EQ(0, writer.close());
+  }
+  struct stat st;
+  ASSERT_EQ(0, ::stat(path.c_str(), &st));
+  ASSERT_EQ(0, ::truncate(path.c_str(), st.st_size - 1));
+
+  TransactionTraceReader reader;
+  ASSERT_EQ(0, reader.open(path));
+  transaction_trace_record_t rec;
+  EXPECT_EQ(1, reader.next(&rec));
+  EXPECT_EQ(-EIO, reader.next(&rec));
+}
+
+TEST_F(TransactionTraceTest, BadMagic)
+{
+  int fd = ::open(path.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+  ASSERT_LE(0, fd);
+  string junk(64, 'j');
+  ASSERT_EQ((ssize_t)junk.size(), ::write(fd, junk.data(), junk.size()));
+  ::close(fd);
+
+  TransactionTraceReader reader;
+  EXPECT_EQ(-EINVAL, reader.open(path));
+}
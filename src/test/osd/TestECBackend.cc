@@ -17,9 +17,13 @@
 #include <errno.h>
 #include <signal.h>
 #include "osd/ECBackend.h"
+#include "osd/ECTransaction.h"
+#include "erasure-code/ErasureCode.h"
+#include "global/global_context.h"
 #include "gtest/gtest.h"
 
 using namespace std;
+using ceph::bufferlist;
 
 TEST(ECUtil, stripe_info_t)
 {
@@ -60,3 +64,240 @@ TEST(ECUtil, stripe_info_t)
             make_pair((uint64_t)0, 2*swidth));
 }
 
+
+/// k data chunks and two coding chunks, the xor of all the data chunks
+/// and the xor of the odd ones, which can both be updated from deltas
+class ErasureCodeXor final : public ceph::ErasureCode {
+public:
+  static constexpr unsigned k = 4;
+  static constexpr unsigned m = 2;
+
+  unsigned int get_chunk_count() const override {
+    return k + m;
+  }
+  unsigned int get_data_chunk_count() const override {
+    return k;
+  }
+  unsigned int get_chunk_size(unsigned int object_size) const override {
+    return object_size / k;
+  }
+
+  static bool covers(int parity, int data) {
+    return parity == (int)k || data % 2;
+  }
+  static void xor_into(bufferlist &to, bufferlist from) {
+    char *t = to.c_str();
+    const char *f = from.c_str();
+    for (unsigned i = 0; i < to.length(); i++) {
+      t[i] ^= f[i];
+    }
+  }
+
+  int encode_chunks(const set<int> &want_to_encode,
+		    map<int, bufferlist> *encoded) override {
+    for (int j = k; j < (int)(k + m); j++) {
+      (*encoded)[j].zero();
+      for (int i = 0; i < (int)k; i++) {
+	if (covers(j, i)) {
+	  xor_into((*encoded)[j], (*encoded)[i]);
+	}
+      }
+    }
+    return 0;
+  }
+  int decode_chunks(const set<int> &want_to_read,
+		    const map<int, bufferlist> &chunks,
+		    map<int, bufferlist> *decoded) override {
+    return -EOPNOTSUPP;
+  }
+
+  bool supports_parity_delta() const override {
+    return true;
+  }
+  int apply_delta(const map<int, bufferlist> &deltas,
+		  map<int, bufferlist> *parity) override {
+    for (auto &&[j, p] : *parity) {
+      for (auto &&[i, d] : deltas) {
+	if (covers(j, i)) {
+	  xor_into(p, d);
+	}
+      }
+    }
+    return 0;
+  }
+};
+
+/// overwrites parts of an existing object through the parity delta
+/// path, and checks that the shards end up as a full re-encode of it
+class ECParityDeltaTest : public ::testing::Test {
+protected:
+  static constexpr unsigned k = ErasureCodeXor::k;
+  static constexpr unsigned m = ErasureCodeXor::m;
+  static constexpr uint64_t chunk_size = 4096;
+  static constexpr uint64_t stripe_width = k * chunk_size;
+  static constexpr uint64_t object_size = 4 * stripe_width;
+
+  ECUtil::stripe_info_t sinfo{k, stripe_width};
+  ceph::ErasureCodeInterfaceRef ec_impl{new ErasureCodeXor};
+  NoDoutPrefix dpp{g_ceph_context, ceph_subsys_osd};
+  pg_t pgid{0, 1};
+  // temp objects have no log entry to roll back
+  hobject_t oid{object_t("obj"), "", CEPH_NOSNAP, 0,
+		hobject_t::get_temp_pool(1), ""};
+  string data;
+  map<int, string> shards;
+
+  void SetUp() override {
+    for (uint64_t i = 0; i < object_size; i++) {
+      data.push_back(rand());
+    }
+    shards = encode(data);
+  }
+
+  map<int, string> encode(const string &content) {
+    bufferlist bl;
+    bl.append(content);
+    set<int> want;
+    for (unsigned i = 0; i < k + m; i++) {
+      want.insert(i);
+    }
+    map<int, bufferlist> encoded;
+    EXPECT_EQ(0, ECUtil::encode(sinfo, ec_impl, bl, want, &encoded));
+    map<int, string> ret;
+    for (auto &&[shard, chunks] : encoded) {
+      ret[shard] = chunks.to_str();
+    }
+    return ret;
+  }
+
+  /// apply what the transactions write to the shard objects
+  void apply(map<shard_id_t, ObjectStore::Transaction> &transactions,
+	     set<int> *written_shards) {
+    for (auto &&[shard, t] : transactions) {
+      auto i = t.begin();
+      while (i.have_op()) {
+	auto op = i.decode_op();
+	switch (op->op) {
+	case ObjectStore::Transaction::OP_WRITE:
+	  {
+	    ASSERT_EQ(ghobject_t(oid, ghobject_t::NO_GEN, shard),
+		      i.get_oid(op->oid));
+	    bufferlist bl;
+	    i.decode_bl(bl);
+	    ASSERT_EQ(op->len, bl.length());
+	    ASSERT_LE(op->off + op->len, shards[shard].size());
+	    shards[shard].replace(op->off, op->len, bl.to_str());
+	    written_shards->insert(shard);
+	  }
+	  break;
+	case ObjectStore::Transaction::OP_SETATTR:
+	  {
+	    i.decode_string();
+	    bufferlist bl;
+	    i.decode_bl(bl);
+	  }
+	  break;
+	default:
+	  FAIL() << "unexpected op " << op->op;
+	}
+      }
+    }
+  }
+
+  void overwrite(const vector<pair<uint64_t, uint64_t>> &writes,
+		 const set<int> &expected_shards) {
+    PGTransactionUPtr t(new PGTransaction);
+    for (auto &&[off, len] : writes) {
+      string update;
+      for (uint64_t i = 0; i < len; i++) {
+	update.push_back(rand());
+      }
+      data.replace(off, len, update);
+      bufferlist bl;
+      bl.append(update);
+      t->write(oid, off, len, bl);
+    }
+
+    ECUtil::HashInfoRef hinfo(new ECUtil::HashInfo(k + m));
+    hinfo->set_total_chunk_size_clear_hash(
+      sinfo.aligned_logical_offset_to_chunk_offset(object_size));
+    hinfo->set_projected_total_logical_size(sinfo, object_size);
+    auto plan = ECTransaction::get_write_plan(
+      sinfo, std::move(t),
+      [&](const hobject_t &) { return hinfo; },
+      &dpp);
+    ECTransaction::plan_parity_delta(plan, sinfo, ec_impl, &dpp);
+    ASSERT_EQ(1u, plan.delta_shards.count(oid));
+    ASSERT_EQ(expected_shards, plan.delta_shards.at(oid));
+
+    // what ECBackend reads: the data shards being written and the
+    // coding shards, for the stripes partially written
+    set<int> need = plan.delta_shards.at(oid);
+    for (unsigned j = k; j < k + m; j++) {
+      need.insert(j);
+    }
+    map<hobject_t, map<int, extent_map>> delta_chunks;
+    for (auto &&[off, len] : plan.to_read.at(oid)) {
+      uint64_t chunk_off = sinfo.aligned_logical_offset_to_chunk_offset(off);
+      uint64_t chunk_len = sinfo.aligned_logical_offset_to_chunk_offset(len);
+      for (int shard : need) {
+	bufferlist bl;
+	bl.append(shards[shard].substr(chunk_off, chunk_len));
+	delta_chunks[oid][shard].insert(chunk_off, chunk_len, bl);
+      }
+    }
+
+    map<shard_id_t, ObjectStore::Transaction> transactions;
+    for (unsigned i = 0; i < k + m; i++) {
+      transactions[shard_id_t(i)];
+    }
+    map<hobject_t, extent_map> written;
+    set<hobject_t> temp_added, temp_removed;
+    vector<pg_log_entry_t> entries;
+    ECTransaction::generate_transactions(
+      plan, ec_impl, pgid, sinfo, {}, delta_chunks, entries, &written,
+      &transactions, &temp_added, &temp_removed, &dpp);
+    ASSERT_TRUE(written[oid].empty());
+
+    set<int> written_shards;
+    apply(transactions, &written_shards);
+    ASSERT_EQ(need, written_shards);
+    auto expected = encode(data);
+    for (unsigned i = 0; i < k + m; i++) {
+      ASSERT_EQ(expected[i], shards[i]) << "shard " << i;
+    }
+  }
+};
+
+TEST_F(ECParityDeltaTest, SingleChunk)
+{
+  // unaligned head and tail in the second data chunk of a stripe
+  overwrite({{stripe_width + chunk_size + 100, 200}}, {1});
+}
+
+TEST_F(ECParityDeltaTest, AlignedChunk)
+{
+  overwrite({{stripe_width + 2 * chunk_size, chunk_size}}, {2});
+}
+
+TEST_F(ECParityDeltaTest, AcrossStripes)
+{
+  // from the last data chunk of a stripe into the first of the next one
+  overwrite({{2 * stripe_width - chunk_size + 10, chunk_size - 10 + 500}},
+	    {0, 3});
+}
+
+TEST_F(ECParityDeltaTest, SeveralStripes)
+{
+  // the same data chunk of stripes that are not contiguous
+  overwrite({{chunk_size + 5, 50},
+	     {2 * stripe_width + chunk_size + 1000, 3000}},
+	    {1});
+}
+
+TEST_F(ECParityDeltaTest, UnalignedTail)
+{
+  // ends one byte short of the end of the object
+  overwrite({{object_size - 300, 299}}, {3});
+  overwrite({{object_size - chunk_size - 7, 7}}, {2});
+}
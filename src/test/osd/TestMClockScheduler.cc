@@ -53,8 +53,8 @@ public:
   struct MockDmclockItem : public PGOpQueueable {
     op_scheduler_class scheduler_class;
 
-    MockDmclockItem(op_scheduler_class _scheduler_class) :
-      PGOpQueueable(spg_t()),
+    MockDmclockItem(op_scheduler_class _scheduler_class, spg_t pgid = spg_t()) :
+      PGOpQueueable(pgid),
       scheduler_class(_scheduler_class) {}
 
     MockDmclockItem()
@@ -254,3 +254,91 @@ TEST_F(mClockSchedulerTest, TestAllQueuesEnqueueDequeue) {
 
   ASSERT_TRUE(q.empty());
 }
+
+TEST_F(mClockSchedulerTest, TestPoolProfile) {
+  // the clients of pool 3 share a limit of a few requests per minute
+  g_ceph_context->_conf.set_val(
+    "osd_mclock_scheduler_client_profiles",
+    "{\"pool.3\": {\"lim\": 0.000001}}");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  spg_t pool3(pg_t(0, 3));
+  spg_t pool4(pg_t(0, 4));
+  q.enqueue(create_item(100, client1, op_scheduler_class::client, pool3));
+  q.enqueue(create_item(101, client2, op_scheduler_class::client, pool3));
+  q.enqueue(create_item(102, client3, op_scheduler_class::client, pool4));
+
+  std::map<uint64_t, unsigned> dequeued;
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_FALSE(q.empty());
+    auto r = get_item(q.dequeue());
+    dequeued[r.get_owner()]++;
+  }
+  ASSERT_EQ(1u, dequeued[client3]);
+  ASSERT_EQ(1u, dequeued[client1] + dequeued[client2]);
+
+  // the other pool 3 request waits for the pool limit
+  ASSERT_FALSE(q.empty());
+  WorkItem w = q.dequeue();
+  ASSERT_TRUE(std::get_if<double>(&w) != nullptr);
+
+  g_ceph_context->_conf.set_val("osd_mclock_scheduler_client_profiles", "");
+  g_ceph_context->_conf.apply_changes(nullptr);
+}
+
+TEST_F(mClockSchedulerTest, TestClientProfile) {
+  // client1 is capped, client2 of the same pool is not
+  g_ceph_context->_conf.set_val(
+    "osd_mclock_scheduler_client_profiles",
+    "{\"client.1001\": {\"lim\": 0.000001}}");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  spg_t pool3(pg_t(0, 3));
+  for (unsigned i = 0; i < 2; ++i) {
+    q.enqueue(create_item(100 + i, client1, op_scheduler_class::client, pool3));
+  }
+  for (unsigned i = 0; i < 3; ++i) {
+    q.enqueue(create_item(200 + i, client2, op_scheduler_class::client, pool3));
+  }
+
+  std::map<uint64_t, unsigned> dequeued;
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_FALSE(q.empty());
+    auto r = get_item(q.dequeue());
+    dequeued[r.get_owner()]++;
+  }
+  ASSERT_EQ(1u, dequeued[client1]);
+  ASSERT_EQ(3u, dequeued[client2]);
+  ASSERT_FALSE(q.empty());
+  WorkItem w = q.dequeue();
+  ASSERT_TRUE(std::get_if<double>(&w) != nullptr);
+
+  g_ceph_context->_conf.set_val("osd_mclock_scheduler_client_profiles", "");
+  g_ceph_context->_conf.apply_changes(nullptr);
+}
+
+TEST_F(mClockSchedulerTest, TestProfileChangeKeepsOrder) {
+  // client1's first ops are queued as client.1001, the next ones as
+  // pool.3 once it gets a profile
+  spg_t pool3(pg_t(0, 3));
+  for (unsigned i = 0; i < 3; ++i) {
+    q.enqueue(create_item(100 + i, client1, op_scheduler_class::client, pool3));
+  }
+  g_ceph_context->_conf.set_val(
+    "osd_mclock_scheduler_client_profiles",
+    "{\"pool.3\": {\"wgt\": 2}}");
+  g_ceph_context->_conf.apply_changes(nullptr);
+  for (unsigned i = 3; i < 6; ++i) {
+    q.enqueue(create_item(100 + i, client1, op_scheduler_class::client, pool3));
+  }
+
+  for (unsigned i = 0; i < 6; ++i) {
+    ASSERT_FALSE(q.empty());
+    auto r = get_item(q.dequeue());
+    ASSERT_EQ(100u + i, r.get_map_epoch());
+  }
+  ASSERT_TRUE(q.empty());
+
+  g_ceph_context->_conf.set_val("osd_mclock_scheduler_client_profiles", "");
+  g_ceph_context->_conf.apply_changes(nullptr);
+}
@@ -21,6 +21,7 @@
 
 #include <stdio.h>
 #include <signal.h>
+#include <random>
 #include "gtest/gtest.h"
 #include "osd/PGLog.h"
 #include "osd/OSDMap.h"
@@ -2234,7 +2235,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   log.add(modify);
 
   EXPECT_TRUE(log.logged_object(oid));
-  pg_log_entry_t *entry = log.objects[oid];
+  pg_log_entry_t *entry = log.objects.find(oid)->second;
   EXPECT_EQ(modify.op, entry->op);
   EXPECT_EQ(modify.version, entry->version);
   EXPECT_EQ(modify.prior_version, entry->prior_version);
@@ -2248,7 +2249,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   log.add(del);
 
   EXPECT_TRUE(log.logged_object(oid));
-  entry = log.objects[oid];
+  entry = log.objects.find(oid)->second;
   EXPECT_EQ(del.op, entry->op);
   EXPECT_EQ(del.version, entry->version);
   EXPECT_EQ(del.prior_version, entry->prior_version);
@@ -2261,7 +2262,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
 		   utime_t(20,1), -ENOENT));
 
   EXPECT_TRUE(log.logged_object(oid));
-  entry = log.objects[oid];
+  entry = log.objects.find(oid)->second;
   EXPECT_EQ(del.op, entry->op);
   EXPECT_EQ(del.version, entry->version);
   EXPECT_EQ(del.prior_version, entry->prior_version);
@@ -2673,6 +2674,72 @@ TEST_F(PGLogMergeDupsTest, Superset) {
   check_index();
 }
 
+class PGLogTrimRangeTest : public PGLogMergeDupsTest {
+public:
+  void TearDown() override {
+    g_ceph_context->_conf.set_val_or_die("osd_pg_log_trim_range_delete", "false");
+    clear();
+    StoreTestFixture::TearDown();
+  }
+
+  ghobject_t log_oid{hobject_t(object_t("log"), "", CEPH_NOSNAP, 0, 1, "")};
+
+  void write(write_stats_t *stats) {
+    ObjectStore::Transaction t;
+    map<string, bufferlist> km;
+    write_log_and_missing(t, &km, test_coll, log_oid, false, stats);
+    if (!km.empty()) {
+      t.omap_setkeys(test_coll, log_oid, km);
+    }
+    auto ch = store->open_collection(test_coll);
+    ASSERT_EQ(0, store->queue_transaction(ch, std::move(t)));
+  }
+
+  set<string> get_keys() {
+    set<string> keys;
+    auto ch = store->open_collection(test_coll);
+    store->omap_get_keys(ch, log_oid, &keys);
+    return keys;
+  }
+};
+
+TEST_F(PGLogTrimRangeTest, TrimRangeDelete) {
+  entity_name_t client = entity_name_t::CLIENT(777);
+  for (unsigned i = 1; i <= 10; ++i) {
+    add(pg_log_entry_t(pg_log_entry_t::MODIFY,
+		       hobject_t(object_t("obj"), "", CEPH_NOSNAP, i, 1, ""),
+		       eversion_t(1, i), eversion_t(1, i - 1), i,
+		       osd_reqid_t(client, 8, i), utime_t(), 0));
+  }
+  log.skip_can_rollback_to_to_head();
+  write(nullptr);
+  pg_info_t info;
+  info.last_complete = eversion_t(1, 10);
+
+  // one point delete per trimmed entry
+  trim(eversion_t(1, 4), info);
+  write_stats_t stats;
+  write(&stats);
+  EXPECT_EQ(4u, stats.keys_removed);
+  EXPECT_EQ(0u, stats.key_ranges_removed);
+
+  // a single range delete for all of them
+  g_ceph_context->_conf.set_val_or_die("osd_pg_log_trim_range_delete", "true");
+  trim(eversion_t(1, 7), info);
+  stats = write_stats_t();
+  write(&stats);
+  EXPECT_EQ(0u, stats.keys_removed);
+  EXPECT_EQ(1u, stats.key_ranges_removed);
+
+  auto keys = get_keys();
+  for (unsigned i = 1; i <= 10; ++i) {
+    EXPECT_EQ(i > 7 ? 1u : 0u, keys.count(eversion_t(1, i).get_key_name())) << i;
+  }
+  for (auto& d : log.dups) {
+    EXPECT_EQ(1u, keys.count(d.get_key_name()));
+  }
+}
+
 
 struct PGLogTrimTest :
   public ::testing::Test,
@@ -2984,6 +3051,44 @@ TEST(pg_log_dup_t, get_key_name) {
   EXPECT_EQ("dup_0000001234.00000000000000005678", a_key_name);
 }
 
+TEST(PGLogIndex, churn) {
+  // compare against a std::map through inserts, replacements and erases
+  // spanning several rehashes and probe run shifts
+  PGLogIndex<osd_reqid_t, pg_log_dup_t, &pg_log_dup_t::reqid> index;
+  std::map<osd_reqid_t, pg_log_dup_t*> ref;
+  std::list<pg_log_dup_t> dups;
+  entity_name_t client = entity_name_t::CLIENT(777);
+  std::mt19937 rng(42);
+
+  for (unsigned i = 0; i < 20000; ++i) {
+    osd_reqid_t reqid(client, 1, rng() % 2000);
+    if (rng() % 3) {
+      dups.emplace_back(eversion_t(1, i), i, reqid, 0);
+      index.insert_or_assign(&dups.back());
+      ref[reqid] = &dups.back();
+    } else {
+      EXPECT_EQ(ref.erase(reqid), index.erase(reqid));
+    }
+    ASSERT_EQ(ref.size(), index.size());
+  }
+  for (auto& [reqid, dup] : ref) {
+    auto it = index.find(reqid);
+    ASSERT_TRUE(it != index.end());
+    EXPECT_EQ(reqid, it->first);
+    EXPECT_EQ(dup, it->second);
+  }
+  size_t n = 0;
+  for (auto it = index.begin(); it != index.end(); ++it, ++n) {
+    EXPECT_EQ(1u, ref.count((*it).first));
+  }
+  EXPECT_EQ(ref.size(), n);
+
+  index.clear();
+  EXPECT_TRUE(index.empty());
+  EXPECT_EQ(0u, index.get_mem_usage());
+  EXPECT_TRUE(index.begin() == index.end());
+}
+
 
 // This tests trim() to make copies of
 // 2 log entries (107, 106) and 3 additional for a total
@@ -3025,6 +3130,15 @@ TEST_F(PGLogTrimTest, TestTrimDups) {
   EXPECT_EQ(eversion_t(20, 103), write_from_dups) << log;
   EXPECT_EQ(2u, log.log.size()) << log;
   EXPECT_EQ(4u, log.dups.size()) << log;
+
+  log.index();
+  PGLog::IndexedLog::mem_usage_t usage;
+  log.get_mem_usage(&usage);
+  EXPECT_EQ(2u, usage.entries);
+  EXPECT_EQ(4u, usage.dups);
+  EXPECT_LE(2 * sizeof(pg_log_entry_t), usage.entry_bytes);
+  EXPECT_LE(4 * sizeof(pg_log_dup_t), usage.dup_bytes);
+  EXPECT_LT(0u, usage.index_bytes);
 }
 
 // This tests trim() to make copies of
@@ -280,3 +280,111 @@ TEST(extentcache, write_write_overlap2)
 
   c.release_write_pin(pin3);
 }
+
+TEST(extentcache, clean_reuse)
+{
+  hobject_t oid;
+
+  ExtentCache c;
+  ExtentCache::write_pin pin;
+  c.open_write_pin(pin);
+
+  auto to_write = iset_from_vector({{0, 10}});
+  auto must_read = c.reserve_extents_for_rmw(
+    oid, pin, to_write, to_write);
+  ASSERT_EQ(must_read, to_write);
+  c.present_rmw_update(oid, pin, imap_from_iset(to_write));
+  c.release_write_pin(pin, true);
+  ASSERT_EQ(10u, c.get_clean_bytes());
+
+  // a later overlapping rmw only reads what was never written
+  ExtentCache::write_pin pin2;
+  c.open_write_pin(pin2);
+  auto to_read2 = iset_from_vector({{0, 2}, {8, 4}});
+  auto to_write2 = iset_from_vector({{0, 12}});
+  auto must_read2 = c.reserve_extents_for_rmw(
+    oid, pin2, to_write2, to_read2);
+  ASSERT_EQ(must_read2, iset_from_vector({{10, 2}}));
+  ASSERT_EQ(0u, c.get_clean_bytes());
+
+  auto pending_read = to_read2;
+  pending_read.subtract(must_read2);
+  auto pending = c.get_remaining_extents_for_rmw(
+    oid, pin2, pending_read);
+  ASSERT_EQ(pending.get_interval_set(), pending_read);
+
+  c.present_rmw_update(oid, pin2, imap_from_iset(to_write2));
+  c.release_write_pin(pin2, true);
+  ASSERT_EQ(12u, c.get_clean_bytes());
+
+  c.print(std::cerr);
+
+  // 0~10 and 10~2 were pinned separately
+  c.trim_clean(5);
+  ASSERT_EQ(2u, c.get_clean_bytes());
+  c.clear_clean();
+  ASSERT_EQ(0u, c.get_clean_bytes());
+}
+
+TEST(extentcache, clean_trim_lru)
+{
+  hobject_t oid1, oid2;
+  oid1.pool = 1;
+  oid2.pool = 2;
+
+  ExtentCache c;
+  ExtentCache::write_pin pin;
+  c.open_write_pin(pin);
+  auto to_write = iset_from_vector({{0, 10}});
+  c.reserve_extents_for_rmw(oid1, pin, to_write, extent_set());
+  c.present_rmw_update(oid1, pin, imap_from_iset(to_write));
+  c.release_write_pin(pin, true);
+
+  ExtentCache::write_pin pin2;
+  c.open_write_pin(pin2);
+  c.reserve_extents_for_rmw(oid2, pin2, to_write, extent_set());
+  c.present_rmw_update(oid2, pin2, imap_from_iset(to_write));
+  c.release_write_pin(pin2, true);
+  ASSERT_EQ(20u, c.get_clean_bytes());
+
+  // oid1 was released first and goes first
+  c.trim_clean(10);
+  ASSERT_EQ(10u, c.get_clean_bytes());
+
+  ExtentCache::write_pin pin3;
+  c.open_write_pin(pin3);
+  ASSERT_EQ(to_write,
+	    c.reserve_extents_for_rmw(oid1, pin3, to_write, to_write));
+  c.release_write_pin(pin3);
+
+  ExtentCache::write_pin pin4;
+  c.open_write_pin(pin4);
+  ASSERT_TRUE(
+    c.reserve_extents_for_rmw(oid2, pin4, to_write, to_write).empty());
+  c.release_write_pin(pin4);
+  ASSERT_EQ(0u, c.get_clean_bytes());
+
+  ExtentCacheBudget budget(100, 0.1);
+  budget.update(0, 30);
+  budget.update(0, 10);
+  ASSERT_EQ(40u, budget.get_used_bytes());
+  ASSERT_EQ(50u, budget.get_share());
+  budget.update(30, 0);
+  ASSERT_EQ(10u, budget.get_used_bytes());
+  ASSERT_EQ(100u, budget.get_share());
+  budget.set_max_bytes(20);
+  ASSERT_EQ(20u, budget.get_share());
+
+  // no share of the spare memory until an EC PG caches something
+  ASSERT_EQ(0.0, budget.get_cache_ratio());
+  budget.register_backend();
+  ASSERT_EQ(0.1, budget.get_cache_ratio());
+  budget.update(10, 0);
+  ASSERT_EQ(0.0, budget.get_cache_ratio());
+  budget.unregister_backend();
+
+  // what the autotuner assigns is capped
+  budget.set_cache_bytes(PriorityCache::Priority::LAST, 1 << 30);
+  ASSERT_EQ(20, budget.commit_cache_size(1ull << 32));
+  ASSERT_EQ(20u, budget.get_share());
+}
@@ -0,0 +1,44 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "osdc/Objecter.h"
+
+#include <gtest/gtest.h>
+
+using read_load_t = Objecter::read_load_t;
+
+TEST(ObjecterReadBalance, pick_lowest_expected_wait)
+{
+  // 1ms with 3 queued waits longer than 2ms with nothing queued
+  read_load_t load[] = {{1000, 3}, {2000, 0}, {1500, 1}};
+  ASSERT_EQ(1u, Objecter::pick_read_target(load, 3));
+
+  // the first one wins ties, i.e. the primary
+  read_load_t tie[] = {{1000, 1}, {2000, 0}, {500, 3}};
+  ASSERT_EQ(0u, Objecter::pick_read_target(tie, 3));
+}
+
+TEST(ObjecterReadBalance, pick_unknown_first)
+{
+  read_load_t load[] = {{10, 0}, {0, 5}, {0, 0}};
+  ASSERT_EQ(1u, Objecter::pick_read_target(load, 3));
+}
+
+TEST(ObjecterReadBalance, update_read_lat_ewma)
+{
+  // the first sample is taken as is
+  ASSERT_EQ(800u, Objecter::update_read_lat_ewma(0, 800));
+  // then weighs 1/8
+  ASSERT_EQ(900u, Objecter::update_read_lat_ewma(800, 1600));
+  ASSERT_EQ(700u, Objecter::update_read_lat_ewma(800, 0));
+  // and never brings it back to unknown
+  ASSERT_EQ(1u, Objecter::update_read_lat_ewma(0, 0));
+  ASSERT_EQ(1u, Objecter::update_read_lat_ewma(1, 0));
+
+  // converges to a steady latency
+  uint64_t ewma = 100;
+  for (int i = 0; i < 100; ++i) {
+    ewma = Objecter::update_read_lat_ewma(ewma, 5000);
+  }
+  ASSERT_NEAR(5000, (double)ewma, 10);
+}
@@ -0,0 +1,284 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation. See file COPYING.
+ */
+
+/*
+ * Replay a transaction trace recorded with the OSD admin socket command
+ * "objectstore_trace_start" against any ObjectStore backend, either at the
+ * original pace or accelerated, and report commit latency percentiles.
+ *
+ * The target store is expected to match the state the traced store was in
+ * when tracing started, e.g. a fresh mkfs for a trace of a new OSD.
+ */
+
+#include <boost/program_options/variables_map.hpp>
+#include <boost/program_options/parsers.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <set>
+#include <thread>
+
+#include "common/ceph_argparse.h"
+#include "common/ceph_mutex.h"
+#include "common/ceph_time.h"
+#include "common/errno.h"
+#include "global/global_init.h"
+#include "os/ObjectStore.h"
+#include "os/TransactionTrace.h"
+
+using namespace std;
+namespace po = boost::program_options;
+using ceph::os::transaction_trace_record_t;
+using ceph::os::TransactionTraceReader;
+
+namespace {
+
+struct ReplayState {
+  ceph::mutex lock = ceph::make_mutex("ReplayState::lock");
+  ceph::condition_variable cond;
+  unsigned inflight = 0;
+  vector<uint64_t> lat_ns;
+
+  void start() {
+    std::lock_guard l(lock);
+    ++inflight;
+  }
+  void finish(ceph::mono_time submitted) {
+    uint64_t lat = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      ceph::mono_clock::now() - submitted).count();
+    std::lock_guard l(lock);
+    lat_ns.push_back(lat);
+    --inflight;
+    cond.notify_all();
+  }
+  void wait_below(unsigned max) {
+    std::unique_lock l(lock);
+    cond.wait(l, [&] { return inflight < max; });
+  }
+};
+
+struct C_ReplayCommit : public Context {
+  ReplayState *state;
+  ceph::mono_time submitted;
+  C_ReplayCommit(ReplayState *s, ceph::mono_time t)
+    : state(s), submitted(t) {}
+  void finish(int r) override {
+    state->finish(submitted);
+  }
+};
+
+/// collections the transactions create, and those whose handle they
+/// remove or may replace
+void scan_collection_ops(vector<ObjectStore::Transaction>& tls,
+			 set<coll_t> *created,
+			 set<coll_t> *dropped)
+{
+  for (auto& t : tls) {
+    auto i = t.begin();
+    while (i.have_op()) {
+      auto op = i.decode_op();
+      switch (op->op) {
+      case ObjectStore::Transaction::OP_MKCOLL:
+	created->insert(i.get_cid(op->cid));
+	break;
+      case ObjectStore::Transaction::OP_RMCOLL:
+      case ObjectStore::Transaction::OP_MERGE_COLLECTION:
+	dropped->insert(i.get_cid(op->cid));
+	break;
+      case ObjectStore::Transaction::OP_SPLIT_COLLECTION2:
+	dropped->insert(i.get_cid(op->dest_cid));
+	break;
+      }
+    }
+  }
+}
+
+uint64_t percentile(const vector<uint64_t>& sorted, double p)
+{
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t i = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+  return sorted[i];
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv)
+{
+  string type, dpath, trace_path;
+  double speed = 1.0;
+  unsigned max_inflight = 64;
+
+  po::options_description desc("Allowed options");
+  desc.add_options()
+    ("help", "produce help message")
+    ("type", po::value<string>(&type)->default_value("bluestore"),
+     "Arg is one of [bluestore, memstore, kstore]")
+    ("data-path", po::value<string>(&dpath),
+     "path to object store, mandatory")
+    ("trace", po::value<string>(&trace_path),
+     "transaction trace to replay, mandatory")
+    ("mkfs", "create the object store before replaying")
+    ("speed", po::value<double>(&speed)->default_value(1.0),
+     "replay pace relative to the trace, 0 replays as fast as possible")
+    ("max-inflight", po::value<unsigned>(&max_inflight)->default_value(64),
+     "maximum number of uncommitted transactions")
+    ;
+
+  vector<string> ceph_option_strings;
+  po::variables_map vm;
+  try {
+    po::parsed_options parsed =
+      po::command_line_parser(argc, argv).options(desc).allow_unregistered().run();
+    po::store(parsed, vm);
+    po::notify(vm);
+    ceph_option_strings = po::collect_unrecognized(parsed.options,
+						   po::include_positional);
+  } catch(po::error &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  if (vm.count("help")) {
+    std::cerr << desc << std::endl;
+    return 1;
+  }
+  if (dpath.empty() || trace_path.empty()) {
+    std::cerr << "must specify --data-path and --trace" << std::endl;
+    std::cerr << desc << std::endl;
+    return 1;
+  }
+  if (speed < 0 || max_inflight == 0) {
+    std::cerr << "--speed must be >= 0 and --max-inflight > 0" << std::endl;
+    return 1;
+  }
+
+  vector<const char *> ceph_options;
+  ceph_options.reserve(ceph_option_strings.size());
+  for (auto& i : ceph_option_strings) {
+    ceph_options.push_back(i.c_str());
+  }
+
+  auto cct = global_init(
+    NULL, ceph_options,
+    CEPH_ENTITY_TYPE_OSD,
+    CODE_ENVIRONMENT_UTILITY_NODOUT,
+    CINIT_FLAG_NO_MON_CONFIG);
+  common_init_finish(g_ceph_context);
+
+  TransactionTraceReader reader;
+  int r = reader.open(trace_path);
+  if (r < 0) {
+    std::cerr << "unable to open trace " << trace_path << ": "
+	      << cpp_strerror(r) << std::endl;
+    return 1;
+  }
+
+  std::unique_ptr<ObjectStore> store = ObjectStore::create(
+    g_ceph_context, type, dpath);
+  if (!store) {
+    std::cerr << "Unable to create store of type " << type << std::endl;
+    return 1;
+  }
+  if (vm.count("mkfs")) {
+    r = store->mkfs();
+    if (r < 0) {
+      std::cerr << "mkfs failed: " << cpp_strerror(r) << std::endl;
+      return 1;
+    }
+  }
+  r = store->mount();
+  if (r < 0) {
+    std::cerr << "mount failed: " << cpp_strerror(r) << std::endl;
+    return 1;
+  }
+
+  ReplayState state;
+  map<coll_t, ObjectStore::CollectionHandle> colls;
+  uint64_t num_records = 0, num_ops = 0;
+  auto replay_start = ceph::mono_clock::now();
+
+  while (true) {
+    transaction_trace_record_t rec;
+    r = reader.next(&rec);
+    if (r <= 0) {
+      break;
+    }
+    if (rec.tls.empty()) {
+      continue;
+    }
+    set<coll_t> created, dropped;
+    scan_collection_ops(rec.tls, &created, &dropped);
+    // like the OSD, get a new handle for each collection created, even
+    // if one with the same cid was removed earlier in the trace
+    for (auto& cid : created) {
+      colls[cid] = store->create_new_collection(cid);
+    }
+    auto p = colls.find(rec.cid);
+    if (p == colls.end()) {
+      ObjectStore::CollectionHandle ch;
+      if (store->collection_exists(rec.cid)) {
+	ch = store->open_collection(rec.cid);
+      } else {
+	// the trace started after this collection was created
+	ch = store->create_new_collection(rec.cid);
+	ObjectStore::Transaction t;
+	t.create_collection(rec.cid, 0);
+	store->queue_transaction(ch, std::move(t));
+      }
+      p = colls.emplace(rec.cid, ch).first;
+    }
+
+    if (speed > 0) {
+      std::this_thread::sleep_until(
+	replay_start + ceph::make_timespan(rec.stamp_ns / speed / 1e9));
+    }
+    state.wait_below(max_inflight);
+
+    for (auto& t : rec.tls) {
+      num_ops += t.get_num_ops();
+    }
+    state.start();
+    rec.tls.back().register_on_commit(
+      new C_ReplayCommit(&state, ceph::mono_clock::now()));
+    store->queue_transactions(p->second, rec.tls);
+    ++num_records;
+    // reopened on their next use
+    for (auto& cid : dropped) {
+      colls.erase(cid);
+    }
+  }
+  if (r < 0) {
+    std::cerr << "error reading trace after " << num_records << " records: "
+	      << cpp_strerror(r) << std::endl;
+  }
+
+  state.wait_below(1);
+  double secs = ceph::to_seconds<double>(ceph::mono_clock::now() - replay_start);
+  colls.clear();
+  store->umount();
+
+  auto& lat = state.lat_ns;
+  std::sort(lat.begin(), lat.end());
+  std::cout << "replayed " << num_records << " records (" << num_ops
+	    << " ops) in " << secs << "s, "
+	    << (secs > 0 ? num_records / secs : 0) << " records/s" << std::endl;
+  std::cout << "commit latency (us):"
+	    << " p50 " << percentile(lat, .5) / 1000
+	    << " p90 " << percentile(lat, .9) / 1000
+	    << " p99 " << percentile(lat, .99) / 1000
+	    << " p99.9 " << percentile(lat, .999) / 1000
+	    << " max " << (lat.empty() ? 0 : lat.back() / 1000)
+	    << std::endl;
+  return r < 0 ? 1 : 0;
+}